@@ -1,12 +1,56 @@
 #ifndef CMD_ARGS_H
 #define CMD_ARGS_H
 
+#include "sink.h"
+#include "dendrites.h"
+#include "placement.h"
+#include "soma_step.h"
+#include "network.h"
+
 /**
  * Container for values given in the command line.
  */
 typedef struct CmdArgs {
   int num_dendrs; // The number of dendrites to simulate.
   int num_comps;  // The number of compartments per dendrite.
+  int plot;       // Nonzero if results should be plotted after the run.
+  int quiet;      // Nonzero if progress should not be printed.
+  SinkType output_type; // Where results are sent.
+  char *output_name;    // Output file/object name, NULL for the default.
+  int events;           // Nonzero to output spike events instead of Vm.
+  double spike_threshold; // Spike detection threshold, mV.
+  KernelOpts kernel;    // Dendrite kernel selection.
+  int split;            // Processes per dendrite (mpi_hh), 0 to choose.
+  int num_threads;      // Worker threads advancing the dendrites (seq_hh).
+  PlaceOpts place;      // CPU and memory placement of the dendrites.
+  int bench_placement;  // Nonzero to benchmark the placement and exit.
+  int bench_shapes;     // Nonzero to benchmark the shape kernels and exit.
+  int autotune;         // 1 to pick the fastest configuration, 2 to retune.
+  char *tune_file;      // Where tuned configurations are cached.
+  SomaMethod soma;      // Soma integrator.
+  double ps_tol;        // Parker-Sochacki tolerance.
+  int validate_soma;    // Nonzero to validate the soma integrators and exit.
+  int soma_substeps;    // Soma steps per dendrite step (multi-rate).
+  int hold_current;     // Nonzero to hold the dendritic current over them.
+  int wr_window;        // Waveform relaxation window in steps, 0 for off.
+  double wr_tol;        // Waveform relaxation tolerance, mV.
+  int shm_reduce;       // Nonzero to exchange through node shared memory.
+  int validate_reduce;  // Nonzero to validate the reduced model and exit.
+  int validate_kernel;  // Nonzero to validate the dendrite kernel and exit.
+  int duration;         // Simulated time in ms.
+  char *serve;          // Socket to serve simulation jobs on, or NULL.
+  char *connect;        // Socket of the server to send the job to, or NULL.
+  int shutdown;         // Nonzero if the job stops the server.
+  char *stimulus;       // Stimulus file, NULL for the built-in generator.
+  int stim_window;      // Milliseconds of the stimulus file mapped at a time.
+  char *write_stimulus; // File to write the built-in stimulus to, or NULL.
+  char *dendr_params;   // Per-dendrite parameter file, or NULL.
+  char *snapshot;       // File to write the end state of the run to, or NULL.
+  int telemetry;        // Nonzero to publish progress in shared memory.
+  char *telemetry_name; // Shared memory object for it, NULL for the default.
+  NetOpts net;          // Network of neurons (mpi_hh), neurons 0 for none.
+  char *record;         // File to record every dendrite to (mpi_hh), or NULL.
+  int record_buffer;    // Milliseconds buffered between writes to it.
 } CmdArgs;
 
 /**
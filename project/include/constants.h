@@ -10,6 +10,83 @@
 #define DENDRCONDCOMP 1000  // Lateral compartmental conductance, nS
 #define DENDRCONDDISTR 100  // Deviation of compartmental conductance, nS
 
+// Spike detection on the soma potential.
+#define SPIKE_THRESHOLD 0     // Upward crossing that marks a spike, mV
+#define SPIKE_REARM -30       // Potential must fall below this to re-arm, mV
+#define SPIKE_REFRACTORY 1.0  // Minimum time between spikes, ms
+
+// Defaults for the temporally blocked dendrite kernel.
+#define BLOCK_STEPS 16        // Integration steps per block
+#define BLOCK_TILE 512        // Compartments per tile
+
+// Jacobi dendrite kernel (-k jacobi).
+#define DENDR_LANES 4         // Compartments updated per vector operation
+
+// Compartment counts (-c) with fused and Jacobi kernels of their own. The
+// Makefile sets the list from SHAPES.
+#ifndef DENDR_SHAPES
+#define DENDR_SHAPES( X ) X(10) X(100) X(1000)
+#endif
+#define SHAPE_BENCH_UPDATES 20000000  // Compartment steps per timed run
+
+// Dendrite kernel validation (--validate-kernel).
+#define KERNEL_TOLERANCE 0.01  // Allowed deviation from the reference, mV
+
+// Soma integrator validation (--validate-soma).
+#define SOMA_SPIKE_TOLERANCE 0.05  // Allowed first spike shift, ms
+
+// Parker-Sochacki soma integrator (--soma parker-sochacki).
+#define PS_TOL 1e-9           // Default tolerance on the last series terms
+#define PS_MAX_ORDER 24       // Highest series order before halving the step
+#define PS_MAX_HALVINGS 12    // Halvings of a step before accepting it
+#define SOMA_BENCH_DV 0.01    // Accuracy the integrators are timed at, mV
+
+// Reduced dendrite model validation (--validate-reduce).
+#define REDUCE_TOLERANCE 1e-6  // Allowed deviation from the full model, mV
+
+// Worker threads (seq_hh -t).
+#define BARRIER_SPINS 2000    // Spins before a waiting worker yields the CPU
+#define BENCH_REPEATS 3       // Runs per configuration in benchmarks
+#define STEAL_CHUNK_COMPS 1024  // Compartments per work stealing chunk
+
+// Auto-tuning (seq_hh --autotune).
+#define TUNE_MS 1             // Simulated time per calibration window, ms
+#define TUNE_FILE "hh_tune.txt"  // Default tuning cache
+
+// Performance history (hh_perf).
+#define PERF_FILE "hh_perf.txt"  // Default history file
+#define PERF_THRESHOLD 10.0   // Slowdown flagged as a regression, percent
+
+// Differential testing (hh_check).
+#define CHECK_DENDRITES "3,6"         // Default dendrite counts
+#define CHECK_COMPARTMENTS "8,30,100" // Default compartment counts
+#define CHECK_PROCS "2,3"             // Default process and thread counts
+#define CHECK_DURATION 15     // Simulated time per run, ms
+#define CHECK_EXACT 1e-9      // Tolerance of the exact engines, mV and ms
+#define CHECK_INEXACT -1.0    // Tolerance of engines that are only reported
+#define CHECK_MPIRUN "mpirun -np"  // Command starting mpi_hh
+
+// Live telemetry (hhtop).
+#define TEL_PREFIX "/hh_tel_"  // Telemetry blocks are TEL_PREFIX<pid>
+#define HHTOP_INTERVAL 1.0    // Seconds between hhtop refreshes
+
+// Spiking networks (mpi_hh --neurons).
+#define NET_FAN_IN 10         // Synapses onto each neuron
+#define NET_WEIGHT 20.0       // Potential step per spike, mV
+#define NET_MIN_DELAY 1.0     // Shortest axonal delay, ms
+#define NET_MAX_DELAY 3.0     // Longest axonal delay, ms
+#define NET_SEED 1            // Seed of the random network
+
+// Waveform relaxation (mpi_hh --wr-window).
+#define WR_TOL 1e-6           // Default convergence tolerance, mV
+#define WR_MAX_ITERS 50       // Iterations per window before giving up
+
+// Parallel recording (mpi_hh --record).
+#define REC_BUFFER_MS 10      // Milliseconds buffered between writes
+
+// Stimulus files (--stimulus).
+#define STIM_WINDOW 1         // Milliseconds of samples mapped at a time
+
 #define FNAME_LEN 80        // Filename lengths.
 
 #endif
@@ -0,0 +1,126 @@
+#ifndef DENDR_BLOCK_H
+#define DENDR_BLOCK_H
+
+/**
+ * Per-dendrite state of the temporally blocked dendrite kernel.
+ *
+ * dendriteStep() sweeps the whole dendrite once per integration step. For
+ * long dendrites that streams the full voltage array through the cache for a
+ * tiny update per compartment. Only the compartment next to the soma needs the
+ * soma potential of the current step though: compartment j at step s depends
+ * on compartment j-1 at step s and on compartment j+1 at step s-1. So at the
+ * start of a block of K steps, compartments far from the soma can be advanced
+ * K steps at once, tile by tile (skewed/trapezoidal tiles of `tile'
+ * compartments), while the staircase of the K compartments closest to the
+ * soma is finished one step at a time as the soma potential becomes known.
+ *
+ * Every compartment goes through exactly the same floating point operations,
+ * in the same order, as in dendriteStep(), so results match the reference
+ * kernel to within 1e-9 mV (bitwise on IEEE 754 hardware without fused
+ * multiply-add contraction).
+ */
+typedef struct DendrBlock {
+  int num_comps;      // Compartments, including the dummy and the soma.
+  int block_steps;    // Maximum number of steps per block (K).
+  int tile;           // Compartments per tile.
+  int len;            // Steps in the current block.
+  double *cur;        // Tip injected current for each step of the block.
+  double *stair_old;  // Value of v_d[m-k] before it was advanced to step k.
+  double *edge_old;   // Tile edge values before the step-k update.
+} DendrBlock;
+
+/**
+ * Name: dendrUpdateRange
+ *
+ * Description:
+ * Advances compartments lo..hi-1 of a dendrite by one integration step, left
+ * to right, exactly as dendriteStep() does. Compartment j is stored at
+ * v[j-offset], so the range may live in an array holding only part of the
+ * dendrite, as long as its neighbours v[lo-1-offset] and v[hi-offset] are
+ * there too. Compartment 1 receives the tip current `cur'.
+ *
+ * Parameters:
+ * @param v             (INOUT) membrane potentials
+ * @param offset        index of compartment 0 relative to v
+ * @param num_comps     compartments in the whole dendrite, incl. dummy and soma
+ * @param lo            first compartment to advance
+ * @param hi            one past the last compartment to advance
+ * @param left_old      value of compartment lo-1 before it reached this step
+ * @param cur           current injected at the tip for this step
+ * @param dt            integration time step size
+ */
+void dendrUpdateRange( double *v, int offset, int num_comps, int lo, int hi,
+                       double left_old, double cur, double dt );
+
+/**
+ * Name: dendrBlockInit
+ *
+ * Description:
+ * Allocates the scratch space of a blocked dendrite kernel.
+ *
+ * Parameters:
+ * @param blk           kernel state to initialize
+ * @param num_comps     number of compartments, including dummy and soma
+ * @param block_steps   maximum number of steps per block
+ * @param tile          compartments per tile
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int dendrBlockInit( DendrBlock *blk, int num_comps, int block_steps,
+                    int tile );
+
+/**
+ * Name: dendrBlockFree
+ *
+ * Description:
+ * Releases the scratch space of a blocked dendrite kernel.
+ *
+ * Parameters:
+ * @param blk       kernel state to free
+ */
+void dendrBlockFree( DendrBlock *blk );
+
+/**
+ * Name: dendrBlockBegin
+ *
+ * Description:
+ * Starts a block of `len' integration steps and performs the first one. All
+ * compartments that do not depend on future soma potentials are advanced as
+ * far as possible. The tip current of each step of the block must be in
+ * blk->cur[0..len-1].
+ *
+ * Parameters:
+ * @param blk           kernel state
+ * @param v_d           (INOUT) membrane potentials of the dendrite
+ * @param len           number of steps in this block (1..block_steps)
+ * @param delta_t       integration time step size
+ * @param v_m           soma membrane potential
+ *
+ * Returns:
+ * @return double       current injected by this dendrite into soma
+ */
+double dendrBlockBegin( DendrBlock *blk, double *v_d, int len,
+                        double delta_t, double v_m );
+
+/**
+ * Name: dendrBlockStep
+ *
+ * Description:
+ * Performs step `k' (1..len-1) of the current block. Only the compartments
+ * within k of the soma still need updating.
+ *
+ * Parameters:
+ * @param blk           kernel state
+ * @param v_d           (INOUT) membrane potentials of the dendrite
+ * @param k             step within the block
+ * @param delta_t       integration time step size
+ * @param v_m           soma membrane potential
+ *
+ * Returns:
+ * @return double       current injected by this dendrite into soma
+ */
+double dendrBlockStep( DendrBlock *blk, double *v_d, int k, double delta_t,
+                       double v_m );
+
+#endif
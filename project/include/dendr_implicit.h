@@ -0,0 +1,31 @@
+#ifndef DENDR_IMPLICIT_H
+#define DENDR_IMPLICIT_H
+
+/**
+ * Name: dendrImplicitSolve
+ *
+ * Description:
+ * Advances a dendrite by one backward Euler step. The compartments form a
+ * tridiagonal system (each one is coupled to its two neighbours, the soma
+ * potential is held at `v_m' over the step) that is solved directly with the
+ * Thomas algorithm, so the step is stable for any `delta_t'. dendriteStep()
+ * is explicit: the coupling conductances make its step size limit about the
+ * model step (1/STEPS ms), which rules it out for coarse dendrite steps.
+ *
+ * The conductances are those of dendriteStep().
+ *
+ * Parameters:
+ * @param v_d           (INOUT) membrane potentials of the dendrite
+ * @param scratch       scratch space for 2*num_comps doubles
+ * @param cur           current injected at the tip for this step
+ * @param num_comps     number of compartments, including dummy and soma
+ * @param delta_t       integration time step size
+ * @param v_m           soma membrane potential
+ *
+ * Returns:
+ * @return double       current injected by this dendrite into soma
+ */
+double dendrImplicitSolve( double *v_d, double *scratch, double cur,
+                           int num_comps, double delta_t, double v_m );
+
+#endif
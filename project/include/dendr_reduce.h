@@ -0,0 +1,55 @@
+#ifndef DENDR_REDUCE_H
+#define DENDR_REDUCE_H
+
+#include "dendrites.h"
+#include "soma_step.h"
+
+#include <stdio.h>
+
+/**
+ * Name: dendrReduceValidate
+ *
+ * Description:
+ * Simulates the cell for COMPTIME ms twice, once with every dendrite and
+ * once with the dendrites collapsed into one equivalent cable (see
+ * dendrSetInit()), and reports the largest difference of the once per ms
+ * soma trace, the spike counts and both run times.
+ *
+ * Parameters:
+ * @param num_dendrs    number of dendrites
+ * @param num_comps     compartments per dendrite, incl. dummy and soma
+ * @param opts          kernel used by both runs (its reduce flag is ignored)
+ * @param method        soma integrator
+ * @param out           where the report goes
+ *
+ * Returns:
+ * @return int          nonzero if the traces agree to REDUCE_TOLERANCE mV
+ *                      and the spike counts match
+ */
+int dendrReduceValidate( int num_dendrs, int num_comps, KernelOpts *opts,
+                         SomaMethod method, FILE *out );
+
+/**
+ * Name: dendrKernelValidate
+ *
+ * Description:
+ * Simulates the cell for COMPTIME ms with the reference kernel and with
+ * opts->kernel, and reports the largest and mean difference of the once per
+ * ms soma trace, the shift of the first spike, the spike counts and both
+ * run times.
+ *
+ * Parameters:
+ * @param num_dendrs    number of dendrites
+ * @param num_comps     compartments per dendrite, incl. dummy and soma
+ * @param opts          kernel to validate (its reduce flag is ignored)
+ * @param method        soma integrator
+ * @param out           where the report goes
+ *
+ * Returns:
+ * @return int          nonzero if the traces agree to KERNEL_TOLERANCE mV
+ *                      and the spike counts match
+ */
+int dendrKernelValidate( int num_dendrs, int num_comps, KernelOpts *opts,
+                         SomaMethod method, FILE *out );
+
+#endif
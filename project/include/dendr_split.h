@@ -0,0 +1,125 @@
+#ifndef DENDR_SPLIT_H
+#define DENDR_SPLIT_H
+
+#include "repro_sum.h"
+
+#include <mpi.h>
+
+// MPI tags of the halo exchange (mpi_hh.c uses 1 to 3).
+#define TAG_HALO_TO_SOMA  4   // Last compartment, sent towards the soma.
+#define TAG_HALO_TO_TIP   5   // First compartment, sent towards the tip.
+
+/**
+ * Part of a group of dendrites whose compartments are split across several
+ * processes (compartment-level domain decomposition).
+ *
+ * The `parts' processes of a group each own a contiguous range of compartments
+ * of every dendrite of the group. Part 0 owns the compartments next to the
+ * soma and is the only one that exchanges currents with the soma; part
+ * parts-1 owns the tip. Within a step, compartment j needs compartment j-1 at
+ * the same step and j+1 at the previous step, so at each step a part
+ *
+ *   - receives the new value of compartment lo-1 from its tip-side neighbour,
+ *   - sends its new first compartment back to that neighbour, which needs it
+ *     one step later,
+ *   - sends its new last compartment to its soma-side neighbour.
+ *
+ * Only one value per dendrite crosses each boundary per step, and the parts
+ * form a pipeline: the tip-side parts run up to one step ahead of their
+ * soma-side neighbour. The arithmetic is that of dendriteStep(), so results
+ * do not depend on the number of parts.
+ */
+typedef struct DendrSplit {
+  int num_dendrs;       // Dendrites in the group.
+  int num_comps;        // Compartments per dendrite, incl. dummy and soma.
+  int lo, hi;           // This part owns compartments lo..hi-1.
+  int tip_rank;         // Tip-side neighbour, MPI_PROC_NULL for the tip.
+  int soma_rank;        // Soma-side neighbour, MPI_PROC_NULL next to soma.
+  MPI_Comm comm;        // Communicator the ranks refer to.
+  double **volt;        // Compartments lo-1..hi of each dendrite.
+  double *from_tip;     // Compartment lo-1 of each dendrite, this step.
+  double *from_soma;    // Compartment hi of each dendrite, previous step.
+  double *to_tip;       // First owned compartments, being sent.
+  double *to_soma;      // Last owned compartments, being sent.
+  double *first_old;    // First owned compartments before this step.
+  MPI_Request req_from_soma, req_to_tip, req_to_soma;
+  int started;          // Nonzero once the first step was taken.
+  ReproSum sum;         // Current injected into the soma, last step.
+} DendrSplit;
+
+/**
+ * Name: dendrSplitChoose
+ *
+ * Description:
+ * Picks how many processes should share each dendrite. Only divisors of
+ * `num_procs' are considered, so that every process belongs to a group. The
+ * one giving the fewest compartments on the busiest process wins; ties go to
+ * the smaller value, which needs less communication.
+ *
+ * Parameters:
+ * @param num_procs     number of processes
+ * @param num_dendrs    number of dendrites
+ * @param num_comps     compartments per dendrite (as given by the user)
+ *
+ * Returns:
+ * @return int          number of processes per dendrite
+ */
+int dendrSplitChoose( int num_procs, int num_dendrs, int num_comps );
+
+/**
+ * Name: dendrSplitInit
+ *
+ * Description:
+ * Sets up one part of a split group of dendrites and initializes its
+ * compartments to the rest voltage. The ranks of part p of the group are
+ * expected to be `rank' - p + q for part q, i.e. consecutive, starting with the
+ * part next to the soma.
+ *
+ * Parameters:
+ * @param split         part to initialize
+ * @param num_dendrs    number of dendrites in the group
+ * @param num_comps     compartments per dendrite, incl. dummy and soma
+ * @param parts         number of processes sharing the group
+ * @param part          which part this process owns (0 is next to the soma)
+ * @param rank          rank of this process in `comm'
+ * @param comm          communicator of the group
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int dendrSplitInit( DendrSplit *split, int num_dendrs, int num_comps,
+                    int parts, int part, int rank, MPI_Comm comm );
+
+/**
+ * Name: dendrSplitFree
+ *
+ * Description:
+ * Completes the outstanding halo exchange and releases the memory held by a
+ * part. Every part of the group must call it after the same number of steps.
+ *
+ * Parameters:
+ * @param split     part to free
+ */
+void dendrSplitFree( DendrSplit *split );
+
+/**
+ * Name: dendrSplitStep
+ *
+ * Description:
+ * Advances the compartments of this part by one integration step. Dendrite
+ * `d' of the group is given seed `step + d + 1', as with dendrSetStep().
+ *
+ * Parameters:
+ * @param split     part to advance
+ * @param step      integration step within the current millisecond
+ * @param delta_t   integration time step size
+ * @param v_m       soma membrane potential (only used by part 0)
+ *
+ * Returns:
+ * @return double   current injected into the soma by the group (part 0), or
+ *                  0 for the other parts; also left in split->sum
+ */
+double dendrSplitStep( DendrSplit *split, int step, double delta_t,
+                       double v_m );
+
+#endif
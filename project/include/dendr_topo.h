@@ -0,0 +1,230 @@
+#ifndef DENDR_TOPO_H
+#define DENDR_TOPO_H
+
+#include <stdio.h>
+
+/**
+ * Electrical parameters of a dendrite that can differ from the defaults of
+ * hh_model.h and constants.h.
+ */
+typedef struct DendrParams {
+  double g_scale;     // Factor on the lateral conductances.
+  double cap;         // Compartment capacitance, pF (Cd by default).
+  double inj_scale;   // Factor on the current injected at the tip.
+} DendrParams;
+
+/**
+ * Parameters of a range of dendrites, as read from a parameter file.
+ */
+typedef struct DendrOverride {
+  int first, last;    // Dendrites first..last of the cell.
+  DendrParams params; // Their parameters.
+} DendrOverride;
+
+/**
+ * Per-dendrite parameters of a cell. Dendrites not covered by any entry get
+ * the defaults; where entries overlap, the last one wins.
+ */
+typedef struct DendrOverrides {
+  int count;            // Entries in `list'.
+  DendrOverride *list;  // Entries, in file order.
+} DendrOverrides;
+
+/**
+ * A dendrite shape, built once and shared by all the dendrites with the same
+ * compartment count and parameters.
+ *
+ * dendriteStep() rebuilds the conductances of every compartment at every
+ * step (two divisions each, twice) and sweeps the dendrite twice, once for
+ * the first RK4 slopes and once for the update. A shape holds the
+ * conductances to either side of each compartment and their sums, so
+ * dendrTopoStep() needs no divisions by the compartment position and makes a
+ * single pass: compartment j only needs the old value of compartment j-1,
+ * which is kept in a register. Each of the four RK4 slopes still divides by
+ * the capacitance, as dendriteStep() does. With the default parameters every
+ * compartment goes through the same floating point operations as in
+ * dendriteStep(), so the results are bitwise identical.
+ */
+typedef struct DendrTopo {
+  int num_comps;      // Compartments, including the dummy and the soma.
+  DendrParams params; // Parameters the shape was built for.
+  double *g_before;   // Conductance to the tip-side neighbour, 0 for the tip.
+  double *g_after;    // Conductance to the soma-side neighbour.
+  double *g_sum;      // g_before + g_after.
+  double (*step)( const struct DendrTopo *, double *, double, double,
+                  double );         // Fused kernel for this shape.
+  double (*step_jacobi)( const struct DendrTopo *, double *, double, double,
+                         double );  // Jacobi kernel for this shape.
+} DendrTopo;
+
+/**
+ * A fused or Jacobi kernel, see dendrTopoStep().
+ */
+typedef double (*DendrTopoStepFn)( const DendrTopo *topo, double *v_d,
+                                   double cur, double delta_t, double v_m );
+
+/**
+ * Name: dendrParamsDefault
+ *
+ * Description:
+ * Sets the parameters of hh_model.h and constants.h.
+ *
+ * Parameters:
+ * @param params    (OUTPUT) default parameters
+ */
+void dendrParamsDefault( DendrParams *params );
+
+/**
+ * Name: dendrOverridesLoad
+ *
+ * Description:
+ * Reads a parameter file. Each line holds a dendrite or a range of them
+ * (`first-last', numbered from 0 in the cell) followed by the conductance
+ * factor, the compartment capacitance in pF and the tip current factor;
+ * `#' starts a comment.
+ *
+ * Parameters:
+ * @param ov        (OUTPUT) per-dendrite parameters
+ * @param path      file to read
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int dendrOverridesLoad( DendrOverrides *ov, const char *path );
+
+/**
+ * Name: dendrOverridesFree
+ *
+ * Description:
+ * Releases the entries of a parameter file.
+ *
+ * Parameters:
+ * @param ov        parameters to free
+ */
+void dendrOverridesFree( DendrOverrides *ov );
+
+/**
+ * Name: dendrOverridesLookup
+ *
+ * Description:
+ * Returns the parameters of one dendrite of the cell.
+ *
+ * Parameters:
+ * @param ov        per-dendrite parameters, NULL for the defaults
+ * @param dendrite  index of the dendrite in the cell
+ * @param params    (OUTPUT) its parameters
+ */
+void dendrOverridesLookup( const DendrOverrides *ov, int dendrite,
+                           DendrParams *params );
+
+/**
+ * Name: dendrTopoInit
+ *
+ * Description:
+ * Builds a dendrite shape and picks its kernels with dendrTopoKernel().
+ *
+ * Parameters:
+ * @param topo          shape to build
+ * @param num_comps     compartments, including dummy and soma
+ * @param params        electrical parameters
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int dendrTopoInit( DendrTopo *topo, int num_comps,
+                   const DendrParams *params );
+
+/**
+ * Name: dendrTopoFree
+ *
+ * Description:
+ * Releases a dendrite shape.
+ *
+ * Parameters:
+ * @param topo      shape to free
+ */
+void dendrTopoFree( DendrTopo *topo );
+
+/**
+ * Name: dendrTopoStep
+ *
+ * Description:
+ * Advances a dendrite of the given shape by one integration step, in a
+ * single pass from the tip to the soma.
+ *
+ * Parameters:
+ * @param topo      shape of the dendrite
+ * @param v_d       (INOUT) membrane potentials
+ * @param cur       current injected at the tip, pA, before inj_scale
+ * @param delta_t   integration time step size
+ * @param v_m       soma membrane potential
+ *
+ * Returns:
+ * @return double   current injected by this dendrite into soma
+ */
+double dendrTopoStep( const DendrTopo *topo, double *v_d, double cur,
+                      double delta_t, double v_m );
+
+/**
+ * Name: dendrTopoStepJacobi
+ *
+ * Description:
+ * Like dendrTopoStep(), but every RK4 slope of a compartment sees the old
+ * potentials of both neighbours (a Jacobi rather than a Gauss-Seidel
+ * ordering). Compartment j then no longer waits for the new value of j-1,
+ * so DENDR_LANES consecutive compartments are updated with each vector
+ * operation. The results differ from the reference kernel by a small
+ * amount, which --validate-kernel reports.
+ *
+ * Parameters:
+ * @param topo      shape of the dendrite
+ * @param v_d       (INOUT) membrane potentials
+ * @param cur       current injected at the tip, pA, before inj_scale
+ * @param delta_t   integration time step size
+ * @param v_m       soma membrane potential
+ *
+ * Returns:
+ * @return double   current injected by this dendrite into soma
+ */
+double dendrTopoStepJacobi( const DendrTopo *topo, double *v_d, double cur,
+                            double delta_t, double v_m );
+
+/**
+ * Name: dendrTopoKernel
+ *
+ * Description:
+ * Returns the fused or Jacobi kernel for dendrites of `num_comps'
+ * compartments. Every count of DENDR_SHAPES has kernels of its own, the
+ * same code compiled with the count as a constant: the loops then have a
+ * known trip count, the Jacobi kernel knows at compile time whether it has
+ * a remainder, and short dendrites are unrolled completely. They give
+ * bitwise the same results as dendrTopoStep() and dendrTopoStepJacobi(),
+ * which are returned for any other count.
+ *
+ * Parameters:
+ * @param num_comps     compartments, including dummy and soma
+ * @param jacobi        nonzero for the Jacobi kernel, zero for the fused one
+ *
+ * Returns:
+ * @return DendrTopoStepFn  kernel to advance such dendrites with
+ */
+DendrTopoStepFn dendrTopoKernel( int num_comps, int jacobi );
+
+/**
+ * Name: dendrTopoBenchmark
+ *
+ * Description:
+ * Times the generic fused and Jacobi kernels against the specialized ones
+ * for every count of DENDR_SHAPES and reports the gains, and whether both
+ * gave bitwise the same potentials.
+ *
+ * Parameters:
+ * @param num_dendrs    dendrites advanced per step
+ * @param out           where to write the report
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int dendrTopoBenchmark( int num_dendrs, FILE *out );
+
+#endif
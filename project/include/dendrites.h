@@ -0,0 +1,226 @@
+#ifndef DENDRITES_H
+#define DENDRITES_H
+
+#include "dendr_block.h"
+#include "dendr_implicit.h"
+#include "dendr_topo.h"
+#include "placement.h"
+#include "stimulus.h"
+#include "repro_sum.h"
+
+#include <stddef.h>
+
+/**
+ * Available dendrite kernels.
+ */
+typedef enum DendrKernel {
+  KERNEL_REFERENCE = 0, // dendriteStep(), one sweep per step.
+  KERNEL_BLOCKED,       // Temporally blocked sweeps, see dendr_block.h.
+  KERNEL_IMPLICIT,      // Backward Euler, see dendr_implicit.h.
+  KERNEL_FUSED,         // Precomputed shapes, one sweep, see dendr_topo.h.
+  KERNEL_JACOBI         // Precomputed shapes, vectorized Jacobi sweep.
+} DendrKernel;
+
+/**
+ * Kernel selection and tuning parameters.
+ */
+typedef struct KernelOpts {
+  DendrKernel kernel;   // Which kernel advances the dendrites.
+  int block_steps;      // Steps per block (KERNEL_BLOCKED).
+  int tile;             // Compartments per tile (KERNEL_BLOCKED).
+  int steps_per_ms;     // Dendrite steps per ms, STEPS unless multi-rate.
+  int reduce;           // Nonzero to collapse a set into one cable.
+  int steal;            // Nonzero to balance threads by work stealing.
+} KernelOpts;
+
+/**
+ * The dendrites simulated by one process.
+ */
+typedef struct DendrSet {
+  int first;          // Index of the first dendrite in the whole cell.
+  int num_dendrs;     // Number of dendrites in the set.
+  int num_comps;      // Compartments per dendrite, incl. dummy and soma.
+  int num_cables;     // Cables simulated: num_dendrs, or 1 if reduced.
+  KernelOpts opts;    // Kernel used to advance them.
+  double **volt;      // Membrane potential of each compartment.
+  double *slab;       // Memory behind `volt', one row per dendrite.
+  size_t slab_size;   // Bytes mapped for `slab'.
+  double *currents;   // Current injected by each dendrite at the last step;
+                      // if reduced, the total is in currents[0].
+  ReproSum sum;       // Exact total of `currents'.
+  double tip_sum;     // Sum of the tip currents at the last step (reduced).
+  int last_step;      // Step `tip_sum' belongs to, -1 for none.
+  DendrBlock *blocks; // Per-dendrite state of the blocked kernel.
+  double *scratch;    // Solver scratch space of the implicit kernel.
+  const Stimulus *stim; // Tip currents, NULL for the built-in generator.
+  int stim_first;     // Index of the first dendrite in `stim'.
+  DendrTopo *topos;   // Distinct shapes of the fused and Jacobi kernels.
+  int num_topos;      // Shapes in `topos'.
+  int *topo_of;       // Index in `topos' of each dendrite.
+} DendrSet;
+
+/**
+ * Name: dendrParseKernel
+ *
+ * Description:
+ * Converts a kernel name (reference, blocked, implicit, fused or jacobi) to
+ * a DendrKernel.
+ *
+ * Parameters:
+ * @param name      name of the kernel
+ * @param kernel    (OUTPUT) matching kernel
+ *
+ * Returns:
+ * @return int      0 if the name is unknown, nonzero otherwise
+ */
+int dendrParseKernel( const char *name, DendrKernel *kernel );
+
+/**
+ * Name: dendrKernelName
+ *
+ * Description:
+ * Returns the name of a kernel, as accepted by dendrParseKernel.
+ *
+ * Parameters:
+ * @param kernel    kernel to name
+ *
+ * Returns:
+ * @return const char*  name of the kernel
+ */
+const char *dendrKernelName( DendrKernel kernel );
+
+/**
+ * Name: dendrSetInit
+ *
+ * Description:
+ * Allocates a set of dendrites and initializes the potential of every
+ * compartment to the rest voltage. The potentials live in a single slab
+ * allocated according to `place'; since the calling thread writes them
+ * first, their pages are local to it unless `place' binds them elsewhere.
+ *
+ * With opts->reduce the set is simulated as one equivalent cable. The
+ * dendrites are linear, identical and all see the same soma potential, so
+ * the sum of their currents is exactly (up to rounding) the current of one
+ * cable driven by their mean tip current, times their number. Consecutive
+ * dendrites get consecutive seeds, so that mean is updated in O(1) per step
+ * and a step costs the same as for a single dendrite. The blocked, fused
+ * and Jacobi kernels are replaced by the reference one.
+ *
+ * Parameters:
+ * @param set           set to initialize
+ * @param first         index of the first dendrite of the set in the cell
+ * @param num_dendrs    number of dendrites
+ * @param num_comps     compartments per dendrite, incl. dummy and soma
+ * @param opts          kernel selection
+ * @param place         page size and binding of the slab
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int dendrSetInit( DendrSet *set, int first, int num_dendrs, int num_comps,
+                  KernelOpts *opts, PlaceOpts *place );
+
+/**
+ * Name: dendrSetReset
+ *
+ * Description:
+ * Puts every compartment of a set back to the rest voltage, as after
+ * dendrSetInit, without reallocating anything.
+ *
+ * Parameters:
+ * @param set       set to reset
+ */
+void dendrSetReset( DendrSet *set );
+
+/**
+ * Name: dendrSetStimulus
+ *
+ * Description:
+ * Drives the tips of a set from `stim' instead of the built-in generator.
+ * Dendrite `d' of the set reads the currents of dendrite `first + d' of the
+ * stimulus; with the generator, that index replaces `first' in the seeds.
+ *
+ * Parameters:
+ * @param set       set of dendrites
+ * @param stim      stimulus, NULL for the built-in generator
+ * @param first     index in `stim' of the first dendrite of the set
+ */
+void dendrSetStimulus( DendrSet *set, const Stimulus *stim, int first );
+
+/**
+ * Name: dendrSetParams
+ *
+ * Description:
+ * Gives the dendrites of a set the parameters of `ov'. Does nothing unless
+ * the set uses the fused or Jacobi kernel with whole dendrites.
+ * Dendrite `d' of the set gets those of dendrite `first + d' of the cell.
+ * One shape is built per distinct set of parameters and shared by all the
+ * dendrites that have them.
+ *
+ * Parameters:
+ * @param set       set of dendrites
+ * @param ov        per-dendrite parameters, NULL for the defaults
+ * @param first     index in the cell of the first dendrite of the set
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int dendrSetParams( DendrSet *set, const DendrOverrides *ov, int first );
+
+/**
+ * Name: dendrSetFree
+ *
+ * Description:
+ * Releases the memory held by a set of dendrites.
+ *
+ * Parameters:
+ * @param set       set to free
+ */
+void dendrSetFree( DendrSet *set );
+
+/**
+ * Name: dendrSetStep
+ *
+ * Description:
+ * Advances every dendrite of the set by one integration step. Dendrite `d'
+ * of the set is given seed `step + first + d + 1', as in the original step
+ * loop, unless a stimulus file drives the set (see dendrSetStimulus). `step'
+ * must count up from 0 within each millisecond, to
+ * opts.steps_per_ms - 1. The current of
+ * each dendrite is left in `currents' and their exact total in `sum', which
+ * can be merged with those of other sets (see repro_sum.h).
+ *
+ * Parameters:
+ * @param set       set to advance
+ * @param step      integration step within the current millisecond
+ * @param delta_t   integration time step size
+ * @param v_m       soma membrane potential
+ *
+ * Returns:
+ * @return double   total current injected by the set into the soma
+ */
+double dendrSetStep( DendrSet *set, int step, double delta_t, double v_m );
+
+/**
+ * Name: dendrSetStepRange
+ *
+ * Description:
+ * Advances dendrites begin..end-1 of a set by one integration step, as
+ * dendrSetStep() does for all of them, and adds their currents to `sum'.
+ * Disjoint ranges of the same set can be advanced by different threads at
+ * once, each with its own `sum' and `scratch'. Not for reduced sets.
+ *
+ * Parameters:
+ * @param set       set of dendrites
+ * @param step      integration step within the current millisecond
+ * @param delta_t   integration time step size
+ * @param v_m       soma membrane potential
+ * @param begin     first dendrite of the range
+ * @param end       one past the last dendrite of the range
+ * @param scratch   2 * num_comps doubles for the implicit kernel
+ * @param sum       (INOUT) exact total the currents are added to
+ */
+void dendrSetStepRange( DendrSet *set, int step, double delta_t, double v_m,
+                        int begin, int end, double *scratch, ReproSum *sum );
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+/**
+ * A synaptic event waiting to be delivered: a step in the potential of one
+ * compartment.
+ */
+typedef struct SynEvent {
+  double *v;          // Potential of the target compartment.
+  double weight;      // Step to add to it, mV.
+} SynEvent;
+
+/**
+ * The events due at one integration step, in the order they were queued.
+ */
+typedef struct EventBin {
+  SynEvent *events;   // Events, contiguous.
+  int count;          // Events queued.
+  int size;           // Room in `events'.
+} EventBin;
+
+/**
+ * Events queued by delivery step. Bin `step & mask' holds the events due at
+ * `step', so queuing and delivering are O(1) per event and need no sorting;
+ * the ring covers more steps than the longest delay, so an event never wraps
+ * onto a step still to come. A bin keeps its memory once emptied, so after
+ * the first few periods of activity no more memory is allocated and
+ * delivery walks one contiguous array per step.
+ */
+typedef struct EventRing {
+  EventBin *bins;     // mask + 1 bins, a power of two.
+  int mask;           // Number of bins minus one.
+  long queued;        // Events queued so far.
+} EventRing;
+
+/**
+ * Name: eventRingInit
+ *
+ * Description:
+ * Allocates an empty ring for delays of up to `horizon' steps.
+ *
+ * Parameters:
+ * @param ring      ring to initialize
+ * @param horizon   longest delay, steps
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int eventRingInit( EventRing *ring, int horizon );
+
+/**
+ * Name: eventRingPush
+ *
+ * Description:
+ * Queues an event for delivery at `step', which must be later than the last
+ * step delivered and no more than `horizon' steps after it.
+ *
+ * Parameters:
+ * @param ring      ring of events
+ * @param step      step the event is due at
+ * @param v         potential of the target compartment
+ * @param weight    step to add to it, mV
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int eventRingPush( EventRing *ring, int step, double *v, double weight );
+
+/**
+ * Name: eventRingDeliver
+ *
+ * Description:
+ * Applies the events due at `step', in the order they were queued, and
+ * empties their bin.
+ *
+ * Parameters:
+ * @param ring      ring of events
+ * @param step      step about to be simulated
+ *
+ * Returns:
+ * @return int      number of events delivered
+ */
+int eventRingDeliver( EventRing *ring, int step );
+
+/**
+ * Name: eventRingFree
+ *
+ * Description:
+ * Releases the memory held by a ring.
+ *
+ * Parameters:
+ * @param ring      ring to free
+ */
+void eventRingFree( EventRing *ring );
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef FIELDS_H
+#define FIELDS_H
+
+/**
+ * Name: splitFields
+ *
+ * Description:
+ * Splits a line of a '|' separated table (tuning files, hh_perf histories)
+ * in place and trims the blanks and newline around every field.
+ *
+ * Parameters:
+ * @param line      (INOUT) line to split, NUL terminated
+ * @param fields    (OUTPUT) start of each field, within `line'
+ * @param max       largest number of fields to split off; the last one
+ *                  keeps the rest of the line
+ *
+ * Returns:
+ * @return int      number of fields found, at most `max'
+ */
+int splitFields( char *line, char **fields, int max );
+
+#endif
@@ -0,0 +1,20 @@
+/*
+  Model parameters shared by the soma and dendrite integrators.
+*/
+
+#ifndef HH_MODEL_H
+#define HH_MODEL_H
+
+// Parameters for cell of 20,000 micometer surface area (2e-4 cm^2)
+#define gL  10      // Leak soma conductance, nS
+#define gLd 0.01    // Leak dendrite compartment conductance, nS
+#define gK  6000    // K soma conductance, nS
+#define gNa 20000   // Na soma conductance, nS
+#define Cs  200     // Soma capacitance, pF
+#define Cd  0.1     // Compartment dendrite capacitance, pF
+#define ENa 50      // Na reversal potential, mV
+#define EK -90      // K reversal potential, mV
+#define EL -65      // Leak reversal potential, mV
+#define Vr -65      // Resting membrane potential, mV
+
+#endif
@@ -31,6 +31,26 @@
 double dendriteStep( double *v_d, int seed, int num_comps, double delta_t,
                      double v_m );
 
+/**
+ * Name: dendriteStepCurrent
+ *
+ * Description:
+ * Same as dendriteStep(), with the current injected at the tip given instead
+ * of drawn from the random number generator.
+ *
+ * Parameters:
+ * @param v_d           (INOUT) membrane potential
+ * @param cur           (INPUT) current injected at the tip, pA
+ * @param num_comps     (INPUT) number of compartments in dendrite
+ * @param delta_t       (INPUT) integration time step size
+ * @param v_m           (INPUT) soma membrane potential
+ *
+ * Returns:
+ * @return double       current injected by this dendrite into soma
+ */
+double dendriteStepCurrent( double *v_d, double cur, int num_comps,
+                            double delta_t, double v_m );
+
 /**
  * Name: rk4Step
  *
@@ -70,6 +90,50 @@ void rk4Step( double *y, double *y0, double *dydt0, int nv, double *fp,
  */
 void soma( double *dydx, double *y, double *param );
 
+/**
+ * Name: rushLarsenStep
+ *
+ * Description:
+ * Advances the soma by one step with the Rush-Larsen (exponential Euler)
+ * scheme. With the membrane potential held at its value at the start of the
+ * step, each gate obeys a linear equation that is solved exactly; then, with
+ * those gates held, so does the potential. Unlike rk4Step(), this is stable
+ * for any step size, though only first order accurate.
+ *
+ * Parameters:
+ * @param y       (INOUT) soma state: Vm, n, m and h
+ * @param param   (INPUT) dt, injected current and dendritic current, as for
+ *                        soma()
+ */
+void rushLarsenStep( double *y, double *param );
+
+/**
+ * Name: parkerSochackiStep
+ *
+ * Description:
+ * Advances the soma by one step with the Parker-Sochacki method (Stewart &
+ * Bair, 2009). The state is expanded as a power series in time; the rates
+ * are series of exp() of the potential, whose coefficients follow from
+ * w' = u' w, and the products and quotients of series are taken term by
+ * term, so each new order costs one pass over the previous ones. Orders are
+ * added until two consecutive ones change the state by less than `tol'; if
+ * that does not happen by PS_MAX_ORDER, the step is beyond the radius of
+ * convergence and is taken as two half steps instead. After PS_MAX_HALVINGS
+ * halvings the series is summed as it is, or if it is not even finite, the
+ * step is taken with rk4Step().
+ *
+ * Parameters:
+ * @param y       (INOUT) soma state: Vm, n, m and h
+ * @param param   (INPUT) dt, injected current and dendritic current, as for
+ *                        soma()
+ * @param tol     (INPUT) largest change of the state, mV or gate fraction,
+ *                        left out of the series
+ *
+ * Returns:
+ * @return int    series orders summed, over all the half steps taken
+ */
+int parkerSochackiStep( double *y, double *param, double tol );
+
 /**
  * Name: dendrite
  *
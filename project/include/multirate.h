@@ -0,0 +1,103 @@
+#ifndef MULTIRATE_H
+#define MULTIRATE_H
+
+/**
+ * Coupling between dendrites and soma when they use different step sizes.
+ *
+ * The soma takes `ratio' steps of dt for every dendrite step of ratio*dt.
+ * Within the millisecond, dendrite step k is taken before soma step k*ratio,
+ * so the soma always integrates against a current that is already known:
+ *
+ *   - the dendrites see the mean soma potential over the soma steps since
+ *     their previous step (the potential at the end of each of them), which
+ *     interpolates the soma onto the coarse grid;
+ *   - the soma sees the dendritic current interpolated linearly between the
+ *     last two dendrite steps, reaching the newest value on its last substep,
+ *     or that newest value held over all substeps.
+ *
+ * With ratio 1 both reduce to the original step loop, bit for bit.
+ */
+typedef struct MultiRate {
+  int ratio;        // Soma steps per dendrite step.
+  int hold;         // Nonzero to hold the current instead of interpolating.
+  double i_prev;    // Dendritic current of the previous dendrite step.
+  double i_curr;    // Dendritic current of the last dendrite step.
+  double v_sum;     // Soma potential summed since the last dendrite step.
+  double v_seen;    // Soma potential the dendrites see at their next step.
+} MultiRate;
+
+/**
+ * Name: multiRateInit
+ *
+ * Description:
+ * Initializes the coupling state, with no dendritic current yet.
+ *
+ * Parameters:
+ * @param mr        state to initialize
+ * @param ratio     soma steps per dendrite step
+ * @param hold      nonzero to hold the dendritic current over the substeps
+ * @param v_m       initial soma membrane potential
+ */
+void multiRateInit( MultiRate *mr, int ratio, int hold, double v_m );
+
+/**
+ * Name: multiRateDendrStep
+ *
+ * Description:
+ * Tells whether the dendrites advance before soma step `step'.
+ *
+ * Parameters:
+ * @param mr        coupling state
+ * @param step      soma step within the current millisecond
+ *
+ * Returns:
+ * @return int      nonzero if the dendrites advance, 0 otherwise
+ */
+int multiRateDendrStep( MultiRate *mr, int step );
+
+/**
+ * Name: multiRateSetCurrent
+ *
+ * Description:
+ * Records the total current of a dendrite step.
+ *
+ * Parameters:
+ * @param mr        coupling state
+ * @param current   current injected by the dendrites into the soma
+ */
+void multiRateSetCurrent( MultiRate *mr, double current );
+
+/**
+ * Name: multiRateCurrent
+ *
+ * Description:
+ * Returns the dendritic current the soma integrates against at `step'.
+ *
+ * Parameters:
+ * @param mr        coupling state
+ * @param step      soma step within the current millisecond
+ *
+ * Returns:
+ * @return double   dendritic current for this soma step
+ */
+double multiRateCurrent( MultiRate *mr, int step );
+
+/**
+ * Name: multiRateSomaDone
+ *
+ * Description:
+ * Records the soma potential at the end of soma step `step'. After the last
+ * substep of a dendrite step `v_seen' holds the potential the dendrites see
+ * next.
+ *
+ * Parameters:
+ * @param mr        coupling state
+ * @param step      soma step within the current millisecond
+ * @param v_m       soma membrane potential after the step
+ *
+ * Returns:
+ * @return int      nonzero if that was the last substep, 0 otherwise
+ */
+int multiRateSomaDone( MultiRate *mr, int step, double v_m );
+
+#endif
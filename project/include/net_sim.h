@@ -0,0 +1,61 @@
+#ifndef NET_SIM_H
+#define NET_SIM_H
+
+#include "cmd_args.h"
+#include "constants.h"
+#include "dendrites.h"
+#include "spike.h"
+
+#include <mpi.h>
+
+/**
+ * A spike of a neuron, as exchanged between processes.
+ */
+typedef struct NetSpike {
+  int neuron;         // Neuron that spiked.
+  int step;           // Integration step the spike was detected in.
+  double time;        // Interpolated spike time, ms.
+} NetSpike;
+
+/**
+ * A neuron simulated by this process: a soma and its dendrites.
+ */
+typedef struct Neuron {
+  int index;          // Index of the neuron in the network.
+  DendrSet dendrites; // Its dendrites, whole.
+  double y[ NUMVAR ]; // Soma state.
+  double y0[ NUMVAR ], dydt[ NUMVAR ];  // Soma integrator scratch.
+  SpikeDetector spikes; // Finds the action potentials of the soma.
+} Neuron;
+
+/**
+ * Name: netSimulate
+ *
+ * Description:
+ * Simulates the network described by cmd_args->net (mpi_hh --neurons or
+ * --network). The neurons are dealt out to the processes round robin (see
+ * netOwner); each process advances its neurons step by step, looks for
+ * spikes in their soma potential and delivers the synaptic events queued
+ * for the step, which add to the potential of their target compartments.
+ *
+ * Spikes only reach their targets after the axonal delay, so a process can
+ * run for as many steps as the shortest delay anywhere in the network
+ * without hearing from the others: whatever the others send during that
+ * time is due after it. The spikes are therefore exchanged in batches, one
+ * MPI_Allgatherv every batch of steps instead of one per step, and queued
+ * in an EventRing by delivery step. The received spikes are put in (step,
+ * neuron) order before they are queued, so the results do not depend on
+ * the number of processes. Must be called by all processes of `comm'.
+ *
+ * Parameters:
+ * @param cmd_args      command line arguments
+ * @param rank          rank of this process in `comm'
+ * @param num_procs     number of processes in `comm'
+ * @param comm          communicator of the simulation
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int netSimulate( CmdArgs *cmd_args, int rank, int num_procs, MPI_Comm comm );
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+/**
+ * How a network of neurons is built (mpi_hh --neurons).
+ */
+typedef struct NetOpts {
+  int neurons;        // Neurons in the network, 0 for a single cell.
+  char *file;         // Synapse file, NULL for a random network.
+  int fan_in;         // Synapses onto each neuron of a random network.
+  double weight;      // Potential step per spike of a random network, mV.
+  double min_delay;   // Shortest axonal delay of a random network, ms.
+  double max_delay;   // Longest axonal delay of a random network, ms.
+  unsigned seed;      // Seed of the random network.
+  int batch;          // Steps between spike exchanges, 0 for the min delay.
+  char *raster;       // File to write every spike to, or NULL.
+} NetOpts;
+
+/**
+ * A connection from the soma of one neuron to a dendrite compartment of
+ * another. Each spike of the source adds `weight' to the potential of the
+ * compartment `delay' steps later.
+ */
+typedef struct Synapse {
+  int source;         // Neuron whose spikes the synapse carries.
+  int target;         // Neuron it connects to.
+  int dendrite;       // Dendrite of the target.
+  int comp;           // Compartment of that dendrite, 0 at the tip.
+  double weight;      // Step in the potential of the compartment, mV.
+  int delay;          // Axonal delay, integration steps.
+} Synapse;
+
+/**
+ * The synapses onto the neurons of one process, grouped by source so that
+ * the targets of a spike are contiguous.
+ */
+typedef struct Network {
+  int num_neurons;    // Neurons in the whole network.
+  int num_synapses;   // Synapses kept, onto the neurons of this process.
+  int total_synapses; // Synapses in the whole network.
+  Synapse *syn;       // Kept synapses, by source, in file or build order.
+  int *first;         // syn[first[n]..first[n+1]-1] leave neuron n.
+  int min_delay;      // Shortest delay in the whole network, steps.
+  int max_delay;      // Longest delay in the whole network, steps.
+} Network;
+
+/**
+ * Name: netDefaults
+ *
+ * Description:
+ * Sets the network options to a single cell and the defaults of
+ * constants.h.
+ *
+ * Parameters:
+ * @param opts      (OUTPUT) default options
+ */
+void netDefaults( NetOpts *opts );
+
+/**
+ * Name: netOwner
+ *
+ * Description:
+ * Returns the process that simulates a neuron. Neurons are dealt out round
+ * robin, so every process gets neurons from all over the network.
+ *
+ * Parameters:
+ * @param neuron        index of the neuron
+ * @param num_procs     number of processes
+ *
+ * Returns:
+ * @return int          rank of the owner
+ */
+int netOwner( int neuron, int num_procs );
+
+/**
+ * Name: netBuild
+ *
+ * Description:
+ * Reads the synapses of a network from opts->file, one `SOURCE TARGET
+ * DENDRITE COMPARTMENT WEIGHT_MV DELAY_MS' line each, or draws a random
+ * network where every neuron gets opts->fan_in synapses from other neurons
+ * at random dendrites and compartments, with delays uniform between the
+ * minimum and the maximum. Every process reads or draws the whole network,
+ * so all of them agree on it, and keeps the synapses onto its own neurons.
+ * Delays are rounded to integration steps and must be at least one.
+ *
+ * Parameters:
+ * @param net           (OUTPUT) synapses onto the neurons of this process
+ * @param opts          how to build the network
+ * @param num_dendrs    dendrites per neuron
+ * @param num_comps     compartments per dendrite (as given by the user)
+ * @param rank          rank of this process
+ * @param num_procs     number of processes
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int netBuild( Network *net, const NetOpts *opts, int num_dendrs,
+              int num_comps, int rank, int num_procs );
+
+/**
+ * Name: netFree
+ *
+ * Description:
+ * Releases the memory held by a network.
+ *
+ * Parameters:
+ * @param net       network to free
+ */
+void netFree( Network *net );
+
+#endif
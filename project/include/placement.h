@@ -0,0 +1,170 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+
+#define PLACE_MAX_CPUS 256   // Longest CPU list accepted by --pin.
+
+/**
+ * How workers are pinned to CPUs.
+ */
+typedef enum PinMode {
+  PIN_NONE = 0,   // Leave scheduling to the kernel.
+  PIN_COMPACT,    // Worker i on the i-th allowed CPU.
+  PIN_SCATTER,    // Round robin over sockets, then over their CPUs.
+  PIN_LIST        // Worker i on cpus[i % num_cpus].
+} PinMode;
+
+/**
+ * Page size backing the dendrite state.
+ */
+typedef enum HugePages {
+  HUGE_OFF = 0,   // Regular pages.
+  HUGE_THP,       // Transparent huge pages (madvise), 2 MiB aligned.
+  HUGE_EXPLICIT   // MAP_HUGETLB from the hugetlbfs pool, THP if none left.
+} HugePages;
+
+/**
+ * Memory and CPU placement of the workers advancing the dendrites.
+ */
+typedef struct PlaceOpts {
+  PinMode pin;                  // Pinning policy.
+  int num_cpus;                 // CPUs in `cpus' (PIN_LIST).
+  int cpus[ PLACE_MAX_CPUS ];   // Explicit CPU list (PIN_LIST).
+  HugePages huge;               // Page size of the state slab.
+  int first_touch;              // Nonzero if each worker initializes its own
+                                // dendrites (so their pages are local to it).
+  int mbind;                    // Nonzero to bind each slab to the NUMA node
+                                // of the CPU allocating it.
+} PlaceOpts;
+
+/**
+ * Name: placeDefaults
+ *
+ * Description:
+ * Fills in the default placement: no pinning, regular pages, first touch by
+ * the owning worker and no explicit binding.
+ *
+ * Parameters:
+ * @param opts      (OUTPUT) placement options
+ */
+void placeDefaults( PlaceOpts *opts );
+
+/**
+ * Name: placeParsePin
+ *
+ * Description:
+ * Parses a pinning policy: none, compact, scatter or a comma separated list
+ * of CPUs and CPU ranges (e.g. 0-3,8,10-11).
+ *
+ * Parameters:
+ * @param spec      policy given on the command line
+ * @param opts      (OUTPUT) placement options updated with the policy
+ *
+ * Returns:
+ * @return int      0 if the policy is invalid, nonzero otherwise
+ */
+int placeParsePin( const char *spec, PlaceOpts *opts );
+
+/**
+ * Name: placeParseHuge
+ *
+ * Description:
+ * Converts a huge page mode (off, thp or explicit) to a HugePages.
+ *
+ * Parameters:
+ * @param name      name of the mode
+ * @param huge      (OUTPUT) matching mode
+ *
+ * Returns:
+ * @return int      0 if the name is unknown, nonzero otherwise
+ */
+int placeParseHuge( const char *name, HugePages *huge );
+
+/**
+ * Name: placeDescribe
+ *
+ * Description:
+ * Writes a one line description of the placement, e.g. for benchmark
+ * reports.
+ *
+ * Parameters:
+ * @param opts      placement options
+ * @param buf       (OUTPUT) description
+ * @param size      size of `buf'
+ */
+void placeDescribe( PlaceOpts *opts, char *buf, size_t size );
+
+/**
+ * Name: placeCpuModel
+ *
+ * Description:
+ * Writes the CPU model of the machine, as in /proc/cpuinfo, or "unknown".
+ * Any '|' in it is replaced by '/'.
+ *
+ * Parameters:
+ * @param buf       (OUTPUT) CPU model
+ * @param size      size of `buf'
+ */
+void placeCpuModel( char *buf, size_t size );
+
+/**
+ * Name: placeCpuFor
+ *
+ * Description:
+ * Returns the CPU worker `worker' should be pinned to.
+ *
+ * Parameters:
+ * @param opts      placement options
+ * @param worker    index of the worker (or of the process on its node)
+ *
+ * Returns:
+ * @return int      CPU number, or -1 if the worker should not be pinned
+ */
+int placeCpuFor( PlaceOpts *opts, int worker );
+
+/**
+ * Name: placePin
+ *
+ * Description:
+ * Pins the calling thread to a CPU.
+ *
+ * Parameters:
+ * @param cpu       CPU number; nothing is done if negative
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int placePin( int cpu );
+
+/**
+ * Name: placeAlloc
+ *
+ * Description:
+ * Allocates zero filled memory for dendrite state with the page size and
+ * binding given in `opts'. The pages are not touched, so without binding they
+ * end up on the NUMA node of whichever thread writes them first.
+ *
+ * Parameters:
+ * @param opts      placement options
+ * @param size      number of bytes needed
+ * @param mapped    (OUTPUT) number of bytes actually mapped, for placeFree
+ *
+ * Returns:
+ * @return void*    the memory, or NULL if there was a problem
+ */
+void *placeAlloc( PlaceOpts *opts, size_t size, size_t *mapped );
+
+/**
+ * Name: placeFree
+ *
+ * Description:
+ * Releases memory obtained from placeAlloc.
+ *
+ * Parameters:
+ * @param ptr       memory to release (may be NULL)
+ * @param mapped    size returned by placeAlloc
+ */
+void placeFree( void *ptr, size_t mapped );
+
+#endif
@@ -20,8 +20,10 @@ typedef struct PlotInfo {
  * Plots data contained in given file. The file is expected to be formatted to
  * be processed by gnuplot.
  *
- * If `image_name' is NULL, gnuplot will plot to a window, otherwise, gnuplot
- * will plot to the filename specified by `image_name'.
+ * If `image_name' is NULL, gnuplot will plot to a window, otherwise the data
+ * is read back and rendered in-process to the PNG file specified by
+ * `image_name' (see plotTrace). Only the window mode starts an external
+ * process.
  *
  * Parameters:
  * @param data_name     name of the data file to plot
@@ -29,4 +31,45 @@ typedef struct PlotInfo {
  */
 void plotData( PlotInfo *pinfo, char *data_name, char *image_name );
 
+/**
+ * Name: plotTrace
+ *
+ * Description:
+ * Renders the soma membrane potential trace to a PNG file without starting
+ * any external process. Sample `i' of `res' is plotted at time `i' ms. The
+ * title gnuplot would have shown is stored in the PNG 'Title' text chunk.
+ *
+ * Parameters:
+ * @param pinfo         simulation information shown in the title
+ * @param res           soma potential, one sample per millisecond
+ * @param num_samples   number of samples in `res'
+ * @param image_name    name of the PNG file to create
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int plotTrace( PlotInfo *pinfo, double *res, int num_samples,
+               char *image_name );
+
+/**
+ * Name: readTrace
+ *
+ * Description:
+ * Reads a results file written by seq_hh or mpi_hh, either in text or in
+ * binary format. The simulation information is taken from the file header and
+ * the soma potential samples are returned in a newly allocated array that the
+ * caller must free.
+ *
+ * Parameters:
+ * @param data_name     name of the data file to read
+ * @param pinfo         (OUTPUT) simulation information from the header
+ * @param res           (OUTPUT) soma potential samples
+ * @param num_samples   (OUTPUT) number of samples read
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int readTrace( char *data_name, PlotInfo *pinfo, double **res,
+               int *num_samples );
+
 #endif
@@ -0,0 +1,109 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+/**
+ * Palette indices understood by the canvas. Every pixel stores one of these,
+ * which keeps images small and lets the PNG writer emit an indexed image.
+ */
+enum {
+  COLOR_WHITE = 0,
+  COLOR_BLACK,
+  COLOR_GRID,
+  COLOR_TRACE,
+  NUM_COLORS
+};
+
+/**
+ * A simple 8-bit indexed drawing surface.
+ */
+typedef struct Canvas {
+  int width;          // Width of the image in pixels.
+  int height;         // Height of the image in pixels.
+  unsigned char *pix; // width*height palette indices, row major.
+} Canvas;
+
+/**
+ * Name: canvasInit
+ *
+ * Description:
+ * Allocates a canvas of the given size and clears it to COLOR_WHITE.
+ *
+ * Parameters:
+ * @param canvas    canvas to initialize
+ * @param width     width in pixels
+ * @param height    height in pixels
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int canvasInit( Canvas *canvas, int width, int height );
+
+/**
+ * Name: canvasFree
+ *
+ * Description:
+ * Releases memory held by a canvas.
+ *
+ * Parameters:
+ * @param canvas    canvas to free
+ */
+void canvasFree( Canvas *canvas );
+
+/**
+ * Name: canvasLine
+ *
+ * Description:
+ * Draws a one pixel wide line between two points (Bresenham). Points outside
+ * of the canvas are clipped pixel by pixel.
+ *
+ * Parameters:
+ * @param canvas    canvas to draw on
+ * @param x0, y0    start point
+ * @param x1, y1    end point
+ * @param color     palette index to draw with
+ */
+void canvasLine( Canvas *canvas, int x0, int y0, int x1, int y1,
+                 unsigned char color );
+
+/**
+ * Name: canvasText
+ *
+ * Description:
+ * Draws a string with the built-in 3x5 pixel font. Only digits, '-', '.' and
+ * spaces are available; any other character is drawn as a space.
+ *
+ * Parameters:
+ * @param canvas    canvas to draw on
+ * @param x, y      top left corner of the first character
+ * @param str       string to draw
+ * @param scale     size of a font pixel in canvas pixels
+ * @param color     palette index to draw with
+ *
+ * Returns:
+ * @return int      width of the drawn string in pixels
+ */
+int canvasText( Canvas *canvas, int x, int y, const char *str, int scale,
+                unsigned char color );
+
+/**
+ * Name: canvasWritePng
+ *
+ * Description:
+ * Writes the canvas to an indexed PNG file. The image data is compressed with
+ * a small run-length deflate coder, which is very effective on line plots.
+ * Optional key/value pairs are stored as tEXt chunks.
+ *
+ * Parameters:
+ * @param canvas    canvas to write
+ * @param fname     name of the PNG file to create
+ * @param keys      tEXt keywords (may be NULL if num_text is 0)
+ * @param values    tEXt values (may be NULL if num_text is 0)
+ * @param num_text  number of tEXt chunks
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int canvasWritePng( Canvas *canvas, const char *fname, const char **keys,
+                    const char **values, int num_text );
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <mpi.h>
+#include <stdint.h>
+
+#define REC_MAGIC "HHREC01"  // First bytes of a recording.
+
+/**
+ * Header of a recording (mpi_hh --record). It is followed by num_ms rows,
+ * one per simulated ms from 0, of num_dendrs records of `values' doubles
+ * (native byte order): the current dendrite d injected into the soma at the
+ * last step of the ms (pA), then the potential of each of its compartments
+ * from the tip to the soma (mV). Record d of row t is at byte
+ *
+ *   sizeof(RecHeader) + ((t * num_dendrs) + d) * values * sizeof(double)
+ *
+ * so every process knows where its dendrites go without asking anyone.
+ */
+typedef struct RecHeader {
+  char magic[8];          // REC_MAGIC.
+  int32_t num_dendrs;     // Dendrites per row.
+  int32_t num_comps;      // Compartments per dendrite.
+  int32_t num_ms;         // Rows, one per ms.
+  int32_t values;         // Doubles per record, num_comps + 1.
+} RecHeader;
+
+/**
+ * The part of a recording written by one process: `count' consecutive
+ * dendrites of the cell from `first'. Rows are buffered for `buffer_ms' ms
+ * and then written by all processes at once with one collective MPI-IO
+ * write, each process through a file view that only shows its own records,
+ * so the MPI library can merge the pieces into large contiguous writes
+ * instead of every process seeking on its own (or everything going through
+ * rank 0).
+ */
+typedef struct Recorder {
+  MPI_File fh;            // The shared file.
+  MPI_Comm comm;          // Processes writing it.
+  int num_dendrs;         // Dendrites in the cell.
+  int values;             // Doubles per record.
+  int first;              // First dendrite of this process.
+  int count;              // Dendrites of this process, may be 0.
+  int buffer_ms;          // Rows buffered between writes.
+  int buffered;           // Rows in the buffer.
+  int next_row;           // Row the buffer starts at.
+  double *buf;            // Buffered records, row after row.
+  double io_time;         // Time spent opening, writing and closing, s.
+  long long bytes;        // Bytes written by this process.
+} Recorder;
+
+/**
+ * Name: recordOpen
+ *
+ * Description:
+ * Creates a recording of `duration' rows and writes its header (rank 0).
+ * Must be called by all processes of `comm'.
+ *
+ * Parameters:
+ * @param rec           recorder to initialize
+ * @param path          file to create
+ * @param num_dendrs    dendrites in the cell
+ * @param num_comps     compartments per dendrite (as given by the user)
+ * @param duration      simulated time, ms
+ * @param first         first dendrite of this process
+ * @param count         dendrites of this process
+ * @param buffer_ms     rows to buffer between collective writes
+ * @param comm          processes writing the file
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int recordOpen( Recorder *rec, const char *path, int num_dendrs,
+                int num_comps, int duration, int first, int count,
+                int buffer_ms, MPI_Comm comm );
+
+/**
+ * Name: recordSample
+ *
+ * Description:
+ * Adds the next row: the current and compartment potentials of this
+ * process' dendrites. Writes the buffer out once it is full, so it must be
+ * called by all processes of the recording, once per ms.
+ *
+ * Parameters:
+ * @param rec           recorder
+ * @param volt          potentials, compartments 1..num_comps of each dendrite
+ * @param currents      current of each dendrite at the last step
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int recordSample( Recorder *rec, double **volt, const double *currents );
+
+/**
+ * Name: recordClose
+ *
+ * Description:
+ * Writes what is left in the buffer and closes the file. Rank 0 of the
+ * recording gets the total bytes written and the aggregate bandwidth: the
+ * bytes over the I/O time of the slowest process. Must be called by all
+ * processes of the recording.
+ *
+ * Parameters:
+ * @param rec           recorder
+ * @param bytes         (OUTPUT) total bytes written (rank 0)
+ * @param seconds       (OUTPUT) I/O time of the slowest process (rank 0)
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int recordClose( Recorder *rec, long long *bytes, double *seconds );
+
+#endif
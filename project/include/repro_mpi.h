@@ -0,0 +1,32 @@
+#ifndef REPRO_MPI_H
+#define REPRO_MPI_H
+
+#include "repro_sum.h"
+
+#include <mpi.h>
+
+/**
+ * Name: reproSumType
+ *
+ * Description:
+ * Returns the MPI datatype of a ReproSum, committing it on first use.
+ *
+ * Returns:
+ * @return MPI_Datatype   datatype of one ReproSum
+ */
+MPI_Datatype reproSumType( void );
+
+/**
+ * Name: reproSumOp
+ *
+ * Description:
+ * Returns the MPI reduction that merges ReproSums, creating it on first use.
+ * The merge is associative and commutative, so MPI_Reduce() may combine the
+ * partial sums in any order or tree and still give the same total.
+ *
+ * Returns:
+ * @return MPI_Op   reduction for reproSumType()
+ */
+MPI_Op reproSumOp( void );
+
+#endif
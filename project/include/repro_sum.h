@@ -0,0 +1,88 @@
+#ifndef REPRO_SUM_H
+#define REPRO_SUM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Order independent sum of doubles.
+ *
+ * Each term is converted to a 128-bit fixed point number with 64 integer and
+ * 64 fraction bits and added as an integer. Integer addition is associative,
+ * so the total does not depend on the order of the terms or on how they were
+ * grouped into partial sums (threads, processes, nodes); it only depends on
+ * the terms themselves. Terms of magnitude 2^-11 to 2^62 (dendritic
+ * currents are 1e-3 to 1e6 pA) convert exactly, so the total is the exact
+ * sum, rounded once (to nearest, ties to even) when it is read.
+ */
+typedef struct ReproSum {
+  int64_t hi;       // Integer part (floor) of the sum.
+  uint64_t lo;      // Fraction of the sum, in units of 2^-64.
+} ReproSum;
+
+/**
+ * Name: reproSumZero
+ *
+ * Description:
+ * Empties a sum.
+ *
+ * Parameters:
+ * @param s         sum to empty
+ */
+void reproSumZero( ReproSum *s );
+
+/**
+ * Name: reproSumAdd
+ *
+ * Description:
+ * Adds a term to a sum. Bits of `x' below 2^-64 are dropped.
+ *
+ * Parameters:
+ * @param s         sum
+ * @param x         term, |x| < 2^62
+ */
+void reproSumAdd( ReproSum *s, double x );
+
+/**
+ * Name: reproSumMerge
+ *
+ * Description:
+ * Adds a partial sum to a sum.
+ *
+ * Parameters:
+ * @param s         sum
+ * @param t         partial sum to add
+ */
+void reproSumMerge( ReproSum *s, const ReproSum *t );
+
+/**
+ * Name: reproSumValue
+ *
+ * Description:
+ * Reads a sum.
+ *
+ * Parameters:
+ * @param s         sum
+ *
+ * Returns:
+ * @return double   the sum, correctly rounded to a double
+ */
+double reproSumValue( const ReproSum *s );
+
+/**
+ * Name: reproSumBenchmark
+ *
+ * Description:
+ * Times summing `num_terms' dendritic currents `steps' times, with plain
+ * double additions and with a ReproSum.
+ *
+ * Parameters:
+ * @param num_terms     terms per sum
+ * @param steps         sums to time
+ * @param naive_ns      (OUTPUT) time per term of the plain sum, ns
+ * @param repro_ns      (OUTPUT) time per term of the ReproSum, ns
+ */
+void reproSumBenchmark( int num_terms, int steps, double *naive_ns,
+                        double *repro_ns );
+
+#endif
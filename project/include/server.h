@@ -0,0 +1,77 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define JOB_LINE_LEN 4096   // Longest job line.
+#define JOB_MAX_ARGS 128    // Most arguments in a job.
+
+/**
+ * Name: serverListen
+ *
+ * Description:
+ * Creates a Unix domain stream socket bound to `path' and listens on it. A
+ * stale socket file left at `path' is replaced.
+ *
+ * Parameters:
+ * @param path      file system path of the socket
+ *
+ * Returns:
+ * @return int      listening descriptor, or -1 if there was a problem
+ */
+int serverListen( const char *path );
+
+/**
+ * Name: serverReadJob
+ *
+ * Description:
+ * Reads one job from a client: a single line of command line arguments
+ * separated by blanks. The newline is stripped.
+ *
+ * Parameters:
+ * @param fd        connection to read from
+ * @param line      (OUTPUT) the job line
+ * @param size      size of `line'
+ *
+ * Returns:
+ * @return int      0 if no complete line could be read, nonzero otherwise
+ */
+int serverReadJob( int fd, char *line, size_t size );
+
+/**
+ * Name: serverSplitArgs
+ *
+ * Description:
+ * Splits a job line in place into an argument vector. argv[0] is set to
+ * `name' and the vector is terminated by NULL.
+ *
+ * Parameters:
+ * @param line      job line, modified
+ * @param name      program name to put in argv[0]
+ * @param argv      (OUTPUT) room for JOB_MAX_ARGS + 1 pointers
+ *
+ * Returns:
+ * @return int      number of arguments, including argv[0]
+ */
+int serverSplitArgs( char *line, char *name, char **argv );
+
+/**
+ * Name: clientRun
+ *
+ * Description:
+ * Sends a job to a server and copies everything it sends back to `out'
+ * until it closes the connection.
+ *
+ * Parameters:
+ * @param path      file system path of the server's socket
+ * @param argc      number of job arguments
+ * @param argv      job arguments (without a program name)
+ * @param out       where the reply goes
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int clientRun( const char *path, int argc, char **argv, FILE *out );
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef SHM_REDUCE_H
+#define SHM_REDUCE_H
+
+#include "repro_sum.h"
+
+#include <mpi.h>
+
+/**
+ * One slot of the node-local exchange area, padded to its own cache line.
+ */
+typedef struct ShmSlot {
+  ReproSum current;   // Current of a process.
+  double value;       // The soma potential.
+  long seq;           // Round in which the slot was written.
+  char pad[ 64 - sizeof(ReproSum) - sizeof(double) - sizeof(long) ];
+} ShmSlot;
+
+/**
+ * Hierarchical exchange of the dendritic currents and the soma potential.
+ *
+ * The processes of each node share an MPI-3 shared memory window holding
+ * one slot per process plus one for the soma potential. To sum the
+ * currents, every process writes its slot and publishes it by bumping the
+ * slot's round number; the node leader (lowest rank of the node) waits for
+ * all of them and merges them. Only the leaders then take part in an
+ * MPI_Reduce onto rank 0, which is skipped on a single node. The
+ * soma potential goes the other way: MPI_Bcast among the leaders, then one
+ * slot write per node that the other processes of the node wait for.
+ *
+ * Within a node an exchange costs a few cache line transfers instead of a
+ * message per process. The currents travel as ReproSums, so results are
+ * identical to the point-to-point exchange whatever the number of nodes.
+ */
+typedef struct ShmReduce {
+  MPI_Comm node_comm;   // Processes on this node.
+  MPI_Comm leader_comm; // Node leaders, MPI_COMM_NULL for the others.
+  int node_rank;        // Rank within the node, 0 for the leader.
+  int node_size;        // Processes on this node.
+  int num_nodes;        // Nodes taking part.
+  int root;             // Nonzero on rank 0 of the communicator.
+  int spins;            // Spins before a waiting process yields the CPU.
+  MPI_Win win;          // Window holding the slots.
+  ShmSlot *slots;       // node_size current slots, then the potential slot.
+  long cur_round;       // Current exchanges done.
+  long v_round;         // Potential broadcasts done.
+} ShmReduce;
+
+/**
+ * Name: shmReduceInit
+ *
+ * Description:
+ * Splits `comm' into nodes and allocates the shared window of this node.
+ * Collective over `comm', whose rank 0 becomes the leader of its node.
+ *
+ * Parameters:
+ * @param sr        exchange to initialize
+ * @param comm      communicator of all processes
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int shmReduceInit( ShmReduce *sr, MPI_Comm comm );
+
+/**
+ * Name: shmReduceFree
+ *
+ * Description:
+ * Releases the window and communicators. Collective.
+ *
+ * Parameters:
+ * @param sr        exchange to free
+ */
+void shmReduceFree( ShmReduce *sr );
+
+/**
+ * Name: shmReduceCurrent
+ *
+ * Description:
+ * Sums the current of every process onto rank 0 of the communicator.
+ * Collective.
+ *
+ * Parameters:
+ * @param sr        exchange to use
+ * @param current   current of this process
+ *
+ * Returns:
+ * @return double   total current on rank 0, this process' current elsewhere
+ */
+double shmReduceCurrent( ShmReduce *sr, const ReproSum *current );
+
+/**
+ * Name: shmBcastPotential
+ *
+ * Description:
+ * Sends the soma potential from rank 0 of the communicator to every
+ * process. Collective.
+ *
+ * Parameters:
+ * @param sr        exchange to use
+ * @param v_m       soma membrane potential (rank 0)
+ *
+ * Returns:
+ * @return double   soma membrane potential
+ */
+double shmBcastPotential( ShmReduce *sr, double v_m );
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include "plot.h"
+#include "spike.h"
+#include "constants.h"
+
+#include <stdio.h>
+#include <stddef.h>
+
+/**
+ * Available output backends.
+ */
+typedef enum SinkType {
+  SINK_NULL = 0,  // Discard everything (benchmarking).
+  SINK_TEXT,      // gnuplot-ready text file under data/ (the default).
+  SINK_BINARY,    // BinHeader followed by raw doubles under data/.
+  SINK_STDOUT,    // Text streamed to stdout as samples are produced.
+  SINK_SHM        // POSIX shared memory segment (see ShmHeader).
+} SinkType;
+
+#define BIN_MAGIC "HHBIN01"  // 7 characters plus the terminating zero.
+#define SHM_MAGIC "HHSHM01"
+
+#define BIN_KIND_TRACE  0    // Samples are soma potentials, one per ms.
+#define BIN_KIND_EVENTS 1    // Samples are spike times, ms.
+
+/**
+ * Header of a binary results file. It is followed by `num_samples' doubles in
+ * host byte order: one soma potential per simulated millisecond, or one spike
+ * time per spike for event output (see `kind').
+ */
+typedef struct BinHeader {
+  char magic[8];       // BIN_MAGIC
+  int sim_time;        // Simulated time, ms.
+  int num_comps;       // Compartments per dendrite.
+  int num_dendrs;      // Number of dendrites.
+  int slaves;          // Number of slave processes.
+  int num_samples;     // Number of samples following the header.
+  int kind;            // BIN_KIND_TRACE or BIN_KIND_EVENTS.
+  double int_step;     // Integration step, ms.
+  double exec_time;    // Execution time, s.
+} BinHeader;
+
+/**
+ * Header of a shared memory results segment. It is followed by room for
+ * `capacity' doubles. `num_samples' is published with release semantics after
+ * each sample is stored, so a reader that loads it with acquire semantics may
+ * read that many samples. `done' becomes nonzero once `exec_time' is valid.
+ */
+typedef struct ShmHeader {
+  char magic[8];              // SHM_MAGIC
+  BinHeader info;             // Run description, as for binary files.
+  int capacity;               // Number of samples the segment can hold.
+  volatile int num_samples;   // Number of samples written so far.
+  volatile int done;          // Nonzero once the run has finished.
+} ShmHeader;
+
+/**
+ * Output sink. All simulation output goes through one of these so that the
+ * simulation loop does not need to know where results end up.
+ */
+typedef struct OutputSink {
+  SinkType type;
+  char data_fname[ FNAME_LEN ];   // Data file or shared memory object name.
+  char graph_fname[ FNAME_LEN ];  // Matching graph name (file sinks only).
+  FILE *fp;                       // Open data file, if any.
+  FILE *log;                      // Where informational messages go.
+  PlotInfo info;                  // Run description given to sinkOpen.
+  double *samples;                // Samples buffered by the text sink.
+  int num_samples;                // Number of samples received so far.
+  int capacity;                   // Room in 'samples'.
+  int events;                     // Nonzero to record spike events only.
+  SpikeStats spikes;              // Statistics over the spikes received.
+  ShmHeader *shm;                 // Mapped segment of the shm sink.
+  size_t shm_size;                // Size of the mapping.
+} OutputSink;
+
+/**
+ * Name: sinkParseType
+ *
+ * Description:
+ * Converts a backend name (null, text, binary, stdout or shm) to a SinkType.
+ *
+ * Parameters:
+ * @param name      name of the backend
+ * @param type      (OUTPUT) matching sink type
+ *
+ * Returns:
+ * @return int      0 if the name is unknown, nonzero otherwise
+ */
+int sinkParseType( const char *name, SinkType *type );
+
+/**
+ * Name: sinkOpen
+ *
+ * Description:
+ * Prepares a sink for a run. For the text and binary sinks, the data/ and
+ * graphs/ directories are created if needed and, unless `name' is given, the
+ * file name is derived from the run parameters and the current time:
+ *
+ *    data/pWWdXXcYY_MMDDYY_HHMMSS.dat   (or .bin)
+ *
+ * A numeric suffix is appended if a file of that name already exists, so
+ * runs started in the same second do not overwrite each other. For the shm
+ * sink, `name' is the shared memory object name (default "/hh_<pid>").
+ *
+ * If `events' is nonzero, the soma trace is dropped and only the spike times
+ * given to sinkSpike are recorded, followed by summary statistics.
+ *
+ * Parameters:
+ * @param sink          sink to open
+ * @param type          backend to use
+ * @param name          file/object name, or NULL to use the default
+ * @param pinfo         description of the run (exec_time is ignored)
+ * @param num_procs     number of processes taking part in the run
+ * @param events        nonzero to record spike events instead of the trace
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int sinkOpen( OutputSink *sink, SinkType type, const char *name,
+              PlotInfo *pinfo, int num_procs, int events );
+
+/**
+ * Name: sinkOpenStream
+ *
+ * Description:
+ * Opens a sink that writes what the stdout sink would to an already open
+ * stream, e.g. a socket. The stream stays open after sinkClose.
+ *
+ * Parameters:
+ * @param sink          sink to open
+ * @param fp            stream to write to
+ * @param pinfo         description of the run (exec_time is ignored)
+ * @param events        nonzero to record spike events instead of the trace
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int sinkOpenStream( OutputSink *sink, FILE *fp, PlotInfo *pinfo, int events );
+
+/**
+ * Name: sinkSample
+ *
+ * Description:
+ * Records the soma membrane potential at time `t_ms'.
+ *
+ * Parameters:
+ * @param sink      sink to record to
+ * @param t_ms      simulated time, ms
+ * @param v         soma membrane potential, mV
+ */
+void sinkSample( OutputSink *sink, int t_ms, double v );
+
+/**
+ * Name: sinkSpike
+ *
+ * Description:
+ * Records an action potential of the soma. Spikes are always counted for the
+ * summary; they are only written out if the sink was opened for events.
+ *
+ * Parameters:
+ * @param sink      sink to record to
+ * @param t_spike   spike time, ms
+ */
+void sinkSpike( OutputSink *sink, double t_spike );
+
+/**
+ * Name: sinkClose
+ *
+ * Description:
+ * Finishes the output of a run, recording its execution time, and releases
+ * the resources held by the sink.
+ *
+ * Parameters:
+ * @param sink          sink to close
+ * @param exec_time     execution time of the run, s
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int sinkClose( OutputSink *sink, double exec_time );
+
+/**
+ * Name: sinkHasFile
+ *
+ * Description:
+ * Tells whether the sink writes a soma trace file that can be plotted
+ * afterwards.
+ *
+ * Parameters:
+ * @param sink      sink to query
+ *
+ * Returns:
+ * @return int      nonzero for the text and binary sinks
+ */
+int sinkHasFile( OutputSink *sink );
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdio.h>
+
+/**
+ * End state of a run, as written with --snapshot: the soma potential at each
+ * ms, the spike times and the potential of every compartment of every
+ * dendrite after the last step. Snapshots are text files, one record per
+ * line, with every value printed to full precision:
+ *
+ *    # comment line describing the run
+ *    trace N v0 ... vN-1
+ *    spikes N t0 ... tN-1
+ *    dendrite I v1 ... vC     (one per dendrite, compartments tip to soma)
+ *
+ * Runs without per-dendrite state (reduced dendrites) have no dendrite lines.
+ */
+typedef struct Snapshot {
+  int num_dendrs;     // Dendrites in the cell.
+  int num_comps;      // Compartments per dendrite.
+  int sim_time;       // Simulated time, ms; samples in `trace'.
+  double *trace;      // Soma potential at each ms.
+  int num_spikes;     // Spikes in `spikes'.
+  double *spikes;     // Spike times, ms.
+  double *volt;       // num_dendrs x num_comps potentials, NULL if absent.
+} Snapshot;
+
+/**
+ * Name: snapshotOpen
+ *
+ * Description:
+ * Creates a snapshot file and writes the soma trace and the spike times. The
+ * dendrites are then added with snapshotDendrite, in any order.
+ *
+ * Parameters:
+ * @param path          file to create
+ * @param num_dendrs    dendrites in the cell
+ * @param num_comps     compartments per dendrite (as given by the user)
+ * @param sim_time      simulated time, ms
+ * @param trace         soma potential at each ms
+ * @param spikes        spike times, ms
+ * @param num_spikes    number of spikes
+ *
+ * Returns:
+ * @return FILE*        the open file, NULL if there was a problem
+ */
+FILE *snapshotOpen( const char *path, int num_dendrs, int num_comps,
+                    int sim_time, const double *trace, const double *spikes,
+                    int num_spikes );
+
+/**
+ * Name: snapshotDendrite
+ *
+ * Description:
+ * Adds one dendrite to a snapshot.
+ *
+ * Parameters:
+ * @param fp        file returned by snapshotOpen
+ * @param index     index of the dendrite in the cell
+ * @param v         its compartments, tip first, without the dummy
+ * @param num_comps compartments per dendrite (as given by the user)
+ */
+void snapshotDendrite( FILE *fp, int index, const double *v, int num_comps );
+
+/**
+ * Name: snapshotRead
+ *
+ * Description:
+ * Reads a snapshot file. Dendrites missing from the file are left at 0.
+ *
+ * Parameters:
+ * @param snap      (OUTPUT) contents of the file
+ * @param path      file to read
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int snapshotRead( Snapshot *snap, const char *path );
+
+/**
+ * Name: snapshotFree
+ *
+ * Description:
+ * Releases what snapshotRead allocated.
+ *
+ * Parameters:
+ * @param snap      snapshot to free
+ */
+void snapshotFree( Snapshot *snap );
+
+#endif
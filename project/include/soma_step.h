@@ -0,0 +1,98 @@
+#ifndef SOMA_STEP_H
+#define SOMA_STEP_H
+
+#include <stdio.h>
+
+/**
+ * Available soma integrators.
+ */
+typedef enum SomaMethod {
+  SOMA_RK4 = 0,       // rk4Step() on soma(), the original integrator.
+  SOMA_RUSH_LARSEN,   // rushLarsenStep(), exponential in gates and Vm.
+  SOMA_PARKER_SOCHACKI  // parkerSochackiStep(), adaptive order series.
+} SomaMethod;
+
+/**
+ * Name: somaParseMethod
+ *
+ * Description:
+ * Converts an integrator name (rk4, rush-larsen or parker-sochacki) to a
+ * SomaMethod.
+ *
+ * Parameters:
+ * @param name      name of the integrator
+ * @param method    (OUTPUT) matching integrator
+ *
+ * Returns:
+ * @return int      0 if the name is unknown, nonzero otherwise
+ */
+int somaParseMethod( const char *name, SomaMethod *method );
+
+/**
+ * Name: somaMethodName
+ *
+ * Description:
+ * Returns the name of an integrator, as accepted by somaParseMethod.
+ *
+ * Parameters:
+ * @param method    integrator to name
+ *
+ * Returns:
+ * @return const char*  name of the integrator
+ */
+const char *somaMethodName( SomaMethod method );
+
+/**
+ * Name: somaSetTolerance
+ *
+ * Description:
+ * Sets the tolerance of the Parker-Sochacki integrator, PS_TOL until then.
+ *
+ * Parameters:
+ * @param tol       largest change of the state left out of the series
+ */
+void somaSetTolerance( double tol );
+
+/**
+ * Name: somaStep
+ *
+ * Description:
+ * Advances the soma by one step of size param[0] with the given integrator.
+ * The state before the step is left in `y0'.
+ *
+ * Parameters:
+ * @param method    integrator to use
+ * @param y         (INOUT) soma state: Vm, n, m and h
+ * @param y0        (OUTPUT) soma state before the step
+ * @param dydt      scratch space for NUMVAR derivatives
+ * @param param     dt, injected current and dendritic current (see soma())
+ */
+void somaStep( SomaMethod method, double *y, double *y0, double *dydt,
+               double *param );
+
+/**
+ * Name: somaValidate
+ *
+ * Description:
+ * Validates the soma integrators against the RK4 trace. The isolated soma is
+ * driven by a constant current for COMPTIME ms, first with RK4 at the model
+ * step (1/STEPS ms) as the reference, then with every integrator at a range
+ * of larger steps. For each run the largest deviation of the once per ms
+ * trace from the reference, the spike count, the shift of the first spike
+ * and the wall time are reported; runs that diverge are marked unstable.
+ * Then, for every integrator, the largest step that stays within
+ * SOMA_BENCH_DV of the reference with the same spike count, and what it
+ * costs, so the integrators are compared at equal accuracy.
+ *
+ * Parameters:
+ * @param i_dendr   current injected into the soma, pA
+ * @param out       where the report goes
+ *
+ * Returns:
+ * @return int      nonzero if every integrator but RK4 at the model step
+ *                  fires as many spikes as the reference, the first one
+ *                  within SOMA_SPIKE_TOLERANCE ms
+ */
+int somaValidate( double i_dendr, FILE *out );
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef SPIKE_H
+#define SPIKE_H
+
+/**
+ * Running statistics over a sequence of spike times.
+ */
+typedef struct SpikeStats {
+  int num_spikes;     // Number of spikes seen.
+  double first;       // Time of the first spike, ms.
+  double last;        // Time of the last spike, ms.
+  double sum_isi;     // Sum of interspike intervals, ms.
+  double sum_isi2;    // Sum of squared interspike intervals, ms^2.
+} SpikeStats;
+
+/**
+ * Online action potential detector for the soma potential. A spike is an
+ * upward crossing of `threshold'. After a spike the detector is disarmed until
+ * the potential falls below `rearm' (hysteresis) and at least `refractory' ms
+ * have passed, so the noise on a single action potential is never counted
+ * twice.
+ */
+typedef struct SpikeDetector {
+  double threshold;   // Crossing level, mV.
+  double rearm;       // Level the potential must fall below to re-arm, mV.
+  double refractory;  // Minimum time between spikes, ms.
+  int armed;          // Nonzero if the next crossing counts as a spike.
+  double last_spike;  // Time of the most recent spike, ms.
+  SpikeStats stats;   // Statistics over the spikes detected so far.
+} SpikeDetector;
+
+/**
+ * Name: spikeInit
+ *
+ * Description:
+ * Initializes a spike detector. The detector starts armed.
+ *
+ * Parameters:
+ * @param det           detector to initialize
+ * @param threshold     crossing level, mV
+ * @param rearm         re-arm level, mV (should be below `threshold')
+ * @param refractory    minimum time between spikes, ms
+ */
+void spikeInit( SpikeDetector *det, double threshold, double rearm,
+                double refractory );
+
+/**
+ * Name: spikeUpdate
+ *
+ * Description:
+ * Feeds one integration step to the detector. This is meant to be called
+ * after every soma update and costs a couple of comparisons unless a spike is
+ * found. The spike time is linearly interpolated between the two samples.
+ *
+ * Parameters:
+ * @param det       detector to update
+ * @param t         time at the end of the step, ms
+ * @param dt        length of the step, ms
+ * @param v_prev    soma potential at the start of the step, mV
+ * @param v         soma potential at the end of the step, mV
+ * @param t_spike   (OUTPUT) interpolated spike time, if a spike was found
+ *
+ * Returns:
+ * @return int      nonzero if a spike was detected during this step
+ */
+int spikeUpdate( SpikeDetector *det, double t, double dt, double v_prev,
+                 double v, double *t_spike );
+
+/**
+ * Name: spikeStatsAdd
+ *
+ * Description:
+ * Adds a spike time to a set of running statistics. Spike times must be given
+ * in increasing order.
+ *
+ * Parameters:
+ * @param stats     statistics to update
+ * @param t_spike   spike time, ms
+ */
+void spikeStatsAdd( SpikeStats *stats, double t_spike );
+
+/**
+ * Name: spikeSummary
+ *
+ * Description:
+ * Derives the summary figures reported for a run from running statistics.
+ *
+ * Parameters:
+ * @param stats     statistics to summarize
+ * @param duration  simulated time, ms
+ * @param rate      (OUTPUT) mean firing rate, Hz
+ * @param mean_isi  (OUTPUT) mean interspike interval, ms (0 if < 2 spikes)
+ * @param cv_isi    (OUTPUT) coefficient of variation of the interspike
+ *                  intervals (0 if < 3 spikes)
+ */
+void spikeSummary( SpikeStats *stats, double duration, double *rate,
+                   double *mean_isi, double *cv_isi );
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef STEAL_H
+#define STEAL_H
+
+#include <stdint.h>
+
+/**
+ * Double ended queue of chunk indices for work stealing. Its owner takes
+ * chunks from the back and other threads steal from the front, so the two
+ * only meet on the last chunk. Both ends live in one 64-bit word and are
+ * moved with a compare and swap; since chunks are only pushed while no one
+ * pops or steals (between steps), that is all the synchronization needed.
+ */
+typedef struct ChunkDeque {
+  int *items;             // Chunk indices.
+  int capacity;           // Room in `items'.
+  volatile uint64_t ends; // Front index in the high half, back in the low.
+} ChunkDeque;
+
+/**
+ * Name: dequeInit
+ *
+ * Description:
+ * Allocates an empty deque.
+ *
+ * Parameters:
+ * @param dq        deque to initialize
+ * @param capacity  most chunks it will hold
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int dequeInit( ChunkDeque *dq, int capacity );
+
+/**
+ * Name: dequeFree
+ *
+ * Description:
+ * Releases a deque.
+ *
+ * Parameters:
+ * @param dq        deque to free
+ */
+void dequeFree( ChunkDeque *dq );
+
+/**
+ * Name: dequeClear
+ *
+ * Description:
+ * Empties a deque. Not safe while other threads pop or steal.
+ *
+ * Parameters:
+ * @param dq        deque to empty
+ */
+void dequeClear( ChunkDeque *dq );
+
+/**
+ * Name: dequePush
+ *
+ * Description:
+ * Appends a chunk at the back. Not safe while other threads pop or steal.
+ *
+ * Parameters:
+ * @param dq        deque
+ * @param chunk     chunk index
+ */
+void dequePush( ChunkDeque *dq, int chunk );
+
+/**
+ * Name: dequePop
+ *
+ * Description:
+ * Takes the chunk at the back, as the owner of the deque.
+ *
+ * Parameters:
+ * @param dq        deque
+ * @param chunk     (OUTPUT) chunk index
+ *
+ * Returns:
+ * @return int      0 if the deque was empty, nonzero otherwise
+ */
+int dequePop( ChunkDeque *dq, int *chunk );
+
+/**
+ * Name: dequeSteal
+ *
+ * Description:
+ * Takes the chunk at the front, from another thread than the owner.
+ *
+ * Parameters:
+ * @param dq        deque
+ * @param chunk     (OUTPUT) chunk index
+ *
+ * Returns:
+ * @return int      0 if the deque was empty, nonzero otherwise
+ */
+int dequeSteal( ChunkDeque *dq, int *chunk );
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef STIMULUS_H
+#define STIMULUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STIM_MAGIC "HHSTIM1"  // First bytes of a stimulus file.
+
+/**
+ * Where the current injected at the dendrite tips comes from.
+ */
+typedef enum StimType {
+  STIM_GENERATOR = 0,   // Built in: INJCURMEAN +-10% from stimGenerate(),
+                        // seeded by step and dendrite as in dendriteStep().
+  STIM_FILE             // Recorded per-dendrite time series, see below.
+} StimType;
+
+/**
+ * Header of a stimulus file. It is followed by num_ms * steps_per_ms rows of
+ * num_dendrs doubles (pA, native byte order): row s holds the tip current of
+ * every dendrite at sample s, so a millisecond of stimulus is contiguous and
+ * the file is read front to back.
+ */
+typedef struct StimHeader {
+  char magic[8];          // STIM_MAGIC.
+  int32_t num_dendrs;     // Dendrites per row.
+  int32_t steps_per_ms;   // Samples per ms.
+  int32_t num_ms;         // Milliseconds of stimulus; sample rows of ms t
+                          // drive simulated ms t+1.
+  int32_t reserved;       // 0.
+} StimHeader;
+
+/**
+ * A stimulus. A file is mapped a window of `window_ms' milliseconds at a
+ * time; when the simulation enters a window, the previous one is unmapped
+ * and the next one is read ahead, so the steps never wait on the disk and
+ * the mapping does not grow with the length of the file.
+ */
+typedef struct Stimulus {
+  StimType type;          // Kind of stimulus.
+  int num_dendrs;         // Dendrites in the file.
+  int steps_per_ms;       // Samples per ms in the file.
+  int num_ms;             // Milliseconds in the file.
+  int window_ms;          // Milliseconds mapped at a time.
+  int fd;                 // The file, -1 for the generator.
+  void *map;              // Current window mapping, NULL for none.
+  size_t map_len;         // Bytes mapped.
+  int win_first;          // First ms of the mapped window.
+  int win_ms;             // Milliseconds in the mapped window.
+  const double *window;   // First row of the mapped window.
+  const double *rows;     // First row of the ms being simulated.
+  int windows;            // Windows mapped so far.
+} Stimulus;
+
+/**
+ * Name: stimGenerate
+ *
+ * Description:
+ * The built-in stimulus, the tip current every kernel injects for `seed':
+ * INJCURMEAN +-10% from the first rand() after srand( seed ). With glibc
+ * that number is computed without them, so that any number of threads can
+ * call this at once; with other C libraries (or if stimGenerator() finds
+ * that glibc's rand() changed) they are called under a lock.
+ *
+ * Parameters:
+ * @param seed      seed of the random number generator
+ *
+ * Returns:
+ * @return double   tip current, pA
+ */
+double stimGenerate( int seed );
+
+/**
+ * Name: stimGenerator
+ *
+ * Description:
+ * Initializes a stimulus of type STIM_GENERATOR. The first call checks
+ * stimGenerate() against srand() and rand(), so it must be made before
+ * any other thread draws the stimulus.
+ *
+ * Parameters:
+ * @param stim      stimulus to initialize
+ */
+void stimGenerator( Stimulus *stim );
+
+/**
+ * Name: stimOpen
+ *
+ * Description:
+ * Opens a stimulus file for a simulation of `num_dendrs' dendrites over
+ * `duration' ms. The file needs at least that many dendrites and duration-1
+ * ms of samples.
+ *
+ * Parameters:
+ * @param stim          stimulus to initialize
+ * @param path          stimulus file
+ * @param num_dendrs    dendrites that will read from it
+ * @param duration      simulated time, ms
+ * @param window_ms     milliseconds to map at a time
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int stimOpen( Stimulus *stim, const char *path, int num_dendrs, int duration,
+              int window_ms );
+
+/**
+ * Name: stimSetTime
+ *
+ * Description:
+ * Moves the stimulus to simulated ms `t_ms' (1, 2, ...), remapping and
+ * reading ahead at window boundaries. Must be called at the start of every
+ * ms, while no dendrite is being advanced.
+ *
+ * Parameters:
+ * @param stim      stimulus
+ * @param t_ms      millisecond about to be simulated
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int stimSetTime( Stimulus *stim, int t_ms );
+
+/**
+ * Name: stimCurrent
+ *
+ * Description:
+ * Returns the tip current of a dendrite at a step of the current ms. The
+ * generator seeds with step + dendrite + 1. A file is sampled at
+ * step * steps_per_ms(file) / steps_per_ms, so it can be coarser than the
+ * dendrite step (the samples are then held).
+ *
+ * Parameters:
+ * @param stim          stimulus, NULL for the generator
+ * @param step          dendrite step within the ms
+ * @param steps_per_ms  dendrite steps per ms
+ * @param dendrite      index of the dendrite in the stimulus
+ *
+ * Returns:
+ * @return double       tip current, pA
+ */
+double stimCurrent( const Stimulus *stim, int step, int steps_per_ms,
+                    int dendrite );
+
+/**
+ * Name: stimRow
+ *
+ * Description:
+ * Returns the samples of every dendrite at a step of the current ms, i.e.
+ * stimCurrent() for dendrites 0, 1, ... (STIM_FILE only).
+ *
+ * Parameters:
+ * @param stim          stimulus
+ * @param step          dendrite step within the ms
+ * @param steps_per_ms  dendrite steps per ms
+ *
+ * Returns:
+ * @return const double*  num_dendrs samples
+ */
+const double *stimRow( const Stimulus *stim, int step, int steps_per_ms );
+
+/**
+ * Name: stimClose
+ *
+ * Description:
+ * Unmaps and closes a stimulus file.
+ *
+ * Parameters:
+ * @param stim      stimulus to close
+ */
+void stimClose( Stimulus *stim );
+
+/**
+ * Name: stimWrite
+ *
+ * Description:
+ * Writes the generator's stimulus, with dendrites numbered from 0, to a
+ * stimulus file. Running from that file reproduces the built-in stimulus.
+ *
+ * Parameters:
+ * @param path          file to write
+ * @param num_dendrs    dendrites per row
+ * @param steps_per_ms  samples per ms
+ * @param num_ms        milliseconds of samples
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int stimWrite( const char *path, int num_dendrs, int steps_per_ms,
+               int num_ms );
+
+#endif
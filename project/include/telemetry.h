@@ -0,0 +1,153 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "constants.h"
+
+#include <stddef.h>
+
+#define TEL_MAGIC "HHTEL01"  // 7 characters plus the terminating zero.
+
+/**
+ * Progress of one rank (mpi_hh) or worker thread (seq_hh). Each slot has a
+ * single writer, which bumps `seq' to an odd value before changing the other
+ * fields and to the next even value after; a reader copies the slot and
+ * retries if `seq' was odd or changed meanwhile (a sequence lock). Slots are
+ * a cache line each, so writers on different cores never share one.
+ */
+typedef struct TelemetrySlot {
+  volatile unsigned seq;  // Odd while the slot is being written.
+  int active;             // Nonzero once the slot has been written.
+  int sim_ms;             // Simulated time reached, ms.
+  long steps;             // Integration steps done.
+  double elapsed;         // Wall time since the run started, s.
+  double compute;         // Part of it spent computing, s.
+  double comm;            // Part spent communicating or waiting, s.
+  long rss_kb;            // Peak resident memory of the process, kB.
+} __attribute__((aligned(64))) TelemetrySlot;
+
+/**
+ * Header of a telemetry block, followed by `num_slots' slots. Everything but
+ * `done' is written before the block is published.
+ */
+typedef struct TelemetryHeader {
+  char magic[8];          // TEL_MAGIC
+  char program[16];       // seq_hh or mpi_hh.
+  int pid;                // Process that started the run (rank 0).
+  int num_dendrs;         // Dendrites in the cell.
+  int num_comps;          // Compartments per dendrite.
+  int duration;           // Simulated time of the run, ms.
+  int num_slots;          // Ranks or worker threads.
+  volatile int done;      // Nonzero once the run has finished.
+} TelemetryHeader;
+
+/**
+ * A mapped telemetry block.
+ */
+typedef struct Telemetry {
+  char name[ FNAME_LEN ]; // Shared memory object name.
+  TelemetryHeader *hdr;   // The block, NULL if telemetry is off.
+  TelemetrySlot *slots;   // Slots following the header.
+  size_t size;            // Bytes mapped.
+  int owner;              // Nonzero if this process created the block.
+  double start;           // When the block was opened, monotonic s.
+} Telemetry;
+
+/**
+ * Name: telemetryOpen
+ *
+ * Description:
+ * Creates a telemetry block in POSIX shared memory, or with `create' zero
+ * maps the one another process of the run created. The default name is
+ * TEL_PREFIX followed by `pid'. A block that can't be set up leaves
+ * telemetry off for this process, which is reported but does not stop the
+ * run.
+ *
+ * Parameters:
+ * @param tel           block to open
+ * @param name          object name, or NULL for the default
+ * @param create        nonzero to create the block, zero to map it
+ * @param program       name of the simulator
+ * @param pid           process that started the run
+ * @param num_dendrs    dendrites in the cell
+ * @param num_comps     compartments per dendrite
+ * @param duration      simulated time, ms
+ * @param num_slots     ranks or worker threads
+ *
+ * Returns:
+ * @return int          0 if telemetry is off, nonzero otherwise
+ */
+int telemetryOpen( Telemetry *tel, const char *name, int create,
+                   const char *program, int pid, int num_dendrs,
+                   int num_comps, int duration, int num_slots );
+
+/**
+ * Name: telemetryUpdate
+ *
+ * Description:
+ * Publishes the progress of one slot. Meant to be called about once per
+ * simulated ms: it costs a clock read and a getrusage() call.
+ *
+ * Parameters:
+ * @param tel       open block (nothing happens if telemetry is off)
+ * @param slot      rank or worker thread
+ * @param sim_ms    simulated time reached, ms
+ * @param steps     integration steps done
+ * @param compute   seconds spent computing, or negative for all of them
+ * @param comm      seconds spent communicating or waiting
+ */
+void telemetryUpdate( Telemetry *tel, int slot, int sim_ms, long steps,
+                      double compute, double comm );
+
+/**
+ * Name: telemetryClose
+ *
+ * Description:
+ * Unmaps the block. The process that created it also marks the run finished
+ * and removes it, so with several writers (the ranks of a node) it must close
+ * the block last.
+ *
+ * Parameters:
+ * @param tel       block to close
+ */
+void telemetryClose( Telemetry *tel );
+
+/**
+ * Name: telemetryAttach
+ *
+ * Description:
+ * Maps an existing block read-only, e.g. in a viewer.
+ *
+ * Parameters:
+ * @param tel       (OUTPUT) mapped block
+ * @param name      object name
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int telemetryAttach( Telemetry *tel, const char *name );
+
+/**
+ * Name: telemetryRead
+ *
+ * Description:
+ * Copies one slot of an attached block, retrying while it is being written.
+ *
+ * Parameters:
+ * @param tel       attached block
+ * @param slot      slot to read
+ * @param out       (OUTPUT) consistent copy of the slot
+ */
+void telemetryRead( const Telemetry *tel, int slot, TelemetrySlot *out );
+
+/**
+ * Name: telemetryDetach
+ *
+ * Description:
+ * Unmaps a block mapped with telemetryAttach.
+ *
+ * Parameters:
+ * @param tel       block to unmap
+ */
+void telemetryDetach( Telemetry *tel );
+
+#endif
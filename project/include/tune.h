@@ -0,0 +1,103 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include "dendrites.h"
+#include "placement.h"
+
+#include <stdio.h>
+#include <stddef.h>
+
+/**
+ * An engine configuration considered by the auto-tuner.
+ */
+typedef struct TuneConfig {
+  KernelOpts kernel;      // Dendrite kernel and its parameters.
+  int num_threads;        // Worker threads.
+  double ns_per_update;   // Measured cost, ns per compartment and step.
+} TuneConfig;
+
+/**
+ * Name: tuneDescribe
+ *
+ * Description:
+ * Writes a configuration in the form of the command line options that select
+ * it, e.g. "-k blocked --block-steps 16 --tile 512 -t 4".
+ *
+ * Parameters:
+ * @param cfg       configuration to describe
+ * @param buf       (OUTPUT) description
+ * @param size      size of `buf'
+ */
+void tuneDescribe( TuneConfig *cfg, char *buf, size_t size );
+
+/**
+ * Name: tuneLookup
+ *
+ * Description:
+ * Looks for a cached configuration in a tuning file. Entries are keyed by the
+ * CPU model, the number of online CPUs and the problem shape.
+ *
+ * The tuning file is plain text, one entry per line, fields separated by '|':
+ *
+ *    cpu model | cpus | dendrites | compartments | kernel | block steps |
+ *    tile | threads | ns per compartment-step
+ *
+ * Lines starting with '#' are ignored.
+ *
+ * Parameters:
+ * @param fname         tuning file
+ * @param num_dendrs    number of dendrites
+ * @param num_comps     compartments per dendrite (as given by the user)
+ * @param cfg           (OUTPUT) cached configuration
+ *
+ * Returns:
+ * @return int          nonzero if an entry was found
+ */
+int tuneLookup( const char *fname, int num_dendrs, int num_comps,
+                TuneConfig *cfg );
+
+/**
+ * Name: tuneStore
+ *
+ * Description:
+ * Records a configuration in a tuning file, replacing any entry for the same
+ * machine and shape. The file is rewritten atomically.
+ *
+ * Parameters:
+ * @param fname         tuning file
+ * @param num_dendrs    number of dendrites
+ * @param num_comps     compartments per dendrite (as given by the user)
+ * @param cfg           configuration to record
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int tuneStore( const char *fname, int num_dendrs, int num_comps,
+               TuneConfig *cfg );
+
+/**
+ * Name: tuneSelect
+ *
+ * Description:
+ * Picks the fastest configuration for a problem shape. A cached choice is
+ * reused unless `retune' is set; otherwise every candidate available on this
+ * machine (kernels, block and tile sizes, thread counts up to the number of
+ * online CPUs) is timed over TUNE_MS ms of simulated time and the fastest is
+ * cached.
+ *
+ * Parameters:
+ * @param fname         tuning file
+ * @param retune        nonzero to ignore the cache
+ * @param num_dendrs    number of dendrites
+ * @param num_comps     compartments per dendrite (as given by the user)
+ * @param place         CPU and memory placement used for the timings
+ * @param log           where progress goes, NULL for none
+ * @param cfg           (OUTPUT) selected configuration
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int tuneSelect( const char *fname, int retune, int num_dendrs, int num_comps,
+                PlaceOpts *place, FILE *log, TuneConfig *cfg );
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef WAVE_RELAX_H
+#define WAVE_RELAX_H
+
+#include "dendrites.h"
+#include "soma_step.h"
+
+#include <mpi.h>
+
+/**
+ * Waveform relaxation between the soma (rank 0) and the dendrites of every
+ * process.
+ *
+ * Instead of exchanging a current and a potential at every integration
+ * step, time is cut into windows of `window' steps. Each iteration over a
+ * window:
+ *
+ *   1. rank 0 broadcasts a guess of the soma potential waveform over the
+ *      window (the potential at the start of the window, held, at first);
+ *   2. every process rewinds its dendrites to the start of the window and
+ *      integrates them against that waveform, recording the current of each
+ *      step, and the current waveforms are summed onto rank 0;
+ *   3. rank 0 rewinds the soma and integrates it against the summed current,
+ *      which gives the next guess of the potential waveform.
+ *
+ * The window is done once two consecutive soma waveforms differ by less than
+ * `tol' mV anywhere (or after `max_iters' iterations). The dendrites then
+ * hold their state at the end of the window and rank 0 the soma state that
+ * goes with it. Every iteration costs one broadcast and one reduction, and
+ * one more broadcast ends the window.
+ */
+typedef struct WaveRelax {
+  int window;         // Integration steps per window.
+  double tol;         // Convergence tolerance on the soma waveform, mV.
+  int max_iters;      // Iterations per window before giving up.
+  double *v_wave;     // Soma potential before each step, then a done flag.
+  double *v_new;      // Soma potential after each step, latest iterate.
+  ReproSum *i_local;  // Current of this process' dendrites at each step.
+  ReproSum *i_wave;   // Summed current at each step (rank 0).
+  double *checkpoint; // Dendrite potentials at the start of the window.
+  long windows;       // Windows completed.
+  long iterations;    // Iterations over all windows.
+  long unconverged;   // Windows that hit max_iters.
+  long syncs;         // Collective operations issued.
+} WaveRelax;
+
+/**
+ * Name: waveRelaxInit
+ *
+ * Description:
+ * Allocates the waveforms and checkpoint of a waveform relaxation.
+ *
+ * Parameters:
+ * @param wr            state to initialize
+ * @param window        integration steps per window, must divide STEPS
+ * @param tol           convergence tolerance on the soma waveform, mV
+ * @param max_iters     iterations per window before giving up
+ * @param set           dendrites of this process
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int waveRelaxInit( WaveRelax *wr, int window, double tol, int max_iters,
+                   DendrSet *set );
+
+/**
+ * Name: waveRelaxFree
+ *
+ * Description:
+ * Releases the memory held by a waveform relaxation.
+ *
+ * Parameters:
+ * @param wr        state to free
+ */
+void waveRelaxFree( WaveRelax *wr );
+
+/**
+ * Name: waveRelaxWindow
+ *
+ * Description:
+ * Iterates one window to convergence. Collective over `comm'. On rank 0,
+ * `y' is advanced to the end of the window and `v_new' holds the potential
+ * after each of its steps.
+ *
+ * Parameters:
+ * @param wr        relaxation state
+ * @param set       dendrites of this process
+ * @param step      first integration step of the window within the ms
+ * @param method    soma integrator (rank 0)
+ * @param y         (INOUT) soma state (rank 0)
+ * @param param     soma parameters, param[0] is the step size
+ * @param rank      rank of this process in `comm'
+ * @param comm      communicator of all processes
+ *
+ * Returns:
+ * @return int      iterations taken
+ */
+int waveRelaxWindow( WaveRelax *wr, DendrSet *set, int step,
+                     SomaMethod method, double *y, double *param, int rank,
+                     MPI_Comm comm );
+
+#endif
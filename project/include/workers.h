@@ -0,0 +1,259 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include "dendrites.h"
+#include "placement.h"
+#include "steal.h"
+
+#include <stdio.h>
+#include <pthread.h>
+
+/**
+ * Barrier that spins for a while before yielding the CPU. The threads meet
+ * twice per integration step, far too often for pthread_barrier_t.
+ */
+typedef struct SpinBarrier {
+  int count;              // Number of threads taking part.
+  volatile int arrived;   // Threads that reached the barrier this round.
+  volatile int sense;     // Flipped by the last thread of each round.
+} SpinBarrier;
+
+struct Workers;
+
+/**
+ * Consecutive dendrites of one worker's set, the unit of work stealing.
+ */
+typedef struct StealChunk {
+  int home;               // Worker whose set holds the dendrites.
+  int begin, end;         // Dendrites begin..end-1 of that set.
+  int runner;             // Worker that advanced them at the last step.
+} StealChunk;
+
+/**
+ * A thread advancing a contiguous block of dendrites.
+ */
+typedef struct Worker {
+  struct Workers *pool;   // Pool the worker belongs to.
+  int id;                 // Index of the worker; 0 is the calling thread.
+  int cpu;                // CPU the worker is pinned to, -1 if none.
+  int first, count;       // Dendrites first..first+count-1.
+  DendrSet set;           // The dendrites themselves.
+  int sense;              // Barrier sense of this worker.
+  pthread_t thread;       // Thread running the worker (id > 0).
+  ChunkDeque deque;       // Chunks left to advance this step (stealing).
+  ReproSum sum;           // Exact total of the chunks it advanced.
+  double busy;            // Seconds spent advancing dendrites.
+  double idle;            // Seconds spent waiting for the other workers.
+  long steals;            // Chunks taken from other workers' deques.
+} Worker;
+
+/**
+ * Pool of threads sharing the dendrites of one cell. The calling thread is
+ * worker 0; it also integrates the soma between steps.
+ */
+typedef struct Workers {
+  int num_threads;        // Number of workers, including the caller.
+  int num_dendrs;         // Dendrites in the cell.
+  int num_comps;          // Compartments per dendrite, incl. dummy and soma.
+  KernelOpts kernel;      // Dendrite kernel.
+  PlaceOpts place;        // CPU and memory placement.
+  Worker *workers;        // The workers.
+  StealChunk *chunks;     // Chunks of all the sets (stealing).
+  int num_chunks;         // Chunks in `chunks'.
+  SpinBarrier barrier;    // Where workers meet before and after each step.
+  int step;               // Step being computed (set by worker 0).
+  double delta_t;         // Integration time step size.
+  double v_m;             // Soma potential for the step.
+  int quit;               // Nonzero when the workers should exit.
+  volatile int failed;    // Nonzero if a worker could not set up.
+} Workers;
+
+/**
+ * Name: workersInit
+ *
+ * Description:
+ * Splits the dendrites of a cell into contiguous blocks and starts one thread
+ * per block. With first touch, each worker pins itself and then allocates and
+ * initializes its own dendrites, so their pages end up on its NUMA node;
+ * otherwise the calling thread initializes all of them up front.
+ *
+ * With kernel->steal, each block is further cut into chunks of about
+ * STEAL_CHUNK_COMPS compartments (at least one dendrite). At each step a
+ * worker first advances the chunks it advanced at the previous step, which
+ * are still in its cache, and then steals whole chunks from the front of
+ * the other workers' deques until none are left. A worker held up, e.g. by
+ * costlier dendrites or by another process on its CPU, thus hands chunks
+ * over for good instead of holding up the others at every step.
+ *
+ * Parameters:
+ * @param pool          pool to start
+ * @param num_threads   number of workers (capped to the number of dendrites)
+ * @param num_dendrs    number of dendrites in the cell
+ * @param num_comps     compartments per dendrite, incl. dummy and soma
+ * @param kernel        dendrite kernel
+ * @param place         CPU and memory placement
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int workersInit( Workers *pool, int num_threads, int num_dendrs,
+                 int num_comps, KernelOpts *kernel, PlaceOpts *place );
+
+/**
+ * Name: workersStep
+ *
+ * Description:
+ * Advances all dendrites of the cell by one integration step, like
+ * dendrSetStep() on a single set holding all of them. The exact sums of the
+ * workers are merged, so the result does not depend on the number of
+ * workers.
+ *
+ * Parameters:
+ * @param pool      pool of workers
+ * @param step      integration step within the current millisecond
+ * @param delta_t   integration time step size
+ * @param v_m       soma membrane potential
+ *
+ * Returns:
+ * @return double   total current injected by the dendrites into the soma
+ */
+double workersStep( Workers *pool, int step, double delta_t, double v_m );
+
+/**
+ * Name: workersReset
+ *
+ * Description:
+ * Puts the dendrites of every worker back to rest for a new run of the same
+ * shape, keeping the threads and their memory.
+ *
+ * Parameters:
+ * @param pool      pool to reset
+ */
+void workersReset( Workers *pool );
+
+/**
+ * Name: workersStimulus
+ *
+ * Description:
+ * Drives the dendrites of the cell from `stim', numbered as in the cell (see
+ * dendrSetStimulus).
+ *
+ * Parameters:
+ * @param pool      pool of workers
+ * @param stim      stimulus, NULL for the built-in generator
+ */
+void workersStimulus( Workers *pool, const Stimulus *stim );
+
+/**
+ * Name: workersParams
+ *
+ * Description:
+ * Gives the dendrites of the cell the parameters of `ov', numbered as in the
+ * cell (see dendrSetParams).
+ *
+ * Parameters:
+ * @param pool      pool of workers
+ * @param ov        per-dendrite parameters, NULL for the defaults
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+int workersParams( Workers *pool, const DendrOverrides *ov );
+
+/**
+ * Name: workersReport
+ *
+ * Description:
+ * Writes how long each worker spent advancing dendrites and waiting for the
+ * others at the end of each step, and how many chunks it stole, since the
+ * pool was started or last reset.
+ *
+ * Parameters:
+ * @param pool      pool of workers
+ * @param out       where the report goes
+ */
+void workersReport( Workers *pool, FILE *out );
+
+/**
+ * Name: workersMatch
+ *
+ * Description:
+ * Tells whether a pool was started with the shape that workersInit() would
+ * give the arguments, so that it can be reset and reused instead.
+ *
+ * Parameters:
+ * @param pool          running pool
+ * @param num_threads   number of workers (capped to the number of dendrites)
+ * @param num_dendrs    number of dendrites in the cell
+ * @param num_comps     compartments per dendrite, incl. dummy and soma
+ * @param kernel        dendrite kernel
+ * @param place         CPU and memory placement
+ *
+ * Returns:
+ * @return int          nonzero if the pool has that shape
+ */
+int workersMatch( Workers *pool, int num_threads, int num_dendrs,
+                  int num_comps, KernelOpts *kernel, PlaceOpts *place );
+
+/**
+ * Name: workersFree
+ *
+ * Description:
+ * Stops the worker threads and releases their dendrites.
+ *
+ * Parameters:
+ * @param pool      pool to stop
+ */
+void workersFree( Workers *pool );
+
+/**
+ * Name: workersTime
+ *
+ * Description:
+ * Times `steps' integration steps of a cell's dendrites, with the soma
+ * clamped at rest, on a fresh pool of workers. The pool is set up outside of
+ * the timed region. The best of `repeats' runs is kept.
+ *
+ * Parameters:
+ * @param num_threads   number of workers
+ * @param num_dendrs    number of dendrites in the cell
+ * @param num_comps     compartments per dendrite, incl. dummy and soma
+ * @param kernel        dendrite kernel
+ * @param place         CPU and memory placement
+ * @param steps         integration steps per run
+ * @param repeats       number of runs
+ *
+ * Returns:
+ * @return double       best time in seconds, negative if there was a problem
+ */
+double workersTime( int num_threads, int num_dendrs, int num_comps,
+                    KernelOpts *kernel, PlaceOpts *place, int steps,
+                    int repeats );
+
+/**
+ * Name: workersBenchmark
+ *
+ * Description:
+ * Measures what the placement options buy. The dendrites are advanced for
+ * `steps' integration steps (with the soma clamped at rest) twice: once
+ * allocated and initialized by the calling thread with no pinning and regular
+ * pages, and once as configured in `place'. Each run is repeated and the best
+ * time kept. The times and the gain are written to `out'.
+ *
+ * Parameters:
+ * @param num_threads   number of workers
+ * @param num_dendrs    number of dendrites in the cell
+ * @param num_comps     compartments per dendrite, incl. dummy and soma
+ * @param kernel        dendrite kernel
+ * @param place         placement to compare against the baseline
+ * @param steps         integration steps per run
+ * @param out           where the report goes
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+int workersBenchmark( int num_threads, int num_dendrs, int num_comps,
+                      KernelOpts *kernel, PlaceOpts *place, int steps,
+                      FILE *out );
+
+#endif
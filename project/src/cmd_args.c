@@ -1,4 +1,5 @@
 #include "cmd_args.h"
+#include "constants.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -10,7 +11,24 @@ void usage( char *name )
 {
   printf(
 "USAGE:\n"
-"  %s [-h] [-d NUM_DENDR] [-c NUM_COMPARTMENTS]\n"
+"  %s [-h] [-d NUM_DENDR] [-c NUM_COMPARTMENTS] [-n] [-q]\n"
+"      [-o TYPE[:NAME]] [-e] [--threshold MV]\n"
+"      [-k KERNEL] [--block-steps K] [--tile T] [-s PROCS|auto]\n"
+"      [-t THREADS] [--schedule MODE] [--pin POLICY] [--huge-pages MODE]\n"
+"      [--no-first-touch] [--mbind] [--bench-placement] [--bench-shapes]\n"
+"      [--autotune]\n"
+"      [--retune]\n"
+"      [--tune-file FILE] [--soma METHOD] [--ps-tol TOL] [--validate-soma]\n"
+"      [--soma-substeps R] [--hold-current] [--wr-window K] [--wr-tol MV]\n"
+"      [--shm-reduce] [--reduce] [--validate-reduce] [--validate-kernel]\n"
+"      [--duration MS]\n"
+"      [--serve SOCKET] [--connect SOCKET] [--shutdown]\n"
+"      [--stimulus FILE] [--stim-window MS] [--write-stimulus FILE]\n"
+"      [--dendrite-params FILE] [--snapshot FILE]\n"
+"      [--telemetry NAME] [--no-telemetry]\n"
+"      [--neurons N] [--network FILE] [--fan-in K] [--syn-weight MV]\n"
+"      [--syn-delay MIN[,MAX]] [--net-seed SEED] [--spike-batch STEPS]\n"
+"      [--raster FILE] [--record FILE] [--record-buffer MS]\n"
 "\n"
 "DESCRIPTION:\n"
 "  Simulates a neuron using a Hodgkin Huxley simplified compartamental neuron\n"
@@ -34,7 +52,7 @@ void usage( char *name )
 #ifdef PLOT_PNG
 "  Simulation results will also be printed to a PNG file, using the same\n"
 "  filename as the results data file, and stored under the `graphs/'\n"
-"  directory.\n"
+"  directory. The PNG is rendered in-process; gnuplot is not needed.\n"
 "\n"
 #endif
 "OPTIONS:\n"
@@ -49,7 +67,275 @@ void usage( char *name )
 "    The number of compartments per dendrite. Must be greater than 0. Default\n"
 "    is one.\n"
 "\n"
-, name );
+"  -n, --no-plot\n"
+"    Do not plot the results. Use `hh_plot' to render the graphs of a whole\n"
+"    sweep in one pass afterwards.\n"
+"\n"
+"  -q, --quiet\n"
+"    Do not print progress or informational messages.\n"
+"\n"
+"  -o, --output TYPE[:NAME]\n"
+"    Where results are sent. TYPE is one of:\n"
+"      text    gnuplot-ready text file (default)\n"
+"      binary  binary file, data/pWWdXXcYY_MMDDYY_HHMMSS.bin\n"
+"      stdout  text streamed to standard output while the simulation runs\n"
+"      shm     POSIX shared memory object, NAME defaults to /hh_<pid>\n"
+"      null    discard all results (benchmarking)\n"
+"    For text and binary, NAME replaces the generated file name.\n"
+"\n"
+"  -e, --events\n"
+"    Output only the soma spike times followed by summary statistics (count,\n"
+"    rate, mean and CV of the interspike interval) instead of the potential\n"
+"    trace. Nothing is plotted in this mode.\n"
+"\n"
+"  --threshold\n"
+"    Spike detection threshold in mV. Defaults to 0. A spike is counted on an\n"
+"    upward crossing; the detector re-arms once the potential falls below\n"
+"    -30 mV and 1 ms has passed.\n"
+"\n"
+"  -k, --kernel\n"
+"    Dendrite kernel. `reference' (default) sweeps every dendrite once per\n"
+"    integration step. `blocked' advances compartments far from the soma\n"
+"    several steps per sweep in cache-sized tiles, which pays off for long\n"
+"    dendrites; it gives the same results as `reference'. `implicit' takes\n"
+"    backward Euler steps, which stay stable at any step size. `fused'\n"
+"    precomputes the conductances of each dendrite shape and sweeps once\n"
+"    per step; it also gives the same results as `reference'. `jacobi' is\n"
+"    `fused' with every compartment seeing the old potentials of both\n"
+"    neighbours, so several compartments are updated per SIMD instruction;\n"
+"    its results differ slightly (see --validate-kernel).\n"
+"\n"
+"  --block-steps\n"
+"    Integration steps per block for the blocked kernel. Defaults to 16.\n"
+"\n"
+"  --tile\n"
+"    Compartments per tile for the blocked kernel. Defaults to 512.\n"
+"\n"
+"  -s, --split\n"
+"    mpi_hh only. Number of processes that share the compartments of each\n"
+"    dendrite; the number of processes must be a multiple of it. Groups of\n"
+"    that many processes take the dendrites in turn, each process owning a\n"
+"    contiguous range of compartments, so there can be more processes than\n"
+"    dendrites. `auto' picks the value that leaves the least work on the\n"
+"    busiest process. Defaults to 1 (whole dendrites per process).\n"
+"\n"
+"  -t, --threads\n"
+"    seq_hh only. Number of threads advancing the dendrites, each owning a\n"
+"    contiguous block of them. Results do not depend on it. Defaults to 1.\n"
+"\n"
+"  --schedule\n"
+"    seq_hh only. How the threads share the dendrites at each step:\n"
+"      static   each thread advances its own block (default)\n"
+"      steal    blocks are cut into chunks of about %d compartments; a\n"
+"               thread that is done steals chunks from the others and\n"
+"               keeps them for the next step\n"
+"    The time each thread spends idle is reported at the end of the run.\n"
+"\n"
+"  --pin\n"
+"    Pin the threads (seq_hh) or the processes of a node (mpi_hh) to CPUs:\n"
+"      none     leave it to the scheduler (default)\n"
+"      compact  worker i on the i-th CPU\n"
+"      scatter  alternate between sockets\n"
+"      LIST     CPUs and ranges, e.g. 0-7,16-23, used in turn\n"
+"\n"
+"  --huge-pages\n"
+"    Page size of the dendrite state: `off' (default), `thp' (transparent\n"
+"    huge pages) or `explicit' (hugetlbfs pool, falls back to thp).\n"
+"\n"
+"  --no-first-touch\n"
+"    Let the main thread initialize all dendrites instead of the thread that\n"
+"    advances them. Their memory then sits on the main thread's NUMA node.\n"
+"\n"
+"  --mbind\n"
+"    Explicitly bind the dendrite state of each thread or process to the\n"
+"    NUMA node it runs on.\n"
+"\n"
+"  --bench-placement\n"
+"    seq_hh only. Instead of simulating, time the dendrites with the given\n"
+"    threads and placement against unpinned threads whose dendrites were\n"
+"    allocated by the main thread, and report the gain.\n"
+"\n"
+"  --bench-shapes\n"
+"    seq_hh only. Instead of simulating, time the fused and Jacobi kernels\n"
+"    specialized for the compartment counts they were built for (make\n"
+"    SHAPES=...) against the generic ones, with -d dendrites, and report\n"
+"    the gains. -c picks a specialized kernel whenever it is one of these\n"
+"    counts.\n"
+"\n"
+"  --autotune\n"
+"    seq_hh only. Choose the kernel, its block and tile sizes and the number\n"
+"    of threads for this -d/-c on this machine. The choice is read from the\n"
+"    tuning file if there is one for this shape and CPU; otherwise each\n"
+"    candidate is timed on a short calibration window and the fastest is\n"
+"    stored there. Overrides -k, --block-steps, --tile and -t.\n"
+"\n"
+"  --retune\n"
+"    Like --autotune, but always calibrate and replace the cached choice.\n"
+"\n"
+"  --tune-file\n"
+"    Tuning file to use. Defaults to `" TUNE_FILE "'.\n"
+"\n"
+"  --soma\n"
+"    Soma integrator: `rk4' (default), `rush-larsen', which integrates\n"
+"    the gates and Vm exponentially and stays stable at large steps, or\n"
+"    `parker-sochacki', a power series of adaptive order that is accurate\n"
+"    and stable at large steps.\n"
+"\n"
+"  --ps-tol\n"
+"    Parker-Sochacki tolerance: series terms are added until two in a row\n"
+"    change the soma state by less than TOL. Defaults to %g.\n"
+"\n"
+"  --validate-soma\n"
+"    Instead of simulating, drive the isolated soma with the mean current of\n"
+"    NUM_DENDR dendrites and compare the integrators at several step sizes\n"
+"    against RK4 at the model step, for accuracy and wall time.\n"
+"\n"
+"  --soma-substeps\n"
+"    Multi-rate stepping: the dendrites advance once per R soma steps, with\n"
+"    a step R times larger, seeing the mean soma potential of those R steps.\n"
+"    R must divide %d. mpi_hh then exchanges currents and potentials once\n"
+"    per R steps. The explicit kernels are not stable at larger steps, so\n"
+"    R > 1 selects the implicit kernel. Defaults to 1.\n"
+"\n"
+"  --hold-current\n"
+"    With --soma-substeps, hold the dendritic current of the last dendrite\n"
+"    step over the soma substeps instead of interpolating it linearly from\n"
+"    the previous one.\n"
+"\n"
+"  --wr-window\n"
+"    mpi_hh only. Waveform relaxation: instead of exchanging currents and\n"
+"    the soma potential at every step, iterate windows of K steps, each\n"
+"    process integrating its dendrites against the soma waveform of the\n"
+"    previous iteration, until the soma waveform converges. K must divide\n"
+"    %d. Defaults to 0 (off).\n"
+"\n"
+"  --wr-tol\n"
+"    Largest change of the soma waveform, in mV, between two iterations\n"
+"    that ends a window. Defaults to %g.\n"
+"\n"
+"  --shm-reduce\n"
+"    mpi_hh only. Sum the dendritic currents of the processes of a node in\n"
+"    a shared memory window and only exchange node totals between nodes,\n"
+"    instead of sending one message per process to rank 0.\n"
+"\n"
+"  --reduce\n"
+"    Simulate the dendrites of each thread or process as one equivalent\n"
+"    cable driven by their mean tip current, with its current scaled by\n"
+"    their number. The cable is linear, so this matches the full model up\n"
+"    to rounding, at the cost of a single dendrite.\n"
+"\n"
+"  --validate-reduce\n"
+"    seq_hh only. Instead of simulating, run the full and the reduced model\n"
+"    and report the difference of the soma traces and the speedup.\n"
+"\n"
+"  --validate-kernel\n"
+"    seq_hh only. Instead of simulating, run the reference kernel and the\n"
+"    one given with -k and report the difference of the soma traces, the\n"
+"    spike counts and the speedup.\n"
+"\n"
+"  --duration\n"
+"    Simulated time in ms, from 1 to %d. Defaults to %d.\n"
+"\n"
+"  --serve\n"
+"    seq_hh only. Instead of simulating, listen on the Unix socket SOCKET\n"
+"    for jobs and run them one after the other. A job is a command line\n"
+"    (without the program name); its results are streamed back in the\n"
+"    stdout sink format. Worker threads and dendrite buffers are kept warm\n"
+"    and reused by the next job of the same shape.\n"
+"\n"
+"  --connect\n"
+"    seq_hh only. Send the rest of the command line as a job to the server\n"
+"    listening on SOCKET and print its results.\n"
+"\n"
+"  --shutdown\n"
+"    With --connect, stop the server instead of running a job.\n"
+"\n"
+"  --stimulus\n"
+"    Read the current injected at each dendrite tip from FILE instead of\n"
+"    drawing it at random. The file is memory mapped a window at a time and\n"
+"    read ahead. Not available with split dendrites.\n"
+"\n"
+"  --stim-window\n"
+"    Milliseconds of the stimulus file mapped at a time. Defaults to %d.\n"
+"\n"
+"  --write-stimulus\n"
+"    seq_hh only. Instead of simulating, write the built-in random stimulus\n"
+"    for the given dendrites and duration to FILE.\n"
+"\n"
+"  --dendrite-params\n"
+"    Per-dendrite conductance factor, capacitance and tip current factor,\n"
+"    one `DENDRITE[-LAST] G_SCALE CAP_PF INJ_SCALE' line per dendrite or\n"
+"    range of dendrites in FILE. Needs the fused or Jacobi kernel, whole\n"
+"    dendrites and no soma substeps or auto-tuning.\n"
+"\n"
+"  --snapshot\n"
+"    After the run, write the soma potential at each ms, the spike times and\n"
+"    the final potential of every compartment to FILE, to full precision.\n"
+"    Reduced dendrites have no compartments to write. Used by hh_check to\n"
+"    compare engines.\n"
+"\n"
+"  --telemetry\n"
+"    Name of the POSIX shared memory object where the run publishes its\n"
+"    progress while it runs (simulated time, steps, compute and waiting time\n"
+"    and memory of every thread or rank), for `hhtop' to show. Defaults to\n"
+"    " TEL_PREFIX "PID, PID being that of seq_hh or of rank 0. The object is\n"
+"    removed at the end of the run.\n"
+"\n"
+"  --no-telemetry\n"
+"    Do not publish any telemetry.\n"
+"\n"
+"  --neurons\n"
+"    Simulate a network of N neurons instead of a single cell (mpi_hh only).\n"
+"    Every neuron has the dendrites given by -d and -c; the neurons are\n"
+"    dealt out to the processes round robin. Each spike of a neuron adds a\n"
+"    step to the potential of the compartments it has synapses onto, after\n"
+"    the axonal delay of the synapse. Needs whole dendrites, no soma\n"
+"    substeps, waveform relaxation, shared memory reduction or reduced\n"
+"    dendrites.\n"
+"\n"
+"  --network\n"
+"    Read the synapses from FILE, one `SOURCE TARGET DENDRITE COMPARTMENT\n"
+"    WEIGHT_MV DELAY_MS' line each, neurons and compartments counted from 0\n"
+"    and compartment 0 at the tip. Without --neurons, the network has as\n"
+"    many neurons as FILE mentions. Without FILE, every neuron gets synapses\n"
+"    from random other neurons, see below.\n"
+"\n"
+"  --fan-in\n"
+"    Synapses onto each neuron of a random network. Defaults to %d.\n"
+"\n"
+"  --syn-weight\n"
+"    Potential step per spike of a random network, mV. Defaults to %g.\n"
+"\n"
+"  --syn-delay\n"
+"    Axonal delays of a random network, uniform from MIN to MAX ms.\n"
+"    Defaults to %g,%g.\n"
+"\n"
+"  --net-seed\n"
+"    Seed of the random network. Defaults to %d.\n"
+"\n"
+"  --spike-batch\n"
+"    Integration steps between spike exchanges. Defaults to the shortest\n"
+"    delay in the network, the most a process can run ahead of the others;\n"
+"    1 exchanges at every step, which gives the same results.\n"
+"\n"
+"  --raster\n"
+"    Write every spike of the network to FILE, one `NEURON TIME_MS' line\n"
+"    each, in order of time.\n"
+"\n"
+"  --record\n"
+"    Record the current and the potential of every compartment of every\n"
+"    dendrite at each ms to the binary file FILE (mpi_hh only). Every\n"
+"    process writes its own dendrites with collective MPI-IO writes; the\n"
+"    aggregate bandwidth is reported at the end. Needs whole, unreduced\n"
+"    dendrites.\n"
+"\n"
+"  --record-buffer\n"
+"    Milliseconds of recording buffered between collective writes. Defaults\n"
+"    to %d.\n"
+"\n"
+, name, STEAL_CHUNK_COMPS, PS_TOL, STEPS, STEPS, WR_TOL, COMPTIME, COMPTIME, STIM_WINDOW,
+  NET_FAN_IN, NET_WEIGHT, NET_MIN_DELAY, NET_MAX_DELAY, NET_SEED,
+  REC_BUFFER_MS );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -61,6 +347,48 @@ int parseArgs( CmdArgs *cmd_args, int argc, char **argv )
   // Setup default values.
   cmd_args->num_dendrs = 1;
   cmd_args->num_comps  = 1;
+  cmd_args->plot       = 1;
+  cmd_args->quiet      = 0;
+  cmd_args->output_type = SINK_TEXT;
+  cmd_args->output_name = NULL;
+  cmd_args->events = 0;
+  cmd_args->spike_threshold = SPIKE_THRESHOLD;
+  cmd_args->kernel.kernel = KERNEL_REFERENCE;
+  cmd_args->kernel.block_steps = BLOCK_STEPS;
+  cmd_args->kernel.tile = BLOCK_TILE;
+  cmd_args->split = 1;
+  cmd_args->num_threads = 1;
+  placeDefaults( &cmd_args->place );
+  cmd_args->bench_placement = 0;
+  cmd_args->bench_shapes = 0;
+  cmd_args->autotune = 0;
+  cmd_args->tune_file = TUNE_FILE;
+  cmd_args->soma = SOMA_RK4;
+  cmd_args->ps_tol = PS_TOL;
+  cmd_args->validate_soma = 0;
+  cmd_args->soma_substeps = 1;
+  cmd_args->hold_current = 0;
+  cmd_args->wr_window = 0;
+  cmd_args->wr_tol = WR_TOL;
+  cmd_args->shm_reduce = 0;
+  cmd_args->kernel.reduce = 0;
+  cmd_args->kernel.steal = 0;
+  cmd_args->validate_reduce = 0;
+  cmd_args->validate_kernel = 0;
+  cmd_args->duration = COMPTIME;
+  cmd_args->serve = NULL;
+  cmd_args->connect = NULL;
+  cmd_args->shutdown = 0;
+  cmd_args->stimulus = NULL;
+  cmd_args->stim_window = STIM_WINDOW;
+  cmd_args->write_stimulus = NULL;
+  cmd_args->dendr_params = NULL;
+  cmd_args->snapshot = NULL;
+  cmd_args->telemetry = 1;
+  cmd_args->telemetry_name = NULL;
+  netDefaults( &cmd_args->net );
+  cmd_args->record = NULL;
+  cmd_args->record_buffer = REC_BUFFER_MS;
 
   // Define a macro to make checking parameters easier.
   #define PARAM_EQUALS( sn, ln ) (strcmp( (sn), argv[i] ) == 0 ||\
@@ -95,6 +423,356 @@ int parseArgs( CmdArgs *cmd_args, int argc, char **argv )
         cmd_args->num_comps = 1;
       }
 
+      i += 2;
+    } else if (PARAM_EQUALS( "-n", "--no-plot" )) {
+      cmd_args->plot = 0;
+
+      i += 1;
+    } else if (PARAM_EQUALS( "-q", "--quiet" )) {
+      cmd_args->quiet = 1;
+
+      i += 1;
+    } else if (PARAM_EQUALS( "-o", "--output" ) && i + 1 < argc) {
+      char *colon = strchr( argv[i+1], ':' );
+
+      if (colon) {
+        *colon = '\0';
+        cmd_args->output_name = colon + 1;
+      }
+      if (!sinkParseType( argv[i+1], &cmd_args->output_type )) {
+        fprintf(stderr, "Unknown output type '%s'!\n", argv[i+1]);
+        return 0;
+      }
+
+      i += 2;
+    } else if (PARAM_EQUALS( "-e", "--events" )) {
+      cmd_args->events = 1;
+
+      i += 1;
+    } else if (strcmp( "--threshold", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->spike_threshold = atof( argv[i+1] );
+
+      if (cmd_args->spike_threshold <= SPIKE_REARM) {
+        fprintf(stderr, "Spike threshold must be above %d mV!\n",
+                SPIKE_REARM);
+        fprintf(stderr, "Spike threshold default to %d mV!\n",
+                SPIKE_THRESHOLD);
+        cmd_args->spike_threshold = SPIKE_THRESHOLD;
+      }
+
+      i += 2;
+    } else if (PARAM_EQUALS( "-k", "--kernel" ) && i + 1 < argc) {
+      if (!dendrParseKernel( argv[i+1], &cmd_args->kernel.kernel )) {
+        fprintf(stderr, "Unknown kernel '%s'!\n", argv[i+1]);
+        return 0;
+      }
+
+      i += 2;
+    } else if (strcmp( "--block-steps", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->kernel.block_steps = atoi( argv[i+1] );
+
+      if (cmd_args->kernel.block_steps <= 0) {
+        fprintf(stderr, "Steps per block must be greater than 0!\n");
+        fprintf(stderr, "Steps per block default to %d!\n", BLOCK_STEPS);
+        cmd_args->kernel.block_steps = BLOCK_STEPS;
+      }
+
+      i += 2;
+    } else if (strcmp( "--tile", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->kernel.tile = atoi( argv[i+1] );
+
+      if (cmd_args->kernel.tile <= 0) {
+        fprintf(stderr, "Tile size must be greater than 0!\n");
+        fprintf(stderr, "Tile size default to %d!\n", BLOCK_TILE);
+        cmd_args->kernel.tile = BLOCK_TILE;
+      }
+
+      i += 2;
+    } else if (PARAM_EQUALS( "-s", "--split" ) && i + 1 < argc) {
+      if (strcmp( "auto", argv[i+1] ) == 0) {
+        cmd_args->split = 0;
+      } else {
+        cmd_args->split = atoi( argv[i+1] );
+
+        if (cmd_args->split <= 0) {
+          fprintf(stderr, "Processes per dendrite must be greater than 0!\n");
+          fprintf(stderr, "Processes per dendrite default to 1!\n");
+          cmd_args->split = 1;
+        }
+      }
+
+      i += 2;
+    } else if (PARAM_EQUALS( "-t", "--threads" ) && i + 1 < argc) {
+      cmd_args->num_threads = atoi( argv[i+1] );
+
+      if (cmd_args->num_threads <= 0) {
+        fprintf(stderr, "Number of threads must be greater than 0!\n");
+        fprintf(stderr, "Number of threads default to 1!\n");
+        cmd_args->num_threads = 1;
+      }
+
+      i += 2;
+    } else if (strcmp( "--schedule", argv[i] ) == 0 && i + 1 < argc) {
+      if (strcmp( "steal", argv[i+1] ) == 0) {
+        cmd_args->kernel.steal = 1;
+      } else if (strcmp( "static", argv[i+1] ) == 0) {
+        cmd_args->kernel.steal = 0;
+      } else {
+        fprintf(stderr, "Schedule must be static or steal!\n");
+        fprintf(stderr, "Schedule default to static!\n");
+        cmd_args->kernel.steal = 0;
+      }
+
+      i += 2;
+    } else if (strcmp( "--pin", argv[i] ) == 0 && i + 1 < argc) {
+      if (!placeParsePin( argv[i+1], &cmd_args->place )) {
+        fprintf(stderr, "Unknown pinning policy '%s'!\n", argv[i+1]);
+        return 0;
+      }
+
+      i += 2;
+    } else if (strcmp( "--huge-pages", argv[i] ) == 0 && i + 1 < argc) {
+      if (!placeParseHuge( argv[i+1], &cmd_args->place.huge )) {
+        fprintf(stderr, "Unknown huge page mode '%s'!\n", argv[i+1]);
+        return 0;
+      }
+
+      i += 2;
+    } else if (strcmp( "--no-first-touch", argv[i] ) == 0) {
+      cmd_args->place.first_touch = 0;
+
+      i += 1;
+    } else if (strcmp( "--mbind", argv[i] ) == 0) {
+      cmd_args->place.mbind = 1;
+
+      i += 1;
+    } else if (strcmp( "--bench-placement", argv[i] ) == 0) {
+      cmd_args->bench_placement = 1;
+
+      i += 1;
+    } else if (strcmp( "--bench-shapes", argv[i] ) == 0) {
+      cmd_args->bench_shapes = 1;
+
+      i += 1;
+    } else if (strcmp( "--autotune", argv[i] ) == 0) {
+      if (!cmd_args->autotune) {
+        cmd_args->autotune = 1;
+      }
+
+      i += 1;
+    } else if (strcmp( "--retune", argv[i] ) == 0) {
+      cmd_args->autotune = 2;
+
+      i += 1;
+    } else if (strcmp( "--tune-file", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->tune_file = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--soma", argv[i] ) == 0 && i + 1 < argc) {
+      if (!somaParseMethod( argv[i+1], &cmd_args->soma )) {
+        fprintf(stderr, "Unknown soma integrator '%s'!\n", argv[i+1]);
+        return 0;
+      }
+
+      i += 2;
+    } else if (strcmp( "--ps-tol", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->ps_tol = atof( argv[i+1] );
+
+      if (cmd_args->ps_tol <= 0) {
+        fprintf(stderr, "Parker-Sochacki tolerance must be greater than 0!\n");
+        fprintf(stderr, "Parker-Sochacki tolerance default to %g!\n", PS_TOL);
+        cmd_args->ps_tol = PS_TOL;
+      }
+
+      i += 2;
+    } else if (strcmp( "--validate-soma", argv[i] ) == 0) {
+      cmd_args->validate_soma = 1;
+
+      i += 1;
+    } else if (strcmp( "--soma-substeps", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->soma_substeps = atoi( argv[i+1] );
+
+      if (cmd_args->soma_substeps <= 0 ||
+          STEPS % cmd_args->soma_substeps != 0) {
+        fprintf(stderr, "Soma substeps must divide %d!\n", STEPS);
+        fprintf(stderr, "Soma substeps default to 1!\n");
+        cmd_args->soma_substeps = 1;
+      }
+
+      i += 2;
+    } else if (strcmp( "--hold-current", argv[i] ) == 0) {
+      cmd_args->hold_current = 1;
+
+      i += 1;
+    } else if (strcmp( "--wr-window", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->wr_window = atoi( argv[i+1] );
+
+      if (cmd_args->wr_window < 0 ||
+          (cmd_args->wr_window > 0 && STEPS % cmd_args->wr_window != 0)) {
+        fprintf(stderr, "Relaxation window must divide %d!\n", STEPS);
+        fprintf(stderr, "Relaxation window default to 0 (off)!\n");
+        cmd_args->wr_window = 0;
+      }
+
+      i += 2;
+    } else if (strcmp( "--wr-tol", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->wr_tol = atof( argv[i+1] );
+
+      if (cmd_args->wr_tol <= 0) {
+        fprintf(stderr, "Relaxation tolerance must be greater than 0!\n");
+        fprintf(stderr, "Relaxation tolerance default to %g!\n", WR_TOL);
+        cmd_args->wr_tol = WR_TOL;
+      }
+
+      i += 2;
+    } else if (strcmp( "--shm-reduce", argv[i] ) == 0) {
+      cmd_args->shm_reduce = 1;
+
+      i += 1;
+    } else if (strcmp( "--reduce", argv[i] ) == 0) {
+      cmd_args->kernel.reduce = 1;
+
+      i += 1;
+    } else if (strcmp( "--validate-reduce", argv[i] ) == 0) {
+      cmd_args->validate_reduce = 1;
+
+      i += 1;
+    } else if (strcmp( "--validate-kernel", argv[i] ) == 0) {
+      cmd_args->validate_kernel = 1;
+
+      i += 1;
+    } else if (strcmp( "--duration", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->duration = atoi( argv[i+1] );
+
+      if (cmd_args->duration <= 0 || cmd_args->duration > COMPTIME) {
+        fprintf(stderr, "Duration must be between 1 and %d ms!\n", COMPTIME);
+        fprintf(stderr, "Duration default to %d ms!\n", COMPTIME);
+        cmd_args->duration = COMPTIME;
+      }
+
+      i += 2;
+    } else if (strcmp( "--serve", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->serve = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--connect", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->connect = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--shutdown", argv[i] ) == 0) {
+      cmd_args->shutdown = 1;
+
+      i += 1;
+    } else if (strcmp( "--stimulus", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->stimulus = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--stim-window", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->stim_window = atoi( argv[i+1] );
+
+      if (cmd_args->stim_window <= 0) {
+        fprintf(stderr, "Stimulus window must be greater than 0!\n");
+        fprintf(stderr, "Stimulus window default to %d!\n", STIM_WINDOW);
+        cmd_args->stim_window = STIM_WINDOW;
+      }
+
+      i += 2;
+    } else if (strcmp( "--write-stimulus", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->write_stimulus = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--dendrite-params", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->dendr_params = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--snapshot", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->snapshot = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--telemetry", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->telemetry_name = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--no-telemetry", argv[i] ) == 0) {
+      cmd_args->telemetry = 0;
+
+      i += 1;
+    } else if (strcmp( "--neurons", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->net.neurons = atoi( argv[i+1] );
+
+      if (cmd_args->net.neurons < 0) {
+        fprintf(stderr, "Number of neurons must be 0 or greater!\n");
+        fprintf(stderr, "Number of neurons default to 0!\n");
+        cmd_args->net.neurons = 0;
+      }
+
+      i += 2;
+    } else if (strcmp( "--network", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->net.file = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--fan-in", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->net.fan_in = atoi( argv[i+1] );
+
+      if (cmd_args->net.fan_in < 0) {
+        fprintf(stderr, "Fan-in must be 0 or greater!\n");
+        fprintf(stderr, "Fan-in default to %d!\n", NET_FAN_IN);
+        cmd_args->net.fan_in = NET_FAN_IN;
+      }
+
+      i += 2;
+    } else if (strcmp( "--syn-weight", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->net.weight = atof( argv[i+1] );
+
+      i += 2;
+    } else if (strcmp( "--syn-delay", argv[i] ) == 0 && i + 1 < argc) {
+      if (sscanf( argv[i+1], "%lf,%lf", &cmd_args->net.min_delay,
+                  &cmd_args->net.max_delay ) != 2) {
+        cmd_args->net.max_delay = cmd_args->net.min_delay;
+      }
+
+      if (cmd_args->net.min_delay * STEPS < 1 ||
+          cmd_args->net.max_delay < cmd_args->net.min_delay) {
+        fprintf(stderr, "Delays must be at least one step and MAX no "
+                "shorter than MIN!\n");
+        fprintf(stderr, "Delays default to %g,%g ms!\n", NET_MIN_DELAY,
+                NET_MAX_DELAY);
+        cmd_args->net.min_delay = NET_MIN_DELAY;
+        cmd_args->net.max_delay = NET_MAX_DELAY;
+      }
+
+      i += 2;
+    } else if (strcmp( "--net-seed", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->net.seed = (unsigned) strtoul( argv[i+1], NULL, 10 );
+
+      i += 2;
+    } else if (strcmp( "--spike-batch", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->net.batch = atoi( argv[i+1] );
+
+      if (cmd_args->net.batch < 0) {
+        fprintf(stderr, "Spike batch must be 0 or greater!\n");
+        fprintf(stderr, "Spike batch default to 0 (the shortest delay)!\n");
+        cmd_args->net.batch = 0;
+      }
+
+      i += 2;
+    } else if (strcmp( "--raster", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->net.raster = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--record", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->record = argv[i+1];
+
+      i += 2;
+    } else if (strcmp( "--record-buffer", argv[i] ) == 0 && i + 1 < argc) {
+      cmd_args->record_buffer = atoi( argv[i+1] );
+
+      if (cmd_args->record_buffer <= 0) {
+        fprintf(stderr, "Record buffer must be greater than 0!\n");
+        fprintf(stderr, "Record buffer default to %d ms!\n", REC_BUFFER_MS);
+        cmd_args->record_buffer = REC_BUFFER_MS;
+      }
+
       i += 2;
     } else {
       // Unknown parameter.
@@ -103,6 +781,43 @@ int parseArgs( CmdArgs *cmd_args, int argc, char **argv )
     }
   }
 
+  // Coarse dendrite steps need a kernel that is stable at them.
+  cmd_args->kernel.steps_per_ms = STEPS / cmd_args->soma_substeps;
+  if (cmd_args->soma_substeps > 1 &&
+      cmd_args->kernel.kernel != KERNEL_IMPLICIT) {
+    if (cmd_args->kernel.kernel != KERNEL_REFERENCE) {
+      fprintf(stderr, "Soma substeps need the implicit kernel!\n");
+      fprintf(stderr, "Kernel default to implicit!\n");
+    }
+    cmd_args->kernel.kernel = KERNEL_IMPLICIT;
+  }
+
+  // A reduced set is a single cable, which can't be shared.
+  if (cmd_args->kernel.steal && cmd_args->kernel.reduce) {
+    fprintf(stderr, "Work stealing needs whole dendrites!\n");
+    fprintf(stderr, "Schedule default to static!\n");
+    cmd_args->kernel.steal = 0;
+  }
+
+  // Per-dendrite parameters live in the shapes of the fused and Jacobi
+  // kernels.
+  if (cmd_args->dendr_params) {
+    if (cmd_args->soma_substeps > 1 || cmd_args->kernel.reduce ||
+        cmd_args->autotune) {
+      fprintf(stderr, "Dendrite parameters need whole dendrites, no soma "
+              "substeps and no auto-tuning!\n");
+      return 0;
+    }
+    if (cmd_args->kernel.kernel != KERNEL_FUSED &&
+        cmd_args->kernel.kernel != KERNEL_JACOBI) {
+      if (cmd_args->kernel.kernel != KERNEL_REFERENCE) {
+        fprintf(stderr, "Dendrite parameters need the fused kernel!\n");
+        fprintf(stderr, "Kernel default to fused!\n");
+      }
+      cmd_args->kernel.kernel = KERNEL_FUSED;
+    }
+  }
+
   // Everything seems hunky dorey.
   return 1;
 }
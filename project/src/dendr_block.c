@@ -0,0 +1,142 @@
+#include "dendr_block.h"
+#include "hh_model.h"
+#include "constants.h"
+
+#include <stdlib.h>
+
+// Same expression as dendrite() in lib_hh.c.
+#define DERIV( dt, I, gB, gA, yB, y, yA ) \
+  ((dt)*((I) + (gB)*(yB) - ((gB) + (gA))*(y) + (gA)*(yA) - \
+   (gLd)*((y)-EL))/(Cd))
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static inline double compartmentStep( double dt, double I, double gB,
+                                      double gA, double yB_old, double yB,
+                                      double y, double yA )
+{
+  // dendriteStep() takes the first RK4 slope from the previous step's values,
+  // then the remaining ones against the freshly updated left neighbour.
+  double const dt6 = 1.0/6;
+  double k1, k2, k3, k4;
+
+  k1 = DERIV( dt, I, gB, gA, yB_old, y, yA );
+  k2 = DERIV( dt, I, gB, gA, yB, y + 0.5*k1, yA );
+  k3 = DERIV( dt, I, gB, gA, yB, y + 0.5*k2, yA );
+  k4 = DERIV( dt, I, gB, gA, yB, y + 1.0*k3, yA );
+
+  return y + dt6*(k1+k4+2*(k2+k3));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrUpdateRange( double *v, int offset, int num_comps, int lo, int hi,
+                       double left_old, double cur, double dt )
+{
+  int j;
+  double y, gB, gA;
+
+  for (j = lo; j < hi; j++) {
+    y = v[j-offset];
+    if (j == 1) {
+      gA = DENDRCONDCOMP + DENDRCONDDISTR/(num_comps-2-(j-1));
+      v[j-offset] = compartmentStep( dt, cur, 0, gA, left_old, v[j-offset-1],
+                                     y, v[j-offset+1] );
+    } else {
+      gB = DENDRCONDCOMP + DENDRCONDDISTR/(num_comps-1-(j-1));
+      gA = DENDRCONDCOMP + DENDRCONDDISTR/(num_comps-2-(j-1));
+      v[j-offset] = compartmentStep( dt, 0, gB, gA, left_old, v[j-offset-1],
+                                     y, v[j-offset+1] );
+    }
+    left_old = y;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrBlockInit( DendrBlock *blk, int num_comps, int block_steps,
+                    int tile )
+{
+  blk->num_comps = num_comps;
+  blk->block_steps = block_steps;
+  blk->tile = tile;
+  blk->len = 0;
+  blk->cur       = (double*) malloc( block_steps * sizeof(double) );
+  blk->stair_old = (double*) malloc( block_steps * sizeof(double) );
+  blk->edge_old  = (double*) malloc( block_steps * sizeof(double) );
+
+  return blk->cur && blk->stair_old && blk->edge_old;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrBlockFree( DendrBlock *blk )
+{
+  free( blk->cur );
+  free( blk->stair_old );
+  free( blk->edge_old );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double dendrBlockBegin( DendrBlock *blk, double *v_d, int len,
+                        double delta_t, double v_m )
+{
+  int const m = blk->num_comps - 2;  // Compartment next to the soma.
+  int a, k, lo, hi;
+  double left_old;
+
+  blk->len = len;
+
+  // Update somatic potential = potential of the last compartment
+  v_d[m+1] = v_m;
+
+  // Skewed tiles: at step k the tile starting at `a' covers a-k..a+tile-k-1,
+  // clipped to compartments that can reach step k before the soma has to be
+  // consulted again (j <= m-k).
+  for (a = 1; a <= m; a += blk->tile) {
+    for (k = 0; k < len; k++) {
+      lo = a - k < 1 ? 1 : a - k;
+      hi = a + blk->tile - k;
+      if (hi > m - k + 1) {
+        hi = m - k + 1;
+      }
+      if (lo >= hi) {
+        continue;
+      }
+
+      left_old = (lo == 1) ? v_d[0] : blk->edge_old[k];
+      blk->edge_old[k] = v_d[hi-1];
+      if (hi == m - k + 1) {
+        blk->stair_old[k] = v_d[hi-1];
+      }
+      dendrUpdateRange( v_d, 0, blk->num_comps, lo, hi, left_old,
+                        blk->cur[k], delta_t );
+    }
+  }
+
+  return (DENDRCONDCOMP + DENDRCONDDISTR/1) * (v_d[m] - v_m);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double dendrBlockStep( DendrBlock *blk, double *v_d, int k, double delta_t,
+                       double v_m )
+{
+  int const m = blk->num_comps - 2;
+  int lo = m + 1 - k;
+
+  v_d[m+1] = v_m;
+
+  // Compartments lo..m are one step behind; v_d[lo-1] already reached step k
+  // while the tiles were processed and its previous value was saved then.
+  if (lo <= 1) {
+    dendrUpdateRange( v_d, 0, blk->num_comps, 1, m + 1, v_d[0], blk->cur[k],
+                      delta_t );
+  } else {
+    dendrUpdateRange( v_d, 0, blk->num_comps, lo, m + 1, blk->stair_old[k],
+                      blk->cur[k], delta_t );
+  }
+
+  return (DENDRCONDCOMP + DENDRCONDDISTR/1) * (v_d[m] - v_m);
+}
@@ -0,0 +1,46 @@
+#include "dendr_implicit.h"
+#include "hh_model.h"
+#include "constants.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double dendrImplicitSolve( double *v_d, double *scratch, double cur,
+                           int num_comps, double delta_t, double v_m )
+{
+  int const m = num_comps - 2;  // Compartment next to the soma.
+  double *c = scratch;               // Upper diagonal after elimination.
+  double *d = scratch + num_comps;   // Right hand side after elimination.
+  double const r = delta_t / Cd;
+  double gB, gA, a, b, rhs, denom;
+  int j;
+
+  // Update somatic potential = potential of the last compartment
+  v_d[m+1] = v_m;
+
+  // Cd (x_j - v_j) / dt = I_j + gB (x_{j-1} - x_j) + gA (x_{j+1} - x_j)
+  //                       - gLd (x_j - EL)
+  // with x_{m+1} = v_m. Forward elimination, tip to soma.
+  for (j = 1; j <= m; j++) {
+    gB = (j == 1) ? 0 : DENDRCONDCOMP + DENDRCONDDISTR/(num_comps-1-(j-1));
+    gA = DENDRCONDCOMP + DENDRCONDDISTR/(num_comps-2-(j-1));
+
+    a = -gB * r;
+    b = 1 + (gB + gA + gLd) * r;
+    rhs = v_d[j] + r * ((j == 1 ? cur : 0) + gLd * EL);
+    if (j == m) {
+      rhs += gA * r * v_m;
+    }
+
+    denom = (j == 1) ? b : b - a * c[j-1];
+    c[j] = (j == m) ? 0 : -gA * r / denom;
+    d[j] = (j == 1) ? rhs / denom : (rhs - a * d[j-1]) / denom;
+  }
+
+  // Back substitution, soma to tip.
+  v_d[m] = d[m];
+  for (j = m - 1; j >= 1; j--) {
+    v_d[j] = d[j] - c[j] * v_d[j+1];
+  }
+
+  return (DENDRCONDCOMP + DENDRCONDDISTR/1) * (v_d[m] - v_m);
+}
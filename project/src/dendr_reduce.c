@@ -0,0 +1,146 @@
+#include "dendr_reduce.h"
+#include "placement.h"
+#include "spike.h"
+#include "constants.h"
+
+#include <math.h>
+#include <sys/time.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int runCell( int num_dendrs, int num_comps, KernelOpts *opts,
+                    SomaMethod method, double *trace, SpikeStats *stats,
+                    double *secs )
+{
+  // Single-threaded cell, recording Vm once per ms.
+  double y[NUMVAR], y0[NUMVAR], dydt[NUMVAR], param[3], t_spike;
+  struct timeval start, stop, diff;
+  SpikeDetector det;
+  PlaceOpts place;
+  DendrSet set;
+  int t_ms, step;
+
+  placeDefaults( &place );
+  if (!dendrSetInit( &set, 0, num_dendrs, num_comps, opts, &place )) {
+    return 0;
+  }
+
+  y[0] = VREST; y[1] = 0.037; y[2] = 0.0148; y[3] = 0.9959;
+  param[0] = 1.0 / (double) STEPS;
+  param[1] = 0.0;
+
+  spikeInit( &det, SPIKE_THRESHOLD, SPIKE_REARM, SPIKE_REFRACTORY );
+  trace[0] = y[0];
+
+  gettimeofday( &start, NULL );
+  for (t_ms = 1; t_ms < COMPTIME; t_ms++) {
+    for (step = 0; step < STEPS; step++) {
+      param[2] = dendrSetStep( &set, step, param[0], y[0] );
+      somaStep( method, y, y0, dydt, param );
+      spikeUpdate( &det, t_ms - 1 + (step + 1) * param[0], param[0], y0[0],
+                   y[0], &t_spike );
+    }
+    trace[t_ms] = y[0];
+  }
+  gettimeofday( &stop, NULL );
+
+  timersub( &stop, &start, &diff );
+  *secs = (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
+  *stats = det.stats;
+  dendrSetFree( &set );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrReduceValidate( int num_dendrs, int num_comps, KernelOpts *opts,
+                         SomaMethod method, FILE *out )
+{
+  double full[COMPTIME], reduced[COMPTIME], full_secs, red_secs, max_dv;
+  SpikeStats full_stats, red_stats;
+  KernelOpts run = *opts;
+  int t, ok;
+
+  run.steps_per_ms = STEPS;
+  run.reduce = 0;
+  if (!runCell( num_dendrs, num_comps, &run, method, full, &full_stats,
+                &full_secs )) {
+    return 0;
+  }
+  run.reduce = 1;
+  if (!runCell( num_dendrs, num_comps, &run, method, reduced, &red_stats,
+                &red_secs )) {
+    return 0;
+  }
+
+  max_dv = 0.0;
+  for (t = 0; t < COMPTIME; t++) {
+    max_dv = fmax( max_dv, fabs( reduced[t] - full[t] ) );
+  }
+  ok = max_dv <= REDUCE_TOLERANCE &&
+       red_stats.num_spikes == full_stats.num_spikes;
+
+  fprintf( out, "Reduced model validation: %d dendrites x %d compartments, "
+           "%s kernel, %d ms\n", num_dendrs, num_comps - 2,
+           dendrKernelName( run.kernel ), COMPTIME );
+  fprintf( out, "  full:    %10.3f s  %d spikes\n", full_secs,
+           full_stats.num_spikes );
+  fprintf( out, "  reduced: %10.3f s  %d spikes  (speedup %.1fx)\n",
+           red_secs, red_stats.num_spikes, full_secs / red_secs );
+  fprintf( out, "  max |dV| = %g mV\n", max_dv );
+  fprintf( out, "The reduced model %s the full one (within %g mV, same "
+           "spike count).\n", ok ? "matches" : "DOES NOT match",
+           REDUCE_TOLERANCE );
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrKernelValidate( int num_dendrs, int num_comps, KernelOpts *opts,
+                         SomaMethod method, FILE *out )
+{
+  double ref[COMPTIME], alt[COMPTIME], ref_secs, alt_secs, max_dv, sum_dv;
+  SpikeStats ref_stats, alt_stats;
+  KernelOpts run = *opts;
+  int t, ok;
+
+  run.steps_per_ms = STEPS;
+  run.reduce = 0;
+  run.kernel = KERNEL_REFERENCE;
+  if (!runCell( num_dendrs, num_comps, &run, method, ref, &ref_stats,
+                &ref_secs )) {
+    return 0;
+  }
+  run.kernel = opts->kernel;
+  if (!runCell( num_dendrs, num_comps, &run, method, alt, &alt_stats,
+                &alt_secs )) {
+    return 0;
+  }
+
+  max_dv = sum_dv = 0.0;
+  for (t = 0; t < COMPTIME; t++) {
+    max_dv = fmax( max_dv, fabs( alt[t] - ref[t] ) );
+    sum_dv += fabs( alt[t] - ref[t] );
+  }
+  ok = max_dv <= KERNEL_TOLERANCE &&
+       alt_stats.num_spikes == ref_stats.num_spikes;
+
+  fprintf( out, "Kernel validation: %d dendrites x %d compartments, %s "
+           "kernel, %d ms\n", num_dendrs, num_comps - 2,
+           dendrKernelName( run.kernel ), COMPTIME );
+  fprintf( out, "  reference: %10.3f s  %d spikes\n", ref_secs,
+           ref_stats.num_spikes );
+  fprintf( out, "  %-9s: %10.3f s  %d spikes  (speedup %.1fx)\n",
+           dendrKernelName( run.kernel ), alt_secs, alt_stats.num_spikes,
+           ref_secs / alt_secs );
+  fprintf( out, "  max |dV| = %g mV, mean |dV| = %g mV\n", max_dv,
+           sum_dv / COMPTIME );
+  if (ref_stats.num_spikes > 0 && alt_stats.num_spikes > 0) {
+    fprintf( out, "  first spike shifted by %+.3f ms\n",
+             alt_stats.first - ref_stats.first );
+  }
+  fprintf( out, "The %s kernel %s the reference one (within %g mV, same "
+           "spike count).\n", dendrKernelName( run.kernel ),
+           ok ? "matches" : "DOES NOT match", KERNEL_TOLERANCE );
+  return ok;
+}
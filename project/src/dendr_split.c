@@ -0,0 +1,189 @@
+#include "dendr_split.h"
+#include "dendr_block.h"
+#include "constants.h"
+#include "stimulus.h"
+
+#include <stdlib.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrSplitChoose( int num_procs, int num_dendrs, int num_comps )
+{
+  int parts, groups, load, best = 1, best_load = -1;
+
+  for (parts = 1; parts <= num_procs && parts <= num_comps; parts++) {
+    if (num_procs % parts != 0) {
+      continue;
+    }
+    groups = num_procs / parts;
+    load = ((num_dendrs + groups - 1) / groups) *
+           ((num_comps + parts - 1) / parts);
+    if (best_load < 0 || load < best_load) {
+      best = parts;
+      best_load = load;
+    }
+  }
+
+  return best;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrSplitInit( DendrSplit *split, int num_dendrs, int num_comps,
+                    int parts, int part, int rank, MPI_Comm comm )
+{
+  int const m = num_comps - 2;          // Compartments that are simulated.
+  int const from_tip = parts - 1 - part; // Position counted from the tip.
+  int i, j, n;
+
+  split->num_dendrs = num_dendrs;
+  split->num_comps = num_comps;
+  split->lo = 1 + (from_tip * m) / parts;
+  split->hi = 1 + ((from_tip + 1) * m) / parts;
+  split->tip_rank = part < parts - 1 ? rank + 1 : MPI_PROC_NULL;
+  split->soma_rank = part > 0 ? rank - 1 : MPI_PROC_NULL;
+  split->comm = comm;
+  split->req_from_soma = MPI_REQUEST_NULL;
+  split->req_to_tip = MPI_REQUEST_NULL;
+  split->req_to_soma = MPI_REQUEST_NULL;
+  split->started = 0;
+  reproSumZero( &split->sum );
+
+  n = split->hi - split->lo;
+  if (n <= 0) {
+    return 0;
+  }
+
+  split->from_tip  = (double*) malloc( num_dendrs * sizeof(double) );
+  split->from_soma = (double*) malloc( num_dendrs * sizeof(double) );
+  split->to_tip    = (double*) malloc( num_dendrs * sizeof(double) );
+  split->to_soma   = (double*) malloc( num_dendrs * sizeof(double) );
+  split->first_old = (double*) malloc( num_dendrs * sizeof(double) );
+  split->volt = (double**) malloc( num_dendrs * sizeof(double*) );
+  if (num_dendrs > 0 &&
+      (!split->from_tip || !split->from_soma || !split->to_tip ||
+       !split->to_soma || !split->first_old || !split->volt)) {
+    return 0;
+  }
+
+  // Owned compartments plus one halo element on each side, all at rest.
+  for (i = 0; i < num_dendrs; i++) {
+    split->volt[i] = (double*) malloc( (n + 2) * sizeof(double) );
+    if (!split->volt[i]) {
+      return 0;
+    }
+    for (j = 0; j < n + 2; j++) {
+      split->volt[i][j] = VREST;
+    }
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrSplitFree( DendrSplit *split )
+{
+  int i;
+
+  // The soma-side neighbour sent its first compartments after the last step
+  // too; receive them so nothing is left in flight.
+  MPI_Wait( &split->req_from_soma, MPI_STATUS_IGNORE );
+  MPI_Wait( &split->req_to_tip, MPI_STATUS_IGNORE );
+  MPI_Wait( &split->req_to_soma, MPI_STATUS_IGNORE );
+
+  for (i = 0; i < split->num_dendrs; i++) {
+    free( split->volt[i] );
+  }
+  free( split->volt );
+  free( split->from_tip );
+  free( split->from_soma );
+  free( split->to_tip );
+  free( split->to_soma );
+  free( split->first_old );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double dendrSplitStep( DendrSplit *split, int step, double delta_t,
+                       double v_m )
+{
+  int const n = split->hi - split->lo;   // Owned compartments.
+  int const offset = split->lo - 1;      // Compartment stored at volt[d][0].
+  int const tip = split->tip_rank == MPI_PROC_NULL;
+  int d;
+  double cur = 0.0, left_old;
+  double *v;
+
+  // Right halo: compartment hi as of the previous step. Next to the soma
+  // that is the soma itself.
+  if (split->soma_rank == MPI_PROC_NULL) {
+    for (d = 0; d < split->num_dendrs; d++) {
+      split->volt[d][n+1] = v_m;
+    }
+  } else {
+    if (split->started) {
+      MPI_Wait( &split->req_from_soma, MPI_STATUS_IGNORE );
+      for (d = 0; d < split->num_dendrs; d++) {
+        split->volt[d][n+1] = split->from_soma[d];
+      }
+    }
+    MPI_Irecv( split->from_soma, split->num_dendrs, MPI_DOUBLE,
+               split->soma_rank, TAG_HALO_TO_TIP, split->comm,
+               &split->req_from_soma );
+  }
+
+  // Left halo: compartment lo-1 as of this step.
+  if (!tip) {
+    MPI_Recv( split->from_tip, split->num_dendrs, MPI_DOUBLE, split->tip_rank,
+              TAG_HALO_TO_SOMA, split->comm, MPI_STATUS_IGNORE );
+  }
+
+  // Advance the first compartment of every dendrite and hand it to the
+  // tip-side neighbour right away, it needs it for its next step.
+  MPI_Wait( &split->req_to_tip, MPI_STATUS_IGNORE );
+  for (d = 0; d < split->num_dendrs; d++) {
+    v = split->volt[d];
+    if (tip) {
+      // Current injected at the tip of the dendrite, as in dendriteStep().
+      cur = stimGenerate( step + d + 1 );
+      left_old = v[0];
+    } else {
+      left_old = v[0];
+      v[0] = split->from_tip[d];
+    }
+    split->first_old[d] = v[1];
+    dendrUpdateRange( v, offset, split->num_comps, split->lo, split->lo + 1,
+                      left_old, cur, delta_t );
+    split->to_tip[d] = v[1];
+  }
+  MPI_Isend( split->to_tip, split->num_dendrs, MPI_DOUBLE, split->tip_rank,
+             TAG_HALO_TO_TIP, split->comm, &split->req_to_tip );
+
+  // Then the rest of the owned range.
+  for (d = 0; d < split->num_dendrs; d++) {
+    dendrUpdateRange( split->volt[d], offset, split->num_comps,
+                      split->lo + 1, split->hi, split->first_old[d], 0.0,
+                      delta_t );
+  }
+
+  // The soma-side neighbour needs the last compartment for this step.
+  MPI_Wait( &split->req_to_soma, MPI_STATUS_IGNORE );
+  for (d = 0; d < split->num_dendrs; d++) {
+    split->to_soma[d] = split->volt[d][n];
+  }
+  MPI_Isend( split->to_soma, split->num_dendrs, MPI_DOUBLE, split->soma_rank,
+             TAG_HALO_TO_SOMA, split->comm, &split->req_to_soma );
+
+  // Calculate current injected by the group into soma.
+  reproSumZero( &split->sum );
+  if (split->soma_rank == MPI_PROC_NULL) {
+    for (d = 0; d < split->num_dendrs; d++) {
+      reproSumAdd( &split->sum, (DENDRCONDCOMP + DENDRCONDDISTR/1) *
+                                (split->volt[d][n] - v_m) );
+    }
+  }
+
+  split->started = 1;
+  return reproSumValue( &split->sum );
+}
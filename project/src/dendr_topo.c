@@ -0,0 +1,409 @@
+#include "dendr_topo.h"
+#include "hh_model.h"
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+// Same expression as dendrite() in lib_hh.c, with gB + gA precomputed. It
+// still divides by the capacitance: 1/Cd is not exact in binary, so
+// multiplying by it would round differently from dendriteStep().
+#define DERIV( dt, I, gB, gS, gA, yB, y, yA, C ) \
+  ((dt)*((I) + (gB)*(yB) - (gS)*(y) + (gA)*(yA) - \
+   (gLd)*((y)-EL))/(C))
+
+// DENDR_LANES consecutive compartments. GCC's vector extensions turn the
+// arithmetic into SIMD instructions whatever the optimization level; the
+// type is only double aligned, so it can be loaded from any compartment.
+typedef double DendrVec
+  __attribute__((vector_size(DENDR_LANES * sizeof(double)),
+                 aligned(sizeof(double))));
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrParamsDefault( DendrParams *params )
+{
+  params->g_scale = 1.0;
+  params->cap = Cd;
+  params->inj_scale = 1.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrOverridesLoad( DendrOverrides *ov, const char *path )
+{
+  char line[ 256 ], *hash;
+  DendrOverride entry, *list;
+  int line_no = 0, fields, size = 0;
+  FILE *fp;
+
+  ov->count = 0;
+  ov->list = NULL;
+
+  fp = fopen( path, "r" );
+  if (!fp) {
+    fprintf( stderr, "Can't open dendrite parameter file %s!\n", path );
+    return 0;
+  }
+
+  while (fgets( line, sizeof(line), fp )) {
+    line_no++;
+    if ((hash = strchr( line, '#' ))) {
+      *hash = '\0';
+    }
+    if (strspn( line, " \t\r\n" ) == strlen( line )) {
+      continue;
+    }
+
+    fields = sscanf( line, "%d-%d %lf %lf %lf", &entry.first, &entry.last,
+                     &entry.params.g_scale, &entry.params.cap,
+                     &entry.params.inj_scale );
+    if (fields != 5) {
+      fields = sscanf( line, "%d %lf %lf %lf", &entry.first,
+                       &entry.params.g_scale, &entry.params.cap,
+                       &entry.params.inj_scale ) + 1;
+      entry.last = entry.first;
+    }
+    if (fields != 5 || entry.first < 0 || entry.last < entry.first ||
+        entry.params.g_scale <= 0 || entry.params.cap <= 0) {
+      fprintf( stderr, "%s:%d: expected `DENDRITE[-LAST] G_SCALE CAP_PF "
+               "INJ_SCALE', with positive G_SCALE and CAP_PF!\n", path,
+               line_no );
+      fclose( fp );
+      dendrOverridesFree( ov );
+      return 0;
+    }
+
+    // The explicit step is only just stable with the default parameters.
+    if (entry.params.g_scale / entry.params.cap > 1.0 / Cd) {
+      fprintf( stderr, "%s:%d: dendrites stiffer than the default (G_SCALE / "
+               "CAP_PF > %g) may be unstable at the model step!\n", path,
+               line_no, 1.0 / Cd );
+    }
+
+    if (ov->count == size) {
+      size = size ? 2 * size : 16;
+      list = (DendrOverride*) realloc( ov->list,
+                                       size * sizeof(DendrOverride) );
+      if (!list) {
+        fclose( fp );
+        dendrOverridesFree( ov );
+        return 0;
+      }
+      ov->list = list;
+    }
+    ov->list[ ov->count++ ] = entry;
+  }
+
+  fclose( fp );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrOverridesFree( DendrOverrides *ov )
+{
+  free( ov->list );
+  ov->list = NULL;
+  ov->count = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrOverridesLookup( const DendrOverrides *ov, int dendrite,
+                           DendrParams *params )
+{
+  int i;
+
+  dendrParamsDefault( params );
+  if (!ov) {
+    return;
+  }
+  for (i = 0; i < ov->count; i++) {
+    if (dendrite >= ov->list[i].first && dendrite <= ov->list[i].last) {
+      *params = ov->list[i].params;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrTopoInit( DendrTopo *topo, int num_comps,
+                   const DendrParams *params )
+{
+  double const s = params->g_scale;
+  int j;
+
+  topo->num_comps = num_comps;
+  topo->params = *params;
+  topo->step = dendrTopoKernel( num_comps, 0 );
+  topo->step_jacobi = dendrTopoKernel( num_comps, 1 );
+  topo->g_before = (double*) malloc( num_comps * sizeof(double) );
+  topo->g_after  = (double*) malloc( num_comps * sizeof(double) );
+  topo->g_sum    = (double*) malloc( num_comps * sizeof(double) );
+  if (!topo->g_before || !topo->g_after || !topo->g_sum) {
+    dendrTopoFree( topo );
+    return 0;
+  }
+
+  // Compartment j is compartment i = j-1 of dendriteStep(): the first one
+  // has no conductance towards the tip, the others rise towards the soma.
+  for (j = 1; j < num_comps - 1; j++) {
+    topo->g_before[j] = j == 1 ? 0 :
+                        (DENDRCONDCOMP + DENDRCONDDISTR/(num_comps-j))*s;
+    topo->g_after[j] = (DENDRCONDCOMP + DENDRCONDDISTR/(num_comps-1-j))*s;
+    topo->g_sum[j] = topo->g_before[j] + topo->g_after[j];
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrTopoFree( DendrTopo *topo )
+{
+  free( topo->g_before );
+  free( topo->g_after );
+  free( topo->g_sum );
+  topo->g_before = topo->g_after = topo->g_sum = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// The bodies of the kernels take the compartment next to the soma, `m', as
+// an argument. Inlined where it is a constant, they become the kernels of
+// one shape (see DENDR_SHAPES).
+static inline __attribute__((always_inline))
+double topoStep( const DendrTopo *topo, double *v_d, double cur,
+                 double delta_t, double v_m, int const m )
+{
+  double const C = topo->params.cap;
+  double const dt6 = 1.0/6;
+  const double *g_before = topo->g_before;
+  const double *g_after = topo->g_after;
+  const double *g_sum = topo->g_sum;
+  double I = cur * topo->params.inj_scale;
+  double left_old = v_d[0], y, yB, yA, k1, k2, k3, k4;
+  int j;
+
+  v_d[m+1] = v_m;
+
+  // As in dendriteStep(), the first slope sees the old left neighbour and
+  // the others the new one.
+  for (j = 1; j <= m; j++) {
+    y = v_d[j];
+    yB = v_d[j-1];
+    yA = v_d[j+1];
+
+    k1 = DERIV( delta_t, I, g_before[j], g_sum[j], g_after[j], left_old, y,
+                yA, C );
+    k2 = DERIV( delta_t, I, g_before[j], g_sum[j], g_after[j], yB,
+                y + 0.5*k1, yA, C );
+    k3 = DERIV( delta_t, I, g_before[j], g_sum[j], g_after[j], yB,
+                y + 0.5*k2, yA, C );
+    k4 = DERIV( delta_t, I, g_before[j], g_sum[j], g_after[j], yB,
+                y + 1.0*k3, yA, C );
+    v_d[j] = y + dt6*(k1+k4+2*(k2+k3));
+
+    left_old = y;
+    I = 0;
+  }
+
+  // Calculate current injected by this dendrite into soma
+  return g_after[m]*(v_d[m] - v_m);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static inline __attribute__((always_inline))
+double topoStepJacobi( const DendrTopo *topo, double *v_d, double cur,
+                       double delta_t, double v_m, int const m )
+{
+  double const C = topo->params.cap;
+  double const dt6 = 1.0/6;
+  const double *g_before = topo->g_before;
+  const double *g_after = topo->g_after;
+  const double *g_sum = topo->g_sum;
+  DendrVec I = { 0 }, y, yB, yA, gB, gA, gS, k1, k2, k3, k4;
+  double left_old, ys, ks1, ks2, ks3, ks4;
+  int j;
+
+  v_d[m+1] = v_m;
+  I[0] = cur * topo->params.inj_scale;
+
+  // Every slope sees the old neighbours, so the compartments of a vector are
+  // independent and the update can stay in place: only the tip-side
+  // neighbour of a vector has been overwritten by then, and its old value
+  // is kept in a register, as in dendrTopoStep().
+  left_old = v_d[0];
+  for (j = 1; j + DENDR_LANES - 1 <= m; j += DENDR_LANES) {
+    yB = *(const DendrVec*) &v_d[j-1];
+    yB[0] = left_old;
+    y = *(const DendrVec*) &v_d[j];
+    yA = *(const DendrVec*) &v_d[j+1];
+    gB = *(const DendrVec*) &g_before[j];
+    gA = *(const DendrVec*) &g_after[j];
+    gS = *(const DendrVec*) &g_sum[j];
+
+    k1 = DERIV( delta_t, I, gB, gS, gA, yB, y, yA, C );
+    k2 = DERIV( delta_t, I, gB, gS, gA, yB, y + 0.5*k1, yA, C );
+    k3 = DERIV( delta_t, I, gB, gS, gA, yB, y + 0.5*k2, yA, C );
+    k4 = DERIV( delta_t, I, gB, gS, gA, yB, y + 1.0*k3, yA, C );
+    *(DendrVec*) &v_d[j] = y + dt6*(k1+k4+2*(k2+k3));
+
+    left_old = y[DENDR_LANES-1];
+    I[0] = 0;
+  }
+
+  // The last few compartments, one at a time.
+  for (; j <= m; j++) {
+    ys = v_d[j];
+
+    ks1 = DERIV( delta_t, I[0], g_before[j], g_sum[j], g_after[j], left_old,
+                 ys, v_d[j+1], C );
+    ks2 = DERIV( delta_t, I[0], g_before[j], g_sum[j], g_after[j], left_old,
+                 ys + 0.5*ks1, v_d[j+1], C );
+    ks3 = DERIV( delta_t, I[0], g_before[j], g_sum[j], g_after[j], left_old,
+                 ys + 0.5*ks2, v_d[j+1], C );
+    ks4 = DERIV( delta_t, I[0], g_before[j], g_sum[j], g_after[j], left_old,
+                 ys + 1.0*ks3, v_d[j+1], C );
+    v_d[j] = ys + dt6*(ks1+ks4+2*(ks2+ks3));
+
+    left_old = ys;
+    I[0] = 0;
+  }
+
+  // Calculate current injected by this dendrite into soma
+  return g_after[m]*(v_d[m] - v_m);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double dendrTopoStep( const DendrTopo *topo, double *v_d, double cur,
+                      double delta_t, double v_m )
+{
+  return topoStep( topo, v_d, cur, delta_t, v_m, topo->num_comps - 2 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double dendrTopoStepJacobi( const DendrTopo *topo, double *v_d, double cur,
+                            double delta_t, double v_m )
+{
+  return topoStepJacobi( topo, v_d, cur, delta_t, v_m, topo->num_comps - 2 );
+}
+
+// The kernels of each shape of DENDR_SHAPES.
+#define SHAPE_KERNELS( n ) \
+  static double topoStep##n( const DendrTopo *topo, double *v_d, \
+                             double cur, double delta_t, double v_m ) \
+  { \
+    return topoStep( topo, v_d, cur, delta_t, v_m, n ); \
+  } \
+  static double topoStepJacobi##n( const DendrTopo *topo, double *v_d, \
+                                   double cur, double delta_t, double v_m ) \
+  { \
+    return topoStepJacobi( topo, v_d, cur, delta_t, v_m, n ); \
+  }
+DENDR_SHAPES( SHAPE_KERNELS )
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+DendrTopoStepFn dendrTopoKernel( int num_comps, int jacobi )
+{
+  #define SHAPE_CASE( n ) \
+    case n: \
+      return jacobi ? topoStepJacobi##n : topoStep##n;
+
+  switch (num_comps - 2) {
+  DENDR_SHAPES( SHAPE_CASE )
+  default:
+    return jacobi ? dendrTopoStepJacobi : dendrTopoStep;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static double timeKernel( DendrTopoStepFn kernel, const DendrTopo *topo,
+                          double *volt, int num_dendrs, int steps )
+{
+  int const num_comps = topo->num_comps;
+  struct timeval start, stop, diff;
+  double best = -1.0, secs;
+  int r, d, j, step;
+
+  for (r = 0; r < BENCH_REPEATS; r++) {
+    // Every repeat starts from rest, so they all compute the same thing.
+    for (j = 0; j < num_dendrs * num_comps; j++) {
+      volt[j] = VREST;
+    }
+    gettimeofday( &start, NULL );
+    for (step = 0; step < steps; step++) {
+      for (d = 0; d < num_dendrs; d++) {
+        kernel( topo, volt + d * num_comps, INJCURMEAN, 1.0 / STEPS, VREST );
+      }
+    }
+    gettimeofday( &stop, NULL );
+    timersub( &stop, &start, &diff );
+    secs = (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
+    if (best < 0 || secs < best) {
+      best = secs;
+    }
+  }
+  return best;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrTopoBenchmark( int num_dendrs, FILE *out )
+{
+  #define SHAPE_COUNT( n ) n,
+  static const int shapes[] = { DENDR_SHAPES( SHAPE_COUNT ) 0 };
+  static const char *names[] = { "fused", "jacobi" };
+  double *generic, *special, gen_secs, spec_secs, updates;
+  int i, k, steps, same;
+  DendrParams params;
+  DendrTopo topo;
+
+  fprintf( out, "Shape benchmark: %d dendrites, best of %d\n", num_dendrs,
+           BENCH_REPEATS );
+  fprintf( out, "  %12s %-7s %11s %11s %8s  %s\n", "compartments", "kernel",
+           "generic", "specialized", "speedup", "results" );
+  dendrParamsDefault( &params );
+  for (i = 0; shapes[i] > 0; i++) {
+    if (!dendrTopoInit( &topo, shapes[i] + 2, &params )) {
+      return 0;
+    }
+    generic = (double*) malloc( num_dendrs * topo.num_comps * sizeof(double) );
+    special = (double*) malloc( num_dendrs * topo.num_comps * sizeof(double) );
+    if (!generic || !special) {
+      free( generic );
+      free( special );
+      dendrTopoFree( &topo );
+      return 0;
+    }
+
+    // About the same work for every shape.
+    steps = SHAPE_BENCH_UPDATES / ((double) num_dendrs * shapes[i]);
+    steps = steps > 0 ? steps : 1;
+    updates = (double) steps * num_dendrs * shapes[i];
+    for (k = 0; k < 2; k++) {
+      gen_secs = timeKernel( k ? dendrTopoStepJacobi : dendrTopoStep, &topo,
+                             generic, num_dendrs, steps );
+      spec_secs = timeKernel( dendrTopoKernel( topo.num_comps, k ), &topo,
+                              special, num_dendrs, steps );
+      same = memcmp( generic, special,
+                     num_dendrs * topo.num_comps * sizeof(double) ) == 0;
+      fprintf( out, "  %12d %-7s %8.2f ns %8.2f ns %7.2fx  %s\n", shapes[i],
+               names[k], gen_secs * 1e9 / updates,
+               spec_secs * 1e9 / updates, gen_secs / spec_secs,
+               same ? "identical" : "DIFFERENT" );
+    }
+    free( generic );
+    free( special );
+    dendrTopoFree( &topo );
+  }
+  fprintf( out, "  (ns per compartment-step)\n" );
+  return 1;
+}
@@ -0,0 +1,368 @@
+#include "dendrites.h"
+#include "lib_hh.h"
+#include "constants.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Kernel names, indexed by DendrKernel.
+static const char *kernel_names[] = { "reference", "blocked", "implicit",
+                                      "fused", "jacobi" };
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrParseKernel( const char *name, DendrKernel *kernel )
+{
+  int i;
+
+  for (i = 0; i < (int) (sizeof(kernel_names) / sizeof(kernel_names[0]));
+       i++) {
+    if (strcmp( name, kernel_names[i] ) == 0) {
+      *kernel = (DendrKernel) i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const char *dendrKernelName( DendrKernel kernel )
+{
+  return kernel_names[ kernel ];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int hasShapes( const KernelOpts *opts )
+{
+  return (opts->kernel == KERNEL_FUSED || opts->kernel == KERNEL_JACOBI) &&
+         !opts->reduce;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrSetInit( DendrSet *set, int first, int num_dendrs, int num_comps,
+                  KernelOpts *opts, PlaceOpts *place )
+{
+  int i, j;
+
+  set->first = first;
+  set->num_dendrs = num_dendrs;
+  set->num_comps = num_comps;
+  set->opts = *opts;
+  set->blocks = NULL;
+  set->scratch = NULL;
+  set->num_cables = (opts->reduce && num_dendrs > 0) ? 1 : num_dendrs;
+  set->tip_sum = 0.0;
+  set->last_step = -1;
+  set->stim = NULL;
+  set->stim_first = first;
+  set->topos = NULL;
+  set->num_topos = 0;
+  set->topo_of = NULL;
+  reproSumZero( &set->sum );
+
+  set->slab = (double*) placeAlloc( place,
+                                    (size_t) set->num_cables * num_comps *
+                                    sizeof(double), &set->slab_size );
+  set->volt = (double**) malloc( set->num_cables * sizeof(double*) );
+  set->currents = (double*) calloc( num_dendrs, sizeof(double) );
+  if (!set->slab || (num_dendrs > 0 && (!set->volt || !set->currents))) {
+    return 0;
+  }
+
+  // Initialize the potential of each dendrite compartment to the rest voltage.
+  for (i = 0; i < set->num_cables; i++) {
+    set->volt[i] = set->slab + (size_t) i * num_comps;
+    for (j = 0; j < num_comps; j++) {
+      set->volt[i][j] = VREST;
+    }
+  }
+
+  if (opts->kernel == KERNEL_BLOCKED && !opts->reduce) {
+    // Zeroed, so that dendrSetFree() can take a set whose blocks did not all
+    // get allocated.
+    set->blocks = (DendrBlock*) calloc( num_dendrs, sizeof(DendrBlock) );
+    if (!set->blocks) {
+      return 0;
+    }
+    for (i = 0; i < num_dendrs; i++) {
+      if (!dendrBlockInit( &set->blocks[i], num_comps, opts->block_steps,
+                           opts->tile )) {
+        return 0;
+      }
+    }
+  }
+
+  if (opts->kernel == KERNEL_IMPLICIT) {
+    set->scratch = (double*) malloc( 2 * num_comps * sizeof(double) );
+    if (!set->scratch) {
+      return 0;
+    }
+  }
+
+  if (hasShapes( opts ) && !dendrSetParams( set, NULL, first )) {
+    return 0;
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrSetReset( DendrSet *set )
+{
+  int i, j;
+
+  for (i = 0; i < set->num_cables; i++) {
+    for (j = 0; j < set->num_comps; j++) {
+      set->volt[i][j] = VREST;
+    }
+  }
+  for (i = 0; i < set->num_dendrs; i++) {
+    set->currents[i] = 0.0;
+  }
+  set->tip_sum = 0.0;
+  set->last_step = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrSetStimulus( DendrSet *set, const Stimulus *stim, int first )
+{
+  set->stim = stim;
+  set->stim_first = first;
+  set->last_step = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void freeTopos( DendrSet *set )
+{
+  int i;
+
+  for (i = 0; i < set->num_topos; i++) {
+    dendrTopoFree( &set->topos[i] );
+  }
+  free( set->topos );
+  free( set->topo_of );
+  set->topos = NULL;
+  set->topo_of = NULL;
+  set->num_topos = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dendrSetParams( DendrSet *set, const DendrOverrides *ov, int first )
+{
+  DendrParams params;
+  int d, t;
+
+  // Only the fused and Jacobi kernels have shapes.
+  if (!hasShapes( &set->opts )) {
+    return 1;
+  }
+
+  freeTopos( set );
+  set->topos = (DendrTopo*) malloc( (set->num_dendrs + 1) *
+                                    sizeof(DendrTopo) );
+  set->topo_of = (int*) malloc( (set->num_dendrs + 1) * sizeof(int) );
+  if (!set->topos || !set->topo_of) {
+    freeTopos( set );
+    return 0;
+  }
+
+  for (d = 0; d < set->num_dendrs; d++) {
+    dendrOverridesLookup( ov, first + d, &params );
+    for (t = 0; t < set->num_topos; t++) {
+      if (memcmp( &set->topos[t].params, &params, sizeof(params) ) == 0) {
+        break;
+      }
+    }
+    if (t == set->num_topos) {
+      if (!dendrTopoInit( &set->topos[t], set->num_comps, &params )) {
+        freeTopos( set );
+        return 0;
+      }
+      set->num_topos++;
+    }
+    set->topo_of[d] = t;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrSetFree( DendrSet *set )
+{
+  int i;
+
+  if (set->blocks) {
+    for (i = 0; i < set->num_dendrs; i++) {
+      dendrBlockFree( &set->blocks[i] );
+    }
+  }
+  freeTopos( set );
+  placeFree( set->slab, set->slab_size );
+  free( set->volt );
+  free( set->currents );
+  free( set->blocks );
+  free( set->scratch );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static double reducedStep( DendrSet *set, int step, double delta_t,
+                           double v_m )
+{
+  int const m = set->num_comps - 2;  // Compartment next to the soma.
+  int seed = step + set->stim_first + 1;
+  double *v_d = set->volt[0];
+  const double *row;
+  double cur, current;
+  int dendrite;
+
+  if (set->num_dendrs == 0) {
+    return 0.0;
+  }
+
+  if (set->stim && set->stim->type == STIM_FILE) {
+    // Recorded currents have no structure to exploit, but a row is
+    // contiguous.
+    row = stimRow( set->stim, step, set->opts.steps_per_ms ) +
+          set->stim_first;
+    set->tip_sum = 0.0;
+    for (dendrite = 0; dendrite < set->num_dendrs; dendrite++) {
+      set->tip_sum += row[ dendrite ];
+    }
+  } else if (step == set->last_step + 1 && step != 0) {
+    // The seeds of the set slide by one per step. Sum them afresh every ms
+    // so rounding cannot build up.
+    set->tip_sum += stimGenerate( seed + set->num_dendrs - 1 ) -
+                    stimGenerate( seed - 1 );
+  } else {
+    set->tip_sum = 0.0;
+    for (dendrite = 0; dendrite < set->num_dendrs; dendrite++) {
+      set->tip_sum += stimGenerate( seed + dendrite );
+    }
+  }
+  set->last_step = step;
+  cur = set->tip_sum / set->num_dendrs;
+
+  if (set->opts.kernel == KERNEL_IMPLICIT) {
+    current = dendrImplicitSolve( v_d, set->scratch, cur, set->num_comps,
+                                  delta_t, v_m );
+  } else {
+    v_d[m+1] = v_m;
+    dendrUpdateRange( v_d, 0, set->num_comps, 1, m + 1, v_d[0], cur,
+                      delta_t );
+    current = (DENDRCONDCOMP + DENDRCONDDISTR/1) * (v_d[m] - v_m);
+  }
+
+  set->currents[0] = current * set->num_dendrs;
+  reproSumAdd( &set->sum, set->currents[0] );
+  return set->currents[0];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dendrSetStepRange( DendrSet *set, int step, double delta_t, double v_m,
+                        int begin, int end, double *scratch, ReproSum *sum )
+{
+  int const spm = set->opts.steps_per_ms;
+  const DendrTopo *topo;
+  DendrBlock *blk;
+  int dendrite, k, j, len;
+
+  switch (set->opts.kernel) {
+  case KERNEL_BLOCKED:
+    // Blocks never straddle a millisecond since the seeds restart there.
+    k = step % set->opts.block_steps;
+    len = set->opts.steps_per_ms - (step - k);
+    if (len > set->opts.block_steps) {
+      len = set->opts.block_steps;
+    }
+
+    for (dendrite = begin; dendrite < end; dendrite++) {
+      blk = &set->blocks[ dendrite ];
+      if (k == 0) {
+        for (j = 0; j < len; j++) {
+          blk->cur[j] = stimCurrent( set->stim, step + j, spm,
+                                     set->stim_first + dendrite );
+        }
+        set->currents[ dendrite ] =
+          dendrBlockBegin( blk, set->volt[ dendrite ], len, delta_t, v_m );
+      } else {
+        set->currents[ dendrite ] =
+          dendrBlockStep( blk, set->volt[ dendrite ], k, delta_t, v_m );
+      }
+      reproSumAdd( sum, set->currents[ dendrite ] );
+    }
+    break;
+
+  case KERNEL_FUSED:
+    for (dendrite = begin; dendrite < end; dendrite++) {
+      topo = &set->topos[ set->topo_of[ dendrite ] ];
+      set->currents[ dendrite ] =
+        topo->step( topo, set->volt[ dendrite ],
+                    stimCurrent( set->stim, step, spm,
+                                 set->stim_first + dendrite ),
+                    delta_t, v_m );
+      reproSumAdd( sum, set->currents[ dendrite ] );
+    }
+    break;
+
+  case KERNEL_JACOBI:
+    for (dendrite = begin; dendrite < end; dendrite++) {
+      topo = &set->topos[ set->topo_of[ dendrite ] ];
+      set->currents[ dendrite ] =
+        topo->step_jacobi( topo, set->volt[ dendrite ],
+                           stimCurrent( set->stim, step, spm,
+                                        set->stim_first + dendrite ),
+                           delta_t, v_m );
+      reproSumAdd( sum, set->currents[ dendrite ] );
+    }
+    break;
+
+  case KERNEL_IMPLICIT:
+    for (dendrite = begin; dendrite < end; dendrite++) {
+      set->currents[ dendrite ] =
+        dendrImplicitSolve( set->volt[ dendrite ], scratch,
+                            stimCurrent( set->stim, step, spm,
+                                         set->stim_first + dendrite ),
+                            set->num_comps, delta_t, v_m );
+      reproSumAdd( sum, set->currents[ dendrite ] );
+    }
+    break;
+
+  default:
+    for (dendrite = begin; dendrite < end; dendrite++) {
+      // This will update Vm in all compartments and will give a new injected
+      // current value from last compartment into the soma.
+      set->currents[ dendrite ] =
+        dendriteStepCurrent( set->volt[ dendrite ],
+                             stimCurrent( set->stim, step, spm,
+                                          set->stim_first + dendrite ),
+                             set->num_comps, delta_t, v_m );
+      reproSumAdd( sum, set->currents[ dendrite ] );
+    }
+    break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double dendrSetStep( DendrSet *set, int step, double delta_t, double v_m )
+{
+  // The total is summed exactly, so it does not depend on how the cell's
+  // dendrites are split among sets.
+  reproSumZero( &set->sum );
+  if (set->opts.reduce) {
+    return reducedStep( set, step, delta_t, v_m );
+  }
+
+  dendrSetStepRange( set, step, delta_t, v_m, 0, set->num_dendrs,
+                     set->scratch, &set->sum );
+  return reproSumValue( &set->sum );
+}
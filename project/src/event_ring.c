@@ -0,0 +1,69 @@
+#include "event_ring.h"
+
+#include <stdlib.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int eventRingInit( EventRing *ring, int horizon )
+{
+  int num_bins = 1;
+
+  while (num_bins <= horizon) {
+    num_bins *= 2;
+  }
+  ring->mask = num_bins - 1;
+  ring->queued = 0;
+  ring->bins = (EventBin*) calloc( num_bins, sizeof(EventBin) );
+  return ring->bins != NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int eventRingPush( EventRing *ring, int step, double *v, double weight )
+{
+  EventBin *bin = &ring->bins[ step & ring->mask ];
+  SynEvent *grown;
+  int size;
+
+  if (bin->count == bin->size) {
+    size = bin->size ? 2 * bin->size : 8;
+    grown = (SynEvent*) realloc( bin->events, size * sizeof(SynEvent) );
+    if (!grown) {
+      return 0;
+    }
+    bin->events = grown;
+    bin->size = size;
+  }
+  bin->events[ bin->count ].v = v;
+  bin->events[ bin->count ].weight = weight;
+  bin->count++;
+  ring->queued++;
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int eventRingDeliver( EventRing *ring, int step )
+{
+  EventBin *bin = &ring->bins[ step & ring->mask ];
+  int i, count = bin->count;
+
+  for (i = 0; i < count; i++) {
+    *bin->events[i].v += bin->events[i].weight;
+  }
+  bin->count = 0;
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void eventRingFree( EventRing *ring )
+{
+  int i;
+
+  for (i = 0; ring->bins && i <= ring->mask; i++) {
+    free( ring->bins[i].events );
+  }
+  free( ring->bins );
+  ring->bins = NULL;
+}
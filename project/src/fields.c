@@ -0,0 +1,32 @@
+#include "fields.h"
+
+#include <string.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int splitFields( char *line, char **fields, int max )
+{
+  int n = 0;
+  char *p = line, *end;
+
+  while (n < max) {
+    while (*p == ' ' || *p == '\t') {
+      p++;
+    }
+    fields[n++] = p;
+    end = strchr( p, '|' );
+    if (end) {
+      *end = '\0';
+    }
+    p = p + strlen( p );
+    while (p > fields[n-1] && (p[-1] == ' ' || p[-1] == '\t' ||
+                               p[-1] == '\n')) {
+      *--p = '\0';
+    }
+    if (!end) {
+      break;
+    }
+    p = end + 1;
+  }
+  return n;
+}
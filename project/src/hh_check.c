@@ -0,0 +1,436 @@
+/*
+  Multiple Processor Systems. Spring 2023
+
+  Differential testing of the simulation engines. Runs seq_hh with the
+  reference kernel and every other engine (kernels, threads, soma
+  integrators, MPI decompositions) on a matrix of cell shapes and process
+  counts, and compares their soma traces, spike times and final dendrite
+  state, as written with --snapshot, against the reference run with a
+  tolerance per engine. The speed of each engine is reported next to its
+  accuracy.
+*/
+
+#include "snapshot.h"
+#include "constants.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHECK_MAX_CASES 16      // Longest -d, -c and -p lists.
+#define CHECK_CMD_LEN 1024      // Longest command line run.
+
+/**
+ * An engine and what it must match the reference run to. Arguments with a
+ * `%d' take the process count of the case, which makes the engine run once
+ * per process count; so does running under MPI.
+ */
+typedef struct Engine {
+  const char *name;       // Name used with --engines.
+  int mpi;                // Nonzero to run mpi_hh under MPI, else seq_hh.
+  const char *args;       // Arguments selecting the engine.
+  int stimulus;           // Nonzero to read the stimulus file, zero to use
+                          // the built-in generator (which it holds).
+  double trace_tol;       // Largest soma potential difference, mV, or
+                          // CHECK_INEXACT for all three if only reported.
+  double spike_tol;       // Largest spike time difference, ms.
+  double state_tol;       // Largest compartment potential difference, mV.
+} Engine;
+
+// The Jacobi and implicit kernels and the multi-rate coupling change the
+// dynamics: their spikes drift from the reference's by an amount that grows
+// with the run and the compartment count (1.5 ms after 40 ms with -c 100)
+// and can even come and go, so no tolerance holds for all cases. They are
+// CHECK_INEXACT: their differences are shown, and they only fail if they do
+// not run or diverge.
+static const Engine engines[] = {
+  { "blocked", 0, "-k blocked", 1, CHECK_EXACT, CHECK_EXACT, CHECK_EXACT },
+  { "fused", 0, "-k fused", 1, CHECK_EXACT, CHECK_EXACT, CHECK_EXACT },
+  { "jacobi", 0, "-k jacobi", 1, CHECK_INEXACT, CHECK_INEXACT,
+    CHECK_INEXACT },
+  { "implicit", 0, "-k implicit", 1, CHECK_INEXACT, CHECK_INEXACT,
+    CHECK_INEXACT },
+  { "reduce", 0, "--reduce", 1, REDUCE_TOLERANCE, 1e-6, 0 },
+  { "threads", 0, "-t %d", 1, CHECK_EXACT, CHECK_EXACT, CHECK_EXACT },
+  { "threads-gen", 0, "-t %d", 0, CHECK_EXACT, CHECK_EXACT, CHECK_EXACT },
+  { "steal", 0, "-t %d --schedule steal", 1, CHECK_EXACT, CHECK_EXACT,
+    CHECK_EXACT },
+  { "steal-gen", 0, "-t %d --schedule steal -k blocked", 0, CHECK_EXACT,
+    CHECK_EXACT, CHECK_EXACT },
+  { "rush-larsen", 0, "--soma rush-larsen", 1, 1.0, 0.05, 0.1 },
+  { "parker-sochacki", 0, "--soma parker-sochacki", 1, 1e-3, 1e-4, 1e-4 },
+  { "substeps", 0, "--soma-substeps 10", 1, CHECK_INEXACT, CHECK_INEXACT,
+    CHECK_INEXACT },
+  { "mpi", 1, "", 1, CHECK_EXACT, CHECK_EXACT, CHECK_EXACT },
+  { "mpi-split", 1, "-s %d", 0, CHECK_EXACT, CHECK_EXACT, CHECK_EXACT },
+  { "mpi-shm", 1, "--shm-reduce", 1, CHECK_EXACT, CHECK_EXACT,
+    CHECK_EXACT },
+  { "mpi-wr", 1, "--wr-window 100", 1, 1e-4, 1e-4, 1e-4 },
+  { "mpi-jacobi", 1, "-k jacobi", 1, CHECK_INEXACT, CHECK_INEXACT,
+    CHECK_INEXACT },
+};
+
+#define NUM_ENGINES ((int) (sizeof(engines) / sizeof(engines[0])))
+
+/**
+ * Name: usage
+ *
+ * Description:
+ * Prints a simple usage statement for the program.
+ *
+ * Parameters:
+ * @param name      the name used to call this program (i.e., argv[0])
+ */
+static void usage( char *name )
+{
+  int i;
+
+  printf(
+"USAGE:\n"
+"  %s [-h] [-d LIST] [-c LIST] [-p LIST] [--duration MS]\n"
+"      [--engines LIST] [--mpirun CMD] [--keep]\n"
+"\n"
+"DESCRIPTION:\n"
+"  Runs every engine of seq_hh and mpi_hh (found next to this program) on\n"
+"  each combination of dendrites, compartments and process counts, and\n"
+"  compares the soma trace, the spike times and the final potential of\n"
+"  every compartment with a run of seq_hh's reference kernel. All runs are\n"
+"  driven by the same stimulus: a file written by the reference run, or the\n"
+"  built-in generator it came from (the -gen engines). Each engine has its\n"
+"  own tolerances; exact ones must match to %g mV. The Jacobi and implicit\n"
+"  kernels and the soma substeps drift from the reference by more the longer\n"
+"  the run, so their differences are only reported (\"inexact\"); they fail\n"
+"  if they diverge. The time of every run and its speedup over the\n"
+"  reference are reported with the differences.\n"
+"\n"
+"OPTIONS:\n"
+"  -h, --help\n"
+"    Print this usage statement and exit.\n"
+"\n"
+"  -d, --dendrites\n"
+"    Comma separated numbers of dendrites. Defaults to %s.\n"
+"\n"
+"  -c, --compartments\n"
+"    Comma separated numbers of compartments. Defaults to %s.\n"
+"\n"
+"  -p, --procs\n"
+"    Comma separated process (or thread) counts. Defaults to %s.\n"
+"\n"
+"  --duration\n"
+"    Simulated time of every run, ms. Defaults to %d.\n"
+"\n"
+"  --engines\n"
+"    Comma separated engines to check. Defaults to all of them:\n"
+, name, CHECK_EXACT, CHECK_DENDRITES, CHECK_COMPARTMENTS, CHECK_PROCS,
+  CHECK_DURATION );
+
+  for (i = 0; i < NUM_ENGINES; i++) {
+    printf( "      %-16s %s %s\n", engines[i].name,
+            engines[i].mpi ? "mpi_hh" : "seq_hh", engines[i].args );
+  }
+
+  printf(
+"\n"
+"  --mpirun\n"
+"    Command starting mpi_hh, followed by the process count. Defaults to\n"
+"    `%s'.\n"
+"\n"
+"  --keep\n"
+"    Keep the stimulus and snapshot files.\n"
+"\n"
+"EXIT STATUS:\n"
+"  0 if every engine matched the reference, 1 otherwise.\n"
+"\n"
+, CHECK_MPIRUN );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int parseList( const char *text, int *values )
+{
+  const char *p = text;
+  char *end;
+  int n = 0;
+
+  while (n < CHECK_MAX_CASES) {
+    values[n] = (int) strtol( p, &end, 10 );
+    if (end == p || values[n] <= 0 || (*end != ',' && *end != '\0')) {
+      return 0;
+    }
+    n++;
+    if (*end == '\0') {
+      return n;
+    }
+    p = end + 1;
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int selected( const char *list, const char *name )
+{
+  size_t const len = strlen( name );
+  const char *p = list;
+
+  if (!list) {
+    return 1;
+  }
+  while ((p = strstr( p, name ))) {
+    if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0')) {
+      return 1;
+    }
+    p += len;
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int run( const char *cmd, double *secs )
+{
+  char line[ 256 ], *p;
+  FILE *pipe;
+  int found = 0;
+
+  pipe = popen( cmd, "r" );
+  if (!pipe) {
+    return 0;
+  }
+  while (fgets( line, sizeof(line), pipe )) {
+    if ((p = strstr( line, "Execution time:" ))) {
+      *secs = atof( p + 15 );
+      found = 1;
+    }
+  }
+  return pclose( pipe ) == 0 && found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void compare( const Snapshot *ref, const Snapshot *snap,
+                     double *trace, double *spike, double *state )
+{
+  // fmax() would drop the NaNs of a run that diverged; these keep them.
+  size_t const n = (size_t) ref->num_dendrs * ref->num_comps;
+  double diff;
+  size_t i;
+
+  *trace = 0.0;
+  for (i = 0; i < (size_t) ref->sim_time; i++) {
+    diff = fabs( snap->trace[i] - ref->trace[i] );
+    if (!(diff <= *trace)) {
+      *trace = diff;
+    }
+  }
+
+  // A missing or extra spike can't be matched up.
+  *spike = snap->num_spikes == ref->num_spikes ? 0.0 : INFINITY;
+  for (i = 0; isfinite( *spike ) && i < (size_t) ref->num_spikes; i++) {
+    diff = fabs( snap->spikes[i] - ref->spikes[i] );
+    if (!(diff <= *spike)) {
+      *spike = diff;
+    }
+  }
+
+  *state = -1.0;
+  if (ref->volt && snap->volt) {
+    *state = 0.0;
+    for (i = 0; i < n; i++) {
+      diff = fabs( snap->volt[i] - ref->volt[i] );
+      if (!(diff <= *state)) {
+        *state = diff;
+      }
+    }
+  }
+}
+
+/**
+ * Name: main
+ *
+ * Description:
+ * See usage statement (run program with '-h' flag).
+ *
+ * Parameters:
+ * @param argc    number of command line arguments
+ * @param argv    command line arguments
+ */
+int main( int argc, char **argv )
+{
+  int dendrs[ CHECK_MAX_CASES ], comps[ CHECK_MAX_CASES ];
+  int procs[ CHECK_MAX_CASES ];
+  int num_d, num_c, num_p, duration = CHECK_DURATION, keep = 0;
+  const char *only = NULL, *mpirun = CHECK_MPIRUN;
+  char dir[] = "/tmp/hh_check.XXXXXX", bin[ FNAME_LEN ] = ".";
+  char stim[ FNAME_LEN + 32 ], ref_file[ FNAME_LEN + 32 ];
+  char snap_file[ FNAME_LEN + 32 ], cmd[ CHECK_CMD_LEN ];
+  char args[ 64 ], common[ 256 ], *slash;
+  int d, c, p, e, i, per_procs, ok = 1, runs = 0, failures = 0;
+  double ref_secs, secs, trace, spike, state;
+  Snapshot ref, snap;
+  const Engine *eng;
+
+  num_d = parseList( CHECK_DENDRITES, dendrs );
+  num_c = parseList( CHECK_COMPARTMENTS, comps );
+  num_p = parseList( CHECK_PROCS, procs );
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp( argv[i], "-h" ) == 0 || strcmp( argv[i], "--help" ) == 0) {
+      usage( argv[0] );
+      return 0;
+    } else if ((strcmp( argv[i], "-d" ) == 0 ||
+                strcmp( argv[i], "--dendrites" ) == 0) && i + 1 < argc) {
+      num_d = parseList( argv[++i], dendrs );
+    } else if ((strcmp( argv[i], "-c" ) == 0 ||
+                strcmp( argv[i], "--compartments" ) == 0) && i + 1 < argc) {
+      num_c = parseList( argv[++i], comps );
+    } else if ((strcmp( argv[i], "-p" ) == 0 ||
+                strcmp( argv[i], "--procs" ) == 0) && i + 1 < argc) {
+      num_p = parseList( argv[++i], procs );
+    } else if (strcmp( argv[i], "--duration" ) == 0 && i + 1 < argc) {
+      duration = atoi( argv[++i] );
+      if (duration <= 1 || duration > COMPTIME) {
+        fprintf( stderr, "Duration must be between 2 and %d ms!\n",
+                 COMPTIME );
+        fprintf( stderr, "Duration default to %d ms!\n", CHECK_DURATION );
+        duration = CHECK_DURATION;
+      }
+    } else if (strcmp( argv[i], "--engines" ) == 0 && i + 1 < argc) {
+      only = argv[++i];
+    } else if (strcmp( argv[i], "--mpirun" ) == 0 && i + 1 < argc) {
+      mpirun = argv[++i];
+    } else if (strcmp( argv[i], "--keep" ) == 0) {
+      keep = 1;
+    } else {
+      usage( argv[0] );
+      return 1;
+    }
+  }
+  if (!num_d || !num_c || !num_p) {
+    fprintf( stderr, "Lists must hold 1 to %d positive numbers!\n",
+             CHECK_MAX_CASES );
+    return 1;
+  }
+
+  // seq_hh and mpi_hh live next to this program.
+  if ((slash = strrchr( argv[0], '/' ))) {
+    snprintf( bin, sizeof(bin), "%.*s", (int) (slash - argv[0]), argv[0] );
+  }
+  if (!mkdtemp( dir )) {
+    fprintf( stderr, "Can't create a temporary directory!\n" );
+    return 1;
+  }
+  snprintf( ref_file, sizeof(ref_file), "%s/reference.txt", dir );
+  snprintf( snap_file, sizeof(snap_file), "%s/engine.txt", dir );
+
+  for (d = 0; d < num_d && ok; d++) {
+    for (c = 0; c < num_c && ok; c++) {
+      // The reference run and the stimulus every engine is driven by.
+      snprintf( stim, sizeof(stim), "%s/d%dc%d.stim", dir, dendrs[d],
+                comps[c] );
+      snprintf( common, sizeof(common), "-d %d -c %d --duration %d -n -q "
+                "-o null", dendrs[d], comps[c], duration );
+      snprintf( cmd, sizeof(cmd), "%s/seq_hh -d %d --duration %d "
+                "--write-stimulus %s 2>&1 && %s/seq_hh %s --stimulus %s "
+                "--snapshot %s 2>&1", bin, dendrs[d], duration, stim, bin,
+                common, stim, ref_file );
+      if (!run( cmd, &ref_secs ) || !snapshotRead( &ref, ref_file )) {
+        fprintf( stderr, "The reference run failed: %s\n", cmd );
+        ok = 0;
+        break;
+      }
+
+      printf( "\n%d dendrites x %d compartments, %d ms: reference %.3f s, "
+              "%d spikes\n", dendrs[d], comps[c], duration, ref_secs,
+              ref.num_spikes );
+      printf( "  %-16s %5s %9s %8s %12s %12s %12s  %s\n", "engine", "procs",
+              "time (s)", "speedup", "max dVm (mV)", "spikes (ms)",
+              "state (mV)", "result" );
+
+      for (e = 0; e < NUM_ENGINES; e++) {
+        eng = &engines[e];
+        if (!selected( only, eng->name )) {
+          continue;
+        }
+        per_procs = eng->mpi || strchr( eng->args, '%' );
+        for (p = 0; p < (per_procs ? num_p : 1); p++) {
+          snprintf( args, sizeof(args), eng->args, procs[p] );
+          if (strstr( eng->args, "-s %d" ) && procs[p] > comps[c]) {
+            continue;  // More parts than compartments.
+          }
+          if (eng->mpi) {
+            snprintf( cmd, sizeof(cmd), "%s %d %s/mpi_hh", mpirun,
+                      procs[p], bin );
+          } else {
+            snprintf( cmd, sizeof(cmd), "%s/seq_hh", bin );
+          }
+          snprintf( cmd + strlen( cmd ), sizeof(cmd) - strlen( cmd ),
+                    " %s %s%s%s --snapshot %s 2>&1", common, args,
+                    eng->stimulus ? " --stimulus " : "",
+                    eng->stimulus ? stim : "", snap_file );
+          runs++;
+
+          printf( "  %-16s %5d", eng->name,
+                  per_procs ? procs[p] : 1 );
+          if (!run( cmd, &secs ) || !snapshotRead( &snap, snap_file ) ||
+              snap.sim_time != ref.sim_time ||
+              snap.num_dendrs != ref.num_dendrs ||
+              snap.num_comps != ref.num_comps) {
+            printf( "  FAILED TO RUN: %s\n", cmd );
+            failures++;
+            continue;
+          }
+          compare( &ref, &snap, &trace, &spike, &state );
+          snapshotFree( &snap );
+
+          printf( " %9.3f %8.2f %12.3g", secs, ref_secs / secs, trace );
+          if (isfinite( spike )) {
+            printf( " %12.3g", spike );
+          } else {
+            printf( " %12s", "count" );
+          }
+          if (state >= 0) {
+            printf( " %12.3g", state );
+          } else {
+            printf( " %12s", "-" );
+          }
+          if (eng->trace_tol == CHECK_INEXACT) {
+            // Only a run that diverged is wrong.
+            if (isfinite( trace ) && !isnan( state )) {
+              printf( "  inexact\n" );
+            } else {
+              printf( "  DIVERGED\n" );
+              failures++;
+            }
+          } else if (trace <= eng->trace_tol && spike <= eng->spike_tol &&
+                     state <= eng->state_tol) {
+            printf( "  ok\n" );
+          } else {
+            printf( "  MISMATCH (tolerances %g mV, %g ms, %g mV)\n",
+                    eng->trace_tol, eng->spike_tol, eng->state_tol );
+            failures++;
+          }
+          fflush( stdout );
+        }
+      }
+
+      snapshotFree( &ref );
+      if (!keep) {
+        unlink( stim );
+      }
+    }
+  }
+
+  if (!keep) {
+    unlink( ref_file );
+    unlink( snap_file );
+    rmdir( dir );
+  } else {
+    printf( "\nFiles kept in %s\n", dir );
+  }
+
+  printf( "\n%d engine runs, %d failed\n", runs, failures );
+  return ok && failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,536 @@
+/*
+  Multiple Processor Systems. Spring 2023
+
+  Scaling analysis and performance history. Reads the execution times of
+  finished runs from data files, job logs and JSON benchmark records, groups
+  them by problem shape, and reports speedup, efficiency and the Karp-Flatt
+  serial fraction per process count. Best times can be kept in a history
+  file, and runs slower than the last entry there for the same machine and
+  configuration are flagged.
+*/
+
+#include "sink.h"
+#include "placement.h"
+#include "fields.h"
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PERF_LINE_LEN 1024  // Longest line read from a log or history file.
+
+/**
+ * Execution time of one run.
+ */
+typedef struct PerfRun {
+  int num_dendrs;         // Dendrites.
+  int num_comps;          // Compartments per dendrite.
+  int num_procs;          // Processes (1 for seq_hh).
+  double secs;            // Execution time, s.
+  char id[ FNAME_LEN ];   // Data file name without directory, or "".
+} PerfRun;
+
+/**
+ * Growing list of runs.
+ */
+typedef struct PerfRuns {
+  int count;              // Runs in `list'.
+  int size;               // Room in `list'.
+  PerfRun *list;          // The runs.
+} PerfRuns;
+
+/**
+ * Name: usage
+ *
+ * Description:
+ * Prints a simple usage statement for the program.
+ *
+ * Parameters:
+ * @param name      the name used to call this program (i.e., argv[0])
+ */
+static void usage( char *name )
+{
+  printf(
+"USAGE:\n"
+"  %s [-h] [--history FILE] [--machine NAME] [--threshold PCT] [--record]\n"
+"      FILE...\n"
+"\n"
+"DESCRIPTION:\n"
+"  Reads the execution time of every run found in FILE... and reports, for\n"
+"  each number of dendrites and compartments, the best time per process\n"
+"  count with its speedup and efficiency over one process and the\n"
+"  Karp-Flatt serial fraction. Each time is compared with the last one\n"
+"  recorded for the same machine, shape and process count in the history\n"
+"  file, and flagged if it is more than PCT percent slower.\n"
+"\n"
+"  FILE may be a data file written by seq_hh or mpi_hh (text or binary), a\n"
+"  log of their standard output (e.g. a batch job's .out file), or, with a\n"
+"  .json extension, JSON records holding \"dendrites\", \"compartments\",\n"
+"  \"processes\" and \"seconds\". A run found both in a data file and in a\n"
+"  log is counted once.\n"
+"\n"
+"OPTIONS:\n"
+"  -h, --help\n"
+"    Print this usage statement and exit.\n"
+"\n"
+"  --history\n"
+"    History file. Defaults to `" PERF_FILE "'.\n"
+"\n"
+"  --machine\n"
+"    Name of the machine the runs were made on. Defaults to the CPU model\n"
+"    and CPU count of this one.\n"
+"\n"
+"  --threshold\n"
+"    Slowdown over the baseline, in percent, flagged as a regression.\n"
+"    Defaults to %g.\n"
+"\n"
+"  --record\n"
+"    Append the best times to the history file, making them the baseline\n"
+"    of the next comparison.\n"
+"\n"
+"EXIT STATUS:\n"
+"  0 if no regression was flagged, 2 if one was, 1 on errors.\n"
+"\n"
+, name, PERF_THRESHOLD );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int addRun( PerfRuns *runs, int num_dendrs, int num_comps,
+                   int num_procs, double secs, const char *path )
+{
+  const char *base = NULL;
+  PerfRun *list, *run;
+  int i;
+
+  if (path) {
+    base = strrchr( path, '/' );
+    base = base ? base + 1 : path;
+
+    // The same run, seen in its data file and in a log.
+    for (i = 0; i < runs->count; i++) {
+      if (strcmp( runs->list[i].id, base ) == 0) {
+        return 1;
+      }
+    }
+  }
+
+  if (runs->count == runs->size) {
+    runs->size = runs->size ? 2 * runs->size : 64;
+    list = (PerfRun*) realloc( runs->list, runs->size * sizeof(PerfRun) );
+    if (!list) {
+      fprintf( stderr, "Out of memory!\n" );
+      return 0;
+    }
+    runs->list = list;
+  }
+
+  run = &runs->list[ runs->count++ ];
+  run->num_dendrs = num_dendrs;
+  run->num_comps = num_comps;
+  run->num_procs = num_procs;
+  run->secs = secs;
+  snprintf( run->id, FNAME_LEN, "%s", base ? base : "" );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int readData( PerfRuns *runs, const char *path )
+{
+  char line[ PERF_LINE_LEN ], *comps, *dendrs, *exec, *slaves;
+  BinHeader hdr;
+  FILE *fp;
+  int ok;
+
+  fp = fopen( path, "rb" );
+  if (!fp) {
+    fprintf( stderr, "Can't open %s!\n", path );
+    return 0;
+  }
+
+  // Binary data files start with their header.
+  if (fread( &hdr, sizeof(hdr), 1, fp ) == 1 &&
+      memcmp( hdr.magic, BIN_MAGIC, sizeof(hdr.magic) ) == 0) {
+    fclose( fp );
+    return addRun( runs, hdr.num_dendrs, hdr.num_comps, hdr.slaves + 1,
+                   hdr.exec_time, path );
+  }
+
+  // Text ones with a comment line written by sinkClose().
+  rewind( fp );
+  ok = fgets( line, sizeof(line), fp ) != NULL;
+  fclose( fp );
+  if (ok) {
+    comps = strstr( line, "Compartments:" );
+    dendrs = strstr( line, "Dendrites:" );
+    exec = strstr( line, "Execution time:" );
+    slaves = strstr( line, "Slave processes:" );
+    ok = comps && dendrs && exec && slaves;
+  }
+  if (!ok) {
+    fprintf( stderr, "%s has no run description!\n", path );
+    return 0;
+  }
+  return addRun( runs, atoi( dendrs + 10 ), atoi( comps + 13 ),
+                 atoi( slaves + 16 ) + 1, atof( exec + 15 ), path );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int readLog( PerfRuns *runs, const char *path )
+{
+  char line[ PERF_LINE_LEN ], data[ PERF_LINE_LEN ], *base, *p;
+  int num_dendrs = 0, num_comps = 0, num_procs = 0, d, c;
+  FILE *fp;
+
+  fp = fopen( path, "r" );
+  if (!fp) {
+    fprintf( stderr, "Can't open %s!\n", path );
+    return 0;
+  }
+
+  // A run announces its shape, then its data file, whose name holds the
+  // number of processes, and ends with its execution time.
+  data[0] = '\0';
+  while (fgets( line, sizeof(line), fp )) {
+    if (sscanf( line, "Simulating %d dendrites with %d compartments",
+                &num_dendrs, &num_comps ) == 2) {
+      num_procs = 0;
+      data[0] = '\0';
+    } else if (sscanf( line, "Data will be stored in %1023s", data ) == 1) {
+      base = strrchr( data, '/' );
+      base = base ? base + 1 : data;
+      if (sscanf( base, "p%dd%dc%d", &num_procs, &d, &c ) != 3) {
+        num_procs = 0;
+      }
+    } else if ((p = strstr( line, "Execution time:" )) && num_procs > 0 &&
+               num_dendrs > 0) {
+      if (!addRun( runs, num_dendrs, num_comps, num_procs, atof( p + 15 ),
+                   data )) {
+        fclose( fp );
+        return 0;
+      }
+      num_dendrs = 0;
+    }
+  }
+
+  fclose( fp );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static double jsonNumber( const char *obj, const char *end, const char *key,
+                          int *found )
+{
+  const char *p = obj, *colon;
+  size_t const len = strlen( key );
+
+  // Flat records only: "key" : number, anywhere in the object.
+  while ((p = strstr( p, key )) && p < end) {
+    if (p > obj && p[-1] == '"' && p[len] == '"') {
+      colon = p + len + 1;
+      while (*colon == ' ' || *colon == '\t' || *colon == '\n') {
+        colon++;
+      }
+      if (*colon == ':') {
+        *found = 1;
+        return atof( colon + 1 );
+      }
+    }
+    p += len;
+  }
+  *found = 0;
+  return 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int readJson( PerfRuns *runs, const char *path )
+{
+  double num_dendrs, num_comps, num_procs, secs;
+  char *text, *obj, *end;
+  int has_d, has_c, has_p, has_s, ok = 1;
+  long size;
+  FILE *fp;
+
+  fp = fopen( path, "r" );
+  if (!fp) {
+    fprintf( stderr, "Can't open %s!\n", path );
+    return 0;
+  }
+  fseek( fp, 0, SEEK_END );
+  size = ftell( fp );
+  rewind( fp );
+  text = (char*) malloc( size + 1 );
+  if (!text || fread( text, 1, size, fp ) != (size_t) size) {
+    fprintf( stderr, "Can't read %s!\n", path );
+    fclose( fp );
+    free( text );
+    return 0;
+  }
+  text[ size ] = '\0';
+  fclose( fp );
+
+  // Every innermost object with the four fields is a run.
+  for (obj = strchr( text, '{' ); obj && ok; obj = strchr( end, '{' )) {
+    while ((end = strpbrk( obj + 1, "{}" )) && *end == '{') {
+      obj = end;
+    }
+    if (!end) {
+      break;
+    }
+    num_dendrs = jsonNumber( obj, end, "dendrites", &has_d );
+    num_comps = jsonNumber( obj, end, "compartments", &has_c );
+    num_procs = jsonNumber( obj, end, "processes", &has_p );
+    secs = jsonNumber( obj, end, "seconds", &has_s );
+    if (has_d && has_c && has_s) {
+      ok = addRun( runs, (int) num_dendrs, (int) num_comps,
+                   has_p ? (int) num_procs : 1, secs, NULL );
+    }
+  }
+
+  free( text );
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int compareRuns( const void *a, const void *b )
+{
+  const PerfRun *x = (const PerfRun*) a, *y = (const PerfRun*) b;
+
+  if (x->num_dendrs != y->num_dendrs) {
+    return x->num_dendrs - y->num_dendrs;
+  }
+  if (x->num_comps != y->num_comps) {
+    return x->num_comps - y->num_comps;
+  }
+  return x->num_procs - y->num_procs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static double baseline( const char *history, const char *machine,
+                        int num_dendrs, int num_comps, int num_procs )
+{
+  char line[ PERF_LINE_LEN ], *fields[6];
+  double found = -1.0;
+  FILE *fp;
+
+  fp = fopen( history, "r" );
+  if (!fp) {
+    return -1.0;
+  }
+
+  // machine | dendrites | compartments | processes | seconds | date; the
+  // last matching entry is the baseline.
+  while (fgets( line, sizeof(line), fp )) {
+    if (line[0] == '#' || splitFields( line, fields, 6 ) != 6) {
+      continue;
+    }
+    if (strcmp( fields[0], machine ) == 0 &&
+        atoi( fields[1] ) == num_dendrs && atoi( fields[2] ) == num_comps &&
+        atoi( fields[3] ) == num_procs) {
+      found = atof( fields[4] );
+    }
+  }
+
+  fclose( fp );
+  return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int record( const char *history, const char *machine,
+                   const PerfRun *best, int count )
+{
+  char date[ 32 ];
+  time_t now = time( NULL );
+  int i, is_new = access( history, F_OK ) != 0;
+  FILE *fp;
+
+  fp = fopen( history, "a" );
+  if (!fp) {
+    fprintf( stderr, "Can't write history file %s!\n", history );
+    return 0;
+  }
+  if (is_new) {
+    fprintf( fp, "# machine | dendrites | compartments | processes | "
+             "seconds | recorded\n" );
+  }
+  strftime( date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime( &now ) );
+  for (i = 0; i < count; i++) {
+    fprintf( fp, "%s | %d | %d | %d | %f | %s\n", machine,
+             best[i].num_dendrs, best[i].num_comps, best[i].num_procs,
+             best[i].secs, date );
+  }
+  return fclose( fp ) == 0;
+}
+
+/**
+ * Name: main
+ *
+ * Description:
+ * See usage statement (run program with '-h' flag).
+ *
+ * Parameters:
+ * @param argc    number of command line arguments
+ * @param argv    command line arguments
+ */
+int main( int argc, char **argv )
+{
+  char *history = PERF_FILE, *machine = NULL, *dot, cpu[ 256 ];
+  char own_machine[ 300 ], flag[ 32 ];
+  double threshold = PERF_THRESHOLD, t1, speedup, base;
+  int i, j, g, first_file = argc, do_record = 0, regressions = 0;
+  int num_best = 0, ok = 1;
+  PerfRuns runs = { 0, 0, NULL };
+  PerfRun *best;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp( argv[i], "-h" ) == 0 || strcmp( argv[i], "--help" ) == 0) {
+      usage( argv[0] );
+      return 0;
+    } else if (strcmp( argv[i], "--history" ) == 0 && i + 1 < argc) {
+      history = argv[++i];
+    } else if (strcmp( argv[i], "--machine" ) == 0 && i + 1 < argc) {
+      machine = argv[++i];
+    } else if (strcmp( argv[i], "--threshold" ) == 0 && i + 1 < argc) {
+      threshold = atof( argv[++i] );
+      if (threshold <= 0) {
+        fprintf( stderr, "Threshold must be greater than 0!\n" );
+        fprintf( stderr, "Threshold default to %g!\n", PERF_THRESHOLD );
+        threshold = PERF_THRESHOLD;
+      }
+    } else if (strcmp( argv[i], "--record" ) == 0) {
+      do_record = 1;
+    } else if (argv[i][0] == '-') {
+      usage( argv[0] );
+      return 1;
+    } else {
+      first_file = i;
+      break;
+    }
+  }
+
+  if (first_file == argc) {
+    usage( argv[0] );
+    return 1;
+  }
+
+  if (!machine) {
+    placeCpuModel( cpu, sizeof(cpu) );
+    snprintf( own_machine, sizeof(own_machine), "%s (%ld CPUs)", cpu,
+              sysconf( _SC_NPROCESSORS_ONLN ) );
+    machine = own_machine;
+  } else if (strchr( machine, '|' )) {
+    fprintf( stderr, "Machine names can't contain '|'!\n" );
+    return 1;
+  }
+
+  // Data files first, so that logs of the same runs are recognized.
+  for (i = first_file; i < argc && ok; i++) {
+    dot = strrchr( argv[i], '.' );
+    if (dot && (strcmp( dot, ".dat" ) == 0 || strcmp( dot, ".bin" ) == 0)) {
+      ok = readData( &runs, argv[i] );
+    }
+  }
+  for (i = first_file; i < argc && ok; i++) {
+    dot = strrchr( argv[i], '.' );
+    if (dot && strcmp( dot, ".json" ) == 0) {
+      ok = readJson( &runs, argv[i] );
+    } else if (!dot || (strcmp( dot, ".dat" ) != 0 &&
+                        strcmp( dot, ".bin" ) != 0)) {
+      ok = readLog( &runs, argv[i] );
+    }
+  }
+  if (!ok) {
+    free( runs.list );
+    return 1;
+  }
+  if (runs.count == 0) {
+    fprintf( stderr, "No runs found!\n" );
+    return 1;
+  }
+
+  // Best time of each shape and process count.
+  qsort( runs.list, runs.count, sizeof(PerfRun), compareRuns );
+  best = (PerfRun*) malloc( runs.count * sizeof(PerfRun) );
+  if (!best) {
+    free( runs.list );
+    return 1;
+  }
+  for (i = 0; i < runs.count; i++) {
+    if (num_best > 0 && compareRuns( &best[ num_best - 1 ],
+                                     &runs.list[i] ) == 0) {
+      if (runs.list[i].secs < best[ num_best - 1 ].secs) {
+        best[ num_best - 1 ].secs = runs.list[i].secs;
+      }
+    } else {
+      best[ num_best++ ] = runs.list[i];
+    }
+  }
+
+  printf( "Machine: %s\n", machine );
+  for (g = 0; g < num_best; g = j) {
+    j = g + 1;
+    while (j < num_best && best[j].num_dendrs == best[g].num_dendrs &&
+           best[j].num_comps == best[g].num_comps) {
+      j++;
+    }
+
+    // Speedups are over one process, when it was run.
+    t1 = best[g].num_procs == 1 ? best[g].secs : -1.0;
+    printf( "\n%d dendrites x %d compartments\n", best[g].num_dendrs,
+            best[g].num_comps );
+    printf( "  procs    best (s)  speedup  efficiency  serial fraction  "
+            "baseline (s)\n" );
+    for (i = g; i < j; i++) {
+      printf( "  %5d  %10.3f", best[i].num_procs, best[i].secs );
+      if (t1 > 0) {
+        speedup = t1 / best[i].secs;
+        printf( "  %7.2f  %9.1f%%", speedup,
+                speedup / best[i].num_procs * 100.0 );
+        if (best[i].num_procs > 1) {
+          // Karp-Flatt: (1/S - 1/p) / (1 - 1/p).
+          printf( "  %15.4f", (1.0 / speedup - 1.0 / best[i].num_procs) /
+                              (1.0 - 1.0 / best[i].num_procs) );
+        } else {
+          printf( "  %15s", "-" );
+        }
+      } else {
+        printf( "  %7s  %10s  %15s", "-", "-", "-" );
+      }
+
+      base = baseline( history, machine, best[i].num_dendrs,
+                       best[i].num_comps, best[i].num_procs );
+      flag[0] = '\0';
+      if (base > 0 && best[i].secs > base * (1.0 + threshold / 100.0)) {
+        snprintf( flag, sizeof(flag), "  REGRESSION %+.1f%%",
+                  (best[i].secs / base - 1.0) * 100.0 );
+        regressions++;
+      }
+      if (base > 0) {
+        printf( "  %12.3f%s\n", base, flag );
+      } else {
+        printf( "  %12s\n", "-" );
+      }
+    }
+  }
+
+  printf( "\n%d runs, %d configurations, %d regressions over %g%%\n",
+          runs.count, num_best, regressions, threshold );
+
+  if (do_record && !record( history, machine, best, num_best )) {
+    ok = 0;
+  }
+
+  free( best );
+  free( runs.list );
+  return !ok ? 1 : regressions ? 2 : 0;
+}
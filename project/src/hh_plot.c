@@ -0,0 +1,119 @@
+/*
+  Multiple Processor Systems. Spring 2023
+
+  Batch plotter for simulation results. Renders the PNG graph for every data
+  file given on the command line in a single process, so a sweep can run its
+  simulations with plotting disabled ('--no-plot') and plot everything at the
+  end without starting gnuplot once per run.
+*/
+
+#include "plot.h"
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/**
+ * Name: usage
+ *
+ * Description:
+ * Prints a simple usage statement for the program.
+ *
+ * Parameters:
+ * @param name      the name used to call this program (i.e., argv[0])
+ */
+static void usage( char *name )
+{
+  printf(
+"USAGE:\n"
+"  %s [-h] [-o GRAPH_DIR] DATA_FILE...\n"
+"\n"
+"DESCRIPTION:\n"
+"  Renders the soma potential trace stored in each DATA_FILE to a PNG file of\n"
+"  the same name under GRAPH_DIR. No external programs are used.\n"
+"\n"
+"OPTIONS:\n"
+"  -h, --help\n"
+"    Print this usage statement and exit.\n"
+"\n"
+"  -o, --output-dir\n"
+"    Directory where graphs are written. Defaults to `graphs'. It will be\n"
+"    created if it does not exist.\n"
+"\n"
+, name );
+}
+
+/**
+ * Name: main
+ *
+ * Description:
+ * See usage statement (run program with '-h' flag).
+ *
+ * Parameters:
+ * @param argc    number of command line arguments
+ * @param argv    command line arguments
+ */
+int main( int argc, char **argv )
+{
+  char *graph_dir = "graphs";
+  char graph_fname[ FNAME_LEN ];
+  char *base, *dot;
+  double *res;
+  int i, num_samples, first_file = argc, failures = 0;
+  PlotInfo pinfo;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp( argv[i], "-h" ) == 0 || strcmp( argv[i], "--help" ) == 0) {
+      usage( argv[0] );
+      return 0;
+    } else if (strcmp( argv[i], "-o" ) == 0 ||
+               strcmp( argv[i], "--output-dir" ) == 0) {
+      if (i + 1 >= argc) {
+        usage( argv[0] );
+        return 1;
+      }
+      graph_dir = argv[++i];
+    } else {
+      first_file = i;
+      break;
+    }
+  }
+
+  if (first_file == argc) {
+    usage( argv[0] );
+    return 1;
+  }
+
+  // Verify that the output directory exists. Create it if it doesn't.
+  struct stat stat_buf;
+  if ((stat( graph_dir, &stat_buf ) != 0 || !S_ISDIR(stat_buf.st_mode)) &&
+      mkdir( graph_dir, 0700 ) != 0) {
+    fprintf( stderr, "Could not create '%s' directory!\n", graph_dir );
+    return 1;
+  }
+
+  for (i = first_file; i < argc; i++) {
+    if (!readTrace( argv[i], &pinfo, &res, &num_samples )) {
+      failures++;
+      continue;
+    }
+
+    // graphs/<data file name without directory and extension>.png
+    base = strrchr( argv[i], '/' );
+    base = base ? base + 1 : argv[i];
+    dot = strrchr( base, '.' );
+    snprintf( graph_fname, FNAME_LEN, "%s/%.*s.png", graph_dir,
+              dot ? (int) (dot - base) : (int) strlen( base ), base );
+
+    if (plotTrace( &pinfo, res, num_samples, graph_fname )) {
+      printf( "%s -> %s\n", argv[i], graph_fname );
+    } else {
+      failures++;
+    }
+    free( res );
+  }
+
+  return failures ? 1 : 0;
+}
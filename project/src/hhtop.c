@@ -0,0 +1,269 @@
+/*
+  Multiple Processor Systems. Spring 2023
+
+  Live view of running simulations. seq_hh and mpi_hh publish their progress
+  in telemetry blocks in POSIX shared memory (see telemetry.h); this program
+  maps them read-only and shows, for every run, how far it got, how fast it
+  goes and how the time of each thread or rank splits between computing and
+  communicating or waiting, without disturbing the run.
+*/
+
+#include "telemetry.h"
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+
+#define HHTOP_MAX_RUNS 64  // Runs shown at once.
+
+/**
+ * Name: usage
+ *
+ * Description:
+ * Prints a simple usage statement for the program.
+ *
+ * Parameters:
+ * @param name      the name used to call this program (i.e., argv[0])
+ */
+static void usage( char *name )
+{
+  printf(
+"USAGE:\n"
+"  %s [-h] [-n COUNT] [-i SECONDS] [--clean] [NAME...]\n"
+"\n"
+"DESCRIPTION:\n"
+"  Shows the progress of running seq_hh and mpi_hh processes, as published\n"
+"  in their telemetry blocks: simulated time, integration steps per second,\n"
+"  estimated time left, and per thread (seq_hh) or rank (mpi_hh) the share\n"
+"  of time spent computing and communicating or waiting, and the peak\n"
+"  memory of the process. `imbalance' is the largest compute time over the\n"
+"  mean; well balanced runs stay close to 1.\n"
+"\n"
+"  NAME... are telemetry blocks (see --telemetry). By default every block\n"
+"  found in /dev/shm is shown. An mpi_hh run spanning several nodes has one\n"
+"  block per node, holding the ranks of that node.\n"
+"\n"
+"OPTIONS:\n"
+"  -h, --help\n"
+"    Print this usage statement and exit.\n"
+"\n"
+"  -n, --count\n"
+"    Number of refreshes before exiting. Defaults to 0 (until interrupted).\n"
+"    With 1, the screen is not cleared.\n"
+"\n"
+"  -i, --interval\n"
+"    Seconds between refreshes. Defaults to %g.\n"
+"\n"
+"  --clean\n"
+"    Remove the blocks left behind by runs that died, and exit.\n"
+"\n"
+, name, HHTOP_INTERVAL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int findBlocks( char names[][ FNAME_LEN ], int max )
+{
+  const char *prefix = TEL_PREFIX + 1;  // Without the leading '/'.
+  struct dirent *entry;
+  int n = 0;
+  DIR *dir;
+
+  dir = opendir( "/dev/shm" );
+  if (!dir) {
+    return 0;
+  }
+  while ((entry = readdir( dir )) && n < max) {
+    if (strncmp( entry->d_name, prefix, strlen( prefix ) ) == 0) {
+      snprintf( names[ n++ ], FNAME_LEN, "/%.*s", FNAME_LEN - 2,
+                entry->d_name );
+    }
+  }
+  closedir( dir );
+  return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static const char *runState( const Telemetry *tel )
+{
+  char path[ 64 ], stat[ 256 ], *paren;
+  FILE *fp;
+  int zombie = 0;
+
+  if (__atomic_load_n( &tel->hdr->done, __ATOMIC_ACQUIRE )) {
+    return "finished";
+  }
+  if (kill( tel->hdr->pid, 0 ) != 0 && errno == ESRCH) {
+    return "dead";
+  }
+
+  // A killed process nobody waited for yet still answers kill().
+  snprintf( path, sizeof(path), "/proc/%d/stat", tel->hdr->pid );
+  if ((fp = fopen( path, "r" ))) {
+    if (fgets( stat, sizeof(stat), fp ) && (paren = strrchr( stat, ')' ))) {
+      zombie = paren[1] == ' ' && paren[2] == 'Z';
+    }
+    fclose( fp );
+  }
+  return zombie ? "dead" : "running";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void showRun( const Telemetry *tel )
+{
+  TelemetryHeader const *hdr = tel->hdr;
+  TelemetrySlot slot, slowest;
+  double max_compute = 0.0, sum_compute = 0.0, left, total;
+  int i, active = 0, eta;
+
+  printf( "%s  %s pid %d %s  %d dendrites x %d compartments\n", tel->name,
+          hdr->program, hdr->pid, runState( tel ), hdr->num_dendrs,
+          hdr->num_comps );
+
+  // The run goes as fast as its slowest thread or rank.
+  memset( &slowest, 0, sizeof(slowest) );
+  for (i = 0; i < hdr->num_slots; i++) {
+    telemetryRead( tel, i, &slot );
+    if (!slot.active) {
+      continue;
+    }
+    if (!active++ || slot.sim_ms < slowest.sim_ms) {
+      slowest = slot;
+    }
+    max_compute = slot.compute > max_compute ? slot.compute : max_compute;
+    sum_compute += slot.compute;
+  }
+  if (!active) {
+    printf( "  starting\n\n" );
+    return;
+  }
+
+  // The last ms is not simulated, only sampled.
+  total = hdr->duration - 1;
+  left = slowest.sim_ms > 0 ? slowest.elapsed *
+                              (total - slowest.sim_ms) / slowest.sim_ms : 0;
+  eta = (int) (left + 0.5);
+  printf( "  simulated %d/%d ms (%.1f%%)  %.3g steps/s  ETA %02d:%02d:%02d  "
+          "imbalance %.2f\n", slowest.sim_ms, hdr->duration,
+          slowest.sim_ms / total * 100.0,
+          slowest.elapsed > 0 ? slowest.steps / slowest.elapsed : 0.0,
+          eta / 3600, eta / 60 % 60, eta % 60,
+          sum_compute > 0 ? max_compute * active / sum_compute : 1.0 );
+
+  printf( "  %-6s %5s %10s %8s %8s %12s\n",
+          strcmp( hdr->program, "mpi_hh" ) == 0 ? "rank" : "thread", "ms",
+          "steps/s", "compute", "comm", "memory (MB)" );
+  for (i = 0; i < hdr->num_slots; i++) {
+    telemetryRead( tel, i, &slot );
+    if (!slot.active) {
+      continue;  // Not started yet, or on another node.
+    }
+    printf( "  %6d %5d %10.3g %7.1f%% %7.1f%% %12.1f\n", i, slot.sim_ms,
+            slot.elapsed > 0 ? slot.steps / slot.elapsed : 0.0,
+            slot.elapsed > 0 ? slot.compute / slot.elapsed * 100.0 : 0.0,
+            slot.elapsed > 0 ? slot.comm / slot.elapsed * 100.0 : 0.0,
+            slot.rss_kb / 1024.0 );
+  }
+  printf( "\n" );
+}
+
+/**
+ * Name: main
+ *
+ * Description:
+ * See usage statement (run program with '-h' flag).
+ *
+ * Parameters:
+ * @param argc    number of command line arguments
+ * @param argv    command line arguments
+ */
+int main( int argc, char **argv )
+{
+  static char names[ HHTOP_MAX_RUNS ][ FNAME_LEN ];
+  double interval = HHTOP_INTERVAL;
+  int count = 0, clean = 0, first_name = argc, num_names, i, round;
+  Telemetry tel;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp( argv[i], "-h" ) == 0 || strcmp( argv[i], "--help" ) == 0) {
+      usage( argv[0] );
+      return 0;
+    } else if ((strcmp( argv[i], "-n" ) == 0 ||
+                strcmp( argv[i], "--count" ) == 0) && i + 1 < argc) {
+      count = atoi( argv[++i] );
+      if (count < 0) {
+        fprintf( stderr, "Count must be 0 or greater!\n" );
+        fprintf( stderr, "Count default to 0!\n" );
+        count = 0;
+      }
+    } else if ((strcmp( argv[i], "-i" ) == 0 ||
+                strcmp( argv[i], "--interval" ) == 0) && i + 1 < argc) {
+      interval = atof( argv[++i] );
+      if (interval <= 0) {
+        fprintf( stderr, "Interval must be greater than 0!\n" );
+        fprintf( stderr, "Interval default to %g!\n", HHTOP_INTERVAL );
+        interval = HHTOP_INTERVAL;
+      }
+    } else if (strcmp( argv[i], "--clean" ) == 0) {
+      clean = 1;
+    } else if (argv[i][0] == '-') {
+      usage( argv[0] );
+      return 1;
+    } else {
+      first_name = i;
+      break;
+    }
+  }
+
+  for (round = 0; count == 0 || round < count; round++) {
+    if (round > 0) {
+      usleep( (useconds_t) (interval * 1e6) );
+    }
+
+    // Runs come and go, so the blocks are looked for at every refresh.
+    num_names = 0;
+    for (i = first_name; i < argc && num_names < HHTOP_MAX_RUNS; i++) {
+      snprintf( names[ num_names++ ], FNAME_LEN, "%s", argv[i] );
+    }
+    if (first_name == argc) {
+      num_names = findBlocks( names, HHTOP_MAX_RUNS );
+    }
+
+    if (clean) {
+      for (i = 0; i < num_names; i++) {
+        if (telemetryAttach( &tel, names[i] )) {
+          if (strcmp( runState( &tel ), "dead" ) == 0) {
+            printf( "Removing %s\n", tel.name );
+            shm_unlink( tel.name );
+          }
+          telemetryDetach( &tel );
+        }
+      }
+      return 0;
+    }
+
+    if (count != 1) {
+      printf( "\033[H\033[J" );
+    }
+    printf( "hhtop - %d run(s)\n\n", num_names );
+    for (i = 0; i < num_names; i++) {
+      if (telemetryAttach( &tel, names[i] )) {
+        showRun( &tel );
+        telemetryDetach( &tel );
+      } else {
+        printf( "%s  not a telemetry block\n\n", names[i] );
+      }
+    }
+    fflush( stdout );
+  }
+
+  return 0;
+}
@@ -16,40 +16,35 @@
 */
 
 #include "lib_hh.h"
+#include "hh_model.h"
 #include "constants.h"
+#include "stimulus.h"
 
 #include <math.h>
 #include <float.h>
 #include <stdlib.h>
 
-// Parameters for cell of 20,000 micometer surface area (2e-4 cm^2)
-#define gL  10      // Leak soma conductance, nS
-#define gLd 0.01    // Leak dendrite compartment conductance, nS
-#define gK  6000    // K soma conductance, nS
-#define gNa 20000   // Na soma conductance, nS
-#define Cs  200     // Soma capacitance, pF
-#define Cd  0.1     // Compartment dendrite capacitance, pF
-#define ENa 50      // Na reversal potential, mV
-#define EK -90      // K reversal potential, mV
-#define EL -65      // Leak reversal potential, mV
-#define Vr -65      // Resting membrane potential, mV
-
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 double dendriteStep( double *v_d, int seed, int num_comps, double delta_t,
                      double v_m )
+{
+  // Current injected at the tip of the dendrite
+  return dendriteStepCurrent( v_d, stimGenerate( seed ), num_comps, delta_t,
+                              v_m );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double dendriteStepCurrent( double *v_d, double cur, int num_comps,
+                            double delta_t, double v_m )
 {
   int i;
-  double current, cur, temp[1], paramD[6], *vddt;
+  double current, temp[1], paramD[6], *vddt;
 
   vddt = (double*) malloc( sizeof(double) * (num_comps - 1) );
   paramD[0] = delta_t;
 
-  srand(seed);
-
-  // Current injected at the tip of the dendrite
-  cur = INJCURMEAN + INJCURMEAN*0.1 -
-        2*INJCURMEAN*0.1*((double)rand()/((double)RAND_MAX));
   // Update somatic potential = potential of the last compartment
   v_d[num_comps-1] = v_m;
 
@@ -147,9 +142,11 @@ void rk4Step( double *y, double *y0, double *dydt0, int nv, double *fp,
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void soma( double *dydx, double *y, double *param )
+static inline void somaRates( double v, double *alpha_n, double *beta_n,
+                              double *alpha_m, double *beta_m,
+                              double *alpha_h, double *beta_h )
 {
-  double alpha_n, beta_n, alpha_m, beta_m, alpha_h, beta_h;
+  // Opening and closing rates of the gates at membrane potential v, 1/ms.
   double const E_alpha_n = Vr + 15;
   double const E_beta_n  = Vr + 10;
   double const E_alpha_m = Vr + 13;
@@ -157,6 +154,36 @@ void soma( double *dydx, double *y, double *param )
   double const E_alpha_h = Vr + 17;
   double const E_beta_h  = Vr + 40;
 
+  if (v == E_alpha_n) {   // protect against div by zero
+    *alpha_n = 0.032*5;
+  } else {
+    *alpha_n = 0.032 * (E_alpha_n-v)/(exp((E_alpha_n-v)/5) - 1);
+  }
+
+  *beta_n  = 0.5*exp((E_beta_n-v)/40);
+
+  if (v == E_alpha_m) {   // protect against div by zero
+    *alpha_m = 0.32*4;
+  } else {
+    *alpha_m = 0.32 * (E_alpha_m-v)/(exp((E_alpha_m-v)/4) - 1);
+  }
+
+  if (v == E_beta_m) {    // protect against div by zero
+    *beta_m = 0.28*5;
+  } else {
+    *beta_m = 0.28 * (v-E_beta_m)/(exp((v-E_beta_m)/5) - 1);
+  }
+
+  *alpha_h = 0.128 * exp((E_alpha_h-v)/18);
+  *beta_h  = 4 / (exp((E_beta_h-v)/5)+1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void soma( double *dydx, double *y, double *param )
+{
+  double alpha_n, beta_n, alpha_m, beta_m, alpha_h, beta_h;
+
   double v = y[0];
   double n = y[1];
   double m = y[2];
@@ -170,31 +197,246 @@ void soma( double *dydx, double *y, double *param )
   dydx[0] = dt*(I_inj + I_dendr - gK*n4*(v-EK) -
             gNa*m3h*(v-ENa) - gL*(v-EL))/Cs;
 
-  if (v == E_alpha_n) {   // protect against div by zero
-    alpha_n = 0.032*5;
-  } else {
-    alpha_n = 0.032 * (E_alpha_n-v)/(exp((E_alpha_n-v)/5) - 1);
-  }
+  somaRates( v, &alpha_n, &beta_n, &alpha_m, &beta_m, &alpha_h, &beta_h );
 
-  beta_n  = 0.5*exp((E_beta_n-v)/40);
   dydx[1] = dt*(alpha_n*(1-n) - beta_n*n);
+  dydx[2] = dt*(alpha_m*(1-m) - beta_m*m);
+  dydx[3] = dt*(alpha_h*(1-h) - beta_h*h);
+}
 
-  if (v == E_alpha_m) {   // protect against div by zero
-    alpha_m = 0.32*4;
-  } else {
-    alpha_m = 0.32 * (E_alpha_m-v)/(exp((E_alpha_m-v)/4) - 1);
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void rushLarsenStep( double *y, double *param )
+{
+  double alpha_n, beta_n, alpha_m, beta_m, alpha_h, beta_h;
+  double n4, m3h, g_total, v_inf;
+
+  double dt = param[0];
+  double I_inj = param[1];
+  double I_dendr = param[2];
+
+  // With v frozen over the step, each gate relaxes exponentially towards
+  // alpha/(alpha+beta) with rate alpha+beta.
+  somaRates( y[0], &alpha_n, &beta_n, &alpha_m, &beta_m, &alpha_h, &beta_h );
+  y[1] = alpha_n/(alpha_n+beta_n) +
+         (y[1] - alpha_n/(alpha_n+beta_n))*exp(-dt*(alpha_n+beta_n));
+  y[2] = alpha_m/(alpha_m+beta_m) +
+         (y[2] - alpha_m/(alpha_m+beta_m))*exp(-dt*(alpha_m+beta_m));
+  y[3] = alpha_h/(alpha_h+beta_h) +
+         (y[3] - alpha_h/(alpha_h+beta_h))*exp(-dt*(alpha_h+beta_h));
+
+  // With the new gates frozen, v is linear in itself as well: it relaxes
+  // towards the conductance weighted reversal potential with rate g/Cs.
+  n4 = y[1]*y[1]*y[1]*y[1];
+  m3h = y[2]*y[2]*y[2]*y[3];
+  g_total = gK*n4 + gNa*m3h + gL;
+  v_inf = (I_inj + I_dendr + gK*n4*EK + gNa*m3h*ENa + gL*EL) / g_total;
+  y[0] = v_inf + (y[0] - v_inf)*exp(-dt*g_total/Cs);
+}
+
+// Power series of the soma state and of the terms of its equations, over a
+// step scaled to 1: coefficient k of x is x_k, x(t0 + tau*dt) = sum x_k tau^k.
+enum {
+  PS_V, PS_N, PS_M, PS_H,   // State.
+  PS_N2, PS_N4, PS_N4V,     // n^2, n^4, n^4 v.
+  PS_M2, PS_M3,             // m^2, m^3.
+  PS_M3H, PS_M3HV,          // m^3 h, m^3 h v.
+  PS_XAN, PS_EAN, PS_QAN,   // alpha_n: x, exp(x), x/(exp(x)-1).
+  PS_XAM, PS_EAM, PS_QAM,   // alpha_m.
+  PS_XBM, PS_EBM, PS_QBM,   // beta_m.
+  PS_XBN, PS_EBN,           // beta_n: x, exp(x).
+  PS_XAH, PS_EAH,           // alpha_h: x, exp(x).
+  PS_XBH, PS_EBH, PS_RBH,   // beta_h: x, exp(x), 1/(exp(x)+1).
+  PS_SN, PS_SM, PS_SH,      // alpha + beta of each gate.
+  PS_NUM_SERIES
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static inline double seriesMul( const double *a, const double *b, int k )
+{
+  // Coefficient k of a*b.
+  double sum = 0.0;
+  int j;
+
+  for (j = 0; j <= k; j++) {
+    sum += a[j]*b[k-j];
   }
+  return sum;
+}
 
-  if (v == E_beta_m) {    // protect against div by zero
-    beta_m = 0.28*5;
-  } else {
-    beta_m = 0.28 * (v-E_beta_m)/(exp((v-E_beta_m)/5) - 1);
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static inline double seriesExp( const double *u, const double *w, int k )
+{
+  // Coefficient k of w = exp(u), from w' = u' w.
+  double sum = 0.0;
+  int j;
+
+  if (k == 0) {
+    return exp( u[0] );
+  }
+  for (j = 1; j <= k; j++) {
+    sum += j*u[j]*w[k-j];
   }
+  return sum/k;
+}
 
-  dydx[2] = dt*(alpha_m*(1-m) - beta_m*m);
-  alpha_h = 0.128 * exp((E_alpha_h-v)/18);
-  beta_h  = 4 / (exp((E_beta_h-v)/5)+1);
-  dydx[3] = dt*(alpha_h*(1-h) - beta_h*h);
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static inline double seriesRatio( const double *x, const double *e,
+                                  const double *q, int k )
+{
+  // Coefficient k of q = x/(e - 1), from q (e - 1) = x.
+  double sum = x[k];
+  double d0 = e[0] - 1;
+  int j;
+
+  if (d0 == 0.0) {   // protect against div by zero
+    d0 = DBL_EPSILON;
+  }
+  for (j = 1; j <= k; j++) {
+    sum -= e[j]*q[k-j];
+  }
+  return sum/d0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int psSeries( double *y, double *param, double dt, double tol,
+                     int force )
+{
+  // One Parker-Sochacki step of size dt. Returns the order reached, or 0 if
+  // the series did not converge (y is then left alone, unless `force').
+  double s[ PS_NUM_SERIES ][ PS_MAX_ORDER + 1 ];
+  double const I_total = param[1] + param[2];
+  int k, i, order = 0;
+  double next, largest, prev_largest = HUGE_VAL;
+
+  s[PS_V][0] = y[0]; s[PS_N][0] = y[1]; s[PS_M][0] = y[2]; s[PS_H][0] = y[3];
+
+  for (k = 0; k < PS_MAX_ORDER; k++) {
+    double const v = s[PS_V][k];
+    double const c = k == 0 ? 1.0 : 0.0;   // Constants only enter order 0.
+
+    // Terms of the equations, coefficient k, from the state up to order k.
+    s[PS_N2][k]   = seriesMul( s[PS_N], s[PS_N], k );
+    s[PS_N4][k]   = seriesMul( s[PS_N2], s[PS_N2], k );
+    s[PS_N4V][k]  = seriesMul( s[PS_N4], s[PS_V], k );
+    s[PS_M2][k]   = seriesMul( s[PS_M], s[PS_M], k );
+    s[PS_M3][k]   = seriesMul( s[PS_M2], s[PS_M], k );
+    s[PS_M3H][k]  = seriesMul( s[PS_M3], s[PS_H], k );
+    s[PS_M3HV][k] = seriesMul( s[PS_M3H], s[PS_V], k );
+
+    // The rates of somaRates(), written with exp() series.
+    s[PS_XAN][k] = (c*(Vr + 15) - v)/5;
+    s[PS_EAN][k] = seriesExp( s[PS_XAN], s[PS_EAN], k );
+    s[PS_QAN][k] = seriesRatio( s[PS_XAN], s[PS_EAN], s[PS_QAN], k );
+    s[PS_XAM][k] = (c*(Vr + 13) - v)/4;
+    s[PS_EAM][k] = seriesExp( s[PS_XAM], s[PS_EAM], k );
+    s[PS_QAM][k] = seriesRatio( s[PS_XAM], s[PS_EAM], s[PS_QAM], k );
+    s[PS_XBM][k] = (v - c*(Vr + 40))/5;
+    s[PS_EBM][k] = seriesExp( s[PS_XBM], s[PS_EBM], k );
+    s[PS_QBM][k] = seriesRatio( s[PS_XBM], s[PS_EBM], s[PS_QBM], k );
+
+    s[PS_XBN][k] = (c*(Vr + 10) - v)/40;
+    s[PS_EBN][k] = seriesExp( s[PS_XBN], s[PS_EBN], k );
+    s[PS_XAH][k] = (c*(Vr + 17) - v)/18;
+    s[PS_EAH][k] = seriesExp( s[PS_XAH], s[PS_EAH], k );
+    s[PS_XBH][k] = (c*(Vr + 40) - v)/5;
+    s[PS_EBH][k] = seriesExp( s[PS_XBH], s[PS_EBH], k );
+
+    // 1/(exp()+1), from r (e + 1) = 1.
+    next = c;
+    for (i = 1; i <= k; i++) {
+      next -= s[PS_EBH][i]*s[PS_RBH][k-i];
+    }
+    s[PS_RBH][k] = next/(s[PS_EBH][0] + 1);
+
+    // alpha + beta of every gate.
+    s[PS_SN][k] = 0.032*5*s[PS_QAN][k] + 0.5*s[PS_EBN][k];
+    s[PS_SM][k] = 0.32*4*s[PS_QAM][k] + 0.28*5*s[PS_QBM][k];
+    s[PS_SH][k] = 0.128*s[PS_EAH][k] + 4*s[PS_RBH][k];
+
+    // y' = f(y) gives the next coefficient of the state.
+    s[PS_V][k+1] = dt*(c*I_total - gK*(s[PS_N4V][k] - EK*s[PS_N4][k]) -
+                   gNa*(s[PS_M3HV][k] - ENa*s[PS_M3H][k]) -
+                   gL*(s[PS_V][k] - c*EL))/Cs/(k+1);
+    s[PS_N][k+1] = dt*(0.032*5*s[PS_QAN][k] -
+                   seriesMul( s[PS_SN], s[PS_N], k ))/(k+1);
+    s[PS_M][k+1] = dt*(0.32*4*s[PS_QAM][k] -
+                   seriesMul( s[PS_SM], s[PS_M], k ))/(k+1);
+    s[PS_H][k+1] = dt*(0.128*s[PS_EAH][k] -
+                   seriesMul( s[PS_SH], s[PS_H], k ))/(k+1);
+
+    // Converged once two consecutive orders add less than tol (one of them
+    // can vanish by symmetry).
+    largest = fmax( fmax( fabs( s[PS_V][k+1] ), fabs( s[PS_N][k+1] ) ),
+                    fmax( fabs( s[PS_M][k+1] ), fabs( s[PS_H][k+1] ) ) );
+    if (!isfinite( largest )) {
+      return 0;
+    }
+    if (largest < tol && prev_largest < tol) {
+      order = k + 1;
+      break;
+    }
+    prev_largest = largest;
+  }
+
+  if (order == 0) {
+    if (!force) {
+      return 0;
+    }
+    order = PS_MAX_ORDER;
+  }
+
+  // Sum at tau = 1, smallest terms first.
+  for (i = 0; i < NUMVAR; i++) {
+    next = 0.0;
+    for (k = order; k >= 0; k--) {
+      next += s[i][k];
+    }
+    y[i] = next;
+  }
+  return order;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int psStep( double *y, double *param, double dt, double tol,
+                   int depth )
+{
+  int order = psSeries( y, param, dt, tol, depth >= PS_MAX_HALVINGS );
+  double y0[ NUMVAR ], dydt[ NUMVAR ], fp[3];
+  int i;
+
+  if (order > 0) {
+    return order;
+  }
+  if (depth < PS_MAX_HALVINGS) {
+    // Beyond the radius of convergence: take two half steps.
+    order = psStep( y, param, dt/2, tol, depth + 1 );
+    return order + psStep( y, param, dt/2, tol, depth + 1 );
+  }
+
+  // Even the shortest step gives no finite series, so halving again would
+  // never end: take this one with RK4, which sums no series.
+  fp[0] = dt;
+  fp[1] = param[1];
+  fp[2] = param[2];
+  for (i = 0; i < NUMVAR; i++) {
+    y0[i] = y[i];
+  }
+  soma( dydt, y, fp );
+  rk4Step( y, y0, dydt, NUMVAR, fp, 1, soma );
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int parkerSochackiStep( double *y, double *param, double tol )
+{
+  return psStep( y, param, param[0], tol, 0 );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -7,21 +7,35 @@
 */
 
 #include "mpi_hh.h"
+#include "dendrites.h"
+#include "dendr_split.h"
 #include "cmd_args.h"
 #include "constants.h"
 #include "plot.h"
+#include "sink.h"
+#include "spike.h"
+#include "soma_step.h"
+#include "multirate.h"
+#include "wave_relax.h"
+#include "shm_reduce.h"
+#include "stimulus.h"
+#include "repro_mpi.h"
+#include "snapshot.h"
+#include "telemetry.h"
+#include "net_sim.h"
+#include "record.h"
 
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/stat.h>
+#include <unistd.h>
 #include <sys/time.h>
-#include <time.h>
 
 // Define MPI tags for communication
 #define TAG_ASSIGN_DENDRITE   1
 #define TAG_DENDRITE_CURRENT  2
 #define TAG_SOMA_POTENTIAL    3
+#define TAG_SNAPSHOT          6   // dendr_split.h uses 4 and 5.
 
 // Define macros based on compilation options. This is a best practice that
 // ensures that all code is seen by the compiler so there will be no surprises
@@ -39,6 +53,103 @@
   #define ISDEF_PLOT_PNG 0
 #endif
 
+/**
+ * Name: writeSnapshot
+ *
+ * Description:
+ * Collects the final potentials of all dendrites on rank 0 and writes them to
+ * a snapshot file with the soma trace and the spike times. Every process
+ * holds compartments lo..hi-1 of `count' dendrites; the processes of a group
+ * hold consecutive ranges of the same dendrites, and the groups consecutive
+ * dendrites of the cell. Must be called by all processes.
+ *
+ * Parameters:
+ * @param path          file to write (rank 0)
+ * @param rank          rank of this process
+ * @param num_processes number of processes
+ * @param split         processes per group
+ * @param num_dendrs    dendrites in the cell
+ * @param num_comps     compartments per dendrite (as given by the user)
+ * @param duration      simulated time, ms (rank 0)
+ * @param res           soma potential at each ms (rank 0)
+ * @param spike_times   spike times (rank 0)
+ * @param num_spikes    number of spikes (rank 0)
+ * @param volt          compartment lo of each dendrite at volt[d][1]
+ * @param count         dendrites of this process, 0 if reduced
+ * @param lo            first compartment of this process
+ * @param hi            one past its last compartment
+ *
+ * Returns:
+ * @return int          0 if there was a problem, nonzero otherwise
+ */
+static int writeSnapshot(const char *path, int rank, int num_processes,
+                         int split, int num_dendrs, int num_comps,
+                         int duration, double *res, double *spike_times,
+                         int num_spikes, double **volt, int count, int lo,
+                         int hi) {
+  int meta[3] = { count, lo, hi };
+  int num_groups = num_processes / split;
+  int max_dendrs = (num_dendrs + num_groups - 1) / num_groups;
+  int g, q, d, j, n, first = 0;
+  double *rows = NULL, *buf;
+  FILE *fp = NULL;
+
+  // The owned compartments of all dendrites, packed.
+  buf = (double*) malloc(((rank == 0 ? max_dendrs * num_comps
+                                     : count * (hi - lo)) + 1) *
+                         sizeof(double));
+  if (rank == 0) {
+    rows = (double*) malloc((max_dendrs * num_comps + 1) * sizeof(double));
+  }
+  if (!buf || (rank == 0 && !rows)) {
+    fprintf(stderr, "Could not allocate the snapshot!\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  for (d = 0; d < count; d++) {
+    for (j = 0; j < hi - lo; j++) {
+      buf[d * (hi - lo) + j] = volt[d][1 + j];
+    }
+  }
+
+  if (rank != 0) {
+    MPI_Send(meta, 3, MPI_INT, 0, TAG_SNAPSHOT, MPI_COMM_WORLD);
+    MPI_Send(buf, count * (hi - lo), MPI_DOUBLE, 0, TAG_SNAPSHOT,
+             MPI_COMM_WORLD);
+    free(buf);
+    return 1;
+  }
+
+  fp = snapshotOpen(path, num_dendrs, num_comps, duration, res, spike_times,
+                    num_spikes);
+
+  // Assemble the dendrites of each group from its parts, then write them.
+  for (g = 0; g < num_groups; g++) {
+    for (q = 0; q < split; q++) {
+      if (g > 0 || q > 0) {
+        MPI_Recv(meta, 3, MPI_INT, g * split + q, TAG_SNAPSHOT,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(buf, meta[0] * (meta[2] - meta[1]), MPI_DOUBLE,
+                 g * split + q, TAG_SNAPSHOT, MPI_COMM_WORLD,
+                 MPI_STATUS_IGNORE);
+      }
+      n = meta[2] - meta[1];
+      for (d = 0; d < meta[0]; d++) {
+        for (j = 0; j < n; j++) {
+          rows[d * num_comps + meta[1] - 1 + j] = buf[d * n + j];
+        }
+      }
+    }
+    for (d = 0; fp && d < meta[0]; d++) {
+      snapshotDendrite(fp, first + d, &rows[d * num_comps], num_comps);
+    }
+    first += num_dendrs / num_groups + (g < num_dendrs % num_groups);
+  }
+
+  free(rows);
+  free(buf);
+  return fp && fclose(fp) == 0;
+}
+
 /**
  * Name: main
  *
@@ -52,7 +163,8 @@
 int main(int argc, char **argv) {
   CmdArgs cmd_args;                        // Command line arguments.
   int num_comps, num_dendrs; // Simulation parameters.
-  int i, j, t_ms, step, dendrite;          // Various indexing variables.
+  int split, part, soma_side;  // Compartment-level decomposition.
+  int i, t_ms, step;                       // Various indexing variables.
   struct timeval start, stop, diff;        // Values used to measure time.
   int num_processes, rank;                 // MPI Variables
   int rc;                                  // return code
@@ -61,18 +173,35 @@ int main(int argc, char **argv) {
   // Accumulators used during dendrite simulation.
   // NOTE: We depend on the compiler to handle the use of double[] variables as
   //       double*.
-  double current, **dendr_volt;
+  DendrSet dendrites;   // Whole dendrites of this process (split == 1).
+  DendrSplit segments;  // Compartment ranges of this process (split > 1).
+  MultiRate coupling;   // Dendrite and soma step sizes and their coupling.
+  double dendr_dt, current; // Dendrite step size and current of a step.
+  WaveRelax relax;      // Waveform relaxation state (window > 0).
+  int window;           // Waveform relaxation window, 0 for step by step.
+  double v_start;       // Soma potential at the start of a window.
+  ShmReduce shm;        // Node-local exchange (--shm-reduce).
+  Stimulus stim;        // Tip currents of the dendrites (split == 1).
+  int stim_first;       // Index of this process' first dendrite in `stim'.
+  DendrOverrides overrides; // Per-dendrite parameters.
+  double comm_time = 0.0; // Time rank 0 spends exchanging, s.
+  long exchanges = 0;   // Current exchanges done by rank 0.
+  double t0;
+  double spike_times[COMPTIME]; // When the soma spiked, for --snapshot.
   double res[COMPTIME], y[NUMVAR], y0[NUMVAR], dydt[NUMVAR], soma_params[3];
 
-  // Strings used to store filenames for the graph and data files.
-  char time_str[14];
-  char graph_fname[FNAME_LEN];
-  char data_fname[FNAME_LEN];
-
-  FILE *data_file;  // The output file where we store the soma potential values.
-  FILE *graph_file; // File where graph will be saved.
+  OutputSink sink; // Where the soma potential values are sent (rank 0).
+  SpikeDetector spikes; // Finds action potentials in the soma (rank 0).
+  double t_spike;       // Time of a detected spike.
+  FILE *log_file = NULL;  // Where progress and informational messages go.
+  Telemetry tel;        // Progress published for hhtop.
+  int tel_pid;          // Process id the telemetry block is named after.
+  Recorder rec;         // Every dendrite, written in parallel (--record).
+  long long rec_bytes;  // Bytes recorded by all processes.
+  double rec_time;      // I/O time of the slowest of them, s.
 
   PlotInfo pinfo; // Info passed to the plotting functions.
+  int plot_png, plot_screen; // Which plots were requested for this run.
 
   //////////////////////////////////////////////////////////////////////////////
   // Initalize MPI  (ADDED IN - EDIT HERE)
@@ -97,65 +226,153 @@ int main(int argc, char **argv) {
     // Something was wrong.
     exit(1);
   }
+  somaSetTolerance(cmd_args.ps_tol);
+
+  // Options of seq_hh alone.
+  if (cmd_args.serve || cmd_args.connect || cmd_args.shutdown) {
+    if (rank == 0) {
+      fprintf(stderr, "Only seq_hh can serve, send or stop jobs!\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+  if (cmd_args.num_threads > 1) {
+    if (rank == 0) {
+      fprintf(stderr, "Only seq_hh runs worker threads, start more "
+              "processes instead!\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+  if (cmd_args.autotune) {
+    if (rank == 0) {
+      fprintf(stderr, "Only seq_hh can auto-tune its engine!\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+
+  // A network of neurons has a simulation loop of its own.
+  if (cmd_args.net.neurons > 0 || cmd_args.net.file) {
+    rc = netSimulate(&cmd_args, rank, num_processes, MPI_COMM_WORLD);
+    MPI_Finalize();
+    return rc ? 0 : 1;
+  }
 
   // Pull out the parameters so we don't need to type 'cmd_args.' all the time.
   num_dendrs = cmd_args.num_dendrs;
   num_comps = cmd_args.num_comps;
+  plot_png = ISDEF_PLOT_PNG && cmd_args.plot;
+  plot_screen = ISDEF_PLOT_SCREEN && cmd_args.plot;
+
+  // Processes are grouped 'split' at a time; a group simulates its dendrites
+  // together, each process owning a range of compartments. Part 0 of a group
+  // (the process with the lowest rank) owns the compartments next to the soma
+  // and is the only one that talks to the master.
+  split = cmd_args.split;
+  if (split == 0) {
+    split = dendrSplitChoose(num_processes, num_dendrs, num_comps);
+  }
+  if (num_processes % split != 0 || split > num_comps) {
+    if (rank == 0) {
+      fprintf(stderr, "Cannot split %d compartments over %d of %d "
+              "processes!\n", num_comps, split, num_processes);
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+  if (split > 1 && cmd_args.soma_substeps > 1) {
+    if (rank == 0) {
+      fprintf(stderr, "Split dendrites cannot take soma substeps!\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
 
-  if (rank == 0) {
-    printf("Simulating %d dendrites with %d compartments per dendrite.\n",
-           num_dendrs, num_comps);
+  // Waveform relaxation rewinds whole dendrites at window boundaries, which
+  // must also be block boundaries of the blocked kernel.
+  window = cmd_args.wr_window;
+  if (window > 0 && (split > 1 || cmd_args.soma_substeps > 1 ||
+                     (cmd_args.kernel.kernel == KERNEL_BLOCKED &&
+                      window % cmd_args.kernel.block_steps != 0))) {
+    if (rank == 0) {
+      fprintf(stderr, "Waveform relaxation needs whole dendrites, no soma "
+              "substeps and windows of whole blocks!\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+  if (cmd_args.stimulus && split > 1) {
+    if (rank == 0) {
+      fprintf(stderr, "Split dendrites cannot read a stimulus file!\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+  if (cmd_args.dendr_params && split > 1) {
+    if (rank == 0) {
+      fprintf(stderr, "Split dendrites cannot have their own parameters!\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+  if (cmd_args.record && (split > 1 || cmd_args.kernel.reduce)) {
+    if (rank == 0) {
+      fprintf(stderr, "Recording needs whole, unreduced dendrites!\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+  if (cmd_args.shm_reduce && (split > 1 || window > 0)) {
+    if (rank == 0) {
+      fprintf(stderr, "Shared memory reduction needs whole dendrites and "
+              "no waveform relaxation!\n");
+    }
+    MPI_Finalize();
+    exit(1);
   }
+  part = rank % split;
+  soma_side = part == 0;
 
   //////////////////////////////////////////////////////////////////////////////
-  // Create files where results will be stored.
+  // Open the sink where results will be stored.
   //////////////////////////////////////////////////////////////////////////////
 
+  pinfo.sim_time = cmd_args.duration;
+  pinfo.int_step = 1.0 / (double)STEPS;
+  pinfo.num_comps = num_comps;
+  pinfo.num_dendrs = num_dendrs;
+  pinfo.exec_time = 0.0;
+  pinfo.slaves = num_processes - 1; // master process is not a slave
+
   if (rank == 0) {
-    // Generate the graph and data file names.
-    time_t t = time(NULL);
-    struct tm *tmp = localtime(&t);
-    strftime(time_str, 14, "%m%d%y_%H%M%S", tmp);
-
-    // The resulting filenames will resemble
-    //    pWWdXXcYY_MoDaYe_HoMiSe.xxx
-    // where 'WW' is the number of processes, 'XX' is the number of dendrites,
-    // 'YY' the number of compartments, and 'MoDaYe...' the time at which this
-    // simulation was run.
-    sprintf(graph_fname, "graphs/p%dd%dc%d_%s.png", num_processes, num_dendrs, num_comps,
-            time_str);
-    sprintf(data_fname, "data/p%dd%dc%d_%s.dat", num_processes, num_dendrs, num_comps,
-            time_str);
-
-    // Verify that the graphs/ and data/ directories exist. Create them if they
-    // don't.
-    struct stat stat_buf;
-    stat("graphs", &stat_buf);
-    if ((!S_ISDIR(stat_buf.st_mode)) && (mkdir("graphs", 0700) != 0)) {
-      fprintf(stderr, "Could not create 'graphs' directory!\n");
-      exit(1);
-    }
-
-    stat("data", &stat_buf);
-    if ((!S_ISDIR(stat_buf.st_mode)) && (mkdir("data", 0700) != 0)) {
-      fprintf(stderr, "Could not create 'data' directory!\n");
-      exit(1);
-    }
-
-    // Verify that we can open files where results will be stored.
-    if ((data_file = fopen(data_fname, "wb")) == NULL) {
-      fprintf(stderr, "Can't open %s file!\n", data_fname);
-      exit(1);
-    } else {
-      printf("\nData will be stored in %s\n", data_fname);
+    if (!sinkOpen(&sink, cmd_args.output_type, cmd_args.output_name, &pinfo,
+                  num_processes, cmd_args.events)) {
+      MPI_Abort(MPI_COMM_WORLD, 1);
     }
-
-    if (ISDEF_PLOT_PNG && (graph_file = fopen(graph_fname, "wb")) == NULL) {
-      fprintf(stderr, "Can't open %s file!\n", graph_fname);
-      exit(1);
-    } else {
-      printf("Graph will be stored in %s\n", graph_fname);
-      fclose(graph_file);
+    log_file = sink.log;
+
+    // Plots are made from the data file, so only file sinks can be plotted.
+    plot_png = plot_png && sinkHasFile(&sink);
+    plot_screen = plot_screen && sink.type == SINK_TEXT;
+
+    if (!cmd_args.quiet) {
+      fprintf(log_file,
+              "Simulating %d dendrites with %d compartments per dendrite.\n",
+              num_dendrs, num_comps);
+      if (split > 1) {
+        fprintf(log_file, "Each dendrite is split across %d processes.\n",
+                split);
+      } else if (cmd_args.kernel.reduce) {
+        fprintf(log_file, "Each process' dendrites are reduced to one "
+                "equivalent cable.\n");
+      }
+      if (sink.type != SINK_NULL) {
+        fprintf(log_file, "\nData will be stored in %s\n", sink.data_fname);
+      }
+      if (plot_png) {
+        fprintf(log_file, "Graph will be stored in %s\n", sink.graph_fname);
+      }
     }
   }
 
@@ -165,19 +382,21 @@ int main(int argc, char **argv) {
   int process_dendrites, dendrites_assigned = 0;
   int dendrites_remaining;
   
-  // master process assigns dendrites to slave processes
+  int num_groups = num_processes / split;
+  
+  // master process assigns dendrites to the groups of slave processes
   if (rank == 0) {
-    process_dendrites = num_dendrs / num_processes;
-    dendrites_remaining = num_dendrs % num_processes;
+    process_dendrites = num_dendrs / num_groups;
+    dendrites_remaining = num_dendrs % num_groups;
 
     if (dendrites_remaining){
       process_dendrites++;
     }
     // assign dendrites to slave processes
     for (i = 1; i < num_processes; i++){
-      dendrites_assigned = num_dendrs / num_processes;
+      dendrites_assigned = num_dendrs / num_groups;
       // distribute remaining dendrites
-      if (i < dendrites_remaining){
+      if (i / split < dendrites_remaining){
         dendrites_assigned++;
       }
       MPI_Send(&dendrites_assigned, 1, MPI_INT, i, TAG_ASSIGN_DENDRITE, MPI_COMM_WORLD);
@@ -208,7 +427,19 @@ int main(int argc, char **argv) {
                         // value that our simulation will update at each step.
 
   if (rank == 0) {
-    printf("\nIntegration step dt = %f\n", soma_params[0]);
+    if (!cmd_args.quiet) {
+      fprintf(log_file, "\nIntegration step dt = %f\n", soma_params[0]);
+      if (cmd_args.soma_substeps > 1) {
+        fprintf(log_file, "Dendrite step = %f (%d soma substeps, %s "
+                "current)\n", soma_params[0] * cmd_args.soma_substeps,
+                cmd_args.soma_substeps,
+                cmd_args.hold_current ? "held" : "interpolated");
+      }
+      if (window > 0) {
+        fprintf(log_file, "Waveform relaxation over windows of %d steps, "
+                "tolerance %g mV\n", window, cmd_args.wr_tol);
+      }
+    }
 
     // Start the clock.
     gettimeofday(&start, NULL);
@@ -216,11 +447,96 @@ int main(int argc, char **argv) {
 
 
   // Initialize the potential of each dendrite compartment to the rest voltage.
-  dendr_volt = (double **)malloc(process_dendrites * sizeof(double *));
-  for (i = 0; i < process_dendrites; i++) {
-    dendr_volt[i] = (double *)malloc(num_comps * sizeof(double));
-    for (j = 0; j < num_comps; j++) {
-      dendr_volt[i][j] = VREST;
+  // Pin this process according to its rank on the node. The dendrite state
+  // is allocated by the process itself, so it is first touched locally.
+  MPI_Comm node_comm;
+  int node_rank;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank,
+                      MPI_INFO_NULL, &node_comm);
+  MPI_Comm_rank(node_comm, &node_rank);
+  MPI_Comm_free(&node_comm);
+  if (!placePin(placeCpuFor(&cmd_args.place, node_rank))) {
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  // Every node publishes the progress of its ranks in a telemetry block named
+  // after rank 0's pid. The first rank of the node creates it and the others
+  // map it once it exists.
+  tel.hdr = NULL;
+  if (cmd_args.telemetry) {
+    tel_pid = getpid();
+    MPI_Bcast(&tel_pid, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (node_rank == 0) {
+      telemetryOpen(&tel, cmd_args.telemetry_name, 1, "mpi_hh", tel_pid,
+                    num_dendrs, num_comps - 2, cmd_args.duration,
+                    num_processes);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (node_rank != 0) {
+      telemetryOpen(&tel, cmd_args.telemetry_name, 0, "mpi_hh", tel_pid,
+                    num_dendrs, num_comps - 2, cmd_args.duration,
+                    num_processes);
+    }
+  }
+
+  if (split == 1) {
+    if (!dendrSetInit(&dendrites, 0, process_dendrites, num_comps,
+                      &cmd_args.kernel, &cmd_args.place) ||
+        (window > 0 && !waveRelaxInit(&relax, window, cmd_args.wr_tol,
+                                      WR_MAX_ITERS, &dendrites))) {
+      fprintf(stderr, "Could not allocate dendrites!\n");
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Dendrites are handed out in rank order, the first ones getting one
+    // more. The generator keeps seeding with the index within the process.
+    stim_first = rank * (num_dendrs / num_groups) +
+                 (rank < num_dendrs % num_groups ? rank
+                                                 : num_dendrs % num_groups);
+    if (cmd_args.dendr_params) {
+      if (!dendrOverridesLoad(&overrides, cmd_args.dendr_params) ||
+          !dendrSetParams(&dendrites, &overrides, stim_first)) {
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+      dendrOverridesFree(&overrides);
+    }
+    // Each process records its own dendrites straight into the shared file.
+    if (cmd_args.record &&
+        !recordOpen(&rec, cmd_args.record, num_dendrs, num_comps - 2,
+                    cmd_args.duration, stim_first, process_dendrites,
+                    cmd_args.record_buffer, MPI_COMM_WORLD)) {
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (!cmd_args.stimulus) {
+      stimGenerator(&stim);
+      stim_first = 0;
+    } else if (!stimOpen(&stim, cmd_args.stimulus, num_dendrs,
+                         cmd_args.duration,
+                         cmd_args.stim_window)) {
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    dendrSetStimulus(&dendrites, &stim, stim_first);
+  } else {
+    if ((cmd_args.kernel.kernel != KERNEL_REFERENCE ||
+         cmd_args.kernel.reduce) && rank == 0) {
+      fprintf(stderr, "Split dendrites always use the full reference "
+              "kernel.\n");
+    }
+    if (!dendrSplitInit(&segments, process_dendrites, num_comps, split, part,
+                        rank, MPI_COMM_WORLD)) {
+      fprintf(stderr, "Could not allocate dendrites!\n");
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+  }
+
+  if (cmd_args.shm_reduce) {
+    if (!shmReduceInit(&shm, MPI_COMM_WORLD)) {
+      fprintf(stderr, "Could not allocate the shared memory window!\n");
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (rank == 0 && !cmd_args.quiet) {
+      fprintf(log_file, "Currents are summed in shared memory on %d "
+              "node(s)\n", shm.num_nodes);
     }
   }
 
@@ -228,70 +544,160 @@ int main(int argc, char **argv) {
   // Main computation.
   //////////////////////////////////////////////////////////////////////////////
 
-  double current_buffer = 0.0;
+  spikeInit(&spikes, cmd_args.spike_threshold, SPIKE_REARM, SPIKE_REFRACTORY);
+  multiRateInit(&coupling, cmd_args.soma_substeps, cmd_args.hold_current,
+                y[0]);
+  dendr_dt = soma_params[0] * cmd_args.soma_substeps;
+
+  ReproSum current_sum, current_buffer;
   // Record the initial potential value in our results array. #1
   res[0] = y[0];
+  if (rank == 0) {
+    sinkSample(&sink, 0, y[0]);
+  }
+  if (cmd_args.record &&
+      !recordSample(&rec, dendrites.volt, dendrites.currents)) {
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
 
   // Loop over milliseconds.
-  for (t_ms = 1; t_ms < COMPTIME; t_ms++) {
+  for (t_ms = 1; t_ms < cmd_args.duration; t_ms++) {
+    if (split == 1 && !stimSetTime(&stim, t_ms)) {
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
     // Loop over integration time steps in each millisecond. #2
     for (step = 0; step < STEPS; step++) {
-      soma_params[2] = 0.0;
+      if (window > 0) {
+        // Waveform relaxation advances a whole window at a time, after which
+        // the spikes are looked for along the converged soma waveform.
+        if (step % window == 0) {
+          v_start = y[0];
+          waveRelaxWindow(&relax, &dendrites, step, cmd_args.soma, y,
+                          soma_params, rank, MPI_COMM_WORLD);
+          for (i = 0; rank == 0 && i < window; i++) {
+            if (spikeUpdate(&spikes,
+                            t_ms - 1 + (step + i + 1) * soma_params[0],
+                            soma_params[0],
+                            i == 0 ? v_start : relax.v_new[i-1],
+                            relax.v_new[i], &t_spike)) {
+              sinkSpike(&sink, t_spike);
+              if (spikes.stats.num_spikes <= COMPTIME) {
+                spike_times[spikes.stats.num_spikes - 1] = t_spike;
+              }
+            }
+          }
+        }
+        continue;
+      }
 
       // ********* DENDRITE *********
-      // Loop over all the dendrites. #3 (Start MPI Break up here)
-      for (dendrite = 0; dendrite < process_dendrites; dendrite++) {
-        // This will update Vm in all compartments and will give a new
-        // injected current value from last compartment into the soma.
-        current = dendriteStep(dendr_volt[dendrite], step + dendrite + 1,
-                                num_comps, soma_params[0], y[0]);
-        // Accumulate the current generated by the dendrite.
-        soma_params[2] += current;
-      }
+      // Update all dendrites of this process and accumulate the current they
+      // generate. #3 (Start MPI Break up here)
+      // With multi-rate stepping the dendrites, and so the exchanges with
+      // the master, only run once every few soma steps.
+      if (multiRateDendrStep(&coupling, step)) {
+        // The currents travel as exact sums, so the total does not depend
+        // on how the dendrites are spread over processes.
+        if (split == 1) {
+          dendrSetStep(&dendrites, step / coupling.ratio, dendr_dt,
+                       coupling.v_seen);
+          current_sum = dendrites.sum;
+        } else {
+          dendrSplitStep(&segments, step, dendr_dt, coupling.v_seen);
+          current_sum = segments.sum;
+          if (!soma_side) {
+            // The rest of this group's dendrites is on the soma side, which
+            // does the talking to the master.
+            continue;
+          }
+        }
 
-      if (rank == 0) { // master process
-        for (i = 1; i < num_processes; i++) {
-          // receive current from each slave process
-          MPI_Recv(&current_buffer, 1, MPI_DOUBLE, i, TAG_DENDRITE_CURRENT, MPI_COMM_WORLD, &mpi_status);
-          // accumulate current from each slave process
-          soma_params[2] += current_buffer;
+        t0 = MPI_Wtime();
+        if (cmd_args.shm_reduce) {
+          current = shmReduceCurrent(&shm, &current_sum);
+        } else if (rank == 0) { // master process
+          for (i = split; i < num_processes; i += split) {
+            // receive current from each slave process
+            MPI_Recv(&current_buffer, 1, reproSumType(), i, TAG_DENDRITE_CURRENT, MPI_COMM_WORLD, &mpi_status);
+            // accumulate current from each slave process
+            reproSumMerge(&current_sum, &current_buffer);
+          }
+          current = reproSumValue(&current_sum);
+        } else { // slave processes
+          // send current to master process
+          MPI_Send(&current_sum, 1, reproSumType(), 0, TAG_DENDRITE_CURRENT, MPI_COMM_WORLD);
+          current = reproSumValue(&current_sum);
         }
-      } else { // slave processes
-        // send current to master process
-        MPI_Send(&soma_params[2], 1, MPI_DOUBLE, 0, TAG_DENDRITE_CURRENT, MPI_COMM_WORLD);
+        comm_time += MPI_Wtime() - t0;
+        exchanges++;
+        multiRateSetCurrent(&coupling, current);
       }
 
-      // Store previous HH model parameters.
-      y0[0] = y[0];
-      y0[1] = y[1];
-      y0[2] = y[2];
-      y0[3] = y[3];
-
       // This is the main HH computation. It updates the potential, Vm, of the
       // soma, injects current, and calculates action potential. Good stuff.
-      // calculated only by master process
+      // calculated only by master process; previous values are left in y0
       if (rank == 0){
-        soma(dydt, y, soma_params);
-        rk4Step(y, y0, dydt, NUMVAR, soma_params, 1, soma);
+        soma_params[2] = multiRateCurrent(&coupling, step);
+        somaStep(cmd_args.soma, y, y0, dydt, soma_params);
+
+        // Look for an action potential during this step.
+        if (spikeUpdate(&spikes, t_ms - 1 + (step + 1) * soma_params[0],
+                        soma_params[0], y0[0], y[0], &t_spike)) {
+          sinkSpike(&sink, t_spike);
+          if (spikes.stats.num_spikes <= COMPTIME) {
+            spike_times[spikes.stats.num_spikes - 1] = t_spike;
+          }
+        }
 
-        // Send updated soma potential value to slave processes
-        for (i = 1; i < num_processes; i++) {
-          MPI_Send(&y[0], 1, MPI_DOUBLE, i, TAG_SOMA_POTENTIAL, MPI_COMM_WORLD);
+        // Send the soma potential the dendrites see to slave processes
+        if (multiRateSomaDone(&coupling, step, y[0])) {
+          t0 = MPI_Wtime();
+          if (cmd_args.shm_reduce) {
+            shmBcastPotential(&shm, coupling.v_seen);
+          } else {
+            for (i = split; i < num_processes; i += split) {
+              MPI_Send(&coupling.v_seen, 1, MPI_DOUBLE, i, TAG_SOMA_POTENTIAL, MPI_COMM_WORLD);
+            }
+          }
+          comm_time += MPI_Wtime() - t0;
+        }
+      } else if ((step + 1) % coupling.ratio == 0) { // slave processes
+        // receive the soma potential value from master process
+        t0 = MPI_Wtime();
+        if (cmd_args.shm_reduce) {
+          coupling.v_seen = shmBcastPotential(&shm, 0.0);
+        } else {
+          MPI_Recv(&coupling.v_seen, 1, MPI_DOUBLE, 0, TAG_SOMA_POTENTIAL, MPI_COMM_WORLD, &mpi_status);
         }
-      } else { // slave processes
-        // receive updated soma potential value from master process
-        MPI_Recv(&y[0], 1, MPI_DOUBLE, 0, TAG_SOMA_POTENTIAL, MPI_COMM_WORLD, &mpi_status);
+        comm_time += MPI_Wtime() - t0;
       }
     }
       
     if (rank == 0) {
       // Record the membrane potential of the soma at this simulation step.
       // Let's show where we are in terms of computation.
-      printf("\r%02d ms", t_ms);
-      fflush(stdout);
+      if (!cmd_args.quiet) {
+        fprintf(log_file, "\r%02d ms", t_ms);
+        fflush(log_file);
+      }
       res[t_ms] = y[0];
+      sinkSample(&sink, t_ms, y[0]);
+    }
+    if (cmd_args.record &&
+        !recordSample(&rec, dendrites.volt, dendrites.currents)) {
+      MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    telemetryUpdate(&tel, rank, t_ms, (long)t_ms * STEPS, -1.0, comm_time);
+  }
+  if (cmd_args.telemetry) {
+    // The run is only finished once every rank of the node is.
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+  telemetryClose(&tel);
+  if (cmd_args.record &&
+      !recordClose(&rec, &rec_bytes, &rec_time)) {
+    MPI_Abort(MPI_COMM_WORLD, 1);
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -303,43 +709,67 @@ int main(int argc, char **argv) {
     gettimeofday(&stop, NULL);
     timersub(&stop, &start, &diff);
     exec_time = (double)(diff.tv_sec) + (double)(diff.tv_usec) * 0.000001;
-    printf("\n\nExecution time: %f seconds.\n", exec_time);
-
-    // Record the parameters for this simulation as well as data for gnuplot.
-    fprintf(data_file,
-            "# Vm for HH model. "
-            "Simulation time: %d ms, Integration step: %f ms, "
-            "Compartments: %d, Dendrites: %d, Execution time: %f s, "
-            "Slave processes: %d\n",
-            COMPTIME, soma_params[0], num_comps - 2, num_dendrs, exec_time,
-            num_processes - 1);
-    fprintf(data_file, "# X Y\n");
-
-    for (t_ms = 0; t_ms < COMPTIME; t_ms++) {
-      fprintf(data_file, "%d %f\n", t_ms, res[t_ms]);
+    fprintf(log_file, "%sExecution time: %f seconds.\n",
+            cmd_args.quiet ? "" : "\n\n", exec_time);
+    if (!cmd_args.quiet) {
+      fprintf(log_file, "Spikes detected: %d\n", spikes.stats.num_spikes);
+    }
+    if (!cmd_args.quiet && exchanges > 0) {
+      fprintf(log_file, "Exchange time on rank 0: %.3f s, %.3f us per "
+              "step\n", comm_time, comm_time * 1e6 / exchanges);
+    }
+    if (!cmd_args.quiet && cmd_args.record) {
+      fprintf(log_file, "Recorded %.1f MB to %s in %.3f s: %.3f GB/s\n",
+              rec_bytes / 1e6, cmd_args.record, rec_time,
+              rec_time > 0 ? rec_bytes / rec_time / 1e9 : 0.0);
+    }
+    if (!cmd_args.quiet && window > 0) {
+      fprintf(log_file, "Waveform relaxation: %ld windows, %.2f iterations "
+              "per window, %ld did not converge\n", relax.windows,
+              (double)relax.iterations / relax.windows, relax.unconverged);
+      fprintf(log_file, "Synchronizations: %ld collectives (step by step: "
+              "%ld exchanges)\n", relax.syncs,
+              2L * STEPS * (cmd_args.duration - 1));
     }
 
-    fflush(data_file); // Flush and close the data file so that gnuplot will
-    fclose(data_file); // see it.
+    // Flush and close the sink so that the data file is complete before it
+    // is plotted.
+    if (!sinkClose(&sink, exec_time)) {
+      fprintf(stderr, "Could not write results to %s!\n", sink.data_fname);
+    }
 
     //////////////////////////////////////////////////////////////////////////////
     // Plot results if approriate macro was defined
     //////////////////////////////////////////////////////////////////////////////
-    if (ISDEF_PLOT_PNG || ISDEF_PLOT_SCREEN) {
-      pinfo.sim_time = COMPTIME;
-      pinfo.int_step = soma_params[0];
-      pinfo.num_comps = num_comps - 2; // -2 for soma and axon
-      pinfo.num_dendrs = num_dendrs;
-      pinfo.exec_time = exec_time;
-      pinfo.slaves = num_processes -1; // master process is not a slave
+    pinfo.exec_time = exec_time;
+
+    if (plot_png) {
+      plotTrace(&pinfo, res, cmd_args.duration, sink.graph_fname);
+    }
+
+    if (plot_screen) {
+      plotData(&pinfo, sink.data_fname, NULL);
     }
+  }
 
-    if (ISDEF_PLOT_PNG) {
-      plotData(&pinfo, data_fname, graph_fname);
+  // Every process takes part in collecting the final dendrite state. A
+  // reduced set has no dendrites of its own to send.
+  if (cmd_args.snapshot) {
+    if (split == 1) {
+      rc = writeSnapshot(cmd_args.snapshot, rank, num_processes, split,
+                         num_dendrs, num_comps - 2, cmd_args.duration, res,
+                         spike_times, spikes.stats.num_spikes, dendrites.volt,
+                         cmd_args.kernel.reduce ? 0 : dendrites.num_dendrs,
+                         1, num_comps - 1);
+    } else {
+      rc = writeSnapshot(cmd_args.snapshot, rank, num_processes, split,
+                         num_dendrs, num_comps - 2, cmd_args.duration, res,
+                         spike_times, spikes.stats.num_spikes, segments.volt,
+                         segments.num_dendrs, segments.lo, segments.hi);
     }
-    
-    if (ISDEF_PLOT_SCREEN) {
-      plotData(&pinfo, data_fname, NULL);
+    if (!rc) {
+      fprintf(stderr, "Could not write the snapshot to %s!\n",
+              cmd_args.snapshot);
     }
   }
 
@@ -347,10 +777,18 @@ int main(int argc, char **argv) {
   // Free up allocated memory.
   //////////////////////////////////////////////////////////////////////////////
 
-  for (i = 0; i < process_dendrites; i++) {
-    free(dendr_volt[i]);
+  if (window > 0) {
+    waveRelaxFree(&relax);
+  }
+  if (cmd_args.shm_reduce) {
+    shmReduceFree(&shm);
+  }
+  if (split == 1) {
+    dendrSetFree(&dendrites);
+    stimClose(&stim);
+  } else {
+    dendrSplitFree(&segments);
   }
-  free(dendr_volt);
 
   // CLOSE MPI
   MPI_Finalize();
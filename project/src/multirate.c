@@ -0,0 +1,54 @@
+#include "multirate.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void multiRateInit( MultiRate *mr, int ratio, int hold, double v_m )
+{
+  mr->ratio = ratio;
+  mr->hold = hold;
+  mr->i_prev = 0.0;
+  mr->i_curr = 0.0;
+  mr->v_sum = 0.0;
+  mr->v_seen = v_m;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int multiRateDendrStep( MultiRate *mr, int step )
+{
+  return step % mr->ratio == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void multiRateSetCurrent( MultiRate *mr, double current )
+{
+  mr->i_prev = mr->i_curr;
+  mr->i_curr = current;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double multiRateCurrent( MultiRate *mr, int step )
+{
+  int sub = step % mr->ratio + 1;
+
+  // The last substep takes the newest current as is, so ratio 1 is exact.
+  if (mr->hold || sub == mr->ratio) {
+    return mr->i_curr;
+  }
+  return mr->i_prev + (mr->i_curr - mr->i_prev) * sub / mr->ratio;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int multiRateSomaDone( MultiRate *mr, int step, double v_m )
+{
+  mr->v_sum += v_m;
+  if ((step + 1) % mr->ratio != 0) {
+    return 0;
+  }
+  mr->v_seen = mr->v_sum / mr->ratio;
+  mr->v_sum = 0.0;
+  return 1;
+}
@@ -0,0 +1,356 @@
+#include "net_sim.h"
+#include "network.h"
+#include "event_ring.h"
+#include "soma_step.h"
+#include "stimulus.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Spikes on their way between the processes.
+ */
+typedef struct SpikeExchange {
+  NetSpike *local;    // Spikes of this process since the last exchange.
+  int num_local;      // Spikes in `local'.
+  int local_size;     // Room in `local'.
+  NetSpike *all;      // Spikes of every process at the last exchange.
+  int all_size;       // Room in `all'.
+  int *counts;        // Bytes sent by each process.
+  int *displs;        // Where they go in `all', bytes.
+  long total;         // Spikes exchanged so far.
+  long exchanges;     // Exchanges done.
+  double comm_time;   // Time spent in them, s.
+} SpikeExchange;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int compareSpikes( const void *a, const void *b )
+{
+  const NetSpike *x = (const NetSpike*) a, *y = (const NetSpike*) b;
+
+  if (x->step != y->step) {
+    return x->step < y->step ? -1 : 1;
+  }
+  return x->neuron < y->neuron ? -1 : x->neuron > y->neuron;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int growSpikes( NetSpike **list, int *size, int needed )
+{
+  NetSpike *grown;
+  int new_size = *size ? *size : 64;
+
+  if (needed <= *size) {
+    return 1;
+  }
+  while (new_size < needed) {
+    new_size *= 2;
+  }
+  grown = (NetSpike*) realloc( *list, new_size * sizeof(NetSpike) );
+  if (!grown) {
+    return 0;
+  }
+  *list = grown;
+  *size = new_size;
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int exchangeSpikes( SpikeExchange *ex, const Network *net,
+                           Neuron *neurons, int num_procs, EventRing *ring,
+                           FILE *raster, MPI_Comm comm )
+{
+  int bytes = ex->num_local * (int) sizeof(NetSpike);
+  int i, k, p, total = 0;
+  const NetSpike *spike;
+  const Synapse *syn;
+  Neuron *target;
+  double t0;
+
+  t0 = MPI_Wtime();
+  MPI_Allgather( &bytes, 1, MPI_INT, ex->counts, 1, MPI_INT, comm );
+  for (p = 0; p < num_procs; p++) {
+    ex->displs[p] = total;
+    total += ex->counts[p];
+  }
+  total /= (int) sizeof(NetSpike);
+  if (!growSpikes( &ex->all, &ex->all_size, total )) {
+    return 0;
+  }
+  MPI_Allgatherv( ex->local, bytes, MPI_BYTE, ex->all, ex->counts,
+                  ex->displs, MPI_BYTE, comm );
+  ex->comm_time += MPI_Wtime() - t0;
+  ex->exchanges++;
+  ex->total += total;
+  ex->num_local = 0;
+
+  // The order events reach a compartment in must not depend on which
+  // process found which spike.
+  qsort( ex->all, total, sizeof(NetSpike), compareSpikes );
+  for (i = 0; i < total; i++) {
+    spike = &ex->all[i];
+    for (k = net->first[ spike->neuron ];
+         k < net->first[ spike->neuron + 1 ]; k++) {
+      syn = &net->syn[k];
+      target = &neurons[ syn->target / num_procs ];  // Dealt round robin.
+      if (!eventRingPush( ring, spike->step + syn->delay,
+                          &target->dendrites.volt[ syn->dendrite ][
+                            1 + syn->comp ], syn->weight )) {
+        return 0;
+      }
+    }
+    if (raster) {
+      fprintf( raster, "%d %.17g\n", spike->neuron, spike->time );
+    }
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int checkOptions( CmdArgs *cmd_args, int rank )
+{
+  if (cmd_args->split > 1 || cmd_args->soma_substeps > 1 ||
+      cmd_args->wr_window > 0 || cmd_args->shm_reduce ||
+      cmd_args->kernel.reduce || cmd_args->snapshot) {
+    if (rank == 0) {
+      fprintf( stderr, "A network needs whole dendrites and no soma "
+               "substeps, waveform relaxation, shared memory reduction, "
+               "reduced dendrites or snapshots!\n" );
+    }
+    return 0;
+  }
+
+  // Synaptic events change the potentials between steps, which a block of
+  // the blocked kernel would not see.
+  if (cmd_args->kernel.kernel == KERNEL_BLOCKED) {
+    if (rank == 0) {
+      fprintf( stderr, "Networks can't use the blocked kernel!\n" );
+      fprintf( stderr, "Kernel default to reference!\n" );
+    }
+    cmd_args->kernel.kernel = KERNEL_REFERENCE;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int initNeurons( Neuron *neurons, int num_local, CmdArgs *cmd_args,
+                        int rank, int num_procs, Stimulus *stim )
+{
+  int const num_dendrs = cmd_args->num_dendrs;
+  DendrOverrides overrides;
+  Neuron *n;
+  int i;
+
+  overrides.count = 0;
+  overrides.list = NULL;
+  if (cmd_args->dendr_params &&
+      !dendrOverridesLoad( &overrides, cmd_args->dendr_params )) {
+    return 0;
+  }
+
+  for (i = 0; i < num_local; i++) {
+    n = &neurons[i];
+    n->index = rank + i * num_procs;
+    if (!dendrSetInit( &n->dendrites, 0, num_dendrs,
+                       cmd_args->num_comps + 2, &cmd_args->kernel,
+                       &cmd_args->place ) ||
+        (cmd_args->dendr_params &&
+         !dendrSetParams( &n->dendrites, &overrides, 0 ))) {
+      fprintf( stderr, "Could not allocate neuron %d!\n", n->index );
+      dendrOverridesFree( &overrides );
+      return 0;
+    }
+
+    // Every neuron has dendrites of its own in the stimulus, and so seeds
+    // of its own with the generator.
+    dendrSetStimulus( &n->dendrites, stim, n->index * num_dendrs );
+
+    n->y[0] = VREST;
+    n->y[1] = 0.037;
+    n->y[2] = 0.0148;
+    n->y[3] = 0.9959;
+    spikeInit( &n->spikes, cmd_args->spike_threshold, SPIKE_REARM,
+               SPIKE_REFRACTORY );
+  }
+  dendrOverridesFree( &overrides );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int netSimulate( CmdArgs *cmd_args, int rank, int num_procs, MPI_Comm comm )
+{
+  NetOpts *const opts = &cmd_args->net;
+  int const quiet = cmd_args->quiet;
+  int num_local = 0, batch, t_ms, step, s = 0, i, ok = 1;
+  long delivered = 0, total_delivered;
+  double soma_params[3], t_spike, start, exec_time, comm_max;
+  FILE *raster = NULL;
+  SpikeExchange ex;
+  NetSpike *spike;
+  EventRing ring;
+  Neuron *neurons = NULL, *n;
+  Stimulus stim;
+  Network net;
+
+  if (!checkOptions( cmd_args, rank ) ||
+      !netBuild( &net, opts, cmd_args->num_dendrs, cmd_args->num_comps,
+                 rank, num_procs )) {
+    return 0;
+  }
+
+  // Spikes found during a batch are due after it, however short the delay.
+  batch = opts->batch > 0 ? opts->batch : net.min_delay;
+  if (batch > net.min_delay) {
+    if (rank == 0) {
+      fprintf( stderr, "Spikes must be exchanged at least every %d steps, "
+               "the shortest delay!\n", net.min_delay );
+    }
+    netFree( &net );
+    return 0;
+  }
+
+  if (!cmd_args->stimulus) {
+    stimGenerator( &stim );
+  } else if (!stimOpen( &stim, cmd_args->stimulus,
+                        net.num_neurons * cmd_args->num_dendrs,
+                        cmd_args->duration, cmd_args->stim_window )) {
+    netFree( &net );
+    return 0;
+  }
+
+  for (i = rank; i < net.num_neurons; i += num_procs) {
+    num_local++;
+  }
+  memset( &ex, 0, sizeof(ex) );
+  neurons = (Neuron*) calloc( num_local + 1, sizeof(Neuron) );
+  ex.counts = (int*) malloc( num_procs * sizeof(int) );
+  ex.displs = (int*) malloc( num_procs * sizeof(int) );
+  if (!neurons || !ex.counts || !ex.displs ||
+      !eventRingInit( &ring, net.max_delay ) ||
+      !initNeurons( neurons, num_local, cmd_args, rank, num_procs, &stim )) {
+    fprintf( stderr, "Could not set up the network on rank %d!\n", rank );
+    MPI_Abort( comm, 1 );
+  }
+
+  if (rank == 0 && opts->raster) {
+    raster = fopen( opts->raster, "w" );
+    if (!raster) {
+      fprintf( stderr, "Can't create raster file %s!\n", opts->raster );
+    } else {
+      fprintf( raster, "# Spikes of a network of %d neurons. Dendrites: %d, "
+               "Compartments: %d, Simulation time: %d ms\n",
+               net.num_neurons, cmd_args->num_dendrs, cmd_args->num_comps,
+               cmd_args->duration );
+    }
+  }
+
+  if (rank == 0 && !quiet) {
+    printf( "Simulating a network of %d neurons with %d dendrites of %d "
+            "compartments each on %d process(es).\n", net.num_neurons,
+            cmd_args->num_dendrs, cmd_args->num_comps, num_procs );
+    printf( "Synapses: %d, delays %g to %g ms\n", net.total_synapses,
+            (double) net.min_delay / STEPS, (double) net.max_delay / STEPS );
+    printf( "Spikes are exchanged every %d steps (%g ms)\n\n", batch,
+            (double) batch / STEPS );
+  }
+
+  soma_params[0] = 1.0 / (double) STEPS;
+  soma_params[1] = 0.0;
+  MPI_Barrier( comm );
+  start = MPI_Wtime();
+
+  for (t_ms = 1; ok && t_ms < cmd_args->duration; t_ms++) {
+    if (!stimSetTime( &stim, t_ms )) {
+      MPI_Abort( comm, 1 );
+    }
+
+    for (step = 0; ok && step < STEPS; step++, s++) {
+      delivered += eventRingDeliver( &ring, s );
+
+      for (i = 0; i < num_local; i++) {
+        n = &neurons[i];
+        soma_params[2] = dendrSetStep( &n->dendrites, step, soma_params[0],
+                                       n->y[0] );
+        somaStep( cmd_args->soma, n->y, n->y0, n->dydt, soma_params );
+
+        if (spikeUpdate( &n->spikes, t_ms - 1 + (step + 1) * soma_params[0],
+                         soma_params[0], n->y0[0], n->y[0], &t_spike )) {
+          if (!growSpikes( &ex.local, &ex.local_size, ex.num_local + 1 )) {
+            ok = 0;
+            break;
+          }
+          spike = &ex.local[ ex.num_local++ ];
+          spike->neuron = n->index;
+          spike->step = s;
+          spike->time = t_spike;
+        }
+      }
+
+      if (ok && (s + 1) % batch == 0) {
+        ok = exchangeSpikes( &ex, &net, neurons, num_procs, &ring, raster,
+                             comm );
+      }
+    }
+
+    if (rank == 0 && !quiet) {
+      printf( "\r%02d ms", t_ms );
+      fflush( stdout );
+    }
+  }
+
+  // The spikes of a last, partial batch have nobody left to reach, but they
+  // belong in the raster and the counts.
+  if (ok && s % batch != 0) {
+    ok = exchangeSpikes( &ex, &net, neurons, num_procs, &ring, raster, comm );
+  }
+  if (!ok) {
+    fprintf( stderr, "Could not queue the spikes on rank %d!\n", rank );
+    MPI_Abort( comm, 1 );
+  }
+
+  exec_time = MPI_Wtime() - start;
+  MPI_Reduce( &delivered, &total_delivered, 1, MPI_LONG, MPI_SUM, 0, comm );
+  MPI_Reduce( &ex.comm_time, &comm_max, 1, MPI_DOUBLE, MPI_MAX, 0, comm );
+
+  if (rank == 0) {
+    printf( "%sExecution time: %f seconds.\n", quiet ? "" : "\n\n",
+            exec_time );
+    if (!quiet) {
+      printf( "Spikes: %ld, %.2f Hz per neuron\n", ex.total,
+              ex.total * 1000.0 / net.num_neurons /
+              (cmd_args->duration - 1) );
+      printf( "Synaptic events delivered: %ld\n", total_delivered );
+      printf( "Spike exchanges: %ld (%ld with one per step)\n",
+              ex.exchanges, (long) s );
+      printf( "Exchange time on the slowest rank: %.3f s, %.3f us per "
+              "exchange\n", comm_max,
+              ex.exchanges > 0 ? comm_max * 1e6 / ex.exchanges : 0.0 );
+    }
+    if (raster) {
+      fclose( raster );
+      if (!quiet) {
+        printf( "Spikes were written to %s\n", opts->raster );
+      }
+    }
+  }
+
+  for (i = 0; i < num_local; i++) {
+    dendrSetFree( &neurons[i].dendrites );
+  }
+  free( neurons );
+  free( ex.local );
+  free( ex.all );
+  free( ex.counts );
+  free( ex.displs );
+  eventRingFree( &ring );
+  stimClose( &stim );
+  netFree( &net );
+  return 1;
+}
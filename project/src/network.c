@@ -0,0 +1,237 @@
+#include "network.h"
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void netDefaults( NetOpts *opts )
+{
+  opts->neurons = 0;
+  opts->file = NULL;
+  opts->fan_in = NET_FAN_IN;
+  opts->weight = NET_WEIGHT;
+  opts->min_delay = NET_MIN_DELAY;
+  opts->max_delay = NET_MAX_DELAY;
+  opts->seed = NET_SEED;
+  opts->batch = 0;
+  opts->raster = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int netOwner( int neuron, int num_procs )
+{
+  return neuron % num_procs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static unsigned nextRandom( unsigned *state )
+{
+  // xorshift32: rand() would make the network depend on the C library and
+  // on whoever else draws from it.
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int delaySteps( double delay_ms )
+{
+  return (int) floor( delay_ms * STEPS + 0.5 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int addSynapse( Synapse **list, int *count, int *size,
+                       const Synapse *syn )
+{
+  Synapse *grown;
+
+  if (*count == *size) {
+    *size = *size ? 2 * *size : 256;
+    grown = (Synapse*) realloc( *list, *size * sizeof(Synapse) );
+    if (!grown) {
+      return 0;
+    }
+    *list = grown;
+  }
+  (*list)[ (*count)++ ] = *syn;
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int readSynapses( const char *path, int num_dendrs, int num_comps,
+                         Synapse **list, int *count, int *num_neurons )
+{
+  char line[ 256 ], *hash;
+  int line_no = 0, size = 0, max_neuron = -1;
+  double delay_ms;
+  Synapse syn;
+  FILE *fp;
+
+  fp = fopen( path, "r" );
+  if (!fp) {
+    fprintf( stderr, "Can't open network file %s!\n", path );
+    return 0;
+  }
+
+  while (fgets( line, sizeof(line), fp )) {
+    line_no++;
+    if ((hash = strchr( line, '#' ))) {
+      *hash = '\0';
+    }
+    if (strspn( line, " \t\r\n" ) == strlen( line )) {
+      continue;
+    }
+
+    if (sscanf( line, "%d %d %d %d %lf %lf", &syn.source, &syn.target,
+                &syn.dendrite, &syn.comp, &syn.weight, &delay_ms ) != 6 ||
+        syn.source < 0 || syn.target < 0 ||
+        (*num_neurons > 0 && (syn.source >= *num_neurons ||
+                              syn.target >= *num_neurons)) ||
+        syn.dendrite < 0 || syn.dendrite >= num_dendrs ||
+        syn.comp < 0 || syn.comp >= num_comps ||
+        (syn.delay = delaySteps( delay_ms )) < 1) {
+      fprintf( stderr, "%s:%d: expected `SOURCE TARGET DENDRITE COMPARTMENT "
+               "WEIGHT_MV DELAY_MS', with existing neurons, dendrites and "
+               "compartments and a delay of at least one step!\n", path,
+               line_no );
+      fclose( fp );
+      return 0;
+    }
+    if (!addSynapse( list, count, &size, &syn )) {
+      fclose( fp );
+      return 0;
+    }
+    max_neuron = syn.source > max_neuron ? syn.source : max_neuron;
+    max_neuron = syn.target > max_neuron ? syn.target : max_neuron;
+  }
+  fclose( fp );
+
+  // Without --neurons, the network is as large as the file says.
+  if (*num_neurons <= 0) {
+    *num_neurons = max_neuron + 1;
+  }
+  if (*num_neurons <= 0) {
+    fprintf( stderr, "%s has no synapses!\n", path );
+    return 0;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int drawSynapses( const NetOpts *opts, int num_dendrs, int num_comps,
+                         Synapse **list, int *count )
+{
+  unsigned state = opts->seed ? opts->seed : 1;
+  int min_delay = delaySteps( opts->min_delay );
+  int max_delay = delaySteps( opts->max_delay );
+  int size = 0, target, k;
+  Synapse syn;
+
+  for (target = 0; target < opts->neurons; target++) {
+    for (k = 0; k < opts->fan_in && opts->neurons > 1; k++) {
+      // Any neuron but the target itself.
+      syn.source = nextRandom( &state ) % (opts->neurons - 1);
+      syn.source += syn.source >= target;
+      syn.target = target;
+      syn.dendrite = nextRandom( &state ) % num_dendrs;
+      syn.comp = nextRandom( &state ) % num_comps;
+      syn.weight = opts->weight;
+      syn.delay = min_delay +
+                  nextRandom( &state ) % (max_delay - min_delay + 1);
+      if (!addSynapse( list, count, &size, &syn )) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int netBuild( Network *net, const NetOpts *opts, int num_dendrs,
+              int num_comps, int rank, int num_procs )
+{
+  Synapse *all = NULL;
+  int count = 0, i, n, ok;
+
+  memset( net, 0, sizeof(*net) );
+  net->num_neurons = opts->neurons;
+
+  if (opts->file) {
+    ok = readSynapses( opts->file, num_dendrs, num_comps, &all, &count,
+                       &net->num_neurons );
+  } else if (delaySteps( opts->min_delay ) < 1 ||
+             opts->max_delay < opts->min_delay) {
+    fprintf( stderr, "Delays must be at least one step and the longest no "
+             "shorter than the shortest!\n" );
+    ok = 0;
+  } else {
+    ok = drawSynapses( opts, num_dendrs, num_comps, &all, &count );
+  }
+  net->first = (int*) calloc( net->num_neurons + 1, sizeof(int) );
+  if (!ok || !net->first) {
+    free( all );
+    netFree( net );
+    return 0;
+  }
+
+  // The batches of spikes are as long as the shortest delay anywhere.
+  net->total_synapses = count;
+  net->min_delay = count ? all[0].delay : 1;
+  for (i = 0; i < count; i++) {
+    net->min_delay = all[i].delay < net->min_delay ? all[i].delay
+                                                   : net->min_delay;
+    net->max_delay = all[i].delay > net->max_delay ? all[i].delay
+                                                   : net->max_delay;
+    if (netOwner( all[i].target, num_procs ) == rank) {
+      net->first[ all[i].source + 1 ]++;
+      net->num_synapses++;
+    }
+  }
+  net->max_delay = net->max_delay > net->min_delay ? net->max_delay
+                                                   : net->min_delay;
+
+  // Group the synapses kept by source, keeping their order otherwise.
+  for (n = 0; n < net->num_neurons; n++) {
+    net->first[ n + 1 ] += net->first[n];
+  }
+  net->syn = (Synapse*) malloc( (net->num_synapses + 1) * sizeof(Synapse) );
+  if (!net->syn) {
+    free( all );
+    netFree( net );
+    return 0;
+  }
+  for (i = 0; i < count; i++) {
+    if (netOwner( all[i].target, num_procs ) == rank) {
+      net->syn[ net->first[ all[i].source ]++ ] = all[i];
+    }
+  }
+  for (n = net->num_neurons; n > 0; n--) {
+    net->first[n] = net->first[ n - 1 ];
+  }
+  net->first[0] = 0;
+
+  free( all );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void netFree( Network *net )
+{
+  free( net->syn );
+  free( net->first );
+  net->syn = NULL;
+  net->first = NULL;
+}
@@ -0,0 +1,323 @@
+#define _GNU_SOURCE
+#include "placement.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define HUGE_PAGE_SIZE (2UL << 20)  // x86-64/aarch64 default huge page.
+
+// mbind() policy, as in <numaif.h>, which is part of libnuma.
+#define MPOL_PREFERRED 1
+
+// Huge page mode names, indexed by HugePages.
+static const char *huge_names[] = { "off", "thp", "explicit" };
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int allowedCpus( int *cpus, int max )
+{
+  // CPUs this process may run on, in increasing order.
+  cpu_set_t set;
+  int cpu, n = 0;
+
+  if (sched_getaffinity( 0, sizeof(set), &set ) != 0) {
+    return 0;
+  }
+  for (cpu = 0; cpu < CPU_SETSIZE && n < max; cpu++) {
+    if (CPU_ISSET( cpu, &set )) {
+      cpus[n++] = cpu;
+    }
+  }
+  return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int cpuPackage( int cpu )
+{
+  char fname[ 96 ];
+  FILE *fp;
+  int package = 0;
+
+  snprintf( fname, sizeof(fname),
+            "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu );
+  fp = fopen( fname, "r" );
+  if (fp) {
+    if (fscanf( fp, "%d", &package ) != 1) {
+      package = 0;
+    }
+    fclose( fp );
+  }
+  return package;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void placeDefaults( PlaceOpts *opts )
+{
+  opts->pin = PIN_NONE;
+  opts->num_cpus = 0;
+  opts->huge = HUGE_OFF;
+  opts->first_touch = 1;
+  opts->mbind = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int placeParsePin( const char *spec, PlaceOpts *opts )
+{
+  const char *p = spec;
+  char *end;
+  long first, last, cpu;
+
+  if (strcmp( spec, "none" ) == 0) {
+    opts->pin = PIN_NONE;
+    return 1;
+  }
+  if (strcmp( spec, "compact" ) == 0) {
+    opts->pin = PIN_COMPACT;
+    return 1;
+  }
+  if (strcmp( spec, "scatter" ) == 0) {
+    opts->pin = PIN_SCATTER;
+    return 1;
+  }
+
+  // A list of CPUs and ranges.
+  opts->num_cpus = 0;
+  while (*p) {
+    first = strtol( p, &end, 10 );
+    if (end == p || first < 0) {
+      return 0;
+    }
+    last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol( p + 1, &end, 10 );
+      if (end == p + 1 || last < first) {
+        return 0;
+      }
+      p = end;
+    }
+    for (cpu = first; cpu <= last; cpu++) {
+      if (opts->num_cpus == PLACE_MAX_CPUS) {
+        return 0;
+      }
+      opts->cpus[ opts->num_cpus++ ] = (int) cpu;
+    }
+    if (*p == ',') {
+      p++;
+    } else if (*p) {
+      return 0;
+    }
+  }
+
+  opts->pin = PIN_LIST;
+  return opts->num_cpus > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int placeParseHuge( const char *name, HugePages *huge )
+{
+  int i;
+
+  for (i = 0; i < (int) (sizeof(huge_names) / sizeof(huge_names[0])); i++) {
+    if (strcmp( name, huge_names[i] ) == 0) {
+      *huge = (HugePages) i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void placeDescribe( PlaceOpts *opts, char *buf, size_t size )
+{
+  static const char *pin_names[] = { "none", "compact", "scatter", "list" };
+
+  snprintf( buf, size, "pin=%s, %s, huge pages=%s%s", pin_names[ opts->pin ],
+            opts->first_touch ? "first touch" : "allocated by main thread",
+            huge_names[ opts->huge ], opts->mbind ? ", mbind" : "" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void placeCpuModel( char *buf, size_t size )
+{
+  // "model name" from /proc/cpuinfo, or "unknown".
+  char line[ 512 ], *p, *end;
+  FILE *fp;
+
+  snprintf( buf, size, "unknown" );
+  fp = fopen( "/proc/cpuinfo", "r" );
+  if (!fp) {
+    return;
+  }
+  while (fgets( line, sizeof(line), fp )) {
+    if (strncmp( line, "model name", 10 ) == 0 && (p = strchr( line, ':' ))) {
+      p++;
+      while (*p == ' ' || *p == '\t') {
+        p++;
+      }
+      end = p + strlen( p );
+      while (end > p && (end[-1] == '\n' || end[-1] == ' ')) {
+        *--end = '\0';
+      }
+      // '|' separates the fields of the tuning and history files.
+      for (end = p; *end; end++) {
+        if (*end == '|') {
+          *end = '/';
+        }
+      }
+      snprintf( buf, size, "%s", p );
+      break;
+    }
+  }
+  fclose( fp );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int placeCpuFor( PlaceOpts *opts, int worker )
+{
+  int cpus[ PLACE_MAX_CPUS ], packages[ PLACE_MAX_CPUS ];
+  int num_cpus, num_packages, i, pkg, round, rank;
+
+  switch (opts->pin) {
+  case PIN_LIST:
+    return opts->cpus[ worker % opts->num_cpus ];
+
+  case PIN_COMPACT:
+    num_cpus = allowedCpus( cpus, PLACE_MAX_CPUS );
+    return num_cpus ? cpus[ worker % num_cpus ] : -1;
+
+  case PIN_SCATTER:
+    // Deal the allowed CPUs out socket by socket: the first CPU of every
+    // socket, then the second one of every socket, and so on.
+    num_cpus = allowedCpus( cpus, PLACE_MAX_CPUS );
+    if (num_cpus == 0) {
+      return -1;
+    }
+    num_packages = 0;
+    for (i = 0; i < num_cpus; i++) {
+      packages[i] = cpuPackage( cpus[i] );
+      if (packages[i] + 1 > num_packages) {
+        num_packages = packages[i] + 1;
+      }
+    }
+    worker %= num_cpus;
+    for (round = 0; ; round++) {
+      for (pkg = 0; pkg < num_packages; pkg++) {
+        rank = 0;
+        for (i = 0; i < num_cpus; i++) {
+          if (packages[i] == pkg && rank++ == round && worker-- == 0) {
+            return cpus[i];
+          }
+        }
+      }
+    }
+
+  default:
+    return -1;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int placePin( int cpu )
+{
+  cpu_set_t set;
+
+  if (cpu < 0) {
+    return 1;
+  }
+  CPU_ZERO( &set );
+  CPU_SET( cpu, &set );
+  if (pthread_setaffinity_np( pthread_self(), sizeof(set), &set ) != 0) {
+    fprintf( stderr, "Could not pin thread to CPU %d!\n", cpu );
+    return 0;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void *placeAlloc( PlaceOpts *opts, size_t size, size_t *mapped )
+{
+  void *ptr = MAP_FAILED;
+  unsigned long nodemask;
+  unsigned cpu, node;
+
+  if (size == 0) {
+    size = 1;  // mmap() refuses empty mappings.
+  }
+  if (opts->huge == HUGE_OFF) {
+    *mapped = size;
+  } else {
+    *mapped = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+  }
+
+  if (opts->huge == HUGE_EXPLICIT) {
+    ptr = mmap( NULL, *mapped, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    if (ptr == MAP_FAILED) {
+      fprintf( stderr, "No explicit huge pages available, using THP.\n" );
+    }
+  }
+
+  if (ptr == MAP_FAILED && opts->huge != HUGE_OFF) {
+    // Over-allocate so a huge page aligned range of the right size fits, and
+    // give the rest back.
+    char *raw, *start;
+    raw = (char*) mmap( NULL, *mapped + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if (raw == MAP_FAILED) {
+      return NULL;
+    }
+    start = (char*) (((unsigned long) raw + HUGE_PAGE_SIZE - 1) &
+                     ~(HUGE_PAGE_SIZE - 1));
+    if (start > raw) {
+      munmap( raw, start - raw );
+    }
+    munmap( start + *mapped, raw + HUGE_PAGE_SIZE - start );
+    madvise( start, *mapped, MADV_HUGEPAGE );
+    ptr = start;
+  }
+
+  if (ptr == MAP_FAILED) {
+    ptr = mmap( NULL, *mapped, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if (ptr == MAP_FAILED) {
+      return NULL;
+    }
+  }
+
+  // Prefer the node of the CPU we are running on. This is the raw system
+  // call so that libnuma is not needed; failures (no NUMA support) are
+  // harmless since first touch gives the same result on most systems.
+  if (opts->mbind && syscall( SYS_getcpu, &cpu, &node, NULL ) == 0 &&
+      node < 8 * sizeof(nodemask)) {
+    nodemask = 1UL << node;
+    syscall( SYS_mbind, ptr, *mapped, MPOL_PREFERRED, &nodemask,
+             8 * sizeof(nodemask), 0 );
+  }
+
+  return ptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void placeFree( void *ptr, size_t mapped )
+{
+  if (ptr) {
+    munmap( ptr, mapped );
+  }
+}
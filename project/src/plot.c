@@ -1,11 +1,61 @@
 #include "plot.h"
+#include "sink.h"
+#include "raster.h"
 
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Image geometry, chosen to match gnuplot's default PNG terminal.
+#define IMG_WIDTH     640
+#define IMG_HEIGHT    480
+#define MARGIN_LEFT   70
+#define MARGIN_RIGHT  20
+#define MARGIN_TOP    20
+#define MARGIN_BOTTOM 40
+#define FONT_SCALE    2
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static double niceStep( double range, int ticks )
+{
+  // Round range/ticks to 1, 2 or 5 times a power of ten.
+  double raw = range / ticks;
+  double mag = pow( 10, floor( log10( raw ) ) );
+  double frac = raw / mag;
+
+  if (frac <= 1) return mag;
+  if (frac <= 2) return 2 * mag;
+  if (frac <= 5) return 5 * mag;
+  return 10 * mag;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void formatTick( char *buf, double value, double step )
+{
+  int decimals = step >= 1 ? 0 : (int) ceil( -log10( step ) );
+
+  sprintf( buf, "%.*f", decimals, fabs( value ) < step / 2 ? 0.0 : value );
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 void plotData( PlotInfo *pinfo, char *data_name, char *image_name )
 {
+  PlotInfo file_info;
+  double *res;
+  int num_samples;
+
+  if (image_name) {
+    if (readTrace( data_name, &file_info, &res, &num_samples )) {
+      plotTrace( pinfo, res, num_samples, image_name );
+      free( res );
+    }
+    return;
+  }
+
   FILE *pipe = popen("gnuplot -persist","w");
   if (pipe == NULL) {
     // Something went wrong.
@@ -13,11 +63,6 @@ void plotData( PlotInfo *pinfo, char *data_name, char *image_name )
     return;
   }
 
-  if (image_name) {
-    fprintf(pipe, "set terminal png\n");
-    fprintf(pipe, "set output '%s'\n", image_name);
-  }
-
   fprintf( pipe, "set title \"Membrane Potential\\n"
                  "Simulation time: %d ms, Integration step: %f ms,\\n"
                  "Compartments: %d, Dendrites: %d, Execution time: %f s,\\n"
@@ -31,3 +76,178 @@ void plotData( PlotInfo *pinfo, char *data_name, char *image_name )
   fprintf( pipe, "plot '%s' using 1:2 with lines\n", data_name );
   pclose( pipe );
 }
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int plotTrace( PlotInfo *pinfo, double *res, int num_samples,
+               char *image_name )
+{
+  static const char *keys[3] = { "Title", "X-Label", "Y-Label" };
+  const char *values[3];
+  char title[256], label[32];
+  double v_min, v_max, y_step, x_step, tick;
+  int x0 = MARGIN_LEFT, x1 = IMG_WIDTH - MARGIN_RIGHT;
+  int y0 = IMG_HEIGHT - MARGIN_BOTTOM, y1 = MARGIN_TOP;
+  int i, px, py, last_px = 0, last_py = 0, width, ok;
+  Canvas canvas;
+
+  if (num_samples < 1 || !canvasInit( &canvas, IMG_WIDTH, IMG_HEIGHT )) {
+    return 0;
+  }
+
+  // Find a y range that starts and ends on a tick, as gnuplot's autoscale
+  // would.
+  v_min = v_max = res[0];
+  for (i = 1; i < num_samples; i++) {
+    if (res[i] < v_min) v_min = res[i];
+    if (res[i] > v_max) v_max = res[i];
+  }
+  if (v_max - v_min < 1e-9) {
+    v_min -= 1;
+    v_max += 1;
+  }
+  y_step = niceStep( v_max - v_min, 8 );
+  v_min = floor( v_min / y_step ) * y_step;
+  v_max = ceil( v_max / y_step ) * y_step;
+  x_step = niceStep( num_samples > 1 ? num_samples - 1 : 1, 10 );
+
+  #define TO_PX( t ) (x0 + (int) ((t) * (x1 - x0) / \
+                        (num_samples > 1 ? num_samples - 1 : 1) + 0.5))
+  #define TO_PY( v ) (y0 - (int) (((v) - v_min) * (y0 - y1) / \
+                        (v_max - v_min) + 0.5))
+
+  // Grid and tick labels.
+  for (tick = v_min; tick <= v_max + y_step / 2; tick += y_step) {
+    py = TO_PY( tick );
+    canvasLine( &canvas, x0, py, x1, py, COLOR_GRID );
+    canvasLine( &canvas, x0 - 4, py, x0, py, COLOR_BLACK );
+    formatTick( label, tick, y_step );
+    width = 4 * FONT_SCALE * (int) strlen( label ) - FONT_SCALE;
+    canvasText( &canvas, x0 - 8 - width, py - 5 * FONT_SCALE / 2, label,
+                FONT_SCALE, COLOR_BLACK );
+  }
+  for (tick = 0; tick <= num_samples - 1 + x_step / 2; tick += x_step) {
+    px = TO_PX( tick );
+    canvasLine( &canvas, px, y0, px, y1, COLOR_GRID );
+    canvasLine( &canvas, px, y0, px, y0 + 4, COLOR_BLACK );
+    formatTick( label, tick, x_step );
+    width = 4 * FONT_SCALE * (int) strlen( label ) - FONT_SCALE;
+    canvasText( &canvas, px - width / 2, y0 + 8, label, FONT_SCALE,
+                COLOR_BLACK );
+  }
+
+  // Border.
+  canvasLine( &canvas, x0, y0, x1, y0, COLOR_BLACK );
+  canvasLine( &canvas, x1, y0, x1, y1, COLOR_BLACK );
+  canvasLine( &canvas, x1, y1, x0, y1, COLOR_BLACK );
+  canvasLine( &canvas, x0, y1, x0, y0, COLOR_BLACK );
+
+  // The trace itself.
+  for (i = 0; i < num_samples; i++) {
+    px = TO_PX( i );
+    py = TO_PY( res[i] );
+    if (i > 0) {
+      canvasLine( &canvas, last_px, last_py, px, py, COLOR_TRACE );
+    }
+    last_px = px;
+    last_py = py;
+  }
+
+  #undef TO_PX
+  #undef TO_PY
+
+  snprintf( title, sizeof(title), "Membrane Potential. "
+            "Simulation time: %d ms, Integration step: %f ms, "
+            "Compartments: %d, Dendrites: %d, Execution time: %f s, "
+            "Slave processes: %d",
+            pinfo->sim_time, pinfo->int_step,
+            pinfo->num_comps, pinfo->num_dendrs,
+            pinfo->exec_time, pinfo->slaves );
+  values[0] = title;
+  values[1] = "Time, ms";
+  values[2] = "Vm, mV";
+
+  ok = canvasWritePng( &canvas, image_name, keys, values, 3 );
+  canvasFree( &canvas );
+
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int readTrace( char *data_name, PlotInfo *pinfo, double **res,
+               int *num_samples )
+{
+  char line[512];
+  int capacity = 128, t_ms;
+  double v;
+  BinHeader hdr;
+  FILE *fp;
+
+  if ((fp = fopen( data_name, "rb" )) == NULL) {
+    fprintf( stderr, "Can't open %s file!\n", data_name );
+    return 0;
+  }
+
+  memset( pinfo, 0, sizeof(PlotInfo) );
+  *num_samples = 0;
+
+  // Binary results start with a BinHeader, see sink.h.
+  if (fread( &hdr, sizeof(hdr), 1, fp ) == 1 &&
+      memcmp( hdr.magic, BIN_MAGIC, sizeof(hdr.magic) ) == 0) {
+    if (hdr.kind != BIN_KIND_TRACE) {
+      fprintf( stderr, "%s holds spike events, not a trace!\n", data_name );
+      fclose( fp );
+      return 0;
+    }
+    pinfo->sim_time   = hdr.sim_time;
+    pinfo->int_step   = hdr.int_step;
+    pinfo->num_comps  = hdr.num_comps;
+    pinfo->num_dendrs = hdr.num_dendrs;
+    pinfo->exec_time  = hdr.exec_time;
+    pinfo->slaves     = hdr.slaves;
+    *res = (double*) malloc( (hdr.num_samples + 1) * sizeof(double) );
+    *num_samples = (int) fread( *res, sizeof(double), hdr.num_samples, fp );
+    fclose( fp );
+    if (*num_samples == 0) {
+      fprintf( stderr, "No samples found in %s!\n", data_name );
+      free( *res );
+      *res = NULL;
+      return 0;
+    }
+    return 1;
+  }
+  rewind( fp );
+
+  *res = (double*) malloc( capacity * sizeof(double) );
+
+  while (fgets( line, sizeof(line), fp ) != NULL) {
+    if (line[0] == '#') {
+      sscanf( line, "# Vm for HH model. "
+                    "Simulation time: %d ms, Integration step: %lf ms, "
+                    "Compartments: %d, Dendrites: %d, Execution time: %lf s, "
+                    "Slave processes: %d",
+              &pinfo->sim_time, &pinfo->int_step,
+              &pinfo->num_comps, &pinfo->num_dendrs,
+              &pinfo->exec_time, &pinfo->slaves );
+      continue;
+    }
+    if (sscanf( line, "%d %lf", &t_ms, &v ) != 2) {
+      continue;
+    }
+    if (*num_samples == capacity) {
+      capacity *= 2;
+      *res = (double*) realloc( *res, capacity * sizeof(double) );
+    }
+    (*res)[ (*num_samples)++ ] = v;
+  }
+  fclose( fp );
+
+  if (*num_samples == 0) {
+    fprintf( stderr, "No samples found in %s!\n", data_name );
+    free( *res );
+    *res = NULL;
+    return 0;
+  }
+  return 1;
+}
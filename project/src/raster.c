@@ -0,0 +1,358 @@
+#include "raster.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Palette used for PNG output, RGB triplets indexed by the COLOR_* values.
+static const unsigned char palette[ NUM_COLORS ][3] = {
+  { 255, 255, 255 },  // COLOR_WHITE
+  {   0,   0,   0 },  // COLOR_BLACK
+  { 208, 208, 208 },  // COLOR_GRID
+  { 148,   0, 211 },  // COLOR_TRACE (gnuplot's default first line color)
+};
+
+// 3x5 font. Each glyph is five rows of three bits, most significant bit left.
+static const char font_chars[] = "0123456789-.";
+static const unsigned char font_rows[][5] = {
+  { 7, 5, 5, 5, 7 }, { 2, 6, 2, 2, 7 }, { 7, 1, 7, 4, 7 }, { 7, 1, 7, 1, 7 },
+  { 5, 5, 7, 1, 1 }, { 7, 4, 7, 1, 7 }, { 7, 4, 7, 5, 7 }, { 7, 1, 1, 1, 1 },
+  { 7, 5, 7, 5, 7 }, { 7, 5, 7, 1, 7 }, { 0, 0, 7, 0, 0 }, { 0, 0, 0, 0, 2 },
+};
+
+// Deflate tables (RFC 1951, section 3.2.5).
+static const int len_base[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+  67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const int len_extra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+  4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const int dist_base[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+  769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const int dist_extra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8,
+  9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/**
+ * Growable byte buffer with an LSB-first bit writer on top, as required by
+ * deflate.
+ */
+typedef struct ByteBuf {
+  unsigned char *data;
+  size_t len, cap;
+  unsigned int bits;  // Pending bits not yet flushed to 'data'.
+  int nbits;          // Number of pending bits.
+} ByteBuf;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void bufPut( ByteBuf *buf, unsigned char byte )
+{
+  if (buf->len == buf->cap) {
+    buf->cap = buf->cap ? buf->cap * 2 : 4096;
+    buf->data = (unsigned char*) realloc( buf->data, buf->cap );
+  }
+  buf->data[ buf->len++ ] = byte;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void bufBits( ByteBuf *buf, unsigned int value, int count )
+{
+  buf->bits |= value << buf->nbits;
+  buf->nbits += count;
+  while (buf->nbits >= 8) {
+    bufPut( buf, buf->bits & 0xff );
+    buf->bits >>= 8;
+    buf->nbits -= 8;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void bufCode( ByteBuf *buf, unsigned int code, int count )
+{
+  // Huffman codes are packed starting from their most significant bit.
+  unsigned int rev = 0;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    rev = (rev << 1) | ((code >> i) & 1);
+  }
+  bufBits( buf, rev, count );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void deflateSymbol( ByteBuf *buf, int sym )
+{
+  // Fixed Huffman code for the literal/length alphabet.
+  if (sym < 144)      { bufCode( buf, 0x30 + sym, 8 ); }
+  else if (sym < 256) { bufCode( buf, 0x190 + sym - 144, 9 ); }
+  else if (sym < 280) { bufCode( buf, sym - 256, 7 ); }
+  else                { bufCode( buf, 0xc0 + sym - 280, 8 ); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void deflateMatch( ByteBuf *buf, int length, int dist )
+{
+  int i;
+
+  for (i = 28; len_base[i] > length; i--);
+  deflateSymbol( buf, 257 + i );
+  bufBits( buf, length - len_base[i], len_extra[i] );
+
+  for (i = 29; dist_base[i] > dist; i--);
+  bufCode( buf, i, 5 );
+  bufBits( buf, dist - dist_base[i], dist_extra[i] );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int matchLength( const unsigned char *raw, size_t pos, size_t len,
+                        size_t dist )
+{
+  int n = 0;
+
+  if (pos < dist) {
+    return 0;
+  }
+  while (n < 258 && pos + n < len && raw[pos + n] == raw[pos + n - dist]) {
+    n++;
+  }
+  return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static unsigned long crc32Update( unsigned long crc, const unsigned char *data,
+                                  size_t len )
+{
+  static unsigned long table[256];
+  static int have_table = 0;
+  unsigned long c;
+  size_t i;
+  int k;
+
+  if (!have_table) {
+    for (i = 0; i < 256; i++) {
+      c = (unsigned long) i;
+      for (k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+    have_table = 1;
+  }
+
+  crc ^= 0xffffffffUL;
+  for (i = 0; i < len; i++) {
+    crc = table[ (crc ^ data[i]) & 0xff ] ^ (crc >> 8);
+  }
+  return crc ^ 0xffffffffUL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void putBe32( unsigned char *out, unsigned long value )
+{
+  out[0] = (value >> 24) & 0xff;
+  out[1] = (value >> 16) & 0xff;
+  out[2] = (value >>  8) & 0xff;
+  out[3] =  value        & 0xff;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void writeChunk( FILE *fp, const char *type, const unsigned char *data,
+                        size_t len )
+{
+  unsigned char word[4];
+  unsigned long crc;
+
+  putBe32( word, len );
+  fwrite( word, 1, 4, fp );
+  fwrite( type, 1, 4, fp );
+  if (len) {
+    fwrite( data, 1, len, fp );
+  }
+
+  crc = crc32Update( 0, (const unsigned char*) type, 4 );
+  crc = crc32Update( crc, data, len );
+  putBe32( word, crc );
+  fwrite( word, 1, 4, fp );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int canvasInit( Canvas *canvas, int width, int height )
+{
+  canvas->width = width;
+  canvas->height = height;
+  canvas->pix = (unsigned char*) calloc( (size_t) width * height, 1 );
+
+  return canvas->pix != NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void canvasFree( Canvas *canvas )
+{
+  free( canvas->pix );
+  canvas->pix = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void canvasLine( Canvas *canvas, int x0, int y0, int x1, int y1,
+                 unsigned char color )
+{
+  int dx = abs( x1 - x0 ), sx = x0 < x1 ? 1 : -1;
+  int dy = -abs( y1 - y0 ), sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy, e2;
+
+  for (;;) {
+    if (x0 >= 0 && x0 < canvas->width && y0 >= 0 && y0 < canvas->height) {
+      canvas->pix[ y0 * canvas->width + x0 ] = color;
+    }
+    if (x0 == x1 && y0 == y1) {
+      break;
+    }
+    e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int canvasText( Canvas *canvas, int x, int y, const char *str, int scale,
+                unsigned char color )
+{
+  int start = x, row, col, px, py;
+  const char *glyph;
+
+  for (; *str; str++, x += 4 * scale) {
+    if ((glyph = strchr( font_chars, *str )) == NULL) {
+      continue;
+    }
+    for (row = 0; row < 5; row++) {
+      for (col = 0; col < 3; col++) {
+        if (!(font_rows[ glyph - font_chars ][ row ] & (4 >> col))) {
+          continue;
+        }
+        for (py = 0; py < scale; py++) {
+          for (px = 0; px < scale; px++) {
+            canvasLine( canvas, x + col*scale + px, y + row*scale + py,
+                        x + col*scale + px, y + row*scale + py, color );
+          }
+        }
+      }
+    }
+  }
+
+  return x - start - (x > start ? scale : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int canvasWritePng( Canvas *canvas, const char *fname, const char **keys,
+                    const char **values, int num_text )
+{
+  static const unsigned char signature[8] = {
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+  };
+  unsigned char header[13], plte[ NUM_COLORS * 3 ], *raw, *text;
+  size_t stride = canvas->width + 1, raw_len = stride * canvas->height;
+  size_t pos, key_len, val_len;
+  unsigned long s1 = 1, s2 = 0;
+  ByteBuf zbuf = { NULL, 0, 0, 0, 0 };
+  int i, run, up;
+  FILE *fp;
+
+  if ((fp = fopen( fname, "wb" )) == NULL) {
+    fprintf( stderr, "Can't open %s file!\n", fname );
+    return 0;
+  }
+
+  // Scanlines, each prefixed with filter type 0 (none).
+  raw = (unsigned char*) malloc( raw_len );
+  for (i = 0; i < canvas->height; i++) {
+    raw[ i * stride ] = 0;
+    memcpy( raw + i * stride + 1, canvas->pix + (size_t) i * canvas->width,
+            canvas->width );
+  }
+
+  // zlib stream: header, one fixed-Huffman deflate block, adler32.
+  bufPut( &zbuf, 0x78 );
+  bufPut( &zbuf, 0x01 );
+  bufBits( &zbuf, 1, 1 );  // BFINAL
+  bufBits( &zbuf, 1, 2 );  // BTYPE = fixed Huffman
+  for (pos = 0; pos < raw_len;) {
+    // Plots are long horizontal runs and rows that repeat the row above, so
+    // those are the only two match distances worth looking at.
+    run = matchLength( raw, pos, raw_len, 1 );
+    up  = matchLength( raw, pos, raw_len, stride );
+    if (up >= run && up >= 3) {
+      deflateMatch( &zbuf, up, stride );
+      pos += up;
+    } else if (run >= 3) {
+      deflateMatch( &zbuf, run, 1 );
+      pos += run;
+    } else {
+      deflateSymbol( &zbuf, raw[ pos++ ] );
+    }
+  }
+  deflateSymbol( &zbuf, 256 );  // End of block.
+  if (zbuf.nbits) {
+    bufBits( &zbuf, 0, 8 - zbuf.nbits );
+  }
+
+  for (pos = 0; pos < raw_len; pos++) {
+    s1 = (s1 + raw[pos]) % 65521;
+    s2 = (s2 + s1) % 65521;
+  }
+  bufPut( &zbuf, (s2 >> 8) & 0xff );
+  bufPut( &zbuf, s2 & 0xff );
+  bufPut( &zbuf, (s1 >> 8) & 0xff );
+  bufPut( &zbuf, s1 & 0xff );
+
+  putBe32( header, canvas->width );
+  putBe32( header + 4, canvas->height );
+  header[8]  = 8;  // Bit depth.
+  header[9]  = 3;  // Color type: indexed.
+  header[10] = 0;  // Compression.
+  header[11] = 0;  // Filter.
+  header[12] = 0;  // Interlace.
+  memcpy( plte, palette, sizeof(plte) );
+
+  fwrite( signature, 1, 8, fp );
+  writeChunk( fp, "IHDR", header, 13 );
+  writeChunk( fp, "PLTE", plte, sizeof(plte) );
+  for (i = 0; i < num_text; i++) {
+    key_len = strlen( keys[i] );
+    val_len = strlen( values[i] );
+    text = (unsigned char*) malloc( key_len + 1 + val_len );
+    memcpy( text, keys[i], key_len + 1 );
+    memcpy( text + key_len + 1, values[i], val_len );
+    writeChunk( fp, "tEXt", text, key_len + 1 + val_len );
+    free( text );
+  }
+  writeChunk( fp, "IDAT", zbuf.data, zbuf.len );
+  writeChunk( fp, "IEND", NULL, 0 );
+
+  free( raw );
+  free( zbuf.data );
+
+  if (fclose( fp ) != 0) {
+    fprintf( stderr, "Could not write %s!\n", fname );
+    return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,149 @@
+#include "record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int flushRows( Recorder *rec )
+{
+  int const n = rec->buffered * rec->count * rec->values;
+  MPI_Datatype rows = MPI_DOUBLE;
+  MPI_Offset disp = sizeof(RecHeader);
+  double t0 = MPI_Wtime();
+  int rc;
+
+  if (rec->buffered == 0) {
+    return 1;
+  }
+
+  // This process sees a block of `count' records in each buffered row; a
+  // process without dendrites still takes part in the collective write.
+  if (rec->count > 0) {
+    MPI_Type_vector( rec->buffered, rec->count * rec->values,
+                     rec->num_dendrs * rec->values, MPI_DOUBLE, &rows );
+    MPI_Type_commit( &rows );
+    disp += ((MPI_Offset) rec->next_row * rec->num_dendrs + rec->first) *
+            rec->values * sizeof(double);
+  }
+  rc = MPI_File_set_view( rec->fh, disp, MPI_DOUBLE, rows, "native",
+                          MPI_INFO_NULL );
+  if (rc == MPI_SUCCESS) {
+    rc = MPI_File_write_all( rec->fh, rec->buf, n, MPI_DOUBLE,
+                             MPI_STATUS_IGNORE );
+  }
+  if (rec->count > 0) {
+    MPI_Type_free( &rows );
+  }
+
+  rec->bytes += (long long) n * sizeof(double);
+  rec->next_row += rec->buffered;
+  rec->buffered = 0;
+  rec->io_time += MPI_Wtime() - t0;
+  if (rc != MPI_SUCCESS) {
+    fprintf( stderr, "Could not write the recording!\n" );
+    return 0;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int recordOpen( Recorder *rec, const char *path, int num_dendrs,
+                int num_comps, int duration, int first, int count,
+                int buffer_ms, MPI_Comm comm )
+{
+  RecHeader hdr;
+  double t0 = MPI_Wtime();
+  int rank, rc;
+
+  memset( rec, 0, sizeof(*rec) );
+  rec->comm = comm;
+  rec->num_dendrs = num_dendrs;
+  rec->values = num_comps + 1;
+  rec->first = first;
+  rec->count = count;
+  rec->buffer_ms = buffer_ms < duration ? buffer_ms : duration;
+  rec->buf = (double*) malloc( ((size_t) rec->buffer_ms * count *
+                                rec->values + 1) * sizeof(double) );
+  if (!rec->buf) {
+    fprintf( stderr, "Could not allocate the recording buffer!\n" );
+    return 0;
+  }
+
+  MPI_Comm_rank( comm, &rank );
+  rc = MPI_File_open( comm, (char*) path, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &rec->fh );
+  if (rc != MPI_SUCCESS) {
+    if (rank == 0) {
+      fprintf( stderr, "Can't create recording %s!\n", path );
+    }
+    free( rec->buf );
+    rec->buf = NULL;
+    return 0;
+  }
+
+  // Sizing the file up front drops whatever an older file had past its end
+  // and lets the file system allocate it in one go.
+  rc = MPI_File_set_size( rec->fh, sizeof(RecHeader) +
+                          (MPI_Offset) duration * num_dendrs * rec->values *
+                          sizeof(double) );
+  if (rc == MPI_SUCCESS && rank == 0) {
+    memset( &hdr, 0, sizeof(hdr) );
+    memcpy( hdr.magic, REC_MAGIC, sizeof(hdr.magic) );
+    hdr.num_dendrs = num_dendrs;
+    hdr.num_comps = num_comps;
+    hdr.num_ms = duration;
+    hdr.values = rec->values;
+    rc = MPI_File_write_at( rec->fh, 0, &hdr, sizeof(hdr), MPI_BYTE,
+                            MPI_STATUS_IGNORE );
+    rec->bytes += sizeof(hdr);
+  }
+  rec->io_time += MPI_Wtime() - t0;
+  if (rc != MPI_SUCCESS) {
+    fprintf( stderr, "Could not write the recording header!\n" );
+    return 0;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int recordSample( Recorder *rec, double **volt, const double *currents )
+{
+  double *row = rec->buf + (size_t) rec->buffered * rec->count * rec->values;
+  int d;
+
+  for (d = 0; d < rec->count; d++) {
+    row[ d * rec->values ] = currents[d];
+    memcpy( row + d * rec->values + 1, volt[d] + 1,
+            (rec->values - 1) * sizeof(double) );
+  }
+  if (++rec->buffered == rec->buffer_ms) {
+    return flushRows( rec );
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int recordClose( Recorder *rec, long long *bytes, double *seconds )
+{
+  int ok;
+  double t0;
+
+  ok = flushRows( rec );
+  t0 = MPI_Wtime();
+  if (MPI_File_close( &rec->fh ) != MPI_SUCCESS) {
+    ok = 0;
+  }
+  rec->io_time += MPI_Wtime() - t0;
+
+  MPI_Reduce( &rec->bytes, bytes, 1, MPI_LONG_LONG, MPI_SUM, 0, rec->comm );
+  MPI_Reduce( &rec->io_time, seconds, 1, MPI_DOUBLE, MPI_MAX, 0,
+              rec->comm );
+  free( rec->buf );
+  rec->buf = NULL;
+  return ok;
+}
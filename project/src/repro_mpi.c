@@ -0,0 +1,40 @@
+#include "repro_mpi.h"
+
+static MPI_Datatype sum_type = MPI_DATATYPE_NULL;
+static MPI_Op sum_op = MPI_OP_NULL;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+MPI_Datatype reproSumType( void )
+{
+  if (sum_type == MPI_DATATYPE_NULL) {
+    // hi and lo are both 64 bits; the sign of hi survives the trip.
+    MPI_Type_contiguous( 2, MPI_UINT64_T, &sum_type );
+    MPI_Type_commit( &sum_type );
+  }
+  return sum_type;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void mergeSums( void *in, void *inout, int *len, MPI_Datatype *type )
+{
+  ReproSum const *src = (ReproSum const*) in;
+  ReproSum *dst = (ReproSum*) inout;
+  int i;
+
+  (void) type;
+  for (i = 0; i < *len; i++) {
+    reproSumMerge( &dst[i], &src[i] );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+MPI_Op reproSumOp( void )
+{
+  if (sum_op == MPI_OP_NULL) {
+    MPI_Op_create( mergeSums, 1, &sum_op );
+  }
+  return sum_op;
+}
@@ -0,0 +1,122 @@
+#include "repro_sum.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void reproSumZero( ReproSum *s )
+{
+  s->hi = 0;
+  s->lo = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void reproSumAdd( ReproSum *s, double x )
+{
+  double whole = floor( x );
+  double frac = (x - whole) * 0x1p64;  // Both exact.
+  uint64_t lo;
+
+  // Only a tiny negative term can round its fraction up to a whole.
+  if (frac >= 0x1p64) {
+    whole += 1.0;
+    frac = 0.0;
+  }
+
+  lo = s->lo + (uint64_t) frac;
+  s->hi += (int64_t) whole + (lo < s->lo);
+  s->lo = lo;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void reproSumMerge( ReproSum *s, const ReproSum *t )
+{
+  uint64_t const lo = s->lo + t->lo;
+
+  s->hi += t->hi + (lo < s->lo);
+  s->lo = lo;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double reproSumValue( const ReproSum *s )
+{
+  // Converting hi and lo apart and adding them would round twice. Instead
+  // take the magnitude of the 128-bit number, keep its top 64 bits, fold
+  // the bits below into the last one (they only matter to break a tie), and
+  // let the one conversion to double round to nearest even.
+  int const negative = s->hi < 0;
+  uint64_t hi = (uint64_t) s->hi, lo = s->lo, top;
+  int bits;
+  double value;
+
+  if (negative) {
+    hi = ~hi + (lo == 0);
+    lo = -lo;
+  }
+  if (hi == 0) {
+    value = (double) lo * 0x1p-64;
+  } else {
+    bits = 64 - __builtin_clzll( hi );
+    top = bits == 64 ? hi : (hi << (64 - bits)) | (lo >> bits);
+    top |= bits == 64 ? lo != 0 : (lo << (64 - bits)) != 0;
+    value = ldexp( (double) top, bits - 64 );
+  }
+  return negative ? -value : value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static double elapsed( struct timeval *start )
+{
+  struct timeval stop, diff;
+
+  gettimeofday( &stop, NULL );
+  timersub( &stop, start, &diff );
+  return (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void reproSumBenchmark( int num_terms, int steps, double *naive_ns,
+                        double *repro_ns )
+{
+  double *terms = (double*) malloc( num_terms * sizeof(double) );
+  struct timeval start;
+  volatile double sink;
+  double naive;
+  ReproSum sum;
+  int i, s;
+
+  // Currents of the size the dendrites inject, of both signs.
+  for (i = 0; i < num_terms; i++) {
+    terms[i] = (i % 2 ? 1.0 : -0.1) * (100.0 + 37.3 * i);
+  }
+
+  gettimeofday( &start, NULL );
+  for (s = 0; s < steps; s++) {
+    naive = 0.0;
+    for (i = 0; i < num_terms; i++) {
+      naive += terms[i];
+    }
+    sink = naive;
+  }
+  *naive_ns = elapsed( &start ) * 1e9 / ((double) steps * num_terms);
+
+  gettimeofday( &start, NULL );
+  for (s = 0; s < steps; s++) {
+    reproSumZero( &sum );
+    for (i = 0; i < num_terms; i++) {
+      reproSumAdd( &sum, terms[i] );
+    }
+    sink = reproSumValue( &sum );
+  }
+  *repro_ns = elapsed( &start ) * 1e9 / ((double) steps * num_terms);
+
+  (void) sink;
+  free( terms );
+}
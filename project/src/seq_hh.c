@@ -7,15 +7,30 @@
 */
 
 #include "plot.h"
+#include "sink.h"
+#include "spike.h"
 #include "lib_hh.h"
+#include "dendrites.h"
+#include "workers.h"
+#include "tune.h"
+#include "soma_step.h"
+#include "multirate.h"
+#include "dendr_reduce.h"
+#include "server.h"
+#include "stimulus.h"
+#include "snapshot.h"
+#include "telemetry.h"
 #include "cmd_args.h"
 #include "constants.h"
 
-#include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/stat.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include <sys/socket.h>
 
 // Define macros based on compilation options. This is a best practice that
 // ensures that all code is seen by the compiler so there will be no surprises
@@ -33,6 +48,364 @@
   #define ISDEF_PLOT_PNG 0
 #endif
 
+/**
+ * Name: tune
+ *
+ * Description:
+ * Replaces the engine configuration in `cmd_args' by the tuned one for its
+ * shape.
+ *
+ * Parameters:
+ * @param cmd_args  command line arguments, updated
+ * @param log_file  where tuning progress goes, NULL for nowhere
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+static int tune( CmdArgs *cmd_args, FILE *log_file )
+{
+  TuneConfig tuned;
+
+  if (!tuneSelect( cmd_args->tune_file, cmd_args->autotune == 2,
+				   cmd_args->num_dendrs, cmd_args->num_comps,
+				   &cmd_args->place, log_file, &tuned )) {
+	return 0;
+  }
+  // Only the explicit kernels were timed; multi-rate keeps the implicit one.
+  if (cmd_args->soma_substeps == 1) {
+	tuned.kernel.reduce = cmd_args->kernel.reduce;
+	tuned.kernel.steal = cmd_args->kernel.steal;
+	cmd_args->kernel = tuned.kernel;
+  }
+  cmd_args->num_threads = tuned.num_threads;
+  return 1;
+}
+
+/**
+ * Name: simulate
+ *
+ * Description:
+ * Simulates the cell for cmd_args->duration ms. The dendrites must be at rest
+ * (freshly started or reset) and driven by `stim'. The soma potential is
+ * recorded once per ms in `res' and sent to `sink' together with the spikes.
+ * Unless `spike_times' is NULL, the spike times are also stored there; at
+ * most one spike per ms can be found. Progress is published to `tel' once
+ * per ms.
+ *
+ * Parameters:
+ * @param cmd_args  command line arguments
+ * @param dendrites pool of workers holding the dendrites
+ * @param stim      stimulus of the dendrites
+ * @param sink      where results are sent
+ * @param log_file  where progress goes (unless quiet)
+ * @param res       (OUTPUT) soma potential at each ms
+ * @param spike_times (OUTPUT) spike times, or NULL
+ * @param tel       telemetry block of the run, or NULL
+ *
+ * Returns:
+ * @return int      number of spikes detected
+ */
+static int simulate( CmdArgs *cmd_args, Workers *dendrites, Stimulus *stim,
+					 OutputSink *sink, FILE *log_file, double *res,
+					 double *spike_times, Telemetry *tel )
+{
+  int t_ms, step, i;                      // Various indexing variables.
+  Worker *w;
+  MultiRate coupling;  // Dendrite and soma step sizes and their coupling.
+  double dendr_dt;     // Dendrite step size.
+  double y[NUMVAR], y0[NUMVAR], dydt[NUMVAR], soma_params[3];
+  SpikeDetector spikes;  // Finds action potentials in the soma potential.
+  double t_spike;        // Time of a detected spike.
+
+  // Initialize 'y' with precomputed values from the HH model.
+  y[0] = VREST;
+  y[1] = 0.037;
+  y[2] = 0.0148;
+  y[3] = 0.9959;
+
+  // Setup parameters for the soma.
+  soma_params[0] = 1.0 / (double) STEPS;  // dt
+  soma_params[1] = 0.0;  // Direct current injection into soma is always zero.
+  soma_params[2] = 0.0;  // Dendritic current injected into soma. This is the
+						 // value that our simulation will update at each step.
+  dendr_dt = soma_params[0] * cmd_args->soma_substeps;
+
+  spikeInit( &spikes, cmd_args->spike_threshold, SPIKE_REARM,
+			 SPIKE_REFRACTORY );
+  multiRateInit( &coupling, cmd_args->soma_substeps, cmd_args->hold_current,
+				 y[0] );
+
+  // Record the initial potential value in our results array.
+  res[0] = y[0];
+  sinkSample( sink, 0, y[0] );
+
+  // Loop over milliseconds.
+  for (t_ms = 1; t_ms < cmd_args->duration; t_ms++) {
+	// Move the stimulus to this ms. A failure has been reported already.
+	if (!stimSetTime( stim, t_ms )) {
+	  break;
+	}
+
+	// Loop over integration time steps in each millisecond.
+	for (step = 0; step < STEPS; step++) {
+	  // Update Vm in all compartments of all dendrites and accumulate the
+	  // current they inject into the soma. With multi-rate stepping this
+	  // happens once every few soma steps.
+	  if (multiRateDendrStep( &coupling, step )) {
+		multiRateSetCurrent( &coupling,
+							 workersStep( dendrites,
+										  step / coupling.ratio, dendr_dt,
+										  coupling.v_seen ) );
+	  }
+	  soma_params[2] = multiRateCurrent( &coupling, step );
+
+	  // This is the main HH computation. It updates the potential, Vm, of the
+	  // soma, injects current, and calculates action potential. Good stuff.
+	  // The previous HH model parameters are left in y0.
+	  somaStep( cmd_args->soma, y, y0, dydt, soma_params );
+	  multiRateSomaDone( &coupling, step, y[0] );
+
+	  // Look for an action potential during this step.
+	  if (spikeUpdate( &spikes, t_ms - 1 + (step + 1) * soma_params[0],
+					   soma_params[0], y0[0], y[0], &t_spike )) {
+		sinkSpike( sink, t_spike );
+		if (spike_times && spikes.stats.num_spikes <= COMPTIME) {
+		  spike_times[ spikes.stats.num_spikes - 1 ] = t_spike;
+		}
+	  }
+	}
+
+	// Record the membrane potential of the soma at this simulation step.
+	// Let's show where we are in terms of computation.
+	if (!cmd_args->quiet) {
+	  fprintf(log_file, "\r%02d ms",t_ms); fflush(log_file);
+	}
+
+	res[t_ms] = y[0];
+	sinkSample( sink, t_ms, y[0] );
+
+	// Worker threads time their work and their waits; a single thread does
+	// nothing but compute.
+	for (i = 0; tel && i < dendrites->num_threads; i++) {
+	  w = &dendrites->workers[i];
+	  telemetryUpdate( tel, i, t_ms, (long) t_ms * STEPS,
+					   dendrites->num_threads > 1 ? w->busy : -1.0,
+					   dendrites->num_threads > 1 ? w->idle : 0.0 );
+	}
+  }
+
+  return spikes.stats.num_spikes;
+}
+
+/**
+ * Name: snapshot
+ *
+ * Description:
+ * Writes the end state of a run to a snapshot file (see snapshot.h).
+ *
+ * Parameters:
+ * @param path        file to write
+ * @param dendrites   pool of workers holding the dendrites
+ * @param duration    simulated time, ms
+ * @param res         soma potential at each ms
+ * @param spike_times spike times
+ * @param num_spikes  number of spikes
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+static int snapshot( const char *path, Workers *dendrites, int duration,
+					 double *res, double *spike_times, int num_spikes )
+{
+  Worker *w;
+  FILE *fp;
+  int i, d;
+
+  fp = snapshotOpen( path, dendrites->num_dendrs, dendrites->num_comps - 2,
+					 duration, res, spike_times, num_spikes );
+  if (!fp) {
+	return 0;
+  }
+
+  // A reduced set has no dendrites of its own to write.
+  for (i = 0; i < dendrites->num_threads; i++) {
+	w = &dendrites->workers[i];
+	for (d = 0; !dendrites->kernel.reduce && d < w->count; d++) {
+	  snapshotDendrite( fp, w->first + d, &w->set.volt[d][1],
+						dendrites->num_comps - 2 );
+	}
+  }
+  return fclose( fp ) == 0;
+}
+
+/**
+ * Name: serve
+ *
+ * Description:
+ * Runs simulation jobs sent to the socket `path' until one of them is
+ * --shutdown. Each job is a command line without the program name; its
+ * results are streamed back in the stdout sink format. The worker threads
+ * and their dendrites are kept between jobs and only restarted when the
+ * shape of the cell or the engine changes.
+ *
+ * Parameters:
+ * @param path      file system path of the socket
+ * @param name      program name, used as argv[0] of the jobs
+ *
+ * Returns:
+ * @return int      0 if there was a problem, nonzero otherwise
+ */
+static int serve( const char *path, char *name )
+{
+  CmdArgs cmd_args;
+  Workers dendrites;
+  Stimulus stim;
+  DendrOverrides overrides;
+  OutputSink sink;
+  PlotInfo pinfo;
+  struct timeval start, stop, diff;
+  char line[ JOB_LINE_LEN ], *argv[ JOB_MAX_ARGS + 1 ];
+  double res[COMPTIME], exec_time;
+  int fd, conn, argc, warm = 0, reused, num_spikes, jobs = 0;
+  const char *error;
+  FILE *out;
+
+  // A client going away must not take the server with it.
+  signal( SIGPIPE, SIG_IGN );
+
+  fd = serverListen( path );
+  if (fd < 0) {
+	return 0;
+  }
+  printf( "Serving jobs on %s\n", path );
+  fflush( stdout );
+
+  for (;;) {
+	conn = accept( fd, NULL, NULL );
+	if (conn < 0) {
+	  if (errno == EINTR) {
+		continue;
+	  }
+	  fprintf( stderr, "Can't accept jobs on %s!\n", path );
+	  break;
+	}
+	if (!serverReadJob( conn, line, sizeof(line) )) {
+	  close( conn );
+	  continue;
+	}
+	out = fdopen( conn, "w" );
+	if (!out) {
+	  close( conn );
+	  continue;
+	}
+
+	// Jobs run like seq_hh would, minus anything that is not a simulation.
+	error = NULL;
+	overrides.count = 0;
+	overrides.list = NULL;
+	argc = serverSplitArgs( line, name, argv );
+	if (!parseArgs( &cmd_args, argc, argv )) {
+	  error = "invalid job";
+	} else if (cmd_args.shutdown) {
+	  fclose( out );
+	  break;
+	} else if (cmd_args.serve || cmd_args.connect) {
+	  error = "jobs can't serve or connect";
+	} else if (cmd_args.net.neurons > 0 || cmd_args.net.file) {
+	  error = "networks need mpi_hh";
+	} else if (cmd_args.validate_soma || cmd_args.validate_reduce ||
+			   cmd_args.validate_kernel || cmd_args.bench_placement ||
+			   cmd_args.bench_shapes || cmd_args.write_stimulus) {
+	  error = "jobs must be simulations";
+	} else if (cmd_args.autotune && !tune( &cmd_args, NULL )) {
+	  error = "auto-tuning failed";
+	} else if (cmd_args.dendr_params &&
+			   !dendrOverridesLoad( &overrides, cmd_args.dendr_params )) {
+	  error = "could not read the dendrite parameters";
+	} else if (!cmd_args.stimulus) {
+	  stimGenerator( &stim );
+	} else if (!stimOpen( &stim, cmd_args.stimulus, cmd_args.num_dendrs,
+						  cmd_args.duration, cmd_args.stim_window )) {
+	  error = "could not open the stimulus file";
+	}
+	if (error) {
+	  fprintf( out, "# error: %s\n", error );
+	  fclose( out );
+	  dendrOverridesFree( &overrides );
+	  continue;
+	}
+	cmd_args.quiet = 1;
+	cmd_args.plot = 0;
+	somaSetTolerance( cmd_args.ps_tol );
+
+	pinfo.sim_time = cmd_args.duration;
+	pinfo.int_step = 1.0 / (double) STEPS;
+	pinfo.num_comps = cmd_args.num_comps;
+	pinfo.num_dendrs = cmd_args.num_dendrs;
+	pinfo.exec_time = 0.0;
+	pinfo.slaves = 0;
+	sinkOpenStream( &sink, out, &pinfo, cmd_args.events );
+
+	gettimeofday( &start, NULL );
+
+	// Same shape: put the warm dendrites back to rest. Otherwise start over.
+	reused = warm && workersMatch( &dendrites, cmd_args.num_threads,
+								   cmd_args.num_dendrs,
+								   cmd_args.num_comps + 2, &cmd_args.kernel,
+								   &cmd_args.place );
+	if (reused) {
+	  workersReset( &dendrites );
+	} else {
+	  if (warm) {
+		workersFree( &dendrites );
+	  }
+	  warm = workersInit( &dendrites, cmd_args.num_threads,
+						  cmd_args.num_dendrs, cmd_args.num_comps + 2,
+						  &cmd_args.kernel, &cmd_args.place );
+	  if (!warm) {
+		fprintf( out, "# error: could not allocate dendrites\n" );
+		fclose( out );
+		stimClose( &stim );
+		dendrOverridesFree( &overrides );
+		continue;
+	  }
+	}
+	workersStimulus( &dendrites, &stim );
+	if (!workersParams( &dendrites,
+						cmd_args.dendr_params ? &overrides : NULL )) {
+	  fprintf( out, "# error: could not build the dendrite shapes\n" );
+	  fclose( out );
+	  stimClose( &stim );
+	  dendrOverridesFree( &overrides );
+	  continue;
+	}
+	dendrOverridesFree( &overrides );
+
+	num_spikes = simulate( &cmd_args, &dendrites, &stim, &sink, stderr, res,
+						   NULL, NULL );
+	stimClose( &stim );
+
+	gettimeofday( &stop, NULL );
+	timersub( &stop, &start, &diff );
+	exec_time = (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
+	sinkClose( &sink, exec_time );
+	fclose( out );
+
+	printf( "Job %d: %d dendrites x %d compartments, %d ms, %d spikes, "
+			"%f seconds (%s)\n", ++jobs, cmd_args.num_dendrs,
+			cmd_args.num_comps, cmd_args.duration, num_spikes, exec_time,
+			reused ? "warm" : "cold" );
+	fflush( stdout );
+  }
+
+  if (warm) {
+	workersFree( &dendrites );
+  }
+  close( fd );
+  unlink( path );
+  return 1;
+}
+
 /**
  * Name: main
  *
@@ -47,7 +420,6 @@ int main( int argc, char **argv )
 {
   CmdArgs cmd_args;                       // Command line arguments.
   int num_comps, num_dendrs;              // Simulation parameters.
-  int i, j, t_ms, step, dendrite;         // Various indexing variables.
   struct timeval start, stop, diff;       // Values used to measure time.
 
   double exec_time;  // How long we take.
@@ -55,83 +427,159 @@ int main( int argc, char **argv )
   // Accumulators used during dendrite simulation.
   // NOTE: We depend on the compiler to handle the use of double[] variables as
   //       double*.
-  double current, **dendr_volt;
-  double res[COMPTIME], y[NUMVAR], y0[NUMVAR], dydt[NUMVAR], soma_params[3];
-
-  // Strings used to store filenames for the graph and data files.
-  char time_str[14];
-  char graph_fname[ FNAME_LEN ];
-  char data_fname[ FNAME_LEN ];
+  Workers dendrites;
+  Stimulus stim;       // Current injected at the dendrite tips.
+  DendrOverrides overrides;  // Per-dendrite parameters.
+  double res[COMPTIME];
+  double spike_times[COMPTIME];  // When the soma spiked, for --snapshot.
+  Telemetry tel;    // Progress published for hhtop.
 
-  FILE *data_file;  // The output file where we store the soma potential values.
-  FILE *graph_file; // File where graph will be saved.
+  OutputSink sink;  // Where the soma potential values are sent.
+  int num_spikes;   // Action potentials found in the soma potential.
+  FILE *log_file;   // Where progress and informational messages go.
 
   PlotInfo pinfo;   // Info passed to the plotting functions.
+  int plot_png, plot_screen;  // Which plots were requested for this run.
+  char **args;      // Copy of argv for parseArgs().
+  int arg;
 
   //////////////////////////////////////////////////////////////////////////////
   // Parse command line arguments.
   //////////////////////////////////////////////////////////////////////////////
 
-  if (!parseArgs( &cmd_args, argc, argv )) {
+  // parseArgs() splits some arguments in place (-o TYPE:NAME) and cmd_args
+  // keeps pointers into them, so it gets a copy that lasts the whole run and
+  // argv stays as given for --connect.
+  args = (char**) malloc( (argc + 1) * sizeof(char*) );
+  if (!args) {
+	fprintf( stderr, "Could not allocate memory for the arguments!\n" );
+	exit(1);
+  }
+  for (arg = 0; arg < argc; arg++) {
+	if (!(args[ arg ] = strdup( argv[ arg ] ))) {
+	  fprintf( stderr, "Could not allocate memory for the arguments!\n" );
+	  exit(1);
+	}
+  }
+  args[ argc ] = NULL;
+
+  if (!parseArgs( &cmd_args, argc, args )) {
 	// Something was wrong.
 	exit(1);
   }
+  somaSetTolerance( cmd_args.ps_tol );
 
   // Pull out the parameters so we don't need to type 'cmd_args.' all the time.
   num_dendrs = cmd_args.num_dendrs;
   num_comps  = cmd_args.num_comps;
+  plot_png    = ISDEF_PLOT_PNG && cmd_args.plot;
+  plot_screen = ISDEF_PLOT_SCREEN && cmd_args.plot;
+
+  if (cmd_args.connect) {
+	// Hand the job, i.e. everything but --connect, to a server.
+	char *job[ JOB_MAX_ARGS ];
+	int i, n = 0;
+
+	for (i = 1; i < argc && n < JOB_MAX_ARGS; i++) {
+	  if (strcmp( "--connect", argv[i] ) == 0) {
+		i++;
+	  } else {
+		job[ n++ ] = argv[i];
+	  }
+	}
+	return clientRun( cmd_args.connect, n, job, stdout ) ? 0 : 1;
+  }
 
-  printf( "Simulating %d dendrites with %d compartments per dendrite.\n",
-		  num_dendrs, num_comps );
+  if (cmd_args.net.neurons > 0 || cmd_args.net.file) {
+	fprintf( stderr, "Networks of neurons are simulated by mpi_hh!\n" );
+	return 1;
+  }
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Create files where results will be stored.
-  //////////////////////////////////////////////////////////////////////////////
+  if (cmd_args.serve) {
+	// Only run jobs sent by clients.
+	return serve( cmd_args.serve, argv[0] ) ? 0 : 1;
+  }
 
-  // Generate the graph and data file names.
-  time_t t = time(NULL);
-  struct tm *tmp = localtime( &t );
-  strftime( time_str, 14, "%m%d%y_%H%M%S", tmp );
-
-  // The resulting filenames will resemble
-  //    pWWdXXcYY_MoDaYe_HoMiSe.xxx
-  // where 'WW' is the number of processes, 'XX' is the number of dendrites,
-  // 'YY' the number of compartments, and 'MoDaYe...' the time at which this
-  // simulation was run.
-  sprintf( graph_fname, "graphs/p1d%dc%d_%s.png",
-		   num_dendrs, num_comps, time_str );
-  sprintf( data_fname,  "data/p1d%dc%d_%s.dat",
-		   num_dendrs, num_comps, time_str );
-
-  // Verify that the graphs/ and data/ directories exist. Create them if they
-  // don't.
-  struct stat stat_buf;
-  stat( "graphs", &stat_buf );
-  if ((!S_ISDIR(stat_buf.st_mode)) && (mkdir( "graphs", 0700 ) != 0)) {
-	fprintf( stderr, "Could not create 'graphs' directory!\n" );
-	exit(1);
+  if (cmd_args.validate_soma) {
+	// Only compare the soma integrators.
+	return somaValidate( num_dendrs * INJCURMEAN, stdout ) ? 0 : 1;
   }
 
-  stat( "data", &stat_buf );
-  if ((!S_ISDIR(stat_buf.st_mode)) && (mkdir( "data", 0700 ) != 0)) {
-	fprintf( stderr, "Could not create 'data' directory!\n" );
-	exit(1);
+  if (cmd_args.validate_reduce) {
+	// Only compare the reduced dendrites with the full ones.
+	return dendrReduceValidate( num_dendrs, num_comps + 2, &cmd_args.kernel,
+								cmd_args.soma, stdout ) ? 0 : 1;
   }
 
-  // Verify that we can open files where results will be stored.
-  if ((data_file = fopen(data_fname, "wb")) == NULL) {
-	fprintf(stderr, "Can't open %s file!\n", data_fname);
+  if (cmd_args.validate_kernel) {
+	// Only compare the dendrite kernel with the reference one.
+	return dendrKernelValidate( num_dendrs, num_comps + 2, &cmd_args.kernel,
+								cmd_args.soma, stdout ) ? 0 : 1;
+  }
+
+  if (cmd_args.bench_placement) {
+	// Only report what the placement options are worth.
+	return workersBenchmark( cmd_args.num_threads, num_dendrs, num_comps + 2,
+							 &cmd_args.kernel, &cmd_args.place, STEPS,
+							 stdout ) ? 0 : 1;
+  }
+
+  if (cmd_args.bench_shapes) {
+	// Only report what the specialized kernels are worth.
+	return dendrTopoBenchmark( num_dendrs, stdout ) ? 0 : 1;
+  }
+
+  if (cmd_args.write_stimulus) {
+	// Only save the built-in stimulus, e.g. as a template for recorded ones.
+	return stimWrite( cmd_args.write_stimulus, num_dendrs, STEPS,
+					  cmd_args.duration - 1 ) ? 0 : 1;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Open the sink where results will be stored.
+  //////////////////////////////////////////////////////////////////////////////
+
+  pinfo.sim_time = cmd_args.duration;
+  pinfo.int_step = 1.0 / (double) STEPS;
+  pinfo.num_comps = num_comps;
+  pinfo.num_dendrs = num_dendrs;
+  pinfo.exec_time = 0.0;
+  pinfo.slaves = 0;
+
+  if (!sinkOpen( &sink, cmd_args.output_type, cmd_args.output_name, &pinfo,
+				 1, cmd_args.events )) {
 	exit(1);
-  } else {
-	printf( "\nData will be stored in %s\n", data_fname );
+  }
+  log_file = sink.log;
+
+  // Plots are made from the data file, so only file sinks can be plotted.
+  plot_png    = plot_png && sinkHasFile( &sink );
+  plot_screen = plot_screen && sink.type == SINK_TEXT;
+
+  if (!cmd_args.quiet) {
+	fprintf( log_file,
+			 "Simulating %d dendrites with %d compartments per dendrite.\n",
+			 num_dendrs, num_comps );
+	if (cmd_args.kernel.reduce) {
+	  fprintf( log_file, "Each thread's dendrites are reduced to one "
+			   "equivalent cable.\n" );
+	}
+	if (sink.type != SINK_NULL) {
+	  fprintf( log_file, "\nData will be stored in %s\n", sink.data_fname );
+	}
+	if (plot_png) {
+	  fprintf( log_file, "Graph will be stored in %s\n", sink.graph_fname );
+	}
   }
 
-  if (ISDEF_PLOT_PNG && (graph_file = fopen(graph_fname, "wb")) == NULL) {
-	fprintf(stderr, "Can't open %s file!\n", graph_fname);
+  //////////////////////////////////////////////////////////////////////////////
+  // Pick the engine configuration for this shape if asked to.
+  //////////////////////////////////////////////////////////////////////////////
+
+  if (cmd_args.autotune &&
+	  !tune( &cmd_args, cmd_args.quiet ? NULL : log_file )) {
+	fprintf( stderr, "Auto-tuning failed!\n" );
 	exit(1);
-  } else {
-	printf( "Graph will be stored in %s\n", graph_fname );
-	fclose(graph_file);
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -141,74 +589,63 @@ int main( int argc, char **argv )
   // The first compartment is a dummy and the last is connected to the soma.
   num_comps = num_comps + 2;
 
-  // Initialize 'y' with precomputed values from the HH model.
-  y[0] = VREST;
-  y[1] = 0.037;
-  y[2] = 0.0148;
-  y[3] = 0.9959;
-
-  // Setup parameters for the soma.
-  soma_params[0] = 1.0 / (double) STEPS;  // dt
-  soma_params[1] = 0.0;  // Direct current injection into soma is always zero.
-  soma_params[2] = 0.0;  // Dendritic current injected into soma. This is the
-						 // value that our simulation will update at each step.
+  if (!cmd_args.quiet) {
+	fprintf( log_file, "\nIntegration step dt = %f\n", 1.0 / (double) STEPS );
+	if (cmd_args.stimulus) {
+	  fprintf( log_file, "Tip currents are read from %s\n",
+			   cmd_args.stimulus );
+	}
+	if (cmd_args.soma_substeps > 1) {
+	  fprintf( log_file, "Dendrite step = %f (%d soma substeps, %s current)\n",
+			   (double) cmd_args.soma_substeps / (double) STEPS,
+			   cmd_args.soma_substeps,
+			   cmd_args.hold_current ? "held" : "interpolated" );
+	}
+  }
 
-  printf( "\nIntegration step dt = %f\n", soma_params[0]);
+  if (!cmd_args.stimulus) {
+	stimGenerator( &stim );
+  } else if (!stimOpen( &stim, cmd_args.stimulus, num_dendrs,
+						cmd_args.duration, cmd_args.stim_window )) {
+	exit(1);
+  }
+  overrides.count = 0;
+  overrides.list = NULL;
+  if (cmd_args.dendr_params &&
+	  !dendrOverridesLoad( &overrides, cmd_args.dendr_params )) {
+	exit(1);
+  }
 
   // Start the clock.
   gettimeofday( &start, NULL );
 
   // Initialize the potential of each dendrite compartment to the rest voltage.
-  dendr_volt = (double**) malloc( num_dendrs * sizeof(double*) );
-  for (i = 0; i < num_dendrs; i++) {
-	dendr_volt[i] = (double*) malloc( num_comps * sizeof(double) );
-	for (j = 0; j < num_comps; j++) {
-	  dendr_volt[i][j] = VREST;
-	}
+  // Each worker thread does this for its own dendrites.
+  if (!workersInit( &dendrites, cmd_args.num_threads, num_dendrs, num_comps,
+					&cmd_args.kernel, &cmd_args.place )) {
+	fprintf( stderr, "Could not allocate dendrites!\n" );
+	exit(1);
   }
+  workersStimulus( &dendrites, &stim );
+  if (!workersParams( &dendrites, cmd_args.dendr_params ? &overrides : NULL )) {
+	fprintf( stderr, "Could not build the dendrite shapes!\n" );
+	exit(1);
+  }
+  dendrOverridesFree( &overrides );
 
   //////////////////////////////////////////////////////////////////////////////
   // Main computation.
   //////////////////////////////////////////////////////////////////////////////
 
-  // Record the initial potential value in our results array.
-  res[0] = y[0];
-
-  // Loop over milliseconds.
-  for (t_ms = 1; t_ms < COMPTIME; t_ms++) {
-
-	// Loop over integration time steps in each millisecond.
-	for (step = 0; step < STEPS; step++) {
-	  soma_params[2] = 0.0;
-
-	  // Loop over all the dendrites.
-	  for (dendrite = 0; dendrite < num_dendrs; dendrite++) {
-		// This will update Vm in all compartments and will give a new injected
-		// current value from last compartment into the soma.
-		current = dendriteStep( dendr_volt[ dendrite ],
-								step + dendrite + 1,
-								num_comps,
-								soma_params[0],
-								y[0] );
-
-		// Accumulate the current generated by the dendrite.
-		soma_params[2] += current;
-	  }
-
-	  // Store previous HH model parameters.
-	  y0[0] = y[0]; y0[1] = y[1]; y0[2] = y[2]; y0[3] = y[3];
-
-	  // This is the main HH computation. It updates the potential, Vm, of the
-	  // soma, injects current, and calculates action potential. Good stuff.
-	  soma(dydt, y, soma_params);
-	  rk4Step(y, y0, dydt, NUMVAR, soma_params, 1, soma);
-	}
-
-	// Record the membrane potential of the soma at this simulation step.
-	// Let's show where we are in terms of computation.
-	printf("\r%02d ms",t_ms); fflush(stdout);
-
-	res[t_ms] = y[0];
+  if (cmd_args.telemetry) {
+	telemetryOpen( &tel, cmd_args.telemetry_name, 1, "seq_hh", getpid(),
+				   num_dendrs, num_comps - 2, cmd_args.duration,
+				   dendrites.num_threads );
+  }
+  num_spikes = simulate( &cmd_args, &dendrites, &stim, &sink, log_file, res,
+						 spike_times, cmd_args.telemetry ? &tel : NULL );
+  if (cmd_args.telemetry) {
+	telemetryClose( &tel );
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -220,47 +657,45 @@ int main( int argc, char **argv )
   gettimeofday( &stop, NULL );
   timersub( &stop, &start, &diff );
   exec_time = (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
-  printf("\n\nExecution time: %f seconds.\n", exec_time);
-
-  // Record the parameters for this simulation as well as data for gnuplot.
-  fprintf( data_file,
-		   "# Vm for HH model. "
-		   "Simulation time: %d ms, Integration step: %f ms, "
-		   "Compartments: %d, Dendrites: %d, Execution time: %f s, "
-		   "Slave processes: %d\n",
-		   COMPTIME, soma_params[0], num_comps - 2, num_dendrs, exec_time,
-		   0 );
-  fprintf( data_file, "# X Y\n");
+  fprintf(log_file, "%sExecution time: %f seconds.\n",
+		  cmd_args.quiet ? "" : "\n\n", exec_time);
+  if (!cmd_args.quiet) {
+	fprintf(log_file, "Spikes detected: %d\n", num_spikes);
+	if (dendrites.num_threads > 1) {
+	  fprintf(log_file, "\n");
+	  workersReport( &dendrites, log_file );
+	}
+  }
 
-  for (t_ms = 0; t_ms < COMPTIME; t_ms++) {
-	fprintf(data_file, "%d %f\n", t_ms, res[t_ms]);
+  // Flush and close the sink so that the data file is complete before it is
+  // plotted.
+  if (!sinkClose( &sink, exec_time )) {
+	fprintf( stderr, "Could not write results to %s!\n", sink.data_fname );
   }
-  fflush(data_file);  // Flush and close the data file so that gnuplot will
-  fclose(data_file);  // see it.
 
   //////////////////////////////////////////////////////////////////////////////
   // Plot results if approriate macro was defined.
   //////////////////////////////////////////////////////////////////////////////
-  if (ISDEF_PLOT_PNG || ISDEF_PLOT_SCREEN) {
-	pinfo.sim_time = COMPTIME;
-	pinfo.int_step = soma_params[0];
-	pinfo.num_comps = num_comps - 2;
-	pinfo.num_dendrs = num_dendrs;
-	pinfo.exec_time = exec_time;
-	pinfo.slaves = 0;
+  pinfo.exec_time = exec_time;
+
+  if (plot_png) {
+	plotTrace( &pinfo, res, cmd_args.duration, sink.graph_fname );
   }
+  if (plot_screen) { plotData( &pinfo, sink.data_fname, NULL ); }
 
-  if (ISDEF_PLOT_PNG) {    plotData( &pinfo, data_fname, graph_fname ); }
-  if (ISDEF_PLOT_SCREEN) { plotData( &pinfo, data_fname, NULL ); }
+  if (cmd_args.snapshot &&
+	  !snapshot( cmd_args.snapshot, &dendrites, cmd_args.duration, res,
+				 spike_times, num_spikes )) {
+	fprintf( stderr, "Could not write the snapshot to %s!\n",
+			 cmd_args.snapshot );
+  }
 
   //////////////////////////////////////////////////////////////////////////////
   // Free up allocated memory.
   //////////////////////////////////////////////////////////////////////////////
 
-  for(i = 0; i < num_dendrs; i++) {
-	free(dendr_volt[i]);
-  }
-  free(dendr_volt);
+  workersFree( &dendrites );
+  stimClose( &stim );
 
   return 0;
 }
@@ -0,0 +1,131 @@
+#include "server.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int socketAddress( const char *path, struct sockaddr_un *addr )
+{
+  memset( addr, 0, sizeof(*addr) );
+  addr->sun_family = AF_UNIX;
+  if (strlen( path ) >= sizeof(addr->sun_path)) {
+    fprintf( stderr, "Socket path %s is too long!\n", path );
+    return 0;
+  }
+  strcpy( addr->sun_path, path );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int serverListen( const char *path )
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  if (!socketAddress( path, &addr )) {
+    return -1;
+  }
+
+  fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if (fd < 0) {
+    fprintf( stderr, "Can't create socket!\n" );
+    return -1;
+  }
+
+  unlink( path );
+  if (bind( fd, (struct sockaddr*) &addr, sizeof(addr) ) != 0 ||
+      listen( fd, 16 ) != 0) {
+    fprintf( stderr, "Can't listen on %s!\n", path );
+    close( fd );
+    return -1;
+  }
+  return fd;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int serverReadJob( int fd, char *line, size_t size )
+{
+  size_t len = 0;
+  ssize_t n;
+
+  while (len + 1 < size) {
+    n = read( fd, line + len, 1 );
+    if (n <= 0) {
+      return 0;
+    }
+    if (line[len] == '\n') {
+      line[len] = '\0';
+      return 1;
+    }
+    len++;
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int serverSplitArgs( char *line, char *name, char **argv )
+{
+  int argc = 0;
+  char *tok, *save;
+
+  argv[ argc++ ] = name;
+  for (tok = strtok_r( line, " \t\r", &save );
+       tok && argc < JOB_MAX_ARGS;
+       tok = strtok_r( NULL, " \t\r", &save )) {
+    argv[ argc++ ] = tok;
+  }
+  argv[ argc ] = NULL;
+  return argc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int clientRun( const char *path, int argc, char **argv, FILE *out )
+{
+  struct sockaddr_un addr;
+  char buf[ JOB_LINE_LEN ];
+  size_t len = 0;
+  ssize_t n;
+  int fd, i;
+
+  if (!socketAddress( path, &addr )) {
+    return 0;
+  }
+
+  // The job is the arguments on a single line.
+  buf[0] = '\0';
+  for (i = 0; i < argc; i++) {
+    len += snprintf( buf + len, sizeof(buf) - len, "%s%s", i ? " " : "",
+                     argv[i] );
+    if (len + 2 >= sizeof(buf)) {
+      fprintf( stderr, "Job is too long!\n" );
+      return 0;
+    }
+  }
+  buf[ len++ ] = '\n';
+
+  fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if (fd < 0 || connect( fd, (struct sockaddr*) &addr, sizeof(addr) ) != 0) {
+    fprintf( stderr, "Can't connect to %s!\n", path );
+    if (fd >= 0) close( fd );
+    return 0;
+  }
+  if (write( fd, buf, len ) != (ssize_t) len) {
+    fprintf( stderr, "Can't send job to %s!\n", path );
+    close( fd );
+    return 0;
+  }
+
+  while ((n = read( fd, buf, sizeof(buf) )) > 0) {
+    fwrite( buf, 1, n, out );
+    fflush( out );
+  }
+  close( fd );
+  return n == 0;
+}
@@ -0,0 +1,130 @@
+#include "shm_reduce.h"
+#include "repro_mpi.h"
+#include "constants.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void waitRound( long *seq, long round, int max_spins )
+{
+  int spins = 0;
+
+  while (__atomic_load_n( seq, __ATOMIC_ACQUIRE ) < round) {
+    if (++spins > max_spins) {
+      sched_yield();
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int shmReduceInit( ShmReduce *sr, MPI_Comm comm )
+{
+  MPI_Aint size;
+  int rank, leader, disp, i;
+  void *base;
+
+  MPI_Comm_rank( comm, &rank );
+  sr->root = rank == 0;
+  MPI_Comm_split_type( comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+                       &sr->node_comm );
+  MPI_Comm_rank( sr->node_comm, &sr->node_rank );
+  MPI_Comm_size( sr->node_comm, &sr->node_size );
+
+  // With more processes than CPUs the one being waited for may need ours.
+  sr->spins = sr->node_size > sysconf( _SC_NPROCESSORS_ONLN ) ? 0 :
+              BARRIER_SPINS;
+
+  // Keyed by rank, so rank 0 leads its node and the leaders' group.
+  leader = sr->node_rank == 0;
+  MPI_Comm_split( comm, leader ? 0 : MPI_UNDEFINED, rank, &sr->leader_comm );
+  MPI_Allreduce( &leader, &sr->num_nodes, 1, MPI_INT, MPI_SUM, comm );
+
+  size = leader ? (MPI_Aint) (sr->node_size + 1) * sizeof(ShmSlot) : 0;
+  if (MPI_Win_allocate_shared( size, sizeof(ShmSlot), MPI_INFO_NULL,
+                               sr->node_comm, &base, &sr->win ) !=
+      MPI_SUCCESS) {
+    return 0;
+  }
+  MPI_Win_shared_query( sr->win, 0, &size, &disp, &sr->slots );
+
+  if (leader) {
+    for (i = 0; i <= sr->node_size; i++) {
+      reproSumZero( &sr->slots[i].current );
+      sr->slots[i].value = 0.0;
+      sr->slots[i].seq = 0;
+    }
+  }
+  sr->cur_round = 0;
+  sr->v_round = 0;
+
+  // Passive access for the whole run; the slots are synchronized by hand.
+  MPI_Win_lock_all( MPI_MODE_NOCHECK, sr->win );
+  MPI_Barrier( sr->node_comm );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void shmReduceFree( ShmReduce *sr )
+{
+  MPI_Win_unlock_all( sr->win );
+  MPI_Win_free( &sr->win );
+  if (sr->leader_comm != MPI_COMM_NULL) {
+    MPI_Comm_free( &sr->leader_comm );
+  }
+  MPI_Comm_free( &sr->node_comm );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double shmReduceCurrent( ShmReduce *sr, const ReproSum *current )
+{
+  long const round = ++sr->cur_round;
+  ReproSum sum, total;
+  int i;
+
+  if (sr->node_rank != 0) {
+    // The leader read the previous round before the last potential was
+    // published, so the slot is free.
+    sr->slots[ sr->node_rank ].current = *current;
+    __atomic_store_n( &sr->slots[ sr->node_rank ].seq, round,
+                      __ATOMIC_RELEASE );
+    return reproSumValue( current );
+  }
+
+  sum = *current;
+  for (i = 1; i < sr->node_size; i++) {
+    waitRound( &sr->slots[i].seq, round, sr->spins );
+    reproSumMerge( &sum, &sr->slots[i].current );
+  }
+
+  if (sr->num_nodes > 1) {
+    MPI_Reduce( &sum, &total, 1, reproSumType(), reproSumOp(), 0,
+                sr->leader_comm );
+    sum = total;
+  }
+  return reproSumValue( sr->root ? &sum : current );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double shmBcastPotential( ShmReduce *sr, double v_m )
+{
+  long const round = ++sr->v_round;
+  ShmSlot *slot = &sr->slots[ sr->node_size ];
+
+  if (sr->node_rank != 0) {
+    waitRound( &slot->seq, round, sr->spins );
+    return slot->value;
+  }
+
+  if (sr->num_nodes > 1) {
+    MPI_Bcast( &v_m, 1, MPI_DOUBLE, 0, sr->leader_comm );
+  }
+  slot->value = v_m;
+  __atomic_store_n( &slot->seq, round, __ATOMIC_RELEASE );
+  return v_m;
+}
@@ -0,0 +1,413 @@
+#include "sink.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Operations implemented by every backend. A NULL entry means the backend has
+ * nothing to do at that point.
+ */
+typedef struct SinkOps {
+  const char *name;
+  int  (*open)( OutputSink *sink, const char *name );
+  void (*sample)( OutputSink *sink, int t_ms, double v );
+  int  (*close)( OutputSink *sink );
+} SinkOps;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void fillBinHeader( OutputSink *sink, BinHeader *hdr )
+{
+  memset( hdr, 0, sizeof(BinHeader) );
+  memcpy( hdr->magic, BIN_MAGIC, sizeof(hdr->magic) );
+  hdr->sim_time    = sink->info.sim_time;
+  hdr->num_comps   = sink->info.num_comps;
+  hdr->num_dendrs  = sink->info.num_dendrs;
+  hdr->slaves      = sink->info.slaves;
+  hdr->num_samples = sink->num_samples;
+  hdr->kind        = sink->events ? BIN_KIND_EVENTS : BIN_KIND_TRACE;
+  hdr->int_step    = sink->info.int_step;
+  hdr->exec_time   = sink->info.exec_time;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void writeTextHeader( OutputSink *sink, FILE *fp )
+{
+  double rate, mean_isi, cv_isi;
+
+  // Record the parameters for this simulation as well as data for gnuplot.
+  fprintf( fp,
+           "# %s for HH model. "
+           "Simulation time: %d ms, Integration step: %f ms, "
+           "Compartments: %d, Dendrites: %d, Execution time: %f s, "
+           "Slave processes: %d\n", sink->events ? "Spikes" : "Vm",
+           sink->info.sim_time, sink->info.int_step, sink->info.num_comps,
+           sink->info.num_dendrs, sink->info.exec_time, sink->info.slaves );
+
+  if (sink->events) {
+    spikeSummary( &sink->spikes, sink->info.sim_time, &rate, &mean_isi,
+                  &cv_isi );
+    fprintf( fp, "# Spikes: %d, Rate: %f Hz, Mean ISI: %f ms, ISI CV: %f\n",
+             sink->spikes.num_spikes, rate, mean_isi, cv_isi );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int makeDir( const char *dir )
+{
+  struct stat stat_buf;
+
+  if ((stat( dir, &stat_buf ) != 0 || !S_ISDIR(stat_buf.st_mode)) &&
+      mkdir( dir, 0700 ) != 0) {
+    fprintf( stderr, "Could not create '%s' directory!\n", dir );
+    return 0;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int openDataFile( OutputSink *sink, const char *name, const char *ext,
+                         int num_procs )
+{
+  char time_str[14], base[ FNAME_LEN - 20 ];
+  int suffix;
+
+  if (name) {
+    snprintf( sink->data_fname, FNAME_LEN, "%s", name );
+    snprintf( sink->graph_fname, FNAME_LEN, "%s.png", name );
+    if ((sink->fp = fopen( sink->data_fname, "wb" )) == NULL) {
+      fprintf( stderr, "Can't open %s file!\n", sink->data_fname );
+      return 0;
+    }
+    return 1;
+  }
+
+  // Verify that the graphs/ and data/ directories exist. Create them if they
+  // don't.
+  if (!makeDir( "graphs" ) || !makeDir( "data" )) {
+    return 0;
+  }
+
+  // The resulting filenames will resemble
+  //    pWWdXXcYY_MoDaYe_HoMiSe.xxx
+  // where 'WW' is the number of processes, 'XX' is the number of dendrites,
+  // 'YY' the number of compartments, and 'MoDaYe...' the time at which this
+  // simulation was run.
+  time_t t = time( NULL );
+  strftime( time_str, 14, "%m%d%y_%H%M%S", localtime( &t ) );
+  snprintf( base, sizeof(base), "p%dd%dc%d_%s", num_procs,
+            sink->info.num_dendrs, sink->info.num_comps, time_str );
+
+  // Never overwrite the results of a run started in the same second; append
+  // _2, _3, ... instead.
+  for (suffix = 1; suffix < 1000; suffix++) {
+    if (suffix == 1) {
+      snprintf( sink->data_fname, FNAME_LEN, "data/%s.%s", base, ext );
+      snprintf( sink->graph_fname, FNAME_LEN, "graphs/%s.png", base );
+    } else {
+      snprintf( sink->data_fname, FNAME_LEN, "data/%s_%d.%s", base, suffix,
+                ext );
+      snprintf( sink->graph_fname, FNAME_LEN, "graphs/%s_%d.png", base,
+                suffix );
+    }
+
+    int fd = open( sink->data_fname, O_WRONLY | O_CREAT | O_EXCL, 0644 );
+    if (fd >= 0) {
+      sink->fp = fdopen( fd, "wb" );
+      return sink->fp != NULL;
+    }
+    if (errno != EEXIST) {
+      break;
+    }
+  }
+
+  fprintf( stderr, "Can't open %s file!\n", sink->data_fname );
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Text backend: samples are buffered and written in gnuplot format on close.
+////////////////////////////////////////////////////////////////////////////////
+static int textOpen( OutputSink *sink, const char *name )
+{
+  return openDataFile( sink, name, "dat", sink->info.slaves + 1 );
+}
+
+static void textSample( OutputSink *sink, int t_ms, double v )
+{
+  (void) t_ms;
+  if (sink->num_samples == sink->capacity) {
+    sink->capacity = sink->capacity ? sink->capacity * 2 :
+                                      sink->info.sim_time + 1;
+    sink->samples = (double*) realloc( sink->samples,
+                                       sink->capacity * sizeof(double) );
+  }
+  sink->samples[ sink->num_samples ] = v;
+}
+
+static int textClose( OutputSink *sink )
+{
+  int i, ok;
+
+  writeTextHeader( sink, sink->fp );
+  fprintf( sink->fp, sink->events ? "# T\n" : "# X Y\n" );
+  for (i = 0; i < sink->num_samples; i++) {
+    if (sink->events) {
+      fprintf( sink->fp, "%f\n", sink->samples[i] );
+    } else {
+      fprintf( sink->fp, "%d %f\n", i, sink->samples[i] );
+    }
+  }
+
+  ok = fclose( sink->fp ) == 0;
+  free( sink->samples );
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Binary backend: header, then samples appended as they come. The header is
+// rewritten on close once the sample count and execution time are known.
+////////////////////////////////////////////////////////////////////////////////
+static int binaryOpen( OutputSink *sink, const char *name )
+{
+  BinHeader hdr;
+
+  if (!openDataFile( sink, name, "bin", sink->info.slaves + 1 )) {
+    return 0;
+  }
+  fillBinHeader( sink, &hdr );
+  return fwrite( &hdr, sizeof(hdr), 1, sink->fp ) == 1;
+}
+
+static void binarySample( OutputSink *sink, int t_ms, double v )
+{
+  (void) t_ms;
+  fwrite( &v, sizeof(double), 1, sink->fp );
+}
+
+static int binaryClose( OutputSink *sink )
+{
+  BinHeader hdr;
+  int ok;
+
+  fillBinHeader( sink, &hdr );
+  ok = fseek( sink->fp, 0, SEEK_SET ) == 0 &&
+       fwrite( &hdr, sizeof(hdr), 1, sink->fp ) == 1;
+  return (fclose( sink->fp ) == 0) && ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Stdout backend: text streamed line by line so that a consumer on the other
+// end of a pipe sees each sample as soon as it is produced. The header, which
+// contains the execution time, comes last.
+////////////////////////////////////////////////////////////////////////////////
+static void streamStart( OutputSink *sink, FILE *fp, const char *desc )
+{
+  snprintf( sink->data_fname, FNAME_LEN, "%s", desc );
+  sink->fp = fp;
+  fprintf( sink->fp, sink->events ? "# T\n" : "# X Y\n" );
+}
+
+static int stdoutOpen( OutputSink *sink, const char *name )
+{
+  (void) name;
+  streamStart( sink, stdout, "<stdout>" );
+  return 1;
+}
+
+static void stdoutSample( OutputSink *sink, int t_ms, double v )
+{
+  if (sink->events) {
+    fprintf( sink->fp, "%f\n", v );
+  } else {
+    fprintf( sink->fp, "%d %f\n", t_ms, v );
+  }
+  fflush( sink->fp );
+}
+
+static int stdoutClose( OutputSink *sink )
+{
+  writeTextHeader( sink, sink->fp );
+  return fflush( sink->fp ) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Shared memory backend.
+////////////////////////////////////////////////////////////////////////////////
+static int shmOpen( OutputSink *sink, const char *name )
+{
+  // With a refractory period of at least 1 ms there are never more spikes
+  // than trace samples.
+  int fd, capacity = sink->info.sim_time + 1;
+
+  if (name) {
+    snprintf( sink->data_fname, FNAME_LEN, "%s%s", name[0] == '/' ? "" : "/",
+              name );
+  } else {
+    snprintf( sink->data_fname, FNAME_LEN, "/hh_%d", (int) getpid() );
+  }
+
+  sink->shm_size = sizeof(ShmHeader) + capacity * sizeof(double);
+  fd = shm_open( sink->data_fname, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+  if (fd < 0 || ftruncate( fd, sink->shm_size ) != 0) {
+    fprintf( stderr, "Can't create shared memory object %s!\n",
+             sink->data_fname );
+    if (fd >= 0) close( fd );
+    return 0;
+  }
+
+  sink->shm = (ShmHeader*) mmap( NULL, sink->shm_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED, fd, 0 );
+  close( fd );
+  if (sink->shm == MAP_FAILED) {
+    fprintf( stderr, "Can't map shared memory object %s!\n",
+             sink->data_fname );
+    sink->shm = NULL;
+    return 0;
+  }
+
+  memcpy( sink->shm->magic, SHM_MAGIC, sizeof(sink->shm->magic) );
+  fillBinHeader( sink, &sink->shm->info );
+  sink->shm->capacity = capacity;
+  sink->shm->num_samples = 0;
+  sink->shm->done = 0;
+  return 1;
+}
+
+static void shmSample( OutputSink *sink, int t_ms, double v )
+{
+  double *data = (double*) (sink->shm + 1);
+
+  (void) t_ms;
+  if (sink->num_samples < sink->shm->capacity) {
+    data[ sink->num_samples ] = v;
+    __atomic_store_n( &sink->shm->num_samples, sink->num_samples + 1,
+                      __ATOMIC_RELEASE );
+  }
+}
+
+static int shmClose( OutputSink *sink )
+{
+  fillBinHeader( sink, &sink->shm->info );
+  __atomic_store_n( &sink->shm->done, 1, __ATOMIC_RELEASE );
+
+  // The object is left in place for the consumer, which is expected to
+  // shm_unlink() it when done.
+  return munmap( sink->shm, sink->shm_size ) == 0;
+}
+
+// Backend table, indexed by SinkType.
+static const SinkOps sink_ops[] = {
+  { "null",   NULL,       NULL,         NULL },
+  { "text",   textOpen,   textSample,   textClose },
+  { "binary", binaryOpen, binarySample, binaryClose },
+  { "stdout", stdoutOpen, stdoutSample, stdoutClose },
+  { "shm",    shmOpen,    shmSample,    shmClose },
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int sinkParseType( const char *name, SinkType *type )
+{
+  int i;
+
+  for (i = 0; i < (int) (sizeof(sink_ops) / sizeof(sink_ops[0])); i++) {
+    if (strcmp( name, sink_ops[i].name ) == 0) {
+      *type = (SinkType) i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int sinkOpen( OutputSink *sink, SinkType type, const char *name,
+              PlotInfo *pinfo, int num_procs, int events )
+{
+  memset( sink, 0, sizeof(OutputSink) );
+  sink->type = type;
+  sink->events = events;
+  sink->info = *pinfo;
+  sink->info.slaves = num_procs - 1;
+  sink->info.exec_time = 0.0;
+
+  // Data streamed to stdout must not be mixed with progress messages.
+  sink->log = (type == SINK_STDOUT) ? stderr : stdout;
+
+  if (sink_ops[type].open && !sink_ops[type].open( sink, name )) {
+    return 0;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int sinkOpenStream( OutputSink *sink, FILE *fp, PlotInfo *pinfo, int events )
+{
+  if (!sinkOpen( sink, SINK_NULL, NULL, pinfo, 1, events )) {
+    return 0;
+  }
+  sink->type = SINK_STDOUT;
+  sink->log = stderr;
+  streamStart( sink, fp, "<stream>" );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void sinkSample( OutputSink *sink, int t_ms, double v )
+{
+  if (sink->events) {
+    return;
+  }
+  if (sink_ops[ sink->type ].sample) {
+    sink_ops[ sink->type ].sample( sink, t_ms, v );
+  }
+  sink->num_samples++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void sinkSpike( OutputSink *sink, double t_spike )
+{
+  spikeStatsAdd( &sink->spikes, t_spike );
+  if (!sink->events) {
+    return;
+  }
+
+  // Event sinks store spike times where trace sinks store potentials.
+  if (sink_ops[ sink->type ].sample) {
+    sink_ops[ sink->type ].sample( sink, (int) t_spike, t_spike );
+  }
+  sink->num_samples++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int sinkClose( OutputSink *sink, double exec_time )
+{
+  sink->info.exec_time = exec_time;
+  if (sink_ops[ sink->type ].close) {
+    return sink_ops[ sink->type ].close( sink );
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int sinkHasFile( OutputSink *sink )
+{
+  return !sink->events &&
+         (sink->type == SINK_TEXT || sink->type == SINK_BINARY);
+}
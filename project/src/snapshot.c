@@ -0,0 +1,129 @@
+#include "snapshot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+FILE *snapshotOpen( const char *path, int num_dendrs, int num_comps,
+                    int sim_time, const double *trace, const double *spikes,
+                    int num_spikes )
+{
+  FILE *fp;
+  int i;
+
+  fp = fopen( path, "w" );
+  if (!fp) {
+    fprintf( stderr, "Can't create snapshot %s!\n", path );
+    return NULL;
+  }
+
+  fprintf( fp, "# Snapshot of an HH run. Dendrites: %d, Compartments: %d, "
+           "Simulation time: %d ms\n", num_dendrs, num_comps, sim_time );
+  fprintf( fp, "trace %d", sim_time );
+  for (i = 0; i < sim_time; i++) {
+    fprintf( fp, " %.17g", trace[i] );
+  }
+  fprintf( fp, "\nspikes %d", num_spikes );
+  for (i = 0; i < num_spikes; i++) {
+    fprintf( fp, " %.17g", spikes[i] );
+  }
+  fprintf( fp, "\n" );
+  return fp;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void snapshotDendrite( FILE *fp, int index, const double *v, int num_comps )
+{
+  int j;
+
+  fprintf( fp, "dendrite %d", index );
+  for (j = 0; j < num_comps; j++) {
+    fprintf( fp, " %.17g", v[j] );
+  }
+  fprintf( fp, "\n" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int readValues( FILE *fp, double *values, int count )
+{
+  int i;
+
+  for (i = 0; i < count; i++) {
+    if (fscanf( fp, "%lf", &values[i] ) != 1) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int snapshotRead( Snapshot *snap, const char *path )
+{
+  char line[ 256 ], word[ 16 ], *p;
+  int n, ok = 1;
+  FILE *fp;
+
+  memset( snap, 0, sizeof(*snap) );
+  fp = fopen( path, "r" );
+  if (!fp) {
+    fprintf( stderr, "Can't open snapshot %s!\n", path );
+    return 0;
+  }
+
+  // The records are long, so only the comment is read as a line.
+  if (!fgets( line, sizeof(line), fp ) ||
+      !(p = strstr( line, "Dendrites:" )) ||
+      sscanf( p, "Dendrites: %d, Compartments: %d, Simulation time: %d",
+              &snap->num_dendrs, &snap->num_comps, &snap->sim_time ) != 3 ||
+      snap->num_dendrs <= 0 || snap->num_comps <= 0 || snap->sim_time <= 0) {
+    fprintf( stderr, "%s is not a snapshot!\n", path );
+    fclose( fp );
+    return 0;
+  }
+
+  while (ok && fscanf( fp, "%15s %d", word, &n ) == 2) {
+    if (strcmp( word, "trace" ) == 0 && n == snap->sim_time &&
+        !snap->trace) {
+      snap->trace = (double*) malloc( n * sizeof(double) );
+      ok = snap->trace && readValues( fp, snap->trace, n );
+    } else if (strcmp( word, "spikes" ) == 0 && n >= 0 && !snap->spikes) {
+      snap->num_spikes = n;
+      snap->spikes = (double*) malloc( (n + 1) * sizeof(double) );
+      ok = snap->spikes && readValues( fp, snap->spikes, n );
+    } else if (strcmp( word, "dendrite" ) == 0 && n >= 0 &&
+               n < snap->num_dendrs) {
+      if (!snap->volt) {
+        snap->volt = (double*) calloc( (size_t) snap->num_dendrs *
+                                       snap->num_comps, sizeof(double) );
+      }
+      ok = snap->volt &&
+           readValues( fp, snap->volt + (size_t) n * snap->num_comps,
+                       snap->num_comps );
+    } else {
+      ok = 0;
+    }
+  }
+  fclose( fp );
+
+  if (!ok || !snap->trace || !snap->spikes) {
+    fprintf( stderr, "%s is not a complete snapshot!\n", path );
+    snapshotFree( snap );
+    return 0;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void snapshotFree( Snapshot *snap )
+{
+  free( snap->trace );
+  free( snap->spikes );
+  free( snap->volt );
+  snap->trace = snap->spikes = snap->volt = NULL;
+}
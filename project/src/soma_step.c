@@ -0,0 +1,216 @@
+#include "soma_step.h"
+#include "lib_hh.h"
+#include "spike.h"
+#include "constants.h"
+
+#include <math.h>
+#include <string.h>
+#include <sys/time.h>
+
+// Integrator names, indexed by SomaMethod.
+static const char *method_names[] = { "rk4", "rush-larsen",
+                                      "parker-sochacki" };
+
+#define NUM_METHODS ((int) (sizeof(method_names) / sizeof(method_names[0])))
+
+// Tolerance of the Parker-Sochacki integrator.
+static double ps_tol = PS_TOL;
+
+// Series orders summed and steps taken by the Parker-Sochacki integrator.
+static long ps_orders = 0, ps_steps = 0;
+
+// Integration steps per ms tried by somaValidate, the model step first.
+static const int validate_steps[] = { STEPS, 1000, 100, 40, 20, 10, 5, 2 };
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int somaParseMethod( const char *name, SomaMethod *method )
+{
+  int i;
+
+  for (i = 0; i < NUM_METHODS; i++) {
+    if (strcmp( name, method_names[i] ) == 0) {
+      *method = (SomaMethod) i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const char *somaMethodName( SomaMethod method )
+{
+  return method_names[ method ];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void somaSetTolerance( double tol )
+{
+  ps_tol = tol;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void somaStep( SomaMethod method, double *y, double *y0, double *dydt,
+               double *param )
+{
+  // Store previous HH model parameters.
+  y0[0] = y[0]; y0[1] = y[1]; y0[2] = y[2]; y0[3] = y[3];
+
+  switch (method) {
+  case SOMA_RUSH_LARSEN:
+    rushLarsenStep( y, param );
+    break;
+
+  case SOMA_PARKER_SOCHACKI:
+    ps_orders += parkerSochackiStep( y, param, ps_tol );
+    ps_steps++;
+    break;
+
+  default:
+    soma( dydt, y, param );
+    rk4Step( y, y0, dydt, NUMVAR, param, 1, soma );
+    break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int runSoma( SomaMethod method, int steps_per_ms, double i_dendr,
+                    double *trace, SpikeStats *stats, double *secs )
+{
+  // Drives the isolated soma with a constant current, recording Vm once per
+  // ms and the wall time taken. Returns 0 if the solution diverged.
+  double y[NUMVAR], y0[NUMVAR], dydt[NUMVAR], param[3], t_spike;
+  struct timeval start, stop, diff;
+  SpikeDetector det;
+  int t_ms, step;
+
+  y[0] = VREST; y[1] = 0.037; y[2] = 0.0148; y[3] = 0.9959;
+  param[0] = 1.0 / (double) steps_per_ms;
+  param[1] = 0.0;
+  param[2] = i_dendr;
+
+  spikeInit( &det, SPIKE_THRESHOLD, SPIKE_REARM, SPIKE_REFRACTORY );
+  trace[0] = y[0];
+  ps_orders = 0;
+  ps_steps = 0;
+
+  gettimeofday( &start, NULL );
+  for (t_ms = 1; t_ms < COMPTIME; t_ms++) {
+    for (step = 0; step < steps_per_ms; step++) {
+      somaStep( method, y, y0, dydt, param );
+      spikeUpdate( &det, t_ms - 1 + (step + 1) * param[0], param[0], y0[0],
+                   y[0], &t_spike );
+    }
+    if (!isfinite( y[0] ) || fabs( y[0] ) > 1000) {
+      return 0;
+    }
+    trace[t_ms] = y[0];
+  }
+  gettimeofday( &stop, NULL );
+
+  timersub( &stop, &start, &diff );
+  *secs = (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
+  *stats = det.stats;
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int somaValidate( double i_dendr, FILE *out )
+{
+  double ref[COMPTIME], trace[COMPTIME], max_dv, shift, secs;
+  double best_secs[ NUM_METHODS ];
+  int best_steps[ NUM_METHODS ], matches[ NUM_METHODS ];
+  SpikeStats ref_stats, stats;
+  int m, i, t, ok = 1;
+
+  runSoma( SOMA_RK4, STEPS, i_dendr, ref, &ref_stats, &secs );
+
+  fprintf( out, "Soma integrator validation: %.1f pA for %d ms, reference is "
+           "rk4 at dt = %g ms (%d spikes)\n", i_dendr, COMPTIME,
+           1.0 / STEPS, ref_stats.num_spikes );
+  fprintf( out, "  %-16s %9s %14s %7s %18s %10s %6s\n", "method", "dt (ms)",
+           "max |dV| (mV)", "spikes", "1st spike shift", "time (ms)",
+           "order" );
+
+  for (m = 0; m < NUM_METHODS; m++) {
+    best_steps[m] = 0;
+    matches[m] = 0;
+  }
+
+  for (i = 0; i < (int) (sizeof(validate_steps) / sizeof(int)); i++) {
+    for (m = 0; m < NUM_METHODS; m++) {
+      fprintf( out, "  %-16s %9.4f ", method_names[m],
+               1.0 / validate_steps[i] );
+      if (!runSoma( (SomaMethod) m, validate_steps[i], i_dendr, trace,
+                    &stats, &secs )) {
+        fprintf( out, "%14s\n", "unstable" );
+        continue;
+      }
+
+      max_dv = 0.0;
+      for (t = 0; t < COMPTIME; t++) {
+        max_dv = fmax( max_dv, fabs( trace[t] - ref[t] ) );
+      }
+      fprintf( out, "%14.4f %7d ", max_dv, stats.num_spikes );
+      if (stats.num_spikes > 0 && ref_stats.num_spikes > 0) {
+        shift = stats.first - ref_stats.first;
+        fprintf( out, "%15.4f ms ", shift );
+      } else {
+        fprintf( out, "%18s ", "-" );
+      }
+      fprintf( out, "%10.2f ", secs * 1000.0 );
+      if (m == SOMA_PARKER_SOCHACKI) {
+        fprintf( out, "%6.1f\n", (double) ps_orders / ps_steps );
+      } else {
+        fprintf( out, "%6s\n", "-" );
+      }
+
+      // Steps get larger down the table; remember the largest accurate one.
+      if (max_dv <= SOMA_BENCH_DV &&
+          stats.num_spikes == ref_stats.num_spikes) {
+        best_steps[m] = validate_steps[i];
+        best_secs[m] = secs;
+      }
+
+      if (validate_steps[i] == STEPS) {
+        matches[m] = stats.num_spikes == ref_stats.num_spikes &&
+                     (stats.num_spikes == 0 ||
+                      fabs( stats.first - ref_stats.first ) <=
+                      SOMA_SPIKE_TOLERANCE);
+      }
+    }
+  }
+
+  fprintf( out, "Largest step within %g mV of the reference:\n",
+           SOMA_BENCH_DV );
+  for (m = 0; m < NUM_METHODS; m++) {
+    if (best_steps[m] == 0) {
+      fprintf( out, "  %-16s none\n", method_names[m] );
+    } else {
+      fprintf( out, "  %-16s dt = %7.4f ms  %8.2f ms", method_names[m],
+               1.0 / best_steps[m], best_secs[m] * 1000.0 );
+      if (best_steps[ SOMA_RK4 ] != 0 && m != SOMA_RK4) {
+        fprintf( out, "  (%.2fx rk4)", best_secs[ SOMA_RK4 ] / best_secs[m] );
+      }
+      fprintf( out, "\n" );
+    }
+  }
+
+  // Every integrator must reproduce the reference at the model step; one
+  // that was unstable there does not.
+  fprintf( out, "At the model step (same spike count, first spike within %g "
+           "ms):\n", SOMA_SPIKE_TOLERANCE );
+  for (m = 0; m < NUM_METHODS; m++) {
+    if (m != SOMA_RK4) {
+      fprintf( out, "  %-16s %s the reference\n", method_names[m],
+               matches[m] ? "matches" : "DOES NOT match" );
+      ok = ok && matches[m];
+    }
+  }
+  return ok;
+}
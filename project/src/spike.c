@@ -0,0 +1,76 @@
+#include "spike.h"
+
+#include <math.h>
+#include <string.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void spikeInit( SpikeDetector *det, double threshold, double rearm,
+                double refractory )
+{
+  det->threshold = threshold;
+  det->rearm = rearm;
+  det->refractory = refractory;
+  det->armed = 1;
+  det->last_spike = -refractory;
+  memset( &det->stats, 0, sizeof(SpikeStats) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int spikeUpdate( SpikeDetector *det, double t, double dt, double v_prev,
+                 double v, double *t_spike )
+{
+  if (!det->armed) {
+    if (v < det->rearm && t - det->last_spike >= det->refractory) {
+      det->armed = 1;
+    }
+    return 0;
+  }
+
+  if (v_prev >= det->threshold || v < det->threshold) {
+    return 0;
+  }
+
+  // Upward crossing between the two samples; interpolate where it happened.
+  *t_spike = t - dt + dt * (det->threshold - v_prev) / (v - v_prev);
+  det->last_spike = *t_spike;
+  det->armed = 0;
+  spikeStatsAdd( &det->stats, *t_spike );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void spikeStatsAdd( SpikeStats *stats, double t_spike )
+{
+  double isi;
+
+  if (stats->num_spikes == 0) {
+    stats->first = t_spike;
+  } else {
+    isi = t_spike - stats->last;
+    stats->sum_isi += isi;
+    stats->sum_isi2 += isi * isi;
+  }
+  stats->last = t_spike;
+  stats->num_spikes++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void spikeSummary( SpikeStats *stats, double duration, double *rate,
+                   double *mean_isi, double *cv_isi )
+{
+  int num_isi = stats->num_spikes - 1;
+  double var;
+
+  *rate = duration > 0 ? 1000.0 * stats->num_spikes / duration : 0.0;
+  *mean_isi = num_isi > 0 ? stats->sum_isi / num_isi : 0.0;
+  *cv_isi = 0.0;
+
+  if (num_isi > 1 && *mean_isi > 0) {
+    var = (stats->sum_isi2 - num_isi * *mean_isi * *mean_isi) / (num_isi - 1);
+    *cv_isi = var > 0 ? sqrt( var ) / *mean_isi : 0.0;
+  }
+}
@@ -0,0 +1,79 @@
+#include "steal.h"
+
+#include <stdlib.h>
+
+#define FRONT( ends ) ((uint32_t) ((ends) >> 32))
+#define BACK( ends ) ((uint32_t) (ends))
+#define ENDS( front, back ) (((uint64_t) (front) << 32) | (uint32_t) (back))
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dequeInit( ChunkDeque *dq, int capacity )
+{
+  dq->items = (int*) malloc( (capacity > 0 ? capacity : 1) * sizeof(int) );
+  dq->capacity = capacity;
+  dq->ends = 0;
+  return dq->items != NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dequeFree( ChunkDeque *dq )
+{
+  free( dq->items );
+  dq->items = NULL;
+  dq->capacity = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dequeClear( ChunkDeque *dq )
+{
+  dq->ends = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void dequePush( ChunkDeque *dq, int chunk )
+{
+  uint64_t const ends = dq->ends;
+
+  dq->items[ BACK( ends ) ] = chunk;
+  dq->ends = ENDS( FRONT( ends ), BACK( ends ) + 1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dequePop( ChunkDeque *dq, int *chunk )
+{
+  uint64_t ends = __atomic_load_n( &dq->ends, __ATOMIC_ACQUIRE );
+
+  while (FRONT( ends ) < BACK( ends )) {
+    if (__atomic_compare_exchange_n( &dq->ends, &ends,
+                                     ENDS( FRONT( ends ), BACK( ends ) - 1 ),
+                                     0, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE )) {
+      *chunk = dq->items[ BACK( ends ) - 1 ];
+      return 1;
+    }
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int dequeSteal( ChunkDeque *dq, int *chunk )
+{
+  uint64_t ends = __atomic_load_n( &dq->ends, __ATOMIC_ACQUIRE );
+
+  while (FRONT( ends ) < BACK( ends )) {
+    if (__atomic_compare_exchange_n( &dq->ends, &ends,
+                                     ENDS( FRONT( ends ) + 1, BACK( ends ) ),
+                                     0, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE )) {
+      *chunk = dq->items[ FRONT( ends ) ];
+      return 1;
+    }
+  }
+  return 0;
+}
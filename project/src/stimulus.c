@@ -0,0 +1,327 @@
+#include "stimulus.h"
+#include "constants.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Set when the first rand() after srand() must come from the C library: it
+// is not glibc's, or stimGenerator() found it differs from firstRand().
+static int use_libc_rand = 0;
+static pthread_mutex_t rand_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#if defined(__GLIBC__) && RAND_MAX == 2147483647
+// glibc's rand() (TYPE_3) starts from 31 words seeded by srand() and each of
+// its outputs is the sum modulo 2^32 of the ones 3 and 31 places back;
+// srand() discards the first 310, and rand() returns the next one shifted
+// right by one bit. Sums of sums are linear, so that output is a fixed sum
+// of the 31 seeded words modulo 2^32: word i times first_rand_weights[i].
+// The weights come out of the same recurrence run on 31-entry coefficient
+// vectors instead of numbers, word i starting as the i-th unit vector, and
+// reading the vector of the 311th output (an exact integer computation).
+static const uint32_t first_rand_weights[ 31 ] = {
+  16147523u, 12509773u, 8482821u, 13341071u, 10897477u, 6931407u, 10972605u,
+  9480264u, 5702239u, 8983148u, 8231567u, 4728106u, 7320276u, 7130133u,
+  3954500u, 5937551u, 6158615u, 3337591u, 4793992u, 5302529u, 2842455u,
+  3853579u, 4549498u, 2441533u, 3084788u, 3888717u, 2113300u, 2460156u,
+  3310584u, 1841124u, 1955875u
+};
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int libcFirstRand( unsigned seed )
+{
+  // srand() and rand() share one state per process, so worker threads
+  // calling them at once would get each other's numbers.
+  int val;
+
+  pthread_mutex_lock( &rand_lock );
+  srand( seed );
+  val = rand();
+  pthread_mutex_unlock( &rand_lock );
+  return val;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int firstRand( unsigned seed )
+{
+  // What rand() returns first after srand( seed ), computed without their
+  // state or a lock where the C library is known.
+#if defined(__GLIBC__) && RAND_MAX == 2147483647
+  int32_t word = (int32_t) (seed ? seed : 1);
+  uint32_t val = first_rand_weights[0] * (uint32_t) word;
+  long hi, lo;
+  int i;
+
+  if (use_libc_rand) {
+    return libcFirstRand( seed );
+  }
+
+  // srand()'s seeding: word = 16807 * word mod (2^31 - 1), by Schrage's
+  // method.
+  for (i = 1; i < 31; i++) {
+    hi = word / 127773;
+    lo = word % 127773;
+    word = 16807 * lo - 2836 * hi;
+    if (word < 0) {
+      word += 2147483647;
+    }
+    val += first_rand_weights[i] * (uint32_t) word;
+  }
+  return (int) (val >> 1);
+#else
+  return libcFirstRand( seed );
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double stimGenerate( int seed )
+{
+  // Current injected at the tip of the dendrite for this seed.
+  return INJCURMEAN + INJCURMEAN*0.1 -
+         2*INJCURMEAN*0.1*((double)firstRand( seed )/((double)RAND_MAX));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void stimGenerator( Stimulus *stim )
+{
+  static const unsigned seeds[] = { 0, 1, 2, 12345, 2147483647u,
+                                    4294967295u };
+  static int checked = 0;
+  int i;
+
+  memset( stim, 0, sizeof(*stim) );
+  stim->type = STIM_GENERATOR;
+  stim->fd = -1;
+
+  // Once, before any worker thread runs: make sure firstRand() still is
+  // what the C library gives, or use the library from now on.
+  if (checked) {
+    return;
+  }
+  checked = 1;
+  for (i = 0; i < (int) (sizeof(seeds) / sizeof(seeds[0])); i++) {
+    if (firstRand( seeds[i] ) != libcFirstRand( seeds[i] )) {
+      fprintf( stderr, "rand() is not the one stimGenerate() expects, "
+               "drawing the stimulus under a lock!\n" );
+      use_libc_rand = 1;
+      return;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static size_t msBytes( const Stimulus *stim )
+{
+  return (size_t) stim->steps_per_ms * stim->num_dendrs * sizeof(double);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int stimOpen( Stimulus *stim, const char *path, int num_dendrs, int duration,
+              int window_ms )
+{
+  StimHeader hdr;
+  struct stat st;
+
+  stimGenerator( stim );
+  stim->type = STIM_FILE;
+  stim->window_ms = window_ms;
+  stim->win_first = -1;
+
+  stim->fd = open( path, O_RDONLY );
+  if (stim->fd < 0) {
+    fprintf( stderr, "Can't open stimulus file %s!\n", path );
+    return 0;
+  }
+  if (read( stim->fd, &hdr, sizeof(hdr) ) != (ssize_t) sizeof(hdr) ||
+      memcmp( hdr.magic, STIM_MAGIC, sizeof(STIM_MAGIC) ) != 0 ||
+      hdr.num_dendrs <= 0 || hdr.steps_per_ms <= 0 || hdr.num_ms < 0) {
+    fprintf( stderr, "%s is not a stimulus file!\n", path );
+    stimClose( stim );
+    return 0;
+  }
+  stim->num_dendrs = hdr.num_dendrs;
+  stim->steps_per_ms = hdr.steps_per_ms;
+  stim->num_ms = hdr.num_ms;
+
+  if (fstat( stim->fd, &st ) != 0 ||
+      (size_t) st.st_size < sizeof(hdr) + stim->num_ms * msBytes( stim )) {
+    fprintf( stderr, "Stimulus file %s is truncated!\n", path );
+    stimClose( stim );
+    return 0;
+  }
+  if (stim->num_dendrs < num_dendrs || stim->num_ms < duration - 1) {
+    fprintf( stderr, "Stimulus file %s has %d dendrites and %d ms, %d and %d "
+             "are needed!\n", path, stim->num_dendrs, stim->num_ms,
+             num_dendrs, duration - 1 );
+    stimClose( stim );
+    return 0;
+  }
+
+  // The file is read front to back.
+  posix_fadvise( stim->fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int mapWindow( Stimulus *stim, int first )
+{
+  size_t const page = (size_t) sysconf( _SC_PAGESIZE );
+  size_t const ms_bytes = msBytes( stim );
+  off_t offset, aligned;
+  int count;
+
+  if (stim->map) {
+    munmap( stim->map, stim->map_len );
+    stim->map = NULL;
+  }
+
+  count = stim->num_ms - first;
+  if (count > stim->window_ms) {
+    count = stim->window_ms;
+  }
+
+  // mmap() wants a page aligned offset; the rows start wherever they do.
+  offset = (off_t) (sizeof(StimHeader) + (size_t) first * ms_bytes);
+  aligned = offset - offset % page;
+  stim->map_len = (size_t) (offset - aligned) + count * ms_bytes;
+  stim->map = mmap( NULL, stim->map_len, PROT_READ, MAP_SHARED, stim->fd,
+                    aligned );
+  if (stim->map == MAP_FAILED) {
+    stim->map = NULL;
+    fprintf( stderr, "Can't map the stimulus file!\n" );
+    return 0;
+  }
+  stim->win_first = first;
+  stim->win_ms = count;
+  stim->windows++;
+
+  // Fault this window in now and have the kernel read the next one while it
+  // is simulated.
+  madvise( stim->map, stim->map_len, MADV_SEQUENTIAL );
+  madvise( stim->map, stim->map_len, MADV_WILLNEED );
+  if (first + count < stim->num_ms) {
+    posix_fadvise( stim->fd, offset + count * ms_bytes,
+                   (off_t) stim->window_ms * ms_bytes, POSIX_FADV_WILLNEED );
+  }
+
+  stim->window = (const double*) ((char*) stim->map + (offset - aligned));
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int stimSetTime( Stimulus *stim, int t_ms )
+{
+  int const ms = t_ms - 1;  // Rows of the file driving this ms.
+
+  if (stim->type != STIM_FILE) {
+    return 1;
+  }
+  if (ms < 0 || ms >= stim->num_ms) {
+    fprintf( stderr, "Stimulus file ends before %d ms!\n", t_ms );
+    return 0;
+  }
+  if (!stim->map || ms < stim->win_first ||
+      ms >= stim->win_first + stim->win_ms) {
+    if (!mapWindow( stim, ms )) {
+      return 0;
+    }
+  }
+
+  stim->rows = stim->window + (size_t) (ms - stim->win_first) *
+                              stim->steps_per_ms * stim->num_dendrs;
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const double *stimRow( const Stimulus *stim, int step, int steps_per_ms )
+{
+  long const sample = (long) step * stim->steps_per_ms / steps_per_ms;
+
+  return stim->rows + (size_t) sample * stim->num_dendrs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double stimCurrent( const Stimulus *stim, int step, int steps_per_ms,
+                    int dendrite )
+{
+  if (!stim || stim->type == STIM_GENERATOR) {
+    return stimGenerate( step + dendrite + 1 );
+  }
+  return stimRow( stim, step, steps_per_ms )[ dendrite ];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void stimClose( Stimulus *stim )
+{
+  if (stim->map) {
+    munmap( stim->map, stim->map_len );
+    stim->map = NULL;
+  }
+  if (stim->fd >= 0) {
+    close( stim->fd );
+    stim->fd = -1;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int stimWrite( const char *path, int num_dendrs, int steps_per_ms,
+               int num_ms )
+{
+  StimHeader hdr;
+  double *row;
+  FILE *fp;
+  int t, s, d, ok;
+
+  memset( &hdr, 0, sizeof(hdr) );
+  memcpy( hdr.magic, STIM_MAGIC, sizeof(STIM_MAGIC) );
+  hdr.num_dendrs = num_dendrs;
+  hdr.steps_per_ms = steps_per_ms;
+  hdr.num_ms = num_ms;
+
+  fp = fopen( path, "wb" );
+  row = (double*) malloc( num_dendrs * sizeof(double) );
+  if (!fp || !row) {
+    fprintf( stderr, "Can't write stimulus file %s!\n", path );
+    if (fp) fclose( fp );
+    free( row );
+    return 0;
+  }
+
+  ok = fwrite( &hdr, sizeof(hdr), 1, fp ) == 1;
+  for (t = 0; t < num_ms && ok; t++) {
+    // The generator's seeds restart every ms.
+    for (s = 0; s < steps_per_ms && ok; s++) {
+      for (d = 0; d < num_dendrs; d++) {
+        row[d] = stimGenerate( s + d + 1 );
+      }
+      ok = fwrite( row, sizeof(double), num_dendrs, fp ) ==
+           (size_t) num_dendrs;
+    }
+  }
+
+  free( row );
+  if (fclose( fp ) != 0 || !ok) {
+    fprintf( stderr, "Can't write stimulus file %s!\n", path );
+    return 0;
+  }
+  return 1;
+}
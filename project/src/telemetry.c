@@ -0,0 +1,197 @@
+#include "telemetry.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static double now( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static size_t blockSize( int num_slots )
+{
+  // The slots start at the first cache line after the header.
+  return (sizeof(TelemetryHeader) + 63) / 64 * 64 +
+         num_slots * sizeof(TelemetrySlot);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static TelemetrySlot *firstSlot( TelemetryHeader *hdr )
+{
+  return (TelemetrySlot*) ((char*) hdr +
+                           (sizeof(TelemetryHeader) + 63) / 64 * 64);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int telemetryOpen( Telemetry *tel, const char *name, int create,
+                   const char *program, int pid, int num_dendrs,
+                   int num_comps, int duration, int num_slots )
+{
+  int fd;
+
+  tel->hdr = NULL;
+  tel->slots = NULL;
+  tel->owner = create;
+  tel->start = now();
+  tel->size = blockSize( num_slots );
+  if (name) {
+    snprintf( tel->name, FNAME_LEN, "%s%s", name[0] == '/' ? "" : "/",
+              name );
+  } else {
+    snprintf( tel->name, FNAME_LEN, "%s%d", TEL_PREFIX, pid );
+  }
+
+  fd = shm_open( tel->name, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR,
+                 0600 );
+  if (fd < 0 || (create && ftruncate( fd, tel->size ) != 0)) {
+    fprintf( stderr, "Can't create telemetry block %s, running without "
+             "it!\n", tel->name );
+    if (fd >= 0) close( fd );
+    return 0;
+  }
+  tel->hdr = (TelemetryHeader*) mmap( NULL, tel->size,
+                                      PROT_READ | PROT_WRITE, MAP_SHARED,
+                                      fd, 0 );
+  close( fd );
+  if (tel->hdr == MAP_FAILED) {
+    fprintf( stderr, "Can't map telemetry block %s, running without it!\n",
+             tel->name );
+    tel->hdr = NULL;
+    return 0;
+  }
+  tel->slots = firstSlot( tel->hdr );
+
+  if (create) {
+    // The new object is zero filled, so every slot starts out inactive.
+    snprintf( tel->hdr->program, sizeof(tel->hdr->program), "%s", program );
+    tel->hdr->pid = pid;
+    tel->hdr->num_dendrs = num_dendrs;
+    tel->hdr->num_comps = num_comps;
+    tel->hdr->duration = duration;
+    tel->hdr->num_slots = num_slots;
+    tel->hdr->done = 0;
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    memcpy( tel->hdr->magic, TEL_MAGIC, sizeof(tel->hdr->magic) );
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void telemetryUpdate( Telemetry *tel, int slot, int sim_ms, long steps,
+                      double compute, double comm )
+{
+  TelemetrySlot *s;
+  struct rusage usage;
+  unsigned seq;
+
+  if (!tel->hdr || slot < 0 || slot >= tel->hdr->num_slots) {
+    return;
+  }
+  s = &tel->slots[ slot ];
+  getrusage( RUSAGE_SELF, &usage );
+
+  seq = s->seq;
+  __atomic_store_n( &s->seq, seq + 1, __ATOMIC_RELAXED );
+  __atomic_thread_fence( __ATOMIC_RELEASE );
+  s->active = 1;
+  s->sim_ms = sim_ms;
+  s->steps = steps;
+  s->elapsed = now() - tel->start;
+  s->compute = compute < 0 ? s->elapsed - comm : compute;
+  s->comm = comm;
+  s->rss_kb = usage.ru_maxrss;
+  __atomic_store_n( &s->seq, seq + 2, __ATOMIC_RELEASE );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void telemetryClose( Telemetry *tel )
+{
+  if (!tel->hdr) {
+    return;
+  }
+  if (tel->owner) {
+    __atomic_store_n( &tel->hdr->done, 1, __ATOMIC_RELEASE );
+  }
+  munmap( tel->hdr, tel->size );
+  tel->hdr = NULL;
+
+  // Viewers that still have the block mapped see it finish.
+  if (tel->owner) {
+    shm_unlink( tel->name );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int telemetryAttach( Telemetry *tel, const char *name )
+{
+  TelemetryHeader hdr;
+  int fd;
+
+  tel->hdr = NULL;
+  tel->owner = 0;
+  snprintf( tel->name, FNAME_LEN, "%s%s", name[0] == '/' ? "" : "/", name );
+
+  fd = shm_open( tel->name, O_RDONLY, 0 );
+  if (fd < 0) {
+    return 0;
+  }
+  if (pread( fd, &hdr, sizeof(hdr), 0 ) != sizeof(hdr) ||
+      memcmp( hdr.magic, TEL_MAGIC, sizeof(hdr.magic) ) != 0 ||
+      hdr.num_slots <= 0) {
+    close( fd );
+    return 0;
+  }
+
+  tel->size = blockSize( hdr.num_slots );
+  tel->hdr = (TelemetryHeader*) mmap( NULL, tel->size, PROT_READ, MAP_SHARED,
+                                      fd, 0 );
+  close( fd );
+  if (tel->hdr == MAP_FAILED) {
+    tel->hdr = NULL;
+    return 0;
+  }
+  tel->slots = firstSlot( tel->hdr );
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void telemetryRead( const Telemetry *tel, int slot, TelemetrySlot *out )
+{
+  const TelemetrySlot *s = &tel->slots[ slot ];
+  unsigned before, after;
+
+  do {
+    before = __atomic_load_n( &s->seq, __ATOMIC_ACQUIRE );
+    memcpy( out, (const void*) s, sizeof(*out) );
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    after = __atomic_load_n( &s->seq, __ATOMIC_RELAXED );
+  } while ((before & 1) || before != after);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void telemetryDetach( Telemetry *tel )
+{
+  if (tel->hdr) {
+    munmap( tel->hdr, tel->size );
+    tel->hdr = NULL;
+  }
+}
@@ -0,0 +1,234 @@
+#include "tune.h"
+#include "workers.h"
+#include "fields.h"
+#include "constants.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TUNE_LINE_LEN 512        // Longest line of a tuning file.
+#define TUNE_MAX_CANDIDATES 128  // Upper bound on configurations tried.
+
+// Block and tile sizes tried for the blocked kernel.
+static const int tune_block_steps[] = { 8, 16, 32 };
+static const int tune_tiles[] = { 64, 512, 4096 };
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int matchesKey( char **fields, const char *cpu, int num_cpus,
+                       int num_dendrs, int num_comps )
+{
+  return strcmp( fields[0], cpu ) == 0 && atoi( fields[1] ) == num_cpus &&
+         atoi( fields[2] ) == num_dendrs && atoi( fields[3] ) == num_comps;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void tuneDescribe( TuneConfig *cfg, char *buf, size_t size )
+{
+  if (cfg->kernel.kernel == KERNEL_BLOCKED) {
+    snprintf( buf, size, "-k blocked --block-steps %d --tile %d -t %d",
+              cfg->kernel.block_steps, cfg->kernel.tile, cfg->num_threads );
+  } else {
+    snprintf( buf, size, "-k %s -t %d", dendrKernelName( cfg->kernel.kernel ),
+              cfg->num_threads );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int tuneLookup( const char *fname, int num_dendrs, int num_comps,
+                TuneConfig *cfg )
+{
+  char cpu[ TUNE_LINE_LEN ], line[ TUNE_LINE_LEN ], *fields[9];
+  int num_cpus = (int) sysconf( _SC_NPROCESSORS_ONLN );
+  int found = 0;
+  FILE *fp;
+
+  placeCpuModel( cpu, sizeof(cpu) );
+  fp = fopen( fname, "r" );
+  if (!fp) {
+    return 0;
+  }
+
+  while (!found && fgets( line, sizeof(line), fp )) {
+    if (line[0] == '#' || splitFields( line, fields, 9 ) != 9 ||
+        !matchesKey( fields, cpu, num_cpus, num_dendrs, num_comps )) {
+      continue;
+    }
+    if (!dendrParseKernel( fields[4], &cfg->kernel.kernel )) {
+      continue;
+    }
+    cfg->kernel.block_steps = atoi( fields[5] );
+    cfg->kernel.tile = atoi( fields[6] );
+    cfg->kernel.steps_per_ms = STEPS;
+    cfg->kernel.reduce = 0;
+    cfg->kernel.steal = 0;
+    cfg->num_threads = atoi( fields[7] );
+    cfg->ns_per_update = atof( fields[8] );
+    found = cfg->kernel.block_steps > 0 && cfg->kernel.tile > 0 &&
+            cfg->num_threads > 0;
+  }
+
+  fclose( fp );
+  return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int tuneStore( const char *fname, int num_dendrs, int num_comps,
+               TuneConfig *cfg )
+{
+  char cpu[ TUNE_LINE_LEN ], line[ TUNE_LINE_LEN ], copy[ TUNE_LINE_LEN ];
+  char tmp_fname[ TUNE_LINE_LEN ], *fields[9];
+  int num_cpus = (int) sysconf( _SC_NPROCESSORS_ONLN );
+  FILE *in, *out;
+
+  placeCpuModel( cpu, sizeof(cpu) );
+  snprintf( tmp_fname, sizeof(tmp_fname), "%s.%d", fname, (int) getpid() );
+  out = fopen( tmp_fname, "w" );
+  if (!out) {
+    return 0;
+  }
+
+  // Keep every other entry (and comment) of the old file.
+  in = fopen( fname, "r" );
+  if (in) {
+    while (fgets( line, sizeof(line), in )) {
+      strcpy( copy, line );
+      if (line[0] != '#' && splitFields( copy, fields, 9 ) == 9 &&
+          matchesKey( fields, cpu, num_cpus, num_dendrs, num_comps )) {
+        continue;
+      }
+      fputs( line, out );
+    }
+    fclose( in );
+  } else {
+    fprintf( out, "# HH auto-tuning cache, written by --autotune.\n"
+             "# cpu model | cpus | dendrites | compartments | kernel | "
+             "block steps | tile | threads | ns per compartment-step\n" );
+  }
+
+  fprintf( out, "%s | %d | %d | %d | %s | %d | %d | %d | %.3f\n", cpu,
+           num_cpus, num_dendrs, num_comps,
+           dendrKernelName( cfg->kernel.kernel ), cfg->kernel.block_steps,
+           cfg->kernel.tile, cfg->num_threads, cfg->ns_per_update );
+
+  if (fclose( out ) != 0 || rename( tmp_fname, fname ) != 0) {
+    remove( tmp_fname );
+    return 0;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int candidates( int num_dendrs, int num_comps, TuneConfig *cand )
+{
+  int num_cpus = (int) sysconf( _SC_NPROCESSORS_ONLN );
+  int max_threads = num_cpus < num_dendrs ? num_cpus : num_dendrs;
+  int threads, b, t, n = 0;
+
+  for (threads = 1; threads <= max_threads; ) {
+    if (n + 2 > TUNE_MAX_CANDIDATES) {
+      return n;
+    }
+    cand[n].kernel.kernel = KERNEL_REFERENCE;
+    cand[n].kernel.block_steps = BLOCK_STEPS;
+    cand[n].kernel.tile = BLOCK_TILE;
+    cand[n].kernel.steps_per_ms = STEPS;
+    cand[n].kernel.reduce = 0;
+    cand[n].kernel.steal = 0;
+    cand[n].num_threads = threads;
+    n++;
+
+    cand[n] = cand[n-1];
+    cand[n].kernel.kernel = KERNEL_FUSED;
+    n++;
+
+    for (b = 0; b < (int) (sizeof(tune_block_steps) / sizeof(int)); b++) {
+      for (t = 0; t < (int) (sizeof(tune_tiles) / sizeof(int)); t++) {
+        // Tiles longer than the dendrite all behave the same.
+        if (t > 0 && tune_tiles[t-1] >= num_comps) {
+          break;
+        }
+        if (n == TUNE_MAX_CANDIDATES) {
+          return n;
+        }
+        cand[n].kernel.kernel = KERNEL_BLOCKED;
+        cand[n].kernel.block_steps = tune_block_steps[b];
+        cand[n].kernel.tile = tune_tiles[t];
+        cand[n].kernel.steps_per_ms = STEPS;
+        cand[n].kernel.reduce = 0;
+        cand[n].kernel.steal = 0;
+        cand[n].num_threads = threads;
+        n++;
+      }
+    }
+
+    // Powers of two, and the full machine.
+    if (threads < max_threads && threads * 2 > max_threads) {
+      threads = max_threads;
+    } else {
+      threads *= 2;
+    }
+  }
+
+  return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int tuneSelect( const char *fname, int retune, int num_dendrs, int num_comps,
+                PlaceOpts *place, FILE *log, TuneConfig *cfg )
+{
+  TuneConfig cand[ TUNE_MAX_CANDIDATES ];
+  char desc[ 128 ];
+  double secs, updates;
+  int i, n, best = -1;
+
+  if (!retune && tuneLookup( fname, num_dendrs, num_comps, cfg )) {
+    if (log) {
+      tuneDescribe( cfg, desc, sizeof(desc) );
+      fprintf( log, "\nUsing tuned configuration from %s: %s\n", fname,
+               desc );
+    }
+    return 1;
+  }
+
+  n = candidates( num_dendrs, num_comps, cand );
+  updates = (double) num_dendrs * num_comps * TUNE_MS * STEPS;
+  if (log) {
+    fprintf( log, "\nAuto-tuning: %d configurations, %d ms each\n", n,
+             TUNE_MS );
+  }
+
+  for (i = 0; i < n; i++) {
+    secs = workersTime( cand[i].num_threads, num_dendrs, num_comps + 2,
+                        &cand[i].kernel, place, TUNE_MS * STEPS, 1 );
+    if (secs < 0) {
+      return 0;
+    }
+    cand[i].ns_per_update = secs * 1e9 / updates;
+    if (best < 0 || cand[i].ns_per_update < cand[best].ns_per_update) {
+      best = i;
+    }
+    if (log) {
+      tuneDescribe( &cand[i], desc, sizeof(desc) );
+      fprintf( log, "  %-45s %8.3f ns/compartment-step\n", desc,
+               cand[i].ns_per_update );
+    }
+  }
+
+  *cfg = cand[ best ];
+  if (log) {
+    tuneDescribe( cfg, desc, sizeof(desc) );
+    fprintf( log, "Selected: %s\n", desc );
+  }
+  if (!tuneStore( fname, num_dendrs, num_comps, cfg )) {
+    fprintf( stderr, "Could not write tuning file %s!\n", fname );
+  }
+
+  return 1;
+}
@@ -0,0 +1,114 @@
+#include "wave_relax.h"
+#include "repro_mpi.h"
+#include "constants.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int waveRelaxInit( WaveRelax *wr, int window, double tol, int max_iters,
+                   DendrSet *set )
+{
+  wr->window = window;
+  wr->tol = tol;
+  wr->max_iters = max_iters;
+  wr->windows = 0;
+  wr->iterations = 0;
+  wr->unconverged = 0;
+  wr->syncs = 0;
+
+  wr->v_wave  = (double*) malloc( (window + 1) * sizeof(double) );
+  wr->v_new   = (double*) malloc( window * sizeof(double) );
+  wr->i_local = (ReproSum*) malloc( window * sizeof(ReproSum) );
+  wr->i_wave  = (ReproSum*) malloc( window * sizeof(ReproSum) );
+  wr->checkpoint = (double*) malloc( (size_t) set->num_cables *
+                                     set->num_comps * sizeof(double) + 1 );
+
+  return wr->v_wave && wr->v_new && wr->i_local && wr->i_wave &&
+         wr->checkpoint;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void waveRelaxFree( WaveRelax *wr )
+{
+  free( wr->v_wave );
+  free( wr->v_new );
+  free( wr->i_local );
+  free( wr->i_wave );
+  free( wr->checkpoint );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int waveRelaxWindow( WaveRelax *wr, DendrSet *set, int step,
+                     SomaMethod method, double *y, double *param, int rank,
+                     MPI_Comm comm )
+{
+  int const K = wr->window;
+  size_t const size = (size_t) set->num_cables * set->num_comps *
+                      sizeof(double);
+  double y_start[ NUMVAR ], y0[ NUMVAR ], dydt[ NUMVAR ], diff = 0.0;
+  int k, iters = 0, done = 0;
+
+  // The dendrites are rewound here for every iteration.
+  memcpy( wr->checkpoint, set->slab, size );
+
+  // First guess: the soma holds its potential over the window.
+  if (rank == 0) {
+    memcpy( y_start, y, sizeof(y_start) );
+    for (k = 0; k < K; k++) {
+      wr->v_wave[k] = y[0];
+    }
+  }
+
+  for (;;) {
+    // The guess, or the news that the window is done, goes to everybody.
+    if (rank == 0) {
+      wr->v_wave[K] = done;
+    }
+    MPI_Bcast( wr->v_wave, K + 1, MPI_DOUBLE, 0, comm );
+    wr->syncs++;
+    if (wr->v_wave[K] != 0.0) {
+      break;
+    }
+
+    // Dendrites against the guessed waveform, from the start of the window.
+    if (iters > 0) {
+      memcpy( set->slab, wr->checkpoint, size );
+    }
+    for (k = 0; k < K; k++) {
+      dendrSetStep( set, step + k, param[0], wr->v_wave[k] );
+      wr->i_local[k] = set->sum;
+    }
+    MPI_Reduce( wr->i_local, wr->i_wave, K, reproSumType(), reproSumOp(), 0,
+                comm );
+    wr->syncs++;
+    iters++;
+
+    // Soma against the summed current; its waveform is the next guess.
+    if (rank == 0) {
+      memcpy( y, y_start, sizeof(y_start) );
+      diff = 0.0;
+      for (k = 0; k < K; k++) {
+        param[2] = reproSumValue( &wr->i_wave[k] );
+        somaStep( method, y, y0, dydt, param );
+        wr->v_new[k] = y[0];
+        if (k + 1 < K) {
+          diff = fmax( diff, fabs( y[0] - wr->v_wave[k+1] ) );
+          wr->v_wave[k+1] = y[0];
+        }
+      }
+      done = diff < wr->tol || iters >= wr->max_iters;
+    }
+  }
+
+  wr->windows++;
+  wr->iterations += iters;
+  if (rank == 0 && !(diff < wr->tol)) {
+    wr->unconverged++;
+  }
+  return iters;
+}
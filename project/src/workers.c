@@ -0,0 +1,515 @@
+#include "workers.h"
+#include "constants.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void barrierWait( SpinBarrier *barrier, int *sense )
+{
+  int spins = 0;
+
+  *sense = !*sense;
+  if (__atomic_add_fetch( &barrier->arrived, 1, __ATOMIC_ACQ_REL ) ==
+      barrier->count) {
+    // Last one in: reset for the next round and release the others.
+    barrier->arrived = 0;
+    __atomic_store_n( &barrier->sense, *sense, __ATOMIC_RELEASE );
+  } else {
+    while (__atomic_load_n( &barrier->sense, __ATOMIC_ACQUIRE ) != *sense) {
+      if (++spins > BARRIER_SPINS) {
+        sched_yield();
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static double now( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int workerInitSet( Worker *w )
+{
+  Workers *pool = w->pool;
+
+  if (!dendrSetInit( &w->set, w->first, w->count, pool->num_comps,
+                     &pool->kernel, &pool->place )) {
+    fprintf( stderr, "Could not allocate dendrites of worker %d!\n", w->id );
+    return 0;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void runChunk( Worker *w, int c )
+{
+  Workers *pool = w->pool;
+  StealChunk *chunk = &pool->chunks[c];
+
+  // The worker's own scratch space, whoever's dendrites these are.
+  dendrSetStepRange( &pool->workers[ chunk->home ].set, pool->step,
+                     pool->delta_t, pool->v_m, chunk->begin, chunk->end,
+                     w->set.scratch, &w->sum );
+  chunk->runner = w->id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void stealStep( Worker *w )
+{
+  Workers *pool = w->pool;
+  int v, c;
+
+  reproSumZero( &w->sum );
+  while (dequePop( &w->deque, &c )) {
+    runChunk( w, c );
+  }
+
+  // No chunks are added during a step, so one round over the others is
+  // enough.
+  for (v = 1; v < pool->num_threads; v++) {
+    while (dequeSteal( &pool->workers[ (w->id + v) % pool->num_threads ].deque,
+                       &c )) {
+      runChunk( w, c );
+      w->steals++;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void workerStep( Worker *w )
+{
+  Workers *pool = w->pool;
+  double start = now(), done;
+
+  if (pool->kernel.steal) {
+    stealStep( w );
+  } else {
+    dendrSetStep( &w->set, pool->step, pool->delta_t, pool->v_m );
+  }
+  done = now();
+  barrierWait( &pool->barrier, &w->sense );
+
+  w->busy += done - start;
+  w->idle += now() - done;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int initChunks( Workers *pool )
+{
+  int const comps = pool->num_comps - 2;
+  StealChunk *chunk;
+  Worker *w;
+  int i, d, cost;
+
+  pool->chunks = (StealChunk*) malloc( pool->num_dendrs *
+                                       sizeof(StealChunk) );
+  if (!pool->chunks) {
+    return 0;
+  }
+
+  // Chunks of about STEAL_CHUNK_COMPS compartments, never across blocks.
+  for (i = 0; i < pool->num_threads; i++) {
+    w = &pool->workers[i];
+    for (d = 0; d < w->count; ) {
+      chunk = &pool->chunks[ pool->num_chunks++ ];
+      chunk->home = chunk->runner = i;
+      chunk->begin = d;
+      for (cost = 0; d < w->count &&
+                     (cost == 0 || cost + comps <= STEAL_CHUNK_COMPS); d++) {
+        cost += comps;
+      }
+      chunk->end = d;
+    }
+  }
+
+  for (i = 0; i < pool->num_threads; i++) {
+    if (!dequeInit( &pool->workers[i].deque, pool->num_chunks )) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void *workerMain( void *arg )
+{
+  Worker *w = (Worker*) arg;
+  Workers *pool = w->pool;
+
+  // Pin first, then touch the dendrites, so they are allocated locally.
+  if (!placePin( w->cpu ) ||
+      (pool->place.first_touch && !workerInitSet( w ))) {
+    pool->failed = 1;
+  }
+  barrierWait( &pool->barrier, &w->sense );
+
+  for (;;) {
+    barrierWait( &pool->barrier, &w->sense );
+    if (pool->quit) {
+      break;
+    }
+    workerStep( w );
+  }
+
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void stopThreads( Workers *pool )
+{
+  // Releases the started workers from their barrier and waits for them.
+  int i;
+
+  if (pool->num_threads > 1) {
+    pool->quit = 1;
+    barrierWait( &pool->barrier, &pool->workers[0].sense );
+    for (i = 1; i < pool->num_threads; i++) {
+      pthread_join( pool->workers[i].thread, NULL );
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void freePool( Workers *pool, int num_workers )
+{
+  // Frees the memory of the first `num_workers' workers, however far their
+  // setup got: calloc left the sets and deques that were never initialized
+  // empty, and dendrSetFree() and dequeFree() take those as they are.
+  int i;
+
+  for (i = 0; i < num_workers; i++) {
+    dendrSetFree( &pool->workers[i].set );
+    dequeFree( &pool->workers[i].deque );
+  }
+  free( pool->workers );
+  free( pool->chunks );
+  pool->workers = NULL;
+  pool->chunks = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int workersInit( Workers *pool, int num_threads, int num_dendrs,
+                 int num_comps, KernelOpts *kernel, PlaceOpts *place )
+{
+  Worker *w;
+  int i, started;
+
+  if (num_threads > num_dendrs) {
+    num_threads = num_dendrs;
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+
+  pool->num_threads = num_threads;
+  pool->num_dendrs = num_dendrs;
+  pool->num_comps = num_comps;
+  pool->kernel = *kernel;
+  pool->kernel.steal = kernel->steal && !kernel->reduce;
+  pool->place = *place;
+  pool->barrier.count = num_threads;
+  pool->barrier.arrived = 0;
+  pool->barrier.sense = 0;
+  pool->quit = 0;
+  pool->failed = 0;
+  pool->chunks = NULL;
+  pool->num_chunks = 0;
+  pool->workers = (Worker*) calloc( num_threads, sizeof(Worker) );
+  if (!pool->workers) {
+    return 0;
+  }
+
+  // Contiguous blocks of dendrites, as even as possible.
+  for (i = 0; i < num_threads; i++) {
+    w = &pool->workers[i];
+    w->pool = pool;
+    w->id = i;
+    w->cpu = placeCpuFor( place, i );
+    w->first = (int) ((long) i * num_dendrs / num_threads);
+    w->count = (int) ((long) (i + 1) * num_dendrs / num_threads) - w->first;
+    w->sense = 0;
+  }
+
+  if (pool->kernel.steal && !initChunks( pool )) {
+    freePool( pool, num_threads );
+    return 0;
+  }
+
+  // Without first touch the calling thread owns every page, wherever the
+  // workers end up running.
+  if (!place->first_touch) {
+    for (i = 0; i < num_threads; i++) {
+      if (!workerInitSet( &pool->workers[i] )) {
+        freePool( pool, num_threads );
+        return 0;
+      }
+    }
+  }
+
+  if (!placePin( pool->workers[0].cpu ) ||
+      (place->first_touch && !workerInitSet( &pool->workers[0] ))) {
+    freePool( pool, num_threads );
+    return 0;
+  }
+
+  for (started = 1; started < num_threads; started++) {
+    w = &pool->workers[ started ];
+    if (pthread_create( &w->thread, NULL, workerMain, w ) != 0) {
+      fprintf( stderr, "Could not start worker %d!\n", started );
+      break;
+    }
+  }
+
+  if (started < num_threads) {
+    // Let the threads that did start finish their setup and exit; the
+    // barrier must count only them.
+    pool->barrier.count = started;
+    pool->failed = 1;
+  }
+  if (started > 1) {
+    barrierWait( &pool->barrier, &pool->workers[0].sense );
+  }
+  if (pool->failed) {
+    pool->num_threads = started;
+    stopThreads( pool );
+    freePool( pool, num_threads );
+    return 0;
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double workersStep( Workers *pool, int step, double delta_t, double v_m )
+{
+  Worker *w0 = &pool->workers[0];
+  ReproSum sum;
+  int i;
+
+  if (pool->num_threads == 1) {
+    return dendrSetStep( &w0->set, step, delta_t, v_m );
+  }
+
+  if (pool->kernel.steal) {
+    // Each chunk starts where it ran last, the others are parked.
+    for (i = 0; i < pool->num_threads; i++) {
+      dequeClear( &pool->workers[i].deque );
+    }
+    for (i = 0; i < pool->num_chunks; i++) {
+      dequePush( &pool->workers[ pool->chunks[i].runner ].deque, i );
+    }
+  }
+
+  pool->step = step;
+  pool->delta_t = delta_t;
+  pool->v_m = v_m;
+  barrierWait( &pool->barrier, &w0->sense );
+  workerStep( w0 );
+
+  // Exact, so the same as a single set holding all dendrites, whoever
+  // advanced which of them.
+  reproSumZero( &sum );
+  for (i = 0; i < pool->num_threads; i++) {
+    reproSumMerge( &sum, pool->kernel.steal ? &pool->workers[i].sum :
+                                              &pool->workers[i].set.sum );
+  }
+
+  return reproSumValue( &sum );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void workersReset( Workers *pool )
+{
+  int i;
+
+  // The workers are parked at the barrier between runs.
+  for (i = 0; i < pool->num_threads; i++) {
+    dendrSetReset( &pool->workers[i].set );
+    pool->workers[i].busy = 0.0;
+    pool->workers[i].idle = 0.0;
+    pool->workers[i].steals = 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void workersStimulus( Workers *pool, const Stimulus *stim )
+{
+  int i;
+
+  // Like workersReset, only called while the workers are parked.
+  for (i = 0; i < pool->num_threads; i++) {
+    dendrSetStimulus( &pool->workers[i].set, stim,
+                      pool->workers[i].set.first );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int workersParams( Workers *pool, const DendrOverrides *ov )
+{
+  int i;
+
+  // Like workersReset, only called while the workers are parked.
+  for (i = 0; i < pool->num_threads; i++) {
+    if (!dendrSetParams( &pool->workers[i].set, ov,
+                         pool->workers[i].set.first )) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void workersReport( Workers *pool, FILE *out )
+{
+  Worker *w;
+  double total;
+  int i;
+
+  fprintf( out, "Worker time (%s schedule):\n",
+           pool->kernel.steal ? "work stealing" : "static" );
+  for (i = 0; i < pool->num_threads; i++) {
+    w = &pool->workers[i];
+    total = w->busy + w->idle;
+    fprintf( out, "  worker %2d: busy %8.3f s  idle %8.3f s (%5.1f%%)  "
+             "%ld chunks stolen\n", i, w->busy, w->idle,
+             total > 0 ? w->idle / total * 100.0 : 0.0, w->steals );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int workersMatch( Workers *pool, int num_threads, int num_dendrs,
+                  int num_comps, KernelOpts *kernel, PlaceOpts *place )
+{
+  if (num_threads > num_dendrs) {
+    num_threads = num_dendrs;
+  }
+
+  return pool->num_threads == num_threads &&
+         pool->num_dendrs == num_dendrs &&
+         pool->num_comps == num_comps &&
+         pool->kernel.kernel == kernel->kernel &&
+         pool->kernel.block_steps == kernel->block_steps &&
+         pool->kernel.tile == kernel->tile &&
+         pool->kernel.steps_per_ms == kernel->steps_per_ms &&
+         pool->kernel.reduce == kernel->reduce &&
+         pool->kernel.steal == (kernel->steal && !kernel->reduce) &&
+         pool->place.pin == place->pin &&
+         pool->place.num_cpus == place->num_cpus &&
+         memcmp( pool->place.cpus, place->cpus,
+                 place->num_cpus * sizeof(int) ) == 0 &&
+         pool->place.huge == place->huge &&
+         pool->place.first_touch == place->first_touch &&
+         pool->place.mbind == place->mbind;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void workersFree( Workers *pool )
+{
+  stopThreads( pool );
+  freePool( pool, pool->num_threads );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+double workersTime( int num_threads, int num_dendrs, int num_comps,
+                    KernelOpts *kernel, PlaceOpts *place, int steps,
+                    int repeats )
+{
+  Workers pool;
+  struct timeval start, stop, diff;
+  double secs, best = -1.0;
+  int r, s;
+
+  for (r = 0; r < repeats; r++) {
+    if (!workersInit( &pool, num_threads, num_dendrs, num_comps, kernel,
+                      place )) {
+      return -1.0;
+    }
+    gettimeofday( &start, NULL );
+    for (s = 0; s < steps; s++) {
+      workersStep( &pool, s % STEPS, 1.0 / (double) STEPS, VREST );
+    }
+    gettimeofday( &stop, NULL );
+    workersFree( &pool );
+
+    timersub( &stop, &start, &diff );
+    secs = (double) (diff.tv_sec) + (double) (diff.tv_usec) * 0.000001;
+    if (best < 0 || secs < best) {
+      best = secs;
+    }
+  }
+
+  return best;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int workersBenchmark( int num_threads, int num_dendrs, int num_comps,
+                      KernelOpts *kernel, PlaceOpts *place, int steps,
+                      FILE *out )
+{
+  PlaceOpts baseline;
+  char desc[ 128 ];
+  double base_time, conf_time, naive_ns, repro_ns;
+  double updates = (double) num_dendrs * (num_comps - 2) * steps;
+
+  placeDefaults( &baseline );
+  baseline.first_touch = 0;
+
+  base_time = workersTime( num_threads, num_dendrs, num_comps, kernel,
+                           &baseline, steps, BENCH_REPEATS );
+  conf_time = workersTime( num_threads, num_dendrs, num_comps, kernel, place,
+                           steps, BENCH_REPEATS );
+  if (base_time < 0 || conf_time < 0) {
+    return 0;
+  }
+
+  fprintf( out, "Placement benchmark: %d threads, %d dendrites x %d "
+           "compartments, %d steps, best of %d\n",
+           num_threads < num_dendrs ? num_threads : num_dendrs, num_dendrs,
+           num_comps - 2, steps, BENCH_REPEATS );
+  placeDescribe( &baseline, desc, sizeof(desc) );
+  fprintf( out, "  baseline:   %f s  %6.2f ns/compartment-step  (%s)\n",
+           base_time, base_time * 1e9 / updates, desc );
+  placeDescribe( place, desc, sizeof(desc) );
+  fprintf( out, "  configured: %f s  %6.2f ns/compartment-step  (%s)\n",
+           conf_time, conf_time * 1e9 / updates, desc );
+  fprintf( out, "  gain: %+.1f%%  (speedup %.2fx)\n",
+           (base_time - conf_time) / base_time * 100.0, base_time / conf_time );
+
+  // What the exact current sum of workersStep() costs over a plain one.
+  reproSumBenchmark( num_dendrs, steps, &naive_ns, &repro_ns );
+  fprintf( out, "  exact current sum: %.2f ns/dendrite (plain %.2f), %.2f%% "
+           "of the step time\n", repro_ns, naive_ns,
+           (repro_ns - naive_ns) * num_dendrs * steps / (conf_time * 1e9) *
+           100.0 );
+
+  return 1;
+}